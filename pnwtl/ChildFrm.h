@@ -329,6 +329,7 @@ public:
 
 	CTextView* GetTextView();
 	COutputView* GetOutputWindow();
+	bool IsOutputVisible();
 
 	HACCEL GetToolAccelerators();
 
@@ -371,7 +372,6 @@ private:
 	void PrintSetup();
 	void SchemeChanged(Scheme* pScheme);
 	void UpdateTools(Scheme* pScheme);
-	bool IsOutputVisible();
 	BOOL OnEscapePressed();
 	void Export(int type);
 	void SetModifiedOverride(bool bVal);
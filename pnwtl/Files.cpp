@@ -209,13 +209,17 @@ int CFile::Write(void* lpBuf, UINT nCount)
 	return (int)fwrite(lpBuf, nCount, 1, m_file);
 }
 
-void CFile::Close()
+bool CFile::Close()
 {
+	bool bClosed = true;
+
 	if(m_file != NULL)
 	{
-		fclose(m_file);
+		bClosed = fclose(m_file) == 0;
 		m_file = NULL;
 	}
+
+	return bClosed;
 }
 
 long CFile::GetPosition() const
@@ -63,7 +63,8 @@ class CFile
 		bool Open(LPCTSTR filename, UINT flags = 0);
 		int Read(void* lpBuf, UINT nCount);
 		int Write(void* lpBuf, UINT nCount);
-		void Close();
+		/// @return false if data still buffered couldn't be written
+		bool Close();
 		void Seek(UINT offset, EFrom from = begin);
 
 		int ShowError(LPCTSTR filename, LPCTSTR app, bool bOpen = true);
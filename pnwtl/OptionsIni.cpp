@@ -11,86 +11,74 @@
 #include "stdafx.h"
 #include "OptionsManager.h"
 #include "OptionsIni.h"
+#include "inifile.h"
 
-#pragma warning( push )
-#pragma warning(disable: 4996) // see MSDN on hash_map
-
-#if (_ATL_VER >= 0x0700)
-	#include <hash_map>
-	class IniKeyMap : public stdext::hash_map<tstring, tstring>{};
-#else
-	#include <map>
-	class IniKeyMap : public std::map<tstring, tstring>{};
-#endif
+using pnutils::threading::CritLock;
 
 IniOptions::IniOptions() : 
 	groupLocked(false), 
-	keyMap(new IniKeyMap()),
-	_filename(NULL)
+	loaded(false),
+	iniFile(new IniFile())
 {
-	tstring userSettingsPath;
-	GetPNPath(userSettingsPath, PNPATH_USERSETTINGS);
-	userSettingsPath += _T("UserSettings.ini");
-	_filename = new TCHAR[userSettingsPath.length()+1];
-	_tcscpy(_filename, userSettingsPath.c_str());
+	GetPNPath(_filename, PNPATH_USERSETTINGS);
+	_filename += _T("UserSettings.ini");
 }
 
 IniOptions::~IniOptions()
 {
-	if(keyMap)
-	{
-		delete keyMap;
-		keyMap = NULL;
-	}
+	save();
 
-	if(_filename)
+	if(iniFile)
 	{
-		delete [] _filename;
-		_filename = NULL;
+		delete iniFile;
+		iniFile = NULL;
 	}
 }
 
 void IniOptions::SetUserSettingsPath(LPCTSTR path)
 {
+	// Anything changed so far belongs in the old file:
+	save();
+
 	// Call the base class.
 	Options::SetUserSettingsPath(path);
 	
-	if(_filename)
-	{
-		delete [] _filename;
-		_filename = NULL;
-	}
-	
 	// Update our stored filename...
-	tstring userSettingsPath;
-	GetPNPath(userSettingsPath, PNPATH_USERSETTINGS);
-	userSettingsPath += _T("UserSettings.ini");
-	_filename = new TCHAR[userSettingsPath.length()+1];
-	_tcscpy(_filename, userSettingsPath.c_str());
+	CritLock lock(_cs);
+	GetPNPath(_filename, PNPATH_USERSETTINGS);
+	_filename += _T("UserSettings.ini");
+	iniFile->Clear();
+	loaded = false;
 }
 
 void IniOptions::Set(LPCTSTR subkey, LPCTSTR value, bool bVal)
 {
-	::WritePrivateProfileString(groupLocked ? _group : subkey, value, bVal ? _T("1") : _T("0"), _filename);
+	CritLock lock(_cs);
+	file().Set(groupLocked ? _group.c_str() : subkey, value, bVal ? _T("1") : _T("0"));
 }
 
 void IniOptions::Set(LPCTSTR subkey, LPCTSTR value, int iVal)
 {
 	TCHAR cbuf[40];
 	_itot(iVal, cbuf, 10);
-	::WritePrivateProfileString(groupLocked ? _group : subkey, value, cbuf, _filename);
+
+	CritLock lock(_cs);
+	file().Set(groupLocked ? _group.c_str() : subkey, value, cbuf);
 }
 
 void IniOptions::Set(LPCTSTR subkey, LPCTSTR value, uint64_t iVal)
 {
 	TCHAR cbuf[70];
 	_ui64tot(iVal, cbuf, 10);
-	::WritePrivateProfileString(groupLocked ? _group : subkey, value, cbuf, _filename);
+
+	CritLock lock(_cs);
+	file().Set(groupLocked ? _group.c_str() : subkey, value, cbuf);
 }
 
 void IniOptions::Set(LPCTSTR subkey, LPCTSTR value, LPCTSTR szVal)
 {
-	::WritePrivateProfileString(groupLocked ? _group : subkey, value, szVal, _filename);
+	CritLock lock(_cs);
+	file().Set(groupLocked ? _group.c_str() : subkey, value, szVal);
 }
 
 
@@ -101,121 +89,90 @@ bool IniOptions::Get(LPCTSTR subkey, LPCTSTR value, bool bDefault)
 
 int IniOptions::Get(LPCTSTR subkey, LPCTSTR value, int iDefault)
 {
-	if(groupLocked)
-	{
-		IniKeyMap::const_iterator i = keyMap->find(tstring(value));
-		if(i != keyMap->end())
-			return _ttoi((*i).second.c_str());
-		else
-			return iDefault;
-	}
+	CritLock lock(_cs);
+
+	const tstring* val = file().Get(groupLocked ? _group.c_str() : subkey, value);
+	if(val != NULL)
+		return _ttoi(val->c_str());
 	else
-	{
-		return GetPrivateProfileInt(subkey, value, iDefault, _filename);
-	}
+		return iDefault;
 }
 
 uint64_t IniOptions::Get(LPCTSTR subkey, LPCTSTR value, uint64_t iDefault)
 {
-	if(groupLocked)
+	CritLock lock(_cs);
+
+	const tstring* val = file().Get(groupLocked ? _group.c_str() : subkey, value);
+	if(val != NULL && val->size())
 	{
-		IniKeyMap::const_iterator i = keyMap->find(tstring(value));
-		if(i != keyMap->end())
-		{
-			TCHAR* end(NULL);
-			return _tcstoui64((*i).second.c_str(), &end, 10);
-		}
-		else
-			return iDefault;
+		TCHAR* end(NULL);
+		return _tcstoui64(val->c_str(), &end, 10);
 	}
 	else
-	{
-		tstring srep = Get(subkey, value, _T(""));
-		if (srep.size())
-		{
-			TCHAR* end(NULL);
-			return _tcstoui64(srep.c_str(), &end, 10);
-		}
-		else
-		{
-			return iDefault;
-		}
-	}
+		return iDefault;
 }
 
 tstring IniOptions::Get(LPCTSTR subkey, LPCTSTR value, LPCTSTR szDefault)
 {
-	if(groupLocked)
-	{
-		IniKeyMap::const_iterator i = keyMap->find(tstring(value));
-		if(i != keyMap->end())
-			return (*i).second;
-		else
-			return tstring(szDefault);
-	}
-	else
-	{
-		GArray<TCHAR> tcbuf;
-	
-		int nBufferLen = 64;
-		int nLen;
-		do
-		{
-			nBufferLen *= 2;
-			tcbuf.grow(nBufferLen);
-			nLen = ::GetPrivateProfileString(subkey, value, szDefault, &tcbuf[0], nBufferLen, _filename);
-		}
-		while (nLen == nBufferLen-1);
+	CritLock lock(_cs);
 
-		return tstring(&tcbuf[0]);
-	}
+	const tstring* val = file().Get(groupLocked ? _group.c_str() : subkey, value);
+	if(val != NULL)
+		return *val;
+	else
+		return tstring(szDefault);
 }
 
 void IniOptions::Clear(LPCTSTR subkey)
 {
-	const TCHAR* emptySection = _T("\0");
-	::WritePrivateProfileSection(subkey, emptySection, _filename);
+	CritLock lock(_cs);
+	file().ClearSection(subkey);
 }
 
 void IniOptions::group(LPCTSTR location)
 {
-	//The return value specifies the number of characters copied to the buffer, not including the terminating null character. If the buffer is not large enough to contain all the key name and value pairs associated with the named section, the return value is equal to nSize minus two.
-	DWORD bufsize = 2048;
-	TCHAR* buffer = new TCHAR[bufsize];
-	while( GetPrivateProfileSection(location, buffer, bufsize, _filename) == (bufsize -2) )
-	{
-		bufsize *= 2;
-		delete [] buffer;
-		buffer = new TCHAR[bufsize];
-	}
+	CritLock lock(_cs);
+	groupLocked = true;
+	_group = location;
+}
 
-	TCHAR* p = buffer;
-	TCHAR* comma;
-	while(*p)
+void IniOptions::ungroup()
+{
 	{
-		comma = _tcschr(p, _T('='));
+		CritLock lock(_cs);
+		groupLocked = false;
+	}
 
-		if (comma == NULL)
-		{
-			break;
-		}
+	// Group operations are how settings get saved, so write them out now:
+	save();
+}
 
-		*comma = NULL;
-		comma++;
-		keyMap->insert(IniKeyMap::value_type(tstring(p), tstring(comma)));
-		p = comma + _tcslen(comma) + 1;
+/**
+ * Call with the lock held, the file is read the first time it's needed.
+ */
+IniFile& IniOptions::file()
+{
+	if(!loaded)
+	{
+		iniFile->Load(_filename.c_str());
+		loaded = true;
 	}
 
-	delete [] buffer;
-
-	groupLocked = true;
-	_group = location;
+	return *iniFile;
 }
 
-void IniOptions::ungroup()
+/**
+ * Write out changed sections in one go.
+ */
+void IniOptions::save()
 {
-	keyMap->clear();
-	groupLocked = false;
-}
+	CritLock lock(_cs);
 
-#pragma warning( pop ) // 4996 - deprecated hash_map.
\ No newline at end of file
+	if(loaded && iniFile->IsDirty())
+	{
+		if(!iniFile->Save(_filename.c_str()))
+		{
+			LOG(_T("PN2: Failed to write user settings ini file.\n"));
+		}
+	}
+}
@@ -2,7 +2,7 @@
  * @file OptionsIni.h
  * @brief Ini configuration functionality.
  * @author Simon Steele
- * @note Copyright (c) 2004 Simon Steele - http://untidy.net/
+ * @note Copyright (c) 2004-2011 Simon Steele - http://untidy.net/
  *
  * Programmers Notepad 2 : The license file (license.[txt|html]) describes 
  * the conditions under which this source may be modified / distributed.
@@ -11,8 +11,15 @@
 #ifndef inioptions_h__included
 #define inioptions_h__included
 
-class IniKeyMap;
+#include "include/threading.h"
 
+class IniFile;
+
+/**
+ * Options stored in UserSettings.ini. The file is read the first time an
+ * option is needed and kept in memory, changes are written back at the end
+ * of a group operation and when the options are released.
+ */
 class IniOptions : public Options
 {
 	friend class OptionsFactory;
@@ -40,10 +47,15 @@ protected:
 	virtual void group(LPCTSTR location);
 	virtual void ungroup();
 
+	IniFile& file();
+	void save();
+
 	bool groupLocked;
-	IniKeyMap* keyMap;
-	TCHAR*	_filename;
-	LPCTSTR _group;
+	bool loaded;
+	IniFile* iniFile;
+	tstring _filename;
+	tstring _group;
+	pnutils::threading::CriticalSection _cs;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -161,6 +161,7 @@ LRESULT COptionsPageClips::OnEditClipClicked(WORD /*wNotifyCode*/, WORD /*wID*/,
 		clip->Shortcut = editor.GetShortcut();
 		clip->Text = editor.GetText();
 		clip->Name = editor.GetHint();
+		m_pCurSet->ClipChanged(clip);
 
 		CA2CT scconv(clip->Shortcut.c_str());
 		
@@ -69,104 +69,30 @@ XmlOptions::~XmlOptions()
 
 void XmlOptions::Set(LPCTSTR subkey, LPCTSTR value, bool bVal)
 {
-	if (!m_loaded)
-	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	tstring sVal(bVal ? _T("true") : _T("false"));
-	map_type::iterator i = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (i != m_options.end())
-	{
-		(*i).second.swap(sVal);
-	}
-	else
-	{
-		m_options.insert(map_type::value_type((tstring(subkey) + _T(".")) + value, sVal));
-	}
+	m_options.Set(intern(subkey, value), bVal);
 }
 
 void XmlOptions::Set(LPCTSTR subkey, LPCTSTR value, int iVal)
 {
-	if (!m_loaded)
-	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	TCHAR cbuf[40];
-	_itot(iVal, cbuf, 10);
-
-	map_type::iterator i = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (i != m_options.end())
-	{
-		(*i).second = cbuf;
-	}
-	else
-	{
-		m_options.insert(map_type::value_type((tstring(subkey) + _T(".")) + value, cbuf));
-	}
+	m_options.Set(intern(subkey, value), iVal);
 }
 
 void XmlOptions::Set(LPCTSTR subkey, LPCTSTR value, uint64_t iVal)
 {
-	if (!m_loaded)
-	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	TCHAR cbuf[70];
-	_ui64tot(iVal, cbuf, 10);
-
-	map_type::iterator i = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (i != m_options.end())
-	{
-		(*i).second = cbuf;
-	}
-	else
-	{
-		m_options.insert(map_type::value_type((tstring(subkey) + _T(".")) + value, cbuf));
-	}
+	m_options.Set(intern(subkey, value), iVal);
 }
 
 void XmlOptions::Set(LPCTSTR subkey, LPCTSTR value, LPCTSTR szVal)
 {
-	if (!m_loaded)
-	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	map_type::iterator i = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (i != m_options.end())
-	{
-		(*i).second = szVal;
-	}
-	else
-	{
-		m_options.insert(map_type::value_type((tstring(subkey) + _T(".")) + value, szVal));
-	}
+	m_options.Set(intern(subkey, value), szVal);
 }
 
 bool XmlOptions::Get(LPCTSTR subkey, LPCTSTR value, bool bDefault)
 {
-	if (!m_loaded)
-	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	map_type::const_iterator it = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (it != m_options.end() && (*it).second.size())
+	OptionsStore::Handle option = find(subkey, value);
+	if (option != OptionsStore::NoHandle && m_options.GetString(option).size())
 	{
-		return (*it).second[0] == 't' || (*it).second[0] == 'T';
+		return m_options.GetBool(option);
 	}
 
 	return bDefault;
@@ -174,17 +100,10 @@ bool XmlOptions::Get(LPCTSTR subkey, LPCTSTR value, bool bDefault)
 
 int XmlOptions::Get(LPCTSTR subkey, LPCTSTR value, int iDefault)
 {
-	if (!m_loaded)
+	OptionsStore::Handle option = find(subkey, value);
+	if (option != OptionsStore::NoHandle)
 	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	map_type::const_iterator it = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (it != m_options.end())
-	{
-		return _ttoi((*it).second.c_str());
+		return m_options.GetInt(option);
 	}	
 
 	return iDefault;
@@ -192,18 +111,10 @@ int XmlOptions::Get(LPCTSTR subkey, LPCTSTR value, int iDefault)
 
 uint64_t XmlOptions::Get(LPCTSTR subkey, LPCTSTR value, uint64_t iDefault)
 {
-	if (!m_loaded)
+	OptionsStore::Handle option = find(subkey, value);
+	if (option != OptionsStore::NoHandle)
 	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	map_type::const_iterator it = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (it != m_options.end())
-	{
-		TCHAR* end(NULL);
-		return _tcstoui64((*it).second.c_str(), &end, 10);
+		return m_options.GetUInt64(option);
 	}
 
 	return iDefault;
@@ -211,17 +122,10 @@ uint64_t XmlOptions::Get(LPCTSTR subkey, LPCTSTR value, uint64_t iDefault)
 
 tstring XmlOptions::Get(LPCTSTR subkey, LPCTSTR value, LPCTSTR szDefault)
 {
-	if (!m_loaded)
-	{
-		load();
-	}
-
-	subkey = m_groupLocked ? (m_group.c_str()) : subkey;
-
-	map_type::const_iterator it = m_options.find((tstring(subkey) + _T(".")) + value);
-	if (it != m_options.end())
+	OptionsStore::Handle option = find(subkey, value);
+	if (option != OptionsStore::NoHandle)
 	{
-		return (*it).second;
+		return m_options.GetString(option);
 	}
 
 	return szDefault;
@@ -237,7 +141,7 @@ void XmlOptions::SetUserSettingsPath(LPCTSTR path)
 	GetPNPath(m_userSettingsPath, PNPATH_USERSETTINGS);
 	m_userSettingsPath += _T("UserSettings.xml");
 	m_loaded = false;
-	m_options.clear();
+	m_options.Clear();
 }
 
 void XmlOptions::group(LPCTSTR location)
@@ -270,15 +174,47 @@ void XmlOptions::save()
 
 	writer.StartConfig();
 
-	for(map_type::const_iterator i = m_options.begin(); i != m_options.end(); ++i)
+	std::vector<OptionsStore::Handle> options;
+	m_options.GetSorted(options);
+
+	for(std::vector<OptionsStore::Handle>::const_iterator i = options.begin(); i != options.end(); ++i)
 	{
-		writer.WriteOption((*i).first.c_str(), (*i).second.c_str());
+		writer.WriteOption(m_options.GetKey(*i).c_str(), m_options.GetString(*i).c_str());
 	}
 
 	writer.EndConfig();
 	writer.Close();
 }
 
+/**
+ * @return the option, or NoHandle if it doesn't have a value
+ */
+OptionsStore::Handle XmlOptions::find(LPCTSTR subkey, LPCTSTR value)
+{
+	if (!m_loaded)
+	{
+		load();
+	}
+
+	OptionsStore::Handle option = m_options.Find(m_groupLocked ? m_group.c_str() : subkey, value);
+	if (option != OptionsStore::NoHandle && !m_options.HasValue(option))
+	{
+		return OptionsStore::NoHandle;
+	}
+
+	return option;
+}
+
+OptionsStore::Handle XmlOptions::intern(LPCTSTR subkey, LPCTSTR value)
+{
+	if (!m_loaded)
+	{
+		load();
+	}
+
+	return m_options.Intern(m_groupLocked ? m_group.c_str() : subkey, value);
+}
+
 void XmlOptions::startElement(LPCTSTR name, const XMLAttributes& atts)
 {
 	if (*name != NULL && *name == _T('o') && *(name+1) == NULL)
@@ -289,7 +225,7 @@ void XmlOptions::startElement(LPCTSTR name, const XMLAttributes& atts)
 
 void XmlOptions::endElement(LPCTSTR name)
 {
-	m_options.insert(map_type::value_type(m_element, m_value));
+	m_options.Load(m_element, m_value);
 	m_value.clear();
 }
 
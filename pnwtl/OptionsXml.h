@@ -11,6 +11,8 @@
 #ifndef xmloptions_h__included
 #define xmloptions_h__included
 
+#include "optionsstore.h"
+
 class XmlOptions : public Options, private XMLParseState
 {
 	friend class OptionsFactory;
@@ -47,9 +49,11 @@ private:
 	void load();
 	void save();
 
+	OptionsStore::Handle find(LPCTSTR subkey, LPCTSTR value);
+	OptionsStore::Handle intern(LPCTSTR subkey, LPCTSTR value);
+
 	bool m_groupLocked;
-	typedef std::map<tstring, tstring> map_type;
-	map_type m_options;
+	OptionsStore m_options;
 	tstring m_group;
 	tstring m_userSettingsPath;
 	tstring m_element;
@@ -112,6 +112,8 @@ void SchemeManager::GetCompiledPath(tstring& csPath) const
 
 void SchemeManager::Load()
 {
+	PNTRACE_SPAN("scheme", "SchemeManager::Load");
+
 	if (!internalLoad(false))
 	{
 		internalLoad(true);
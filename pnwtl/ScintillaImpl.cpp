@@ -233,6 +233,15 @@ int CScintillaImpl::HandleNotify(LPARAM lParam)
 				SetLineNumberWidth();
 			}
 
+			if (scn->modificationType & SC_MOD_INSERTTEXT)
+			{
+				m_stats.Inserted(scn->position, scn->length);
+			}
+			else if (scn->modificationType & SC_MOD_DELETETEXT)
+			{
+				m_stats.Deleted(scn->position, scn->length);
+			}
+
 			break;
 		}
 
@@ -380,57 +389,76 @@ int CScintillaImpl::HandleNotify(LPARAM lParam)
 ////////////////////////////////////////////////////////////
 // Word Count
 
-#include "include/wordcounter.h"
-
-template <int TBlockSize = 131072>
-class ScintillaWordCounter : public WordCounter< ScintillaWordCounter<TBlockSize> >
+/**
+ * Feeds document statistics straight from Scintilla.
+ */
+class ScintillaStatsSource : public IDocStatsSource
 {
-	friend class WordCounter<ScintillaWordCounter>;
-
 	public:
-		ScintillaWordCounter(CScintilla* sc)
-		{
-			pScintilla = sc;
-			length = pScintilla->GetLength();
-			pos = 0;
-			actualPos = 0;
-		}
-		
-	protected:
-		char getNextChar()
-		{
-			if(pos == 0)
-			{
-				int grabSize = length - actualPos;
-				if (grabSize > TBlockSize)
-					grabSize = TBlockSize;
-				Scintilla::TextRange tr;
-				tr.chrg.cpMin = actualPos;
-				tr.chrg.cpMax = actualPos + grabSize;
-				tr.lpstrText = buffer;
-				pScintilla->GetTextRange(&tr);
-			}
-			int oldpos = pos;
-			pos = (pos+1) % TBlockSize;
-			return buffer[oldpos];
-		}
+		ScintillaStatsSource(CScintilla* sc) : pScintilla(sc) {}
 
-		int getLength()
+		virtual void GetText(int start, int end, char* buffer)
 		{
-			return length;
+			Scintilla::TextRange tr;
+			tr.chrg.cpMin = start;
+			tr.chrg.cpMax = end;
+			tr.lpstrText = buffer;
+			pScintilla->GetTextRange(&tr);
 		}
 
-		int length;
-		int pos;
-		int actualPos;
+	private:
 		CScintilla* pScintilla;
-		char buffer[TBlockSize+1];
 };
 
+/**
+ * Only the blocks changed since the last call are counted again.
+ */
+const TextStats& CScintillaImpl::GetTextStats()
+{
+	ScintillaStatsSource source(this);
+	m_stats.Update(source, GetLength());
+	return m_stats.GetStats();
+}
+
+/**
+ * @return true if GetTextStats only has to count what changed since the last call.
+ */
+bool CScintillaImpl::HaveTextStats()
+{
+	return m_stats.IsCounted(GetLength());
+}
+
+/**
+ * Count some more of a document that's never been counted. This is left
+ * until the UI is idle and done a few blocks at a time, so a big document
+ * takes several calls and input is handled in between.
+ * @return true if the count has just finished
+ */
+bool CScintillaImpl::CountTextStats()
+{
+	if (HaveTextStats())
+	{
+		return false;
+	}
+
+	// Sixteen of DocStats' 64Kb blocks:
+	const int blocksPerCall = 16;
+
+	ScintillaStatsSource source(this);
+	return m_stats.UpdateSome(source, GetLength(), blocksPerCall);
+}
+
+/**
+ * Call when changes may have been missed, e.g. while notifications were off.
+ */
+void CScintillaImpl::ResetTextStats()
+{
+	m_stats.Reset();
+}
+
 int CScintillaImpl::GetWordCount()
 {
-	ScintillaWordCounter<> counter(this);
-	return counter.count();
+	return GetTextStats().Words;
 }
 
 ////////////////////////////////////////////////////////////
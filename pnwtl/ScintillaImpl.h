@@ -13,6 +13,7 @@
 
 #include "scintillaif.h"
 #include "scintillaiterator.h"
+#include "docstats.h"
 
 namespace { class ISearchOptions; }
 class IWordProvider;
@@ -62,6 +63,10 @@ public:
 	virtual int HandleNotify(LPARAM lParam);
 
 	int GetWordCount();
+	const TextStats& GetTextStats();
+	bool HaveTextStats();
+	bool CountTextStats();
+	void ResetTextStats();
 
 	void IndentLine(int line, int indent);
 	
@@ -156,6 +161,7 @@ private:
 	boost::shared_ptr<IWordProvider> m_autoComplete;
 	AutoCompleteHandlerPtr m_autoCompleteHandler;
 	AutoCompleteManager* m_autoCompleteManager;
+	DocStats m_stats;
 };
 
 #endif // scintillaimpl_h__included
\ No newline at end of file
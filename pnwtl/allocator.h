@@ -58,7 +58,7 @@ public:
 	{
 		PNASSERT(oldNoofTs < noofTs);
 
-		T* newMem = Alloc(noofTs);
+		T* newMem = this->Alloc(noofTs);
 		if(newMem == NULL)
 		{
 			return NULL;
@@ -66,7 +66,7 @@ public:
 
 		memcpy(newMem, mem, oldNoofTs * sizeof(T));
 
-		Free(mem);
+		this->Free(mem);
 
 		return newMem;
 	}
@@ -0,0 +1,451 @@
+/**
+ * @file batchexport.cpp
+ * @brief Export many files to HTML or RTF in the background
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "batchexport.h"
+#include "toolscheduler.h"
+#include "SchemeManager.h"
+#include "textfileloader.h"
+
+using pnutils::threading::CritLock;
+
+/// Past this many threads the disk is the bottleneck, not the lexing
+#define MAX_EXPORT_WORKERS 8
+
+////////////////////////////////////////////////////////////////////////////////
+// OutputExportSink
+
+OutputExportSink::OutputExportSink(extensions::ITextOutput* output) : m_output(output)
+{
+}
+
+void OutputExportSink::OnBeginExport(LPCTSTR outputPath)
+{
+	tstring msg(_T("> Exporting to "));
+	msg += outputPath;
+	msg += _T("\n");
+	m_output->AddToolOutput(msg.c_str());
+}
+
+void OutputExportSink::OnFileExported(LPCTSTR sourceFile, LPCTSTR outputFile, LPCTSTR error)
+{
+	tstring msg(sourceFile);
+	if (error == NULL)
+	{
+		msg += _T(" -> ");
+		msg += outputFile;
+	}
+	else
+	{
+		msg += _T(": export failed, ");
+		msg += error;
+	}
+
+	msg += _T("\n");
+	m_output->AddToolOutput(msg.c_str());
+}
+
+void OutputExportSink::OnEndExport(int nExported, int nFailed, bool bCancelled)
+{
+	TCHAR buf[128];
+	_sntprintf(buf, 128, _T("> %s: %d exported, %d failed\n"), bCancelled ? _T("Export cancelled") : _T("Export finished"), nExported, nFailed);
+	buf[127] = 0;
+	m_output->AddToolOutput(buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// OffscreenScintilla
+
+OffscreenScintilla::OffscreenScintilla()
+{
+	m_scihWnd = NULL;
+}
+
+OffscreenScintilla::~OffscreenScintilla()
+{
+	PNASSERT(m_scihWnd == NULL);
+}
+
+bool OffscreenScintilla::Create()
+{
+	// A message-only window, it never needs painting or input:
+	m_scihWnd = ::CreateWindowEx(0, _T("Scintilla"), _T(""), WS_POPUP, 0, 0, 0, 0, HWND_MESSAGE, NULL, ModuleHelper::GetModuleInstance(), NULL);
+	if (m_scihWnd == NULL)
+	{
+		return false;
+	}
+
+	m_Pointer = (void *)SPerform(SCI_GETDIRECTPOINTER);
+	Perform = (scmsgfn)SPerform(SCI_GETDIRECTFUNCTION);
+
+	return true;
+}
+
+void OffscreenScintilla::Destroy()
+{
+	if (m_scihWnd != NULL)
+	{
+		::DestroyWindow(m_scihWnd);
+		m_scihWnd = NULL;
+		Perform = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SchemeSnapshot
+
+SchemeSnapshot::SchemeSnapshot(Scheme* pScheme)
+{
+	// Loading changes the scheme and reads the options, which is only safe
+	// on the UI thread. Only the settings for the view are left out:
+	pScheme->Load(*this, false);
+
+	m_name = pScheme->GetName();
+	m_styles.reset(pScheme->CreateStylesList());
+}
+
+void SchemeSnapshot::Apply(CScintilla& sc) const
+{
+	for (MESSAGES::const_iterator i = m_messages.begin(); i != m_messages.end(); ++i)
+	{
+		const Message& msg = *i;
+		WPARAM wParam = msg.HasWText ? reinterpret_cast<WPARAM>(msg.WText.c_str()) : msg.WParam;
+		LPARAM lParam = msg.HasLText ? reinterpret_cast<LPARAM>(msg.LText.c_str()) : 0;
+
+		sc.SPerform(msg.Msg, wParam, lParam);
+	}
+}
+
+const char* SchemeSnapshot::GetName() const
+{
+	return m_name.c_str();
+}
+
+StylesList* SchemeSnapshot::GetStyles() const
+{
+	return m_styles.get();
+}
+
+/**
+ * Keep the messages that change how text is lexed or exported, the rest
+ * only matter for showing it. Strings are copied, the scheme's buffers
+ * are gone once Load returns.
+ */
+void SchemeSnapshot::Record(long Msg, WPARAM wParam, LPARAM lParam)
+{
+	switch (Msg)
+	{
+		case SCI_SETLEXER:
+		case SCI_SETSTYLEBITS:
+		case SCI_SETTABWIDTH:
+			m_messages.push_back(Message(Msg, wParam, NULL, NULL));
+			break;
+
+		case SCI_SETKEYWORDS:
+			m_messages.push_back(Message(Msg, wParam, NULL, reinterpret_cast<const char*>(lParam)));
+			break;
+
+		case SCI_SETLEXERLANGUAGE:
+		case SCI_SETWORDCHARS:
+			m_messages.push_back(Message(Msg, 0, NULL, reinterpret_cast<const char*>(lParam)));
+			break;
+
+		case SCI_SETPROPERTY:
+			m_messages.push_back(Message(Msg, 0, reinterpret_cast<const char*>(wParam), reinterpret_cast<const char*>(lParam)));
+			break;
+	}
+}
+
+SchemeSnapshot::Message::Message(long msg, WPARAM wParam, const char* wText, const char* lText) :
+	Msg(msg),
+	WParam(wParam),
+	HasWText(wText != NULL),
+	HasLText(lText != NULL),
+	WText(wText ? wText : ""),
+	LText(lText ? lText : "")
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BatchExportWorker
+
+BatchExportWorker::BatchExportWorker(BatchExport* pOwner) :
+	m_pOwner(pOwner),
+	m_pScheme(NULL)
+{
+}
+
+BatchExportWorker::~BatchExportWorker()
+{
+	Stop();
+}
+
+void BatchExportWorker::Run()
+{
+	Tracer::SetThreadName("Batch Export");
+
+	if (m_sc.Create())
+	{
+		m_pScheme = NULL;
+
+		BatchExportJob job;
+		while (GetCanRun() && m_pOwner->next(job))
+		{
+			LPCTSTR error = exportFile(job);
+			m_pOwner->fileDone(job.File.c_str(), job.OutputFile.c_str(), error);
+		}
+
+		// Let go of the text and the scheme before the next run:
+		m_sc.SPerform(SCI_CLEARALL);
+		m_sc.Destroy();
+		m_pScheme = NULL;
+	}
+
+	m_pOwner->workerDone();
+}
+
+void BatchExportWorker::OnException()
+{
+	m_sc.Destroy();
+
+	LOG(_T("PN2: Exception whilst exporting files.\n"));
+
+	m_pOwner->workerDone();
+}
+
+/**
+ * @return NULL once the file is written, or why it couldn't be
+ */
+LPCTSTR BatchExportWorker::exportFile(const BatchExportJob& job)
+{
+	PNTRACE_SPAN("export", "BatchExportWorker::exportFile");
+
+	const SchemeSnapshot& scheme = *job.Scheme;
+	if (scheme.GetStyles() == NULL)
+	{
+		return _T("no styles for its scheme");
+	}
+
+	CFile file;
+	if (!file.Open(job.File.c_str(), CFile::modeRead | CFile::modeBinary))
+	{
+		return _T("it could not be read");
+	}
+
+	// Files of the same type tend to come together:
+	if (&scheme != m_pScheme)
+	{
+		scheme.Apply(m_sc);
+		m_pScheme = &scheme;
+	}
+
+	// Undo stays off, so SCI_CLEARALL doesn't keep a copy of the last file:
+	m_sc.SPerform(SCI_SETUNDOCOLLECTION, 0);
+	m_sc.SPerform(SCI_EMPTYUNDOBUFFER);
+	m_sc.SPerform(SCI_CLEARALL);
+
+	// Read it as the editor would, so Unicode files export as text:
+	EPNEncoding encoding = eUnknown;
+	LoadTextFile(m_sc, file, blockSize, encoding);
+	file.Close();
+
+	CFileName fn(job.OutputFile);
+	CreateDirectoryRecursive(fn.GetPath().c_str());
+
+	FileOutput out(job.OutputFile.c_str());
+	if (!out.IsValid())
+	{
+		return _T("the output file could not be created");
+	}
+
+	ScintillaStyledText source(&m_sc);
+	std::auto_ptr<BaseExporter> exporter(ExporterFactory::GetExporter(m_pOwner->m_type, &out, scheme.GetName(), scheme.GetStyles(), &source));
+	exporter->Export(0, -1);
+
+	if (!out.Close())
+	{
+		// Don't leave half a file looking like an export:
+		::DeleteFile(job.OutputFile.c_str());
+		return _T("the output file could not be written");
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BatchExport
+
+BatchExport::BatchExport() :
+	m_type(ExporterFactory::HTML),
+	m_nExported(0),
+	m_nFailed(0),
+	m_running(0),
+	m_bCancelled(false)
+{
+}
+
+BatchExport::~BatchExport()
+{
+	Stop();
+}
+
+bool BatchExport::Start(ExporterFactory::EExporterType type, FileItPtr& files, LPCTSTR basePath, LPCTSTR outputPath, BatchExportSinkPtr sink)
+{
+	PNASSERT(sink.get() != NULL);
+
+	if (IsRunning())
+	{
+		return false;
+	}
+
+	std::auto_ptr<BaseExporter> exporter(ExporterFactory::GetExporter(type, NULL, NULL, NULL, NULL));
+	if (!exporter.get())
+	{
+		return false;
+	}
+
+	m_queue.Reset(basePath, outputPath, exporter->GetDefaultExtension());
+
+	// Resolve the schemes here, each is loaded once for all its files:
+	typedef std::map<Scheme*, SchemeSnapshotPtr> SNAPSHOTS;
+	SNAPSHOTS snapshots;
+
+	tstring file;
+	while (files->Next(file))
+	{
+		Scheme* pScheme = SchemeManager::GetInstance()->SchemeForFile(file.c_str());
+
+		SNAPSHOTS::const_iterator snapshot = snapshots.find(pScheme);
+		if (snapshot == snapshots.end())
+		{
+			snapshot = snapshots.insert(SNAPSHOTS::value_type(pScheme, SchemeSnapshotPtr(new SchemeSnapshot(pScheme)))).first;
+		}
+
+		m_queue.Add(file, (*snapshot).second);
+	}
+
+	m_type = type;
+	m_sink = sink;
+	m_nExported = 0;
+	m_nFailed = 0;
+	m_bCancelled = false;
+
+	size_t workers = ToolScheduler::GetProcessorCount();
+	if (workers > MAX_EXPORT_WORKERS)
+	{
+		workers = MAX_EXPORT_WORKERS;
+	}
+
+	while (m_workers.size() < workers)
+	{
+		m_workers.push_back(BatchExportWorkerPtr(new BatchExportWorker(this)));
+	}
+
+	m_sink->OnBeginExport(outputPath);
+
+	m_running = static_cast<LONG>(m_workers.size());
+	for (std::vector<BatchExportWorkerPtr>::const_iterator i = m_workers.begin(); i != m_workers.end(); ++i)
+	{
+		(*i)->Start();
+	}
+
+	return true;
+}
+
+void BatchExport::Cancel()
+{
+	m_bCancelled = true;
+	m_queue.Clear();
+
+	for (std::vector<BatchExportWorkerPtr>::const_iterator i = m_workers.begin(); i != m_workers.end(); ++i)
+	{
+		(*i)->SetCanRun(false);
+	}
+}
+
+void BatchExport::Stop()
+{
+	Cancel();
+
+	{
+		CritLock lock(m_cs);
+		m_sink.reset();
+	}
+
+	// Each worker finishes the file it's on, CSSThread::Stop would give up
+	// on a long one and terminate the thread part way through:
+	for (std::vector<BatchExportWorkerPtr>::const_iterator i = m_workers.begin(); i != m_workers.end(); ++i)
+	{
+		::WaitForSingleObject((*i)->GetStoppedHandle(), INFINITE);
+	}
+}
+
+bool BatchExport::IsRunning()
+{
+	return m_running != 0;
+}
+
+/**
+ * Called by the workers to get the next file to export.
+ */
+bool BatchExport::next(BatchExportJob& job)
+{
+	if (m_bCancelled)
+	{
+		return false;
+	}
+
+	return m_queue.Next(job);
+}
+
+void BatchExport::fileDone(LPCTSTR file, LPCTSTR outputFile, LPCTSTR error)
+{
+	BatchExportSinkPtr sink;
+
+	{
+		CritLock lock(m_cs);
+		if (error == NULL)
+		{
+			m_nExported++;
+		}
+		else
+		{
+			m_nFailed++;
+		}
+
+		sink = m_sink;
+	}
+
+	if (sink.get())
+	{
+		sink->OnFileExported(file, outputFile, error);
+	}
+}
+
+/**
+ * Called as each worker finishes, the last one out reports the end.
+ */
+void BatchExport::workerDone()
+{
+	if (::InterlockedDecrement(&m_running) == 0)
+	{
+		BatchExportSinkPtr sink;
+
+		{
+			CritLock lock(m_cs);
+			sink.swap(m_sink);
+		}
+
+		if (sink.get())
+		{
+			sink->OnEndExport(m_nExported, m_nFailed, m_bCancelled);
+		}
+	}
+}
@@ -0,0 +1,190 @@
+/**
+ * @file batchexport.h
+ * @brief Export many files to HTML or RTF in the background
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef batchexport_h__included
+#define batchexport_h__included
+
+#include "include/ssthreads.h"
+#include "include/threading.h"
+#include "exporters.h"
+#include "findinfiles.h"
+#include "batchexportqueue.h"
+
+class Scheme;
+
+/**
+ * Told about a batch export as it happens, calls come from the worker
+ * threads so implementations must be safe to call from any thread.
+ */
+class BatchExportSink
+{
+	public:
+		virtual ~BatchExportSink(){}
+
+		virtual void OnBeginExport(LPCTSTR outputPath) = 0;
+		/// error is NULL if the file was exported, or says why it wasn't
+		virtual void OnFileExported(LPCTSTR sourceFile, LPCTSTR outputFile, LPCTSTR error) = 0;
+		virtual void OnEndExport(int nExported, int nFailed, bool bCancelled) = 0;
+};
+
+typedef boost::shared_ptr<BatchExportSink> BatchExportSinkPtr;
+
+/**
+ * BatchExportSink that reports to an output window.
+ */
+class OutputExportSink : public BatchExportSink
+{
+	public:
+		explicit OutputExportSink(extensions::ITextOutput* output);
+
+		virtual void OnBeginExport(LPCTSTR outputPath);
+		virtual void OnFileExported(LPCTSTR sourceFile, LPCTSTR outputFile, LPCTSTR error);
+		virtual void OnEndExport(int nExported, int nFailed, bool bCancelled);
+
+	private:
+		extensions::ITextOutput* m_output;
+};
+
+/**
+ * A Scintilla window that is never shown, for loading and lexing files
+ * away from the UI. The window belongs to the thread that calls Create.
+ */
+class OffscreenScintilla : public CScintilla
+{
+	public:
+		OffscreenScintilla();
+		virtual ~OffscreenScintilla();
+
+		bool Create();
+		void Destroy();
+};
+
+/**
+ * The settings of a scheme that change how a file is lexed and exported,
+ * taken by loading the scheme on the UI thread. Workers apply them to
+ * their own Scintilla without touching the Scheme or the options.
+ */
+class SchemeSnapshot : private CRecordingScintilla
+{
+	public:
+		explicit SchemeSnapshot(Scheme* pScheme);
+
+		void Apply(CScintilla& sc) const;
+
+		const char* GetName() const;
+
+		/// NULL if the scheme's styles couldn't be read
+		StylesList* GetStyles() const;
+
+	protected:
+		virtual void Record(long Msg, WPARAM wParam, LPARAM lParam);
+
+	private:
+		/// A message with any string arguments copied
+		class Message
+		{
+			public:
+				Message(long msg, WPARAM wParam, const char* wText, const char* lText);
+
+				long Msg;
+				WPARAM WParam;
+				bool HasWText;
+				bool HasLText;
+				std::string WText;
+				std::string LText;
+		};
+
+		typedef std::vector<Message> MESSAGES;
+
+		std::string						m_name;
+		boost::shared_ptr<StylesList>	m_styles;
+		MESSAGES						m_messages;
+};
+
+class BatchExport;
+
+/**
+ * Takes files from a BatchExport one at a time, loads each into its
+ * own hidden Scintilla, lexes it with the snapshot of the scheme for
+ * the file and writes it out with the streaming exporters.
+ */
+class BatchExportWorker : public CSSThread
+{
+	public:
+		explicit BatchExportWorker(BatchExport* pOwner);
+		virtual ~BatchExportWorker();
+
+	private:
+		virtual void Run();
+		virtual void OnException();
+
+		LPCTSTR exportFile(const BatchExportJob& job);
+
+		BatchExport*			m_pOwner;
+		OffscreenScintilla		m_sc;
+		/// Last scheme applied to m_sc
+		const SchemeSnapshot*	m_pScheme;
+};
+
+typedef boost::shared_ptr<BatchExportWorker> BatchExportWorkerPtr;
+
+/**
+ * Exports a list of files on a pool of worker threads, one output file
+ * per input file, see BatchExportQueue::GetOutputFile for where they go.
+ */
+class BatchExport : public Singleton<BatchExport, SINGLETON_AUTO_DELETE>
+{
+	friend class Singleton<BatchExport, SINGLETON_AUTO_DELETE>;
+	friend class BatchExportWorker;
+
+	public:
+		~BatchExport();
+
+		/**
+		 * Start exporting, the sink is kept until the export ends. Call on the
+		 * UI thread, the schemes for the files are loaded here.
+		 * @return false if an export is already running
+		 */
+		bool Start(ExporterFactory::EExporterType type, FileItPtr& files, LPCTSTR basePath, LPCTSTR outputPath, BatchExportSinkPtr sink);
+
+		/**
+		 * Ask the workers to stop after the files they're writing, returns
+		 * straight away. The sink still hears about those files and the end.
+		 */
+		void Cancel();
+
+		/**
+		 * Cancel and wait for the workers, for shutdown. The sink isn't told
+		 * anything more, so nothing the workers do waits on the UI thread.
+		 */
+		void Stop();
+
+		bool IsRunning();
+
+	protected:
+		BatchExport();
+
+	private:
+		bool next(BatchExportJob& job);
+		void fileDone(LPCTSTR file, LPCTSTR outputFile, LPCTSTR error);
+		void workerDone();
+
+		std::vector<BatchExportWorkerPtr>	m_workers;
+		BatchExportQueue					m_queue;
+		BatchExportSinkPtr					m_sink;
+		ExporterFactory::EExporterType		m_type;
+		int									m_nExported;
+		int									m_nFailed;
+		volatile LONG						m_running;
+		volatile bool						m_bCancelled;
+		pnutils::threading::CriticalSection	m_cs;
+};
+
+#endif // #ifndef batchexport_h__included
@@ -0,0 +1,98 @@
+/**
+ * @file batchexportqueue.cpp
+ * @brief The files waiting to be exported by a batch export
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "batchexportqueue.h"
+#include "filename.h"
+
+#if defined (_DEBUG)
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using pnutils::threading::CritLock;
+
+BatchExportQueue::BatchExportQueue()
+{
+}
+
+void BatchExportQueue::Reset(LPCTSTR basePath, LPCTSTR outputPath, LPCTSTR extension)
+{
+	CritLock lock(m_cs);
+
+	m_jobs.clear();
+	m_basePath = basePath ? basePath : _T("");
+	m_outputPath = outputPath;
+	m_extension = extension;
+}
+
+void BatchExportQueue::Add(const tstring& file, SchemeSnapshotPtr scheme)
+{
+	BatchExportJob job;
+	job.File = file;
+	job.Scheme = scheme;
+
+	CritLock lock(m_cs);
+
+	job.OutputFile = GetOutputFile(file.c_str(), m_basePath.c_str(), m_outputPath.c_str(), m_extension.c_str());
+	m_jobs.push_back(job);
+}
+
+bool BatchExportQueue::Next(BatchExportJob& job)
+{
+	CritLock lock(m_cs);
+
+	if (m_jobs.empty())
+	{
+		return false;
+	}
+
+	job = m_jobs.front();
+	m_jobs.pop_front();
+
+	return true;
+}
+
+void BatchExportQueue::Clear()
+{
+	CritLock lock(m_cs);
+	m_jobs.clear();
+}
+
+size_t BatchExportQueue::GetCount()
+{
+	CritLock lock(m_cs);
+	return m_jobs.size();
+}
+
+tstring BatchExportQueue::GetOutputFile(LPCTSTR file, LPCTSTR basePath, LPCTSTR outputPath, LPCTSTR extension)
+{
+	CPathName base(basePath);
+	CFileName fn(file);
+
+	tstring relative;
+	if (base.GetLength() && fn.IsSubElementOf(base.c_str()))
+	{
+		relative = fn.GetRelativePath(base.c_str());
+	}
+	else
+	{
+		relative = fn.GetFileName();
+	}
+
+	// Keep the original extension, foo.h and foo.cpp shouldn't collide:
+	CFileName output(relative);
+	output.Root(CPathName(outputPath).c_str());
+	output.AddExtension(_T("."));
+	output.AddExtension(extension);
+
+	return output.c_str();
+}
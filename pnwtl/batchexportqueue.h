@@ -0,0 +1,83 @@
+/**
+ * @file batchexportqueue.h
+ * @brief The files waiting to be exported by a batch export
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef batchexportqueue_h__included
+#define batchexportqueue_h__included
+
+#include <deque>
+
+#include "include/threading.h"
+
+class SchemeSnapshot;
+
+typedef boost::shared_ptr<SchemeSnapshot> SchemeSnapshotPtr;
+
+/**
+ * One file to export, with everything the worker needs to do it.
+ */
+class BatchExportJob
+{
+	public:
+		tstring File;
+		tstring OutputFile;
+		/// Settings of the scheme for the file, shared by files of the same type
+		SchemeSnapshotPtr Scheme;
+};
+
+/**
+ * Files are added on the UI thread before the export starts, the workers
+ * then take them one at a time from any thread.
+ */
+class BatchExportQueue
+{
+	public:
+		BatchExportQueue();
+
+		/**
+		 * Empty the queue and say where the next lot of files go.
+		 */
+		void Reset(LPCTSTR basePath, LPCTSTR outputPath, LPCTSTR extension);
+
+		/**
+		 * Queue a file, working out where its export will be written.
+		 */
+		void Add(const tstring& file, SchemeSnapshotPtr scheme);
+
+		/**
+		 * Take the next job.
+		 * @return false once the queue is empty
+		 */
+		bool Next(BatchExportJob& job);
+
+		/**
+		 * Drop the jobs that haven't been taken.
+		 */
+		void Clear();
+
+		size_t GetCount();
+
+		/**
+		 * Work out where the export of file will be written. Files below
+		 * basePath keep their folders under outputPath, anything else goes
+		 * in outputPath itself.
+		 */
+		static tstring GetOutputFile(LPCTSTR file, LPCTSTR basePath, LPCTSTR outputPath, LPCTSTR extension);
+
+	private:
+		typedef std::deque<BatchExportJob> JOBS;
+
+		JOBS								m_jobs;
+		tstring								m_basePath;
+		tstring								m_outputPath;
+		tstring								m_extension;
+		pnutils::threading::CriticalSection	m_cs;
+};
+
+#endif // #ifndef batchexportqueue_h__included
@@ -0,0 +1,163 @@
+/**
+ * @file benchmark.h
+ * @brief Shared pieces for the benchmarks project
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ *
+ * The benchmarks build into their own runner, apart from the unit tests, so
+ * the tests stay quick and the timings come from a release build. They run
+ * on text generated from a fixed seed, so every run on every machine sees
+ * the same input. Results go to the test log and, if the PN_BENCH_RESULTS
+ * environment variable names a file, are appended to it one JSON object per
+ * line for comparing runs by script.
+ */
+
+#ifndef benchmark_h__included
+#define benchmark_h__included
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+
+namespace bench {
+
+/**
+ * Park-Miller minimal standard generator, rand() differs between runtimes.
+ */
+class Random
+{
+public:
+	explicit Random(unsigned int seed) : m_state(seed % 2147483647u)
+	{
+		if (m_state == 0)
+			m_state = 1;
+	}
+
+	unsigned int Next()
+	{
+		m_state = static_cast<unsigned int>((static_cast<unsigned long long>(m_state) * 48271u) % 2147483647u);
+		return m_state;
+	}
+
+	/// In [0, limit)
+	unsigned int Next(unsigned int limit)
+	{
+		return Next() % limit;
+	}
+
+private:
+	unsigned int m_state;
+};
+
+/**
+ * ASCII text shaped like source code: indented lines of keywords,
+ * identifiers, numbers and punctuation.
+ */
+inline std::string GenerateCorpus(size_t bytes, unsigned int seed, const char* lineEnd = "\r\n")
+{
+	static const char* words[] = {
+		"int", "return", "if", "else", "for", "while", "const", "static", "void", "class",
+		"count", "index", "buffer", "length", "result", "value", "name", "node", "next", "data",
+		"GetText", "SetScheme", "m_pScheme", "m_nLength", "pData", "nIndex", "Find", "Replace",
+		"=", "==", "+=", "<", "(", ")", "{", "}", ";", ",", "->", "//", "0", "1", "42", "256"
+	};
+	const unsigned int wordCount = sizeof(words) / sizeof(words[0]);
+
+	Random random(seed);
+
+	std::string text;
+	text.reserve(bytes + 128);
+	while (text.size() < bytes)
+	{
+		text.append(random.Next(4), '\t');
+
+		unsigned int lineWords = 1 + random.Next(12);
+		for (unsigned int i = 0; i < lineWords; ++i)
+		{
+			if (i)
+				text += ' ';
+			text += words[random.Next(wordCount)];
+		}
+
+		text += lineEnd;
+	}
+
+	return text;
+}
+
+/**
+ * The same characters as an ASCII string, as UTF-16 with a byte order mark.
+ */
+inline std::string WidenToUtf16(const std::string& ascii, bool bigEndian)
+{
+	std::string wide;
+	wide.reserve(ascii.size() * 2 + 2);
+
+	wide += bigEndian ? '\xFE' : '\xFF';
+	wide += bigEndian ? '\xFF' : '\xFE';
+
+	for (std::string::const_iterator i = ascii.begin(); i != ascii.end(); ++i)
+	{
+		if (bigEndian)
+			wide += '\0';
+		wide += *i;
+		if (!bigEndian)
+			wide += '\0';
+	}
+
+	return wide;
+}
+
+class Stopwatch
+{
+public:
+	Stopwatch() : m_start(std::chrono::high_resolution_clock::now())
+	{
+	}
+
+	double ElapsedMs() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+	}
+
+private:
+	std::chrono::high_resolution_clock::time_point m_start;
+};
+
+/**
+ * Log one result. bytes is the input handled per iteration, or zero
+ * where throughput means nothing.
+ */
+inline void Report(const char* suite, const char* name, size_t bytes, int iterations, double ms)
+{
+	double perIteration = iterations ? ms / iterations : ms;
+
+	std::stringstream json;
+	json << "{\"suite\":\"" << suite << "\",\"name\":\"" << name << "\""
+		<< ",\"bytes\":" << bytes
+		<< ",\"iterations\":" << iterations
+		<< ",\"ms\":" << ms
+		<< ",\"msPerIteration\":" << perIteration;
+	if (bytes && ms > 0.0)
+	{
+		json << ",\"mbPerSecond\":" << (static_cast<double>(bytes) * iterations / (1024.0 * 1024.0)) / (ms / 1000.0);
+	}
+	json << "}";
+
+	BOOST_TEST_MESSAGE(json.str());
+
+	const char* resultsFile = getenv("PN_BENCH_RESULTS");
+	if (resultsFile != NULL && *resultsFile)
+	{
+		std::ofstream results(resultsFile, std::ios::out | std::ios::app);
+		results << json.str() << "\n";
+	}
+}
+
+} // namespace bench
+
+#endif // #ifndef benchmark_h__included
@@ -0,0 +1,14 @@
+// benchmarks.cpp : Defines the entry point for the benchmark runner, run
+// with --log_level=message to see the results as they come.
+//
+
+#include "stdafx.h"
+
+#ifdef PN_BENCH_HEADLESS
+Options* g_Options = NULL;
+#else
+IOptionsWithString* g_Options = NULL;
+#endif
+
+#define BOOST_TEST_MODULE benchmarks
+#include <boost/test/unit_test.hpp>
@@ -0,0 +1,81 @@
+/**
+ * Micro-benchmark for text clip insertion: parsing every time against
+ * instantiating a compiled template.
+ */
+
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+#include "../textclips.h"
+#include "../textclips/chunkparser.h"
+#include "../textclips/cliptemplate.h"
+
+BOOST_AUTO_TEST_SUITE( clip_bench );
+
+using TextClips::Chunk;
+
+namespace {
+
+const char* Suite = "clips";
+const int Insertions = 5000;
+
+class BenchVariableProvider : public TextClips::IVariableProvider
+{
+	virtual bool GetVariable(const char* name, std::string& value)
+	{
+		value = name;
+		return true;
+	}
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( compiled_template_vs_parse )
+{
+	std::string input("for (${1:int} ${2:i} = 0; $2 < ${3:count}; ++$2)\n{\n\t// $(SelectedText)\n\t${0}\n}\n");
+	BenchVariableProvider vars;
+	std::string indent("\t\t");
+
+	std::vector<Chunk> parsed;
+	std::vector<Chunk> instantiated;
+
+	// Parse on every insertion, then fix up each chunk the old way:
+	bench::Stopwatch parseTimer;
+	for (int i = 0; i < Insertions; ++i)
+	{
+		TextClips::ChunkParser p;
+		p.SetVariableProvider(&vars);
+		p.Parse(input, parsed);
+		for (std::vector<Chunk>::iterator c = parsed.begin(); c != parsed.end(); ++c)
+		{
+			std::string fixed;
+			TextClips::ClipTemplate::AppendFixedText(fixed, (*c).GetText(), indent, PNSF_Windows);
+			(*c).SetText(fixed.c_str());
+		}
+	}
+	double parseMs = parseTimer.ElapsedMs();
+
+	// Compile once, instantiate on every insertion:
+	bench::Stopwatch compiledTimer;
+	TextClips::ChunkParser p;
+	TextClips::ClipTemplate compiled(input);
+	p.Compile(input, compiled);
+	for (int i = 0; i < Insertions; ++i)
+	{
+		compiled.Instantiate(instantiated, &vars, NULL, indent, PNSF_Windows);
+	}
+	double compiledMs = compiledTimer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(parsed.size(), instantiated.size());
+	for (size_t i = 0; i < parsed.size(); ++i)
+	{
+		BOOST_REQUIRE_EQUAL(parsed[i].GetText(), instantiated[i].GetText());
+	}
+
+	bench::Report(Suite, "clip_insert_parsed", input.size(), Insertions, parseMs);
+	bench::Report(Suite, "clip_insert_compiled", input.size(), Insertions, compiledMs);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
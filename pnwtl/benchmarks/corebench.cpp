@@ -0,0 +1,254 @@
+/**
+ * Benchmarks for the editor core that doesn't need a window: searching,
+ * encoding conversion, line ending detection, fuzzy matching and clip
+ * parsing, each on generated text. See benchmark.h for the output.
+ */
+
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+#include "../include/boyermoore.h"
+#include "../include/Utf8_16.h"
+#include "../include/lineendings.h"
+#include "../include/liquidmetal.h"
+#include "../textclips/chunkparser.h"
+
+BOOST_AUTO_TEST_SUITE( core_bench );
+
+namespace {
+
+const char* Suite = "core";
+const size_t CorpusSize = 16 * 1024 * 1024;
+const int Passes = 3;
+
+class BenchVariableProvider : public TextClips::IVariableProvider
+{
+	virtual bool GetVariable(const char* name, std::string& value)
+	{
+		value = name;
+		return true;
+	}
+};
+
+/**
+ * Every match, the way Find in Files walks a file.
+ */
+int findAll(BoyerMoore& bm, std::string& text, size_t needleLength)
+{
+	int matches = 0;
+	int pos = 0;
+	int length = static_cast<int>(text.size());
+
+	while (pos < length)
+	{
+		int found = bm.FindForward(&text[pos], length - pos);
+		if (found == -1)
+			break;
+
+		matches++;
+		pos += found + static_cast<int>(needleLength);
+	}
+
+	return matches;
+}
+
+int countMatches(const std::string& text, const std::string& needle)
+{
+	int matches = 0;
+	for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + needle.size()))
+	{
+		matches++;
+	}
+
+	return matches;
+}
+
+std::string lowerCase(const std::string& text)
+{
+	std::string lower(text);
+	for (std::string::iterator i = lower.begin(); i != lower.end(); ++i)
+	{
+		*i = static_cast<char>(tolower(static_cast<unsigned char>(*i)));
+	}
+
+	return lower;
+}
+
+void benchLineEndings(const char* name, std::string& text, EPNEncoding encoding, EPNSaveFormat expected)
+{
+	EPNSaveFormat format = PNSF_NoChange;
+
+	bench::Stopwatch timer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		format = determineLineEndings(reinterpret_cast<unsigned char*>(&text[0]), static_cast<int>(text.size()), encoding);
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(expected, format);
+	bench::Report(Suite, name, text.size(), Passes, ms);
+}
+
+void benchUtf16Read(const char* name, bool bigEndian)
+{
+	std::string ascii(bench::GenerateCorpus(CorpusSize, 3));
+	std::string wide(bench::WidenToUtf16(ascii, bigEndian));
+	Utf8_16::encodingType encoding(bigEndian ? Utf8_16::eUtf16BigEndian : Utf8_16::eUtf16LittleEndian);
+
+	size_t converted = 0;
+	std::string result;
+
+	bench::Stopwatch timer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		Utf8_16_Read reader;
+		converted = reader.convert(&wide[0], wide.size(), encoding, 2);
+		if (i == 0)
+		{
+			result.assign(reader.getNewBuf(), converted);
+		}
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE(result == ascii);
+	bench::Report(Suite, name, wide.size(), Passes, ms);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( boyermoore_case_sensitive )
+{
+	std::string text(bench::GenerateCorpus(CorpusSize, 1));
+	std::string needle("m_pScheme");
+
+	BoyerMoore bm(needle.c_str(), TRUE);
+	int matches = 0;
+
+	bench::Stopwatch timer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		matches = findAll(bm, text, needle.size());
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(countMatches(text, needle), matches);
+	bench::Report(Suite, "boyermoore_case_sensitive", text.size(), Passes, ms);
+}
+
+BOOST_AUTO_TEST_CASE( boyermoore_case_insensitive )
+{
+	std::string text(bench::GenerateCorpus(CorpusSize, 2));
+	std::string needle("gettext");
+
+	BoyerMoore bm(needle.c_str(), FALSE);
+	int matches = 0;
+
+	bench::Stopwatch timer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		matches = findAll(bm, text, needle.size());
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(countMatches(lowerCase(text), needle), matches);
+	bench::Report(Suite, "boyermoore_case_insensitive", text.size(), Passes, ms);
+}
+
+BOOST_AUTO_TEST_CASE( line_endings )
+{
+	std::string crlf(bench::GenerateCorpus(CorpusSize, 4, "\r\n"));
+	benchLineEndings("line_endings_crlf", crlf, eUtf8, PNSF_Windows);
+
+	std::string lf(bench::GenerateCorpus(CorpusSize, 4, "\n"));
+	benchLineEndings("line_endings_lf", lf, eUtf8, PNSF_Unix);
+
+	std::string wide(bench::WidenToUtf16(lf, false));
+	benchLineEndings("line_endings_utf16", wide, eUtf16LittleEndian, PNSF_Unix);
+}
+
+BOOST_AUTO_TEST_CASE( utf16_to_utf8 )
+{
+	benchUtf16Read("utf16le_to_utf8", false);
+	benchUtf16Read("utf16be_to_utf8", true);
+}
+
+BOOST_AUTO_TEST_CASE( liquidmetal_scoring )
+{
+	static const char* parts[] = { "src", "include", "text", "clips", "scheme", "manager", "find", "files", "output", "view", "project", "options" };
+	static const char* extensions[] = { ".cpp", ".h", ".xml", ".txt" };
+	static const char* abbreviations[] = { "sm", "findf", "pv.h", "txtclp", "opt" };
+	const unsigned int partCount = sizeof(parts) / sizeof(parts[0]);
+
+	bench::Random random(5);
+	std::vector<std::string> names;
+	for (int i = 0; i < 20000; ++i)
+	{
+		std::string name(parts[random.Next(partCount)]);
+		name += '\\';
+		name += parts[random.Next(partCount)];
+		name += parts[random.Next(partCount)];
+		name += extensions[random.Next(4)];
+		names.push_back(name);
+	}
+
+	double total = 0.0;
+	int scored = 0;
+
+	bench::Stopwatch timer;
+	for (int a = 0; a < 5; ++a)
+	{
+		LiquidMetal::QuickSilver qs(abbreviations[a]);
+		for (std::vector<std::string>::const_iterator i = names.begin(); i != names.end(); ++i)
+		{
+			total += qs.Score(*i);
+			scored++;
+		}
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE(total > 0.0);
+	bench::Report(Suite, "liquidmetal_scoring", 0, scored, ms);
+}
+
+BOOST_AUTO_TEST_CASE( clip_parsing )
+{
+	static const char* pieces[] = { "for (", "${1:int} ", "${2:i}", " = 0; ", "$2 < ", "${3:count}", "; ++$2)\n", "{\n\t", "$(SelectedText)", "${0}", "\n}\n", "text ", "\\$escaped " };
+	const unsigned int pieceCount = sizeof(pieces) / sizeof(pieces[0]);
+
+	bench::Random random(6);
+	std::vector<std::string> clips;
+	size_t bytes = 0;
+	for (int i = 0; i < 5000; ++i)
+	{
+		std::string clip;
+		unsigned int length = 4 + random.Next(16);
+		for (unsigned int j = 0; j < length; ++j)
+		{
+			clip += pieces[random.Next(pieceCount)];
+		}
+
+		bytes += clip.size();
+		clips.push_back(clip);
+	}
+
+	BenchVariableProvider vars;
+	size_t chunks = 0;
+
+	bench::Stopwatch timer;
+	for (std::vector<std::string>::const_iterator i = clips.begin(); i != clips.end(); ++i)
+	{
+		std::vector<TextClips::Chunk> parsed;
+		TextClips::ChunkParser p;
+		p.SetVariableProvider(&vars);
+		p.Parse(*i, parsed);
+		chunks += parsed.size();
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE(chunks > clips.size());
+	bench::Report(Suite, "clip_parsing", bytes / clips.size(), static_cast<int>(clips.size()), ms);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,104 @@
+/**
+ * Micro-benchmark for the per-keystroke cost of script character events,
+ * with nobody listening, with an indenter listening for line ends and with
+ * a handler for every character, typed normally and in bursts.
+ */
+
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+#include "../pypn/eventfilter.h"
+
+BOOST_AUTO_TEST_SUITE( docevent_bench );
+
+namespace {
+
+const char* Suite = "docevents";
+const int Keystrokes = 2000000;
+
+/**
+ * Does what DocSink does, counting calls where it would call into Python.
+ */
+class BenchSink
+{
+public:
+	BenchSink(const DocEventFilter& filter) : Calls(0), Chars(0), m_filter(filter), m_batch(filter)
+	{
+	}
+
+	void OnCharAdded(char c, bool morePending)
+	{
+		if (m_filter.WantsBatchedChar(c) || m_batch.HasPending())
+		{
+			if (m_batch.Add(c, morePending))
+			{
+				m_batch.Take(m_chars);
+				++Calls;
+				Chars += m_chars.size();
+			}
+		}
+
+		if (m_filter.WantsChar(c))
+		{
+			++Calls;
+			++Chars;
+		}
+	}
+
+	int Calls;
+	size_t Chars;
+
+private:
+	const DocEventFilter& m_filter;
+	CharBatch m_batch;
+	std::string m_chars;
+};
+
+/**
+ * Type text over and over, burst says how many keystrokes arrive together.
+ * Returns the number of calls that would have gone into Python.
+ */
+int type(const DocEventFilter& filter, int burst, const char* name)
+{
+	const char text[] = "\tif (x == 1)\r\n\t{\r\n\t\treturn y;\r\n\t}\r\n";
+	const size_t length = sizeof(text) - 1;
+
+	BenchSink sink(filter);
+
+	bench::Stopwatch timer;
+	for (int i = 0; i < Keystrokes; ++i)
+	{
+		sink.OnCharAdded(text[i % length], (i + 1) % burst != 0);
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE(sink.Chars <= static_cast<size_t>(Keystrokes));
+	bench::Report(Suite, name, 0, Keystrokes, ms);
+
+	return sink.Calls;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( keystroke_overhead_with_and_without_listeners )
+{
+	DocEventFilter none;
+
+	DocEventFilter lineEnds;
+	lineEnds.SetChars("\r\n", false);
+
+	DocEventFilter all;
+	all.SetChars(NULL, true);
+
+	DocEventFilter allBatched;
+	allBatched.SetBatchedChars(NULL, true);
+
+	BOOST_CHECK_EQUAL(0, type(none, 1, "keystroke_no_listeners"));
+	BOOST_CHECK(type(lineEnds, 1, "keystroke_indenter") > 0);
+	BOOST_CHECK_EQUAL(Keystrokes, type(all, 1, "keystroke_every_char"));
+	BOOST_CHECK(type(allBatched, 16, "keystroke_every_char_batched_16") < Keystrokes / 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
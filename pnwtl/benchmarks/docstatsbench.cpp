@@ -0,0 +1,77 @@
+/**
+ * Micro-benchmark for document statistics: a full count of a large
+ * document, plain and SIMD, and the rescan after a single edit.
+ */
+
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+#include "../docstats.h"
+
+BOOST_AUTO_TEST_SUITE( docstats_bench );
+
+namespace {
+
+const char* Suite = "docstats";
+const size_t DocumentSize = 16 * 1024 * 1024;
+
+class BenchSource : public IDocStatsSource
+{
+public:
+	BenchSource(const std::string& text) : m_text(text) {}
+
+	virtual void GetText(int start, int end, char* buffer)
+	{
+		memcpy(buffer, m_text.c_str() + start, end - start);
+		buffer[end - start] = 0;
+	}
+
+private:
+	const std::string& m_text;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( full_count_and_edit )
+{
+	std::string text(bench::GenerateCorpus(DocumentSize, 7));
+	const int length = static_cast<int>(text.size());
+
+	DocStats stats;
+	BlockStats plain, simd;
+
+	bench::Stopwatch plainTimer;
+	stats.Scan(text.c_str(), length, plain, false);
+	double plainMs = plainTimer.ElapsedMs();
+
+	bench::Stopwatch simdTimer;
+	stats.Scan(text.c_str(), length, simd, true);
+	double simdMs = simdTimer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(plain.Words, simd.Words);
+	BOOST_REQUIRE_EQUAL(plain.LineEnds, simd.LineEnds);
+
+	// Blocked, with copying out of the source:
+	BenchSource source(text);
+	bench::Stopwatch blockedTimer;
+	stats.Update(source, length);
+	double blockedMs = blockedTimer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(simd.Words, stats.GetStats().Words);
+
+	// Type a character in the middle:
+	text.insert(text.size() / 2, "x");
+	stats.Inserted(length / 2, 1);
+	bench::Stopwatch editTimer;
+	stats.Update(source, length + 1);
+	double editMs = editTimer.ElapsedMs();
+
+	bench::Report(Suite, "docstats_scan_plain", text.size(), 1, plainMs);
+	bench::Report(Suite, "docstats_scan_simd", text.size(), 1, simdMs);
+	bench::Report(Suite, "docstats_update_blocked", text.size(), 1, blockedMs);
+	bench::Report(Suite, "docstats_update_after_edit", 0, 1, editMs);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,186 @@
+/**
+ * Benchmark for Find in Files: FIFThread searching a generated tree of
+ * source files on disk, as the Find in Files dialog does, file matching and
+ * result reporting included. See benchmark.h for the output.
+ */
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+#include "../findinfiles.h"
+
+BOOST_AUTO_TEST_SUITE( find_bench );
+
+namespace {
+
+const char* Suite = "find";
+const char* Needle = "m_pScheme";
+const int Folders = 8;
+const int FilesPerFolder = 25;
+const size_t FileSize = 64 * 1024;
+const int Passes = 3;
+
+class CountingSink : public FIFSink
+{
+public:
+	CountingSink() : Matches(0), Lines(0), Files(0)
+	{
+	}
+
+	virtual void OnBeginSearch(LPCTSTR stringLookingFor, bool bIsRegex)
+	{
+		Matches = 0;
+	}
+
+	virtual void OnFoundString(LPCTSTR stringFound, LPCTSTR szFilename, int line, LPCTSTR buf)
+	{
+		Matches++;
+	}
+
+	virtual void OnEndSearch(int nFound, int nFiles)
+	{
+		Lines = nFound;
+		Files = nFiles;
+	}
+
+	int Matches;
+	int Lines;
+	int Files;
+};
+
+/**
+ * Lines of text with the needle in them, what Find in Files counts.
+ */
+int countLines(const std::string& text, const std::string& needle)
+{
+	int lines = 0;
+	size_t start = 0;
+	while (start < text.size())
+	{
+		size_t end = text.find('\n', start);
+		if (end == std::string::npos)
+			end = text.size();
+
+		std::string::const_iterator lineEnd(text.begin() + end);
+		if (std::search(text.begin() + start, lineEnd, needle.begin(), needle.end()) != lineEnd)
+			lines++;
+
+		start = end + 1;
+	}
+
+	return lines;
+}
+
+/**
+ * Folders of generated source files below the temp folder, along with a
+ * file in each that the filter should skip. Removed again when done with.
+ */
+class SourceTree
+{
+public:
+	SourceTree() : ExpectedLines(0), Bytes(0)
+	{
+		TCHAR tempPath[MAX_PATH + 1];
+		::GetTempPath(MAX_PATH, tempPath);
+		m_root = tempPath;
+		m_root += _T("pnfindbench\\");
+		::CreateDirectory(m_root.c_str(), NULL);
+
+		unsigned int seed = 20;
+		for (int f = 0; f < Folders; ++f)
+		{
+			std::basic_stringstream<TCHAR> folder;
+			folder << m_root << _T("folder") << f << _T("\\");
+			::CreateDirectory(folder.str().c_str(), NULL);
+			m_folders.push_back(folder.str());
+
+			for (int i = 0; i < FilesPerFolder; ++i)
+			{
+				std::string text(bench::GenerateCorpus(FileSize, seed++));
+
+				std::basic_stringstream<TCHAR> file;
+				file << folder.str() << _T("file") << i << _T(".cpp");
+				write(file.str(), text);
+
+				ExpectedLines += countLines(text, Needle);
+				Bytes += text.size();
+			}
+
+			write(folder.str() + _T("skipped.obj"), bench::GenerateCorpus(FileSize, seed++));
+		}
+	}
+
+	~SourceTree()
+	{
+		for (tstring_array::const_iterator i = m_files.begin(); i != m_files.end(); ++i)
+		{
+			::DeleteFile((*i).c_str());
+		}
+
+		for (tstring_array::const_iterator i = m_folders.begin(); i != m_folders.end(); ++i)
+		{
+			::RemoveDirectory((*i).c_str());
+		}
+
+		::RemoveDirectory(m_root.c_str());
+	}
+
+	LPCTSTR GetRoot() const
+	{
+		return m_root.c_str();
+	}
+
+	int GetFileCount() const
+	{
+		return Folders * FilesPerFolder;
+	}
+
+	int ExpectedLines;
+	size_t Bytes;
+
+private:
+	void write(const tstring& filename, const std::string& text)
+	{
+		m_files.push_back(filename);
+
+		FILE* out = _tfopen(filename.c_str(), _T("wb"));
+		BOOST_REQUIRE(out != NULL);
+		size_t written = fwrite(text.c_str(), 1, text.size(), out);
+		fclose(out);
+		BOOST_REQUIRE_EQUAL(text.size(), written);
+	}
+
+	tstring m_root;
+	tstring_array m_folders;
+	tstring_array m_files;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( find_in_files )
+{
+	SourceTree tree;
+	CountingSink sink;
+	FIFThread fif;
+	CA2CT needle(Needle);
+
+	bench::Stopwatch timer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		fif.Find(needle, tree.GetRoot(), _T("*.cpp"), true, true, false, true, &sink);
+		::WaitForSingleObject(fif.GetStoppedHandle(), INFINITE);
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(tree.GetFileCount(), sink.Files);
+	BOOST_REQUIRE_EQUAL(tree.ExpectedLines, sink.Lines);
+	BOOST_REQUIRE(sink.Matches >= sink.Lines);
+
+	bench::Report(Suite, "find_in_files", tree.Bytes, Passes, ms);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,81 @@
+/**
+ * @file headless.h
+ * @brief Stands in for the Windows headers in the headless benchmark build
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ *
+ * CMakeLists.txt builds the benchmarks for code that doesn't need a window
+ * on any platform, with PN_BENCH_HEADLESS defined. This supplies the few
+ * Windows types and macros that code uses, as narrow (non-Unicode) builds
+ * see them.
+ */
+
+#ifndef headless_h__included
+#define headless_h__included
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef int BOOL;
+#define TRUE 1
+#define FALSE 0
+
+typedef unsigned char UCHAR;
+typedef unsigned int UINT;
+typedef const char* LPCSTR;
+
+typedef void* HWND;
+typedef intptr_t LRESULT;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+
+#define __stdcall
+#define _W64
+
+// For LocalAllocAllocator in allocator.h:
+#define LMEM_FIXED 0
+inline void* LocalAlloc(UINT /*flags*/, size_t bytes) { return malloc(bytes); }
+inline void* LocalFree(void* mem) { free(mem); return NULL; }
+
+typedef char TCHAR;
+typedef const TCHAR* LPCTSTR;
+#define _T(x) x
+#define _tfopen fopen
+
+typedef std::basic_string<TCHAR> tstring;
+typedef std::vector<tstring> tstring_array;
+
+#define PNASSERT assert
+#define _ASSERT assert
+
+#define _strnicmp strncasecmp
+
+#include <boost/shared_ptr.hpp>
+#include <boost/spirit/include/qi.hpp>
+
+class CScintilla;
+
+#include "../allocator.h"
+#include "../pnextstring.h"
+#include "../extiface.h"
+#include "../pnencodings.h"
+
+// For the default in lineendings.h:
+typedef extensions::IOptions Options;
+extern Options* g_Options;
+#define OPTIONS g_Options
+
+#endif // #ifndef headless_h__included
@@ -0,0 +1,89 @@
+/**
+ * Micro-benchmark for ini options: reading the file for every option, as the
+ * profile functions do, against parsing it once and reading from memory.
+ */
+
+#include "stdafx.h"
+
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+#include "../inifile.h"
+
+BOOST_AUTO_TEST_SUITE( ini_bench );
+
+namespace {
+
+const char* Suite = "ini";
+const int Sections = 40;
+const int KeysPerSection = 50;
+const int Reads = 500;
+const TCHAR* BenchFile = _T("inibench.ini");
+
+tstring sectionName(int i)
+{
+	std::basic_stringstream<TCHAR> name;
+	name << _T("Section") << i;
+	return name.str();
+}
+
+tstring keyName(int i)
+{
+	std::basic_stringstream<TCHAR> name;
+	name << _T("Key") << i;
+	return name.str();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( parse_once_vs_read_per_option )
+{
+	IniFile ini;
+	for (int s = 0; s < Sections; ++s)
+	{
+		for (int k = 0; k < KeysPerSection; ++k)
+		{
+			ini.Set(sectionName(s).c_str(), keyName(k).c_str(), _T("some typical option value"));
+		}
+	}
+
+	_tremove(BenchFile);
+	BOOST_REQUIRE(ini.Save(BenchFile));
+
+	// Read the file for every option:
+	size_t found(0);
+	bench::Stopwatch perReadTimer;
+	for (int i = 0; i < Reads; ++i)
+	{
+		IniFile perRead;
+		perRead.Load(BenchFile);
+		if (perRead.Get(sectionName(i % Sections).c_str(), keyName(i % KeysPerSection).c_str()) != NULL)
+		{
+			++found;
+		}
+	}
+	double perReadMs = perReadTimer.ElapsedMs();
+
+	// Parse once, read from memory:
+	bench::Stopwatch cachedTimer;
+	IniFile cached;
+	cached.Load(BenchFile);
+	for (int i = 0; i < Reads; ++i)
+	{
+		if (cached.Get(sectionName(i % Sections).c_str(), keyName(i % KeysPerSection).c_str()) != NULL)
+		{
+			++found;
+		}
+	}
+	double cachedMs = cachedTimer.ElapsedMs();
+
+	_tremove(BenchFile);
+
+	BOOST_CHECK_EQUAL(static_cast<size_t>(Reads * 2), found);
+
+	bench::Report(Suite, "ini_read_file_per_option", 0, Reads, perReadMs);
+	bench::Report(Suite, "ini_read_cached", 0, Reads, cachedMs);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
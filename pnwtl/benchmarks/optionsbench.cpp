@@ -0,0 +1,76 @@
+/**
+ * Micro-benchmark for option lookups: building a "group.name" key for a map
+ * and parsing the value on every read, against interned keys with cached
+ * typed values.
+ */
+
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+#include "../optionsstore.h"
+
+BOOST_AUTO_TEST_SUITE( options_bench );
+
+namespace {
+
+const char* Suite = "options";
+const int Reads = 200000;
+
+const TCHAR* Names[] = {
+	_T("TabWidth"), _T("UseTabs"), _T("LineNumbers"), _T("ShowIndentGuides"),
+	_T("WordWrap"), _T("RightGuide"), _T("RightColumn"), _T("LineEndings"),
+	_T("DefaultEncoding"), _T("SmartStart"), _T("FoldingEnabled"), _T("AutoComplete")
+};
+
+const int NameCount = sizeof(Names) / sizeof(Names[0]);
+
+}
+
+BOOST_AUTO_TEST_CASE( interned_vs_built_keys )
+{
+	typedef std::map<tstring, tstring> map_type;
+	map_type options;
+	OptionsStore store;
+
+	for (int i = 0; i < NameCount; ++i)
+	{
+		tstring key(_T("Editor."));
+		key += Names[i];
+		options.insert(map_type::value_type(key, _T("4")));
+		store.Load(key, _T("4"));
+	}
+
+	// Build the key and parse the value every time:
+	long long total(0);
+	bench::Stopwatch builtTimer;
+	for (int i = 0; i < Reads; ++i)
+	{
+		map_type::const_iterator it = options.find((tstring(_T("Editor")) + _T(".")) + Names[i % NameCount]);
+		if (it != options.end())
+		{
+			total += _ttoi((*it).second.c_str());
+		}
+	}
+	double builtMs = builtTimer.ElapsedMs();
+
+	// Hash the group and name in place, read the cached number:
+	bench::Stopwatch internedTimer;
+	for (int i = 0; i < Reads; ++i)
+	{
+		OptionsStore::Handle option = store.Find(_T("Editor"), Names[i % NameCount]);
+		if (option != OptionsStore::NoHandle)
+		{
+			total += store.GetInt(option);
+		}
+	}
+	double internedMs = internedTimer.ElapsedMs();
+
+	BOOST_CHECK_EQUAL(static_cast<long long>(Reads) * 2 * 4, total);
+
+	bench::Report(Suite, "option_read_built_key", 0, Reads, builtMs);
+	bench::Report(Suite, "option_read_interned", 0, Reads, internedMs);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,388 @@
+/**
+ * Benchmarks for the parts of Scintilla every edit goes through: the cell
+ * buffer holding the text and its undo history, and the C++ lexer styling
+ * and folding a whole document. See benchmark.h for the output.
+ */
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+
+#include "benchmark.h"
+
+#include "../third_party/scintilla/include/Platform.h"
+#include "../third_party/scintilla/include/ILexer.h"
+#include "../third_party/scintilla/include/Scintilla.h"
+#include "../third_party/scintilla/include/SciLexer.h"
+#include "../third_party/scintilla/src/SplitVector.h"
+#include "../third_party/scintilla/src/Partitioning.h"
+#include "../third_party/scintilla/src/CellBuffer.h"
+#include "../third_party/scintilla/lexlib/LexerModule.h"
+
+#ifdef SCI_NAMESPACE
+using namespace Scintilla;
+
+namespace Scintilla {
+#endif
+
+/*
+ * The cell buffer asserts and complains through the platform layer, which
+ * isn't built here.
+ */
+
+void Platform::Assert(const char* c, const char* file, int line)
+{
+	std::stringstream msg;
+	msg << "Scintilla assertion failed: " << c << " (" << file << ":" << line << ")";
+	BOOST_FAIL(msg.str());
+}
+
+void Platform::DebugPrintf(const char* format, ...)
+{
+}
+
+#ifdef SCI_NAMESPACE
+}
+#endif
+
+extern LexerModule lmCPP;
+
+BOOST_AUTO_TEST_SUITE( scintilla_bench );
+
+namespace {
+
+const char* Suite = "scintilla";
+const size_t CorpusSize = 8 * 1024 * 1024;
+const int LoadBlockSize = 64 * 1024;
+const int Keystrokes = 50000;
+const int Passes = 3;
+
+/**
+ * The lexer's view of a document, kept in a cell buffer the way Scintilla's
+ * Document does it, without the watchers or decorations.
+ */
+class BenchDocument : public IDocument
+{
+public:
+	explicit BenchDocument(CellBuffer& cb) : m_cb(cb), m_endStyled(0), m_mask(0)
+	{
+	}
+
+	virtual int SCI_METHOD Version() const
+	{
+		return dvOriginal;
+	}
+
+	virtual void SCI_METHOD SetErrorStatus(int status)
+	{
+	}
+
+	virtual int SCI_METHOD Length() const
+	{
+		return m_cb.Length();
+	}
+
+	virtual void SCI_METHOD GetCharRange(char* buffer, int position, int lengthRetrieve) const
+	{
+		m_cb.GetCharRange(buffer, position, lengthRetrieve);
+	}
+
+	virtual char SCI_METHOD StyleAt(int position) const
+	{
+		return m_cb.StyleAt(position);
+	}
+
+	virtual int SCI_METHOD LineFromPosition(int position) const
+	{
+		return m_cb.LineFromPosition(position);
+	}
+
+	virtual int SCI_METHOD LineStart(int line) const
+	{
+		return m_cb.LineStart(line);
+	}
+
+	virtual int SCI_METHOD GetLevel(int line) const
+	{
+		return line < static_cast<int>(m_levels.size()) ? m_levels[line] : SC_FOLDLEVELBASE;
+	}
+
+	virtual int SCI_METHOD SetLevel(int line, int level)
+	{
+		if (line >= static_cast<int>(m_levels.size()))
+			m_levels.resize(line + 1, SC_FOLDLEVELBASE);
+
+		int previous = m_levels[line];
+		m_levels[line] = level;
+		return previous;
+	}
+
+	virtual int SCI_METHOD GetLineState(int line) const
+	{
+		return line < static_cast<int>(m_lineStates.size()) ? m_lineStates[line] : 0;
+	}
+
+	virtual int SCI_METHOD SetLineState(int line, int state)
+	{
+		if (line >= static_cast<int>(m_lineStates.size()))
+			m_lineStates.resize(line + 1, 0);
+
+		int previous = m_lineStates[line];
+		m_lineStates[line] = state;
+		return previous;
+	}
+
+	virtual void SCI_METHOD StartStyling(int position, char mask)
+	{
+		m_endStyled = position;
+		m_mask = mask;
+	}
+
+	virtual bool SCI_METHOD SetStyleFor(int length, char style)
+	{
+		m_cb.SetStyleFor(m_endStyled, length, style, m_mask);
+		m_endStyled += length;
+		return true;
+	}
+
+	virtual bool SCI_METHOD SetStyles(int length, const char* styles)
+	{
+		for (int i = 0; i < length; ++i)
+		{
+			m_cb.SetStyleAt(m_endStyled++, styles[i], m_mask);
+		}
+
+		return true;
+	}
+
+	virtual void SCI_METHOD DecorationSetCurrentIndicator(int indicator)
+	{
+	}
+
+	virtual void SCI_METHOD DecorationFillRange(int position, int value, int fillLength)
+	{
+	}
+
+	virtual void SCI_METHOD ChangeLexerState(int start, int end)
+	{
+	}
+
+	virtual int SCI_METHOD CodePage() const
+	{
+		return SC_CP_UTF8;
+	}
+
+	virtual bool SCI_METHOD IsDBCSLeadByte(char ch) const
+	{
+		return false;
+	}
+
+	virtual const char* SCI_METHOD BufferPointer()
+	{
+		return m_cb.BufferPointer();
+	}
+
+	virtual int SCI_METHOD GetLineIndentation(int line)
+	{
+		int indent = 0;
+		int end = m_cb.Length();
+		for (int pos = m_cb.LineStart(line); pos < end; ++pos)
+		{
+			char ch = m_cb.CharAt(pos);
+			if (ch == '\t')
+				indent = (indent / 4 + 1) * 4;
+			else if (ch == ' ')
+				indent++;
+			else
+				break;
+		}
+
+		return indent;
+	}
+
+private:
+	CellBuffer& m_cb;
+	int m_endStyled;
+	char m_mask;
+	std::vector<int> m_levels;
+	std::vector<int> m_lineStates;
+};
+
+/**
+ * Load text the way a file is opened: in blocks, without undo.
+ */
+void load(CellBuffer& cb, const std::string& text)
+{
+	bool startSequence = false;
+	cb.SetUndoCollection(false);
+	cb.Allocate(static_cast<int>(text.size()));
+
+	for (size_t pos = 0; pos < text.size(); pos += LoadBlockSize)
+	{
+		int length = static_cast<int>((std::min)(text.size() - pos, static_cast<size_t>(LoadBlockSize)));
+		cb.InsertString(cb.Length(), text.c_str() + pos, length, startSequence);
+	}
+
+	cb.SetUndoCollection(true);
+}
+
+int countLines(const std::string& text)
+{
+	return static_cast<int>(std::count(text.begin(), text.end(), '\n')) + 1;
+}
+
+/**
+ * Type into the buffer with undo on: runs of characters and new lines,
+ * backspaces, and every so often a jump to somewhere else in the document.
+ * Returns the number of characters added.
+ */
+int type(CellBuffer& cb, bench::Random& random)
+{
+	bool startSequence = false;
+	int caret = cb.Length() / 2;
+	int added = 0;
+
+	for (int i = 0; i < Keystrokes; ++i)
+	{
+		if (i % 64 == 0)
+		{
+			caret = random.Next(cb.Length());
+		}
+
+		if (i % 16 == 15 && caret > 0)
+		{
+			cb.DeleteChars(--caret, 1, startSequence);
+			added--;
+		}
+		else
+		{
+			const char* ch = (i % 40 == 39) ? "\n" : "x";
+			cb.InsertString(caret++, ch, 1, startSequence);
+			added++;
+		}
+	}
+
+	return added;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( cellbuffer_load )
+{
+	std::string text(bench::GenerateCorpus(CorpusSize, 8, "\n"));
+	int lines = 0;
+
+	bench::Stopwatch timer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		CellBuffer cb;
+		load(cb, text);
+		lines = cb.Lines();
+	}
+	double ms = timer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(countLines(text), lines);
+	bench::Report(Suite, "cellbuffer_load", text.size(), Passes, ms);
+}
+
+BOOST_AUTO_TEST_CASE( cellbuffer_typing_and_undo )
+{
+	std::string text(bench::GenerateCorpus(CorpusSize, 9, "\n"));
+
+	CellBuffer cb;
+	load(cb, text);
+	bench::Random random(10);
+
+	bench::Stopwatch typingTimer;
+	int added = type(cb, random);
+	double typingMs = typingTimer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(static_cast<int>(text.size()) + added, cb.Length());
+
+	int steps = 0;
+	bench::Stopwatch undoTimer;
+	while (cb.CanUndo())
+	{
+		for (int s = cb.StartUndo(); s > 0; --s)
+		{
+			cb.PerformUndoStep();
+			steps++;
+		}
+	}
+	double undoMs = undoTimer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(static_cast<int>(text.size()), cb.Length());
+	BOOST_REQUIRE_EQUAL(countLines(text), cb.Lines());
+
+	bench::Stopwatch redoTimer;
+	while (cb.CanRedo())
+	{
+		for (int s = cb.StartRedo(); s > 0; --s)
+		{
+			cb.PerformRedoStep();
+		}
+	}
+	double redoMs = redoTimer.ElapsedMs();
+
+	BOOST_REQUIRE_EQUAL(static_cast<int>(text.size()) + added, cb.Length());
+
+	bench::Report(Suite, "cellbuffer_typing", 0, Keystrokes, typingMs);
+	bench::Report(Suite, "cellbuffer_undo", 0, steps, undoMs);
+	bench::Report(Suite, "cellbuffer_redo", 0, steps, redoMs);
+}
+
+BOOST_AUTO_TEST_CASE( lexer_cpp )
+{
+	std::string text(bench::GenerateCorpus(CorpusSize, 11));
+
+	CellBuffer cb;
+	load(cb, text);
+	BenchDocument doc(cb);
+	const int length = cb.Length();
+
+	ILexer* lexer = lmCPP.Create();
+	lexer->WordListSet(0, "int return if else for while const static void class");
+	lexer->PropertySet("fold", "1");
+
+	bench::Stopwatch lexTimer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		lexer->Lex(0, length, SCE_C_DEFAULT, &doc);
+	}
+	double lexMs = lexTimer.ElapsedMs();
+
+	bench::Stopwatch foldTimer;
+	for (int i = 0; i < Passes; ++i)
+	{
+		lexer->Fold(0, length, SCE_C_DEFAULT, &doc);
+	}
+	double foldMs = foldTimer.ElapsedMs();
+
+	lexer->Release();
+
+	// The corpus has keywords, numbers and line comments, and braces
+	// scattered enough that some line opens a fold:
+	int styled[STYLE_MAX + 1] = { 0 };
+	for (int pos = 0; pos < length; ++pos)
+	{
+		styled[static_cast<unsigned char>(cb.StyleAt(pos))]++;
+	}
+
+	int headers = 0;
+	for (int line = 0; line < cb.Lines(); ++line)
+	{
+		if (doc.GetLevel(line) & SC_FOLDLEVELHEADERFLAG)
+			headers++;
+	}
+
+	BOOST_REQUIRE(styled[SCE_C_WORD] > 0);
+	BOOST_REQUIRE(styled[SCE_C_NUMBER] > 0);
+	BOOST_REQUIRE(styled[SCE_C_COMMENTLINE] > 0);
+	BOOST_REQUIRE(headers > 0);
+
+	bench::Report(Suite, "lexer_cpp_lex", text.size(), Passes, lexMs);
+	bench::Report(Suite, "lexer_cpp_fold", text.size(), Passes, foldMs);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
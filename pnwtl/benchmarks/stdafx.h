@@ -0,0 +1,26 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+// The benchmarks build the same editor code as the tests, so they share the
+// tests' precompiled header and add what Find in Files needs. The headless
+// build of the portable benchmarks in CMakeLists.txt uses headless.h instead.
+
+#pragma once
+
+#ifdef PN_BENCH_HEADLESS
+
+#include "headless.h"
+
+#else
+
+#include "../tests/stdafx.h"
+
+#include "../include/singleton.h"
+#include "../include/threading.h"
+#include "../tracing.h"
+
+// For the default in lineendings.h:
+typedef extensions::IOptions Options;
+
+#endif // #ifdef PN_BENCH_HEADLESS
@@ -326,25 +326,19 @@ bool CChildFrame::InsertClipCompleted(Scintilla::SCNotification* notification)
 
 	text.resize(colon);
 
-	const TextClips::LIST_CLIPSETS& sets = m_pTextClips->GetClips( GetTextView()->GetCurrentScheme()->GetName() );
-	BOOST_FOREACH(TextClips::TextClipSet* set, sets)
+	const TextClips::Clip* clip = m_pTextClips->FindByShortcut(GetTextView()->GetCurrentScheme()->GetName(), text);
+	if(clip != NULL)
 	{
-		const TextClips::Clip* clip = set->FindByShortcut(text);
-		if(clip != NULL)
-		{
 #ifdef CLIPS_DEV
-			GetTextView()->DelWordLeft();
-			GetTextView()->InsertClip(clip);
-			break;
+		GetTextView()->DelWordLeft();
+		GetTextView()->InsertClip(clip);
 #else
-			GetTextView()->BeginUndoAction();
-			GetTextView()->DelWordLeft();
-			GetTextView()->EndUndoAction();
+		GetTextView()->BeginUndoAction();
+		GetTextView()->DelWordLeft();
+		GetTextView()->EndUndoAction();
 
-			clip->Insert(GetTextView());
-			break;
+		clip->Insert(GetTextView());
 #endif
-		}
 	}
 
 	return true;
@@ -1143,7 +1137,8 @@ LRESULT CChildFrame::OnCopyRTF(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCt
 
 	StringOutput so(rtfStringLength);
 	std::auto_ptr<StylesList> pStyles(GetTextView()->GetCurrentScheme()->CreateStylesList());
-	RTFExporter rtf(&so, GetTextView()->GetCurrentScheme()->GetName(), pStyles.get(), GetTextView());
+	ScintillaStyledText source(GetTextView());
+	RTFExporter rtf(&so, GetTextView()->GetCurrentScheme()->GetName(), pStyles.get(), &source);
 	
 	//If nothing is selected, copy entire file
 	if(selectionLength == 0) 
@@ -2236,6 +2231,8 @@ bool CChildFrame::PNOpenFile(LPCTSTR pathname, Scheme* pScheme, EPNEncoding enco
 
 bool CChildFrame::SaveFile(LPCTSTR pathname, bool ctagsRefresh, bool bStoreFilename, bool bUpdateMRU)
 {
+	PNTRACE_SPAN("file", "CChildFrame::SaveFile");
+
 	bool bSuccess = false;
 
 	// If this is a user-relevant save, notify the extensions:
@@ -2902,10 +2899,11 @@ void CChildFrame::Export(int type)
 {
 	FileOutput fout(NULL);
 	std::auto_ptr<StylesList> pStyles(GetTextView()->GetCurrentScheme()->CreateStylesList());
+	ScintillaStyledText source(GetTextView());
 	
 	std::auto_ptr<BaseExporter> pExp(ExporterFactory::GetExporter(
 		(ExporterFactory::EExporterType)type, 
-		&fout, GetTextView()->GetCurrentScheme()->GetName(), pStyles.get(), GetTextView()));
+		&fout, GetTextView()->GetCurrentScheme()->GetName(), pStyles.get(), &source));
 	
 	if (!pExp.get())
 	{
@@ -3125,6 +3123,9 @@ void CChildFrame::SetLastView(Views::ViewPtr& view)
 		CTextView* tv = static_cast<CTextView*>(m_lastTextView.get());
 		tv->SetModEventMask(SC_MODEVENTMASKALL);
 
+		// It won't have heard about edits made in the other view:
+		tv->ResetTextStats();
+
 		// Notify the frame to update UI.
 		SendMessage(GetMDIFrame(), PN_NOTIFY, 0, SCN_UPDATEUI);
 	}
@@ -3135,17 +3136,12 @@ void CChildFrame::SetLastView(Views::ViewPtr& view)
  */
 bool CChildFrame::insertMatchingClip(const char* word)
 {
-	const TextClips::LIST_CLIPSETS& clips = m_pTextClips->GetClips(GetTextView()->GetCurrentScheme()->GetName());
-
-	BOOST_FOREACH(TextClips::TextClipSet* set, clips)
+	const TextClips::Clip* desired = m_pTextClips->FindByShortcut(GetTextView()->GetCurrentScheme()->GetName(), word);
+	if(desired != NULL)
 	{
-		const TextClips::Clip* desired = set->FindByShortcut(word);
-		if(desired != NULL)
-		{
-			GetTextView()->DelWordLeft();
-			GetTextView()->InsertClip(desired);
-			return true;
-		}
+		GetTextView()->DelWordLeft();
+		GetTextView()->InsertClip(desired);
+		return true;
 	}
 
 	return false;
@@ -97,7 +97,7 @@ int CodeToScintilla(const KeyToCommand* cmd)
 namespace Commands
 {
 
-KeyMap::KeyMap(KeyToCommand* commands) : kmap(0), len(0), alloc(0), lastdispatcher(0)
+KeyMap::KeyMap(KeyToCommand* commands) : lastdispatcher(0)
 {
 	for (int i = 0; commands[i].key; i++)
 	{
@@ -107,23 +107,8 @@ KeyMap::KeyMap(KeyToCommand* commands) : kmap(0), len(0), alloc(0), lastdispatch
 	}
 }
 
-KeyMap::KeyMap(const KeyMap& copy) : kmap(0), len(0), alloc(0), lastdispatcher(0)
+KeyMap::KeyMap(const KeyMap& copy) : KeyBindings(copy), lastdispatcher(0)
 {
-	len = copy.len;
-	if(len)
-	{
-		KeyToCommand* kNew = new KeyToCommand[copy.len+5];
-		if(!kNew)
-			return;
-		for (int k = 0; k < len; k++)
-			kNew[k] = copy.kmap[k];
-		
-		alloc = copy.len+5;
-		kmap = kNew;
-	}
-	
-	// Copy extension commands
-	extkmap = copy.extkmap;
 	for(ExtensionCommands::iterator i = extkmap.begin(); i != extkmap.end(); ++i)
 	{
 		// Clear out any commands - we haven't registered them yet!
@@ -138,10 +123,7 @@ KeyMap::~KeyMap()
 
 void KeyMap::Clear()
 {
-	delete []kmap;
-	kmap = 0;
-	len = 0;
-	alloc = 0;
+	KeyBindings::Clear();
 	
 	// Release command IDs.
 	if(lastdispatcher != NULL)
@@ -154,91 +136,6 @@ void KeyMap::Clear()
 	}
 }
 
-void KeyMap::AssignCmdKey(int key, int modifiers, unsigned int msg)
-{
-	// Check there's no extended command with this setup...
-	RemoveExtended(key, modifiers);
-	// ...and assign
-	internalAssign(key, modifiers, msg);
-}
-
-void KeyMap::RemoveCmdKey(int key, int modifiers, unsigned int msg)
-{
-	bool found = false;
-	for(int ixArr(0); ixArr < len; ++ixArr)
-	{
-		if(!found && kmap[ixArr].key == key && kmap[ixArr].modifiers == modifiers && kmap[ixArr].msg == msg)
-		{
-			found = true;
-		}
-		if(found && ixArr != len-1)
-		{
-			kmap[ixArr] = kmap[ixArr+1];
-		}
-	}
-	
-	if(found)
-		len--;
-}
-
-void KeyMap::AddExtended(const ExtensionCommand& command)
-{
-	// Make sure there's no classic command on this id already.
-	unsigned int cmd = Find(command.key, command.modifiers);
-	if(cmd != 0)
-		RemoveCmdKey(command.key, command.modifiers, cmd);
-
-	// Insert it
-	extkmap.insert( ExtensionCommands::value_type( command.key | (command.modifiers << 8), command ) );
-}
-
-void KeyMap::RemoveExtended(unsigned char key, unsigned char modifiers)
-{
-	ExtensionCommands::iterator i = extkmap.find( key | (modifiers << 8) );
-	if(i != extkmap.end())
-		extkmap.erase( i );
-}
-
-unsigned int KeyMap::Find(int key, int modifiers)
-{
-	for (int i = 0; i < len; i++)
-	{
-		if ((key == kmap[i].key) && (modifiers == kmap[i].modifiers))
-		{
-			return kmap[i].msg;
-		}
-	}
-	return 0;
-}
-
-const ExtensionCommand* KeyMap::FindExtended(unsigned char key, unsigned char modifiers)
-{
-	ExtensionCommands::const_iterator i = extkmap.find( key | (modifiers << 8) );
-	if( i != extkmap.end() )
-		return &(*i).second;
-	return NULL;
-}
-
-size_t KeyMap::GetCount() const
-{
-	return len;
-}
-
-size_t KeyMap::GetExtendedCount() const
-{
-	return extkmap.size();
-}
-
-const KeyToCommand* KeyMap::GetMappings() const
-{
-	return kmap;
-}
-
-const ExtensionCommands& KeyMap::GetExtendedMappings() const
-{
-	return extkmap;
-}
-
 int KeyMap::MakeAccelerators(ACCEL* buffer, CommandDispatch* dispatcher)
 {
 	size_t i(0);
@@ -261,32 +158,6 @@ int KeyMap::MakeAccelerators(ACCEL* buffer, CommandDispatch* dispatcher)
 	return i;
 }
 
-void KeyMap::internalAssign(int key, int modifiers, unsigned int msg)
-{
-	if ((len+1) >= alloc) {
-		KeyToCommand *ktcNew = new KeyToCommand[alloc + 5];
-		if (!ktcNew)
-			return;
-		for (int k = 0; k < len; k++)
-			ktcNew[k] = kmap[k];
-		alloc += 5;
-		delete []kmap;
-		kmap = ktcNew;
-	}
-	for (int keyIndex = 0; keyIndex < len; keyIndex++)
-	{
-		if ((key == kmap[keyIndex].key) && (modifiers == kmap[keyIndex].modifiers))
-		{
-			kmap[keyIndex].msg = msg;
-			return;
-		}
-	}
-	kmap[len].key = key;
-	kmap[len].modifiers = modifiers;
-	kmap[len].msg = msg;
-	len++;
-}
-
 } // namespace Commands
 
 /////////////////////////////////////////////////////////////////////////////
@@ -890,6 +761,8 @@ KeyToCommand DefaultKeyMap[] = {
 
 	// Tools
 	{K_CTRLSHIFT,	'K',		ID_TOOLS_STOPTOOLS},
+	{0,				VK_F4,		ID_OUTPUT_NEXTERROR},
+	{K_SHIFT,		VK_F4,		ID_OUTPUT_PREVIOUSERROR},
 	{0,				0,			0}
 };
 
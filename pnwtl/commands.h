@@ -11,6 +11,8 @@
 #ifndef commands_h__included
 #define commands_h__included
 
+#include "keymap.h"
+
 #define K_ALT		FALT
 #define K_CTRL		FCONTROL
 #define K_SHIFT		FSHIFT
@@ -21,16 +23,6 @@
 WORD HKToAccelMod(WORD modifiers);
 WORD AccelToHKMod(WORD modifiers);
 
-/**
- * Simple keyboard command struct
- */
-struct KeyToCommand
-{
-	unsigned char modifiers;
-	unsigned char key;
-	unsigned int msg;
-};
-
 int CodeToScintilla(const KeyToCommand* cmd);
 
 /**
@@ -43,17 +35,6 @@ struct StoredExtensionCommand
 	char command[150];
 };
 
-/**
- * This is for commands that have a command string (like scripts)
- */
-class ExtensionCommand : public KeyToCommand
-{
-public:
-	std::string command;
-};
-
-typedef std::map<unsigned short, ExtensionCommand> ExtensionCommands;
-
 /**
  * Keyboard settings file header
  */
@@ -87,39 +68,18 @@ class EditorCommand;
 /**
  * Simple keyboard command map
  */
-class KeyMap {
+class KeyMap : public KeyBindings {
 public:
 	KeyMap(KeyToCommand* commands);
 	KeyMap(const KeyMap& copy);
 	~KeyMap();
 
 	void Clear();
-	
-	void AssignCmdKey(int key, int modifiers, unsigned int msg);
-	void RemoveCmdKey(int key, int modifiers, unsigned int msg);
-
-	void AddExtended(const ExtensionCommand& command);
-	void RemoveExtended(unsigned char key, unsigned char modifiers);
-	
-	unsigned int Find(int key, int modifiers);	// 0 returned on failure
-	const ExtensionCommand* FindExtended(unsigned char key, unsigned char modifiers);
-	
-	size_t GetCount() const;
-	size_t GetExtendedCount() const;
-	
-	const KeyToCommand* GetMappings() const;
-	const ExtensionCommands& GetExtendedMappings() const;
-	
+
 	int MakeAccelerators(ACCEL* buffer, CommandDispatch* dispatcher);
 
 private:
-	void internalAssign(int key, int modifiers, unsigned int msg);
-
-	KeyToCommand *kmap;
 	CommandDispatch *lastdispatcher;
-	ExtensionCommands extkmap;
-	int len;
-	int alloc;
 	static const KeyToCommand MapDefault[];
 };
 
@@ -0,0 +1,531 @@
+/**
+ * @file docstats.cpp
+ * @brief Incremental document statistics
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "docstats.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+	#define DOCSTATS_SSSE3 1
+	#include <intrin.h>
+	#include <tmmintrin.h>
+#endif
+
+// Carriage returns and line feeds end words too, the old counter missed those.
+const char* DocStats::DefaultDelimiters = " \t\r\n\v\f.,!?)}]>;:=@/\\%|*&^$\"'~#+"; //removed: -_
+
+namespace {
+
+/**
+ * Character classes for 64 bytes of text, bit n is byte n.
+ */
+struct Masks
+{
+	uint64_t Word;
+	uint64_t Delimiter;
+	uint64_t LF;
+	uint64_t CR;
+	uint64_t Continuation;
+};
+
+int countBits(uint64_t v)
+{
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return static_cast<int>((v * 0x0101010101010101ULL) >> 56);
+}
+
+#ifdef DOCSTATS_SSSE3
+
+bool hasSsse3()
+{
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+}
+
+/**
+ * One bit for each of 16 bytes, given as their low and high nibbles, that is
+ * set if the byte is in the class described by the nibble tables. Rows
+ * 0-7 of the 16x16 byte table are in the A tables and rows 8-15 in the B
+ * tables, each row has its own bit so any set of bytes can be described.
+ */
+inline unsigned int classBits(__m128i low, __m128i high, const __m128i* tables)
+{
+	__m128i a = _mm_and_si128(_mm_shuffle_epi8(tables[0], low), _mm_shuffle_epi8(tables[1], high));
+	__m128i b = _mm_and_si128(_mm_shuffle_epi8(tables[2], low), _mm_shuffle_epi8(tables[3], high));
+	__m128i hit = _mm_or_si128(a, b);
+	return static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128()))) ^ 0xffff;
+}
+
+#endif
+
+} // namespace
+
+BlockStats::BlockStats() :
+	Bytes(0),
+	Characters(0),
+	Words(0),
+	LineEnds(0),
+	LeadingWord(false),
+	StartsWithLF(false),
+	EndsWithCR(false),
+	Exit(exitUnchanged)
+{
+}
+
+DocStats::ByteClass::ByteClass()
+{
+	memset(m_set, 0, sizeof(m_set));
+	memset(LowA, 0, sizeof(LowA));
+	memset(LowB, 0, sizeof(LowB));
+
+	for (int row = 0; row < 16; ++row)
+	{
+		HighA[row] = static_cast<unsigned char>(row < 8 ? 1 << row : 0);
+		HighB[row] = static_cast<unsigned char>(row < 8 ? 0 : 1 << (row - 8));
+	}
+}
+
+void DocStats::ByteClass::Add(unsigned char c)
+{
+	m_set[c] = true;
+
+	int row = c >> 4;
+	if (row < 8)
+	{
+		LowA[c & 0x0f] |= static_cast<unsigned char>(1 << row);
+	}
+	else
+	{
+		LowB[c & 0x0f] |= static_cast<unsigned char>(1 << (row - 8));
+	}
+}
+
+void DocStats::ByteClass::AddRange(unsigned char first, unsigned char last)
+{
+	for (int c = first; c <= last; ++c)
+	{
+		Add(static_cast<unsigned char>(c));
+	}
+}
+
+DocStats::DocStats(const char* delimiters, int blockSize) :
+	m_blockSize(blockSize),
+	m_length(0),
+	m_lastScanned(0),
+	m_valid(false),
+	m_counted(false),
+	m_dirty(true),
+	m_simd(false)
+{
+	m_word.AddRange('0', '9');
+	m_word.AddRange('A', 'Z');
+	m_word.AddRange('a', 'z');
+	m_word.AddRange(0xC0, 0xFF);
+
+	for (const unsigned char* p = reinterpret_cast<const unsigned char*>(delimiters); *p; ++p)
+	{
+		if (!m_word.Contains(*p))
+		{
+			m_delimiters.Add(*p);
+		}
+	}
+
+#ifdef DOCSTATS_SSSE3
+	m_simd = hasSsse3();
+#endif
+}
+
+void DocStats::Reset()
+{
+	m_valid = false;
+	m_dirty = true;
+}
+
+void DocStats::Inserted(int pos, int length)
+{
+	if (!m_valid || length <= 0)
+	{
+		return;
+	}
+
+	m_dirty = true;
+	m_length += length;
+
+	if (m_blocks.empty())
+	{
+		m_blocks.push_back(Block(length));
+		return;
+	}
+
+	// Text inserted between two blocks goes on the end of the first:
+	int start(0);
+	for (BlockList::iterator i = m_blocks.begin(); i != m_blocks.end(); ++i)
+	{
+		if (pos <= start + (*i).Length || i + 1 == m_blocks.end())
+		{
+			(*i).Length += length;
+			(*i).Dirty = true;
+			return;
+		}
+
+		start += (*i).Length;
+	}
+}
+
+void DocStats::Deleted(int pos, int length)
+{
+	if (!m_valid || length <= 0)
+	{
+		return;
+	}
+
+	m_dirty = true;
+	m_length -= length;
+
+	int end = pos + length;
+	int start(0);
+	for (BlockList::iterator i = m_blocks.begin(); i != m_blocks.end() && start < end; )
+	{
+		// Block positions are from before the delete:
+		int blockEnd = start + (*i).Length;
+		int from = pos > start ? pos : start;
+		int to = end < blockEnd ? end : blockEnd;
+
+		if (from < to)
+		{
+			(*i).Length -= to - from;
+			(*i).Dirty = true;
+		}
+
+		start = blockEnd;
+
+		if ((*i).Length == 0)
+		{
+			i = m_blocks.erase(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void DocStats::Update(IDocStatsSource& source, int documentLength)
+{
+	update(source, documentLength, 0);
+}
+
+bool DocStats::UpdateSome(IDocStatsSource& source, int documentLength, int maxBlocks)
+{
+	return update(source, documentLength, maxBlocks);
+}
+
+/**
+ * @param maxBlocks Most blocks to scan, 0 for all of them
+ * @return true if everything has been counted
+ */
+bool DocStats::update(IDocStatsSource& source, int documentLength, int maxBlocks)
+{
+	m_lastScanned = 0;
+
+	if (!m_valid || documentLength != m_length)
+	{
+		rebuild(documentLength);
+	}
+
+	if (!m_dirty)
+	{
+		return true;
+	}
+
+	splitAndMerge();
+
+	int start(0);
+	for (BlockList::iterator i = m_blocks.begin(); i != m_blocks.end(); ++i)
+	{
+		if ((*i).Dirty)
+		{
+			// The rest is left for the next call:
+			if (maxBlocks > 0 && m_lastScanned == maxBlocks)
+			{
+				return false;
+			}
+
+			if (m_buffer.size() < static_cast<size_t>((*i).Length + 1))
+			{
+				m_buffer.resize((*i).Length + 1);
+			}
+
+			source.GetText(start, start + (*i).Length, &m_buffer[0]);
+			Scan(&m_buffer[0], (*i).Length, (*i).Stats);
+
+			(*i).Dirty = false;
+			++m_lastScanned;
+		}
+
+		start += (*i).Length;
+	}
+
+	total();
+	m_dirty = false;
+	m_counted = true;
+
+	return true;
+}
+
+const TextStats& DocStats::GetStats() const
+{
+	return m_stats;
+}
+
+bool DocStats::IsCounted(int documentLength) const
+{
+	return m_valid && m_counted && documentLength == m_length;
+}
+
+int DocStats::GetLastScanned() const
+{
+	return m_lastScanned;
+}
+
+/**
+ * Counting is done on bit masks 64 bytes at a time. Word starts are found
+ * with an add: treating non-delimiters as ones and adding the word
+ * characters, a carry starts at each word character and runs until the
+ * next delimiter, so a word character with no carry into it starts a word.
+ */
+void DocStats::Scan(const char* text, int length, BlockStats& stats, bool useSimd) const
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+
+	stats = BlockStats();
+	stats.Bytes = length;
+
+	if (length == 0)
+	{
+		return;
+	}
+
+	stats.StartsWithLF = p[0] == '\n';
+	stats.EndsWithCR = p[length - 1] == '\r';
+
+#ifdef DOCSTATS_SSSE3
+	useSimd = useSimd && m_simd;
+
+	__m128i wordTables[4], delimiterTables[4];
+	wordTables[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_word.LowA));
+	wordTables[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_word.HighA));
+	wordTables[2] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_word.LowB));
+	wordTables[3] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_word.HighB));
+	delimiterTables[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_delimiters.LowA));
+	delimiterTables[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_delimiters.HighA));
+	delimiterTables[2] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_delimiters.LowB));
+	delimiterTables[3] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_delimiters.HighB));
+#else
+	useSimd = false;
+#endif
+
+	uint64_t inWord(0);
+	bool seenDecisive(false);
+	bool lastCR(false);
+	int crlfs(0), breaks(0), continuations(0);
+
+	for (int pos = 0; pos < length; pos += 64)
+	{
+		int count = length - pos < 64 ? length - pos : 64;
+		Masks m;
+
+#ifdef DOCSTATS_SSSE3
+		if (useSimd && count == 64)
+		{
+			const __m128i nibble = _mm_set1_epi8(0x0f);
+			const __m128i lf = _mm_set1_epi8('\n');
+			const __m128i cr = _mm_set1_epi8('\r');
+			const __m128i lead = _mm_set1_epi8(static_cast<char>(0xC0));
+
+			m.Word = m.Delimiter = m.LF = m.CR = m.Continuation = 0;
+
+			for (int chunk = 0; chunk < 4; ++chunk)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + pos + chunk * 16));
+				__m128i low = _mm_and_si128(v, nibble);
+				__m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+				int shift = chunk * 16;
+
+				m.Word |= static_cast<uint64_t>(classBits(low, high, wordTables)) << shift;
+				m.Delimiter |= static_cast<uint64_t>(classBits(low, high, delimiterTables)) << shift;
+				m.LF |= static_cast<uint64_t>(static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, lf)))) << shift;
+				m.CR |= static_cast<uint64_t>(static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr)))) << shift;
+				// 0x80 to 0xBF are the only bytes below 0xC0 when signed:
+				m.Continuation |= static_cast<uint64_t>(static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmplt_epi8(v, lead)))) << shift;
+			}
+		}
+		else
+#endif
+		{
+			m.Word = m.Delimiter = m.LF = m.CR = m.Continuation = 0;
+
+			for (int i = 0; i < count; ++i)
+			{
+				unsigned char c = p[pos + i];
+				uint64_t bit = static_cast<uint64_t>(1) << i;
+
+				if (m_word.Contains(c))
+					m.Word |= bit;
+				else if (m_delimiters.Contains(c))
+					m.Delimiter |= bit;
+
+				if (c == '\n')
+					m.LF |= bit;
+				else if (c == '\r')
+					m.CR |= bit;
+				else if ((c & 0xC0) == 0x80)
+					m.Continuation |= bit;
+			}
+		}
+
+		// Bytes past the end have no class, so they leave the word state alone:
+		uint64_t nonDelimiters = ~m.Delimiter;
+		uint64_t sum = nonDelimiters + m.Word;
+		uint64_t carryOut = sum < nonDelimiters ? 1 : 0;
+		uint64_t sumIn = sum + inWord;
+		carryOut |= sumIn < sum ? 1 : 0;
+		uint64_t carries = sumIn ^ nonDelimiters ^ m.Word;
+
+		stats.Words += countBits(m.Word & ~carries);
+		inWord = carryOut;
+
+		uint64_t decisive = m.Word | m.Delimiter;
+		if (!seenDecisive && decisive != 0)
+		{
+			seenDecisive = true;
+			stats.LeadingWord = ((decisive & (0 - decisive)) & m.Word) != 0;
+		}
+
+		crlfs += countBits(m.CR & (m.LF >> 1));
+		if (lastCR && (m.LF & 1))
+		{
+			++crlfs;
+		}
+		lastCR = (m.CR >> 63) != 0;
+
+		breaks += countBits(m.LF) + countBits(m.CR);
+		continuations += countBits(m.Continuation);
+	}
+
+	stats.LineEnds = breaks - crlfs;
+	stats.Characters = length - continuations;
+
+	if (seenDecisive)
+	{
+		stats.Exit = inWord ? BlockStats::exitWord : BlockStats::exitSpace;
+	}
+}
+
+/**
+ * Start again with one dirty block covering the document.
+ */
+void DocStats::rebuild(int documentLength)
+{
+	m_blocks.clear();
+	if (documentLength > 0)
+	{
+		m_blocks.push_back(Block(documentLength));
+	}
+
+	m_length = documentLength;
+	m_valid = true;
+	m_counted = false;
+	m_dirty = true;
+}
+
+/**
+ * Dirty blocks that have grown too big are split, and small ones are
+ * merged into the next block, before they're scanned.
+ */
+void DocStats::splitAndMerge()
+{
+	BlockList blocks;
+	blocks.reserve(m_blocks.size() + m_length / m_blockSize + 1);
+
+	for (BlockList::const_iterator i = m_blocks.begin(); i != m_blocks.end(); ++i)
+	{
+		if (!(*i).Dirty)
+		{
+			blocks.push_back(*i);
+			continue;
+		}
+
+		int length = (*i).Length;
+
+		// Too small, and both it and the next one need scanning anyway:
+		while (length < m_blockSize / 4 && i + 1 != m_blocks.end() && (*(i + 1)).Dirty)
+		{
+			++i;
+			length += (*i).Length;
+		}
+
+		while (length > m_blockSize * 2)
+		{
+			blocks.push_back(Block(m_blockSize));
+			length -= m_blockSize;
+		}
+
+		blocks.push_back(Block(length));
+	}
+
+	m_blocks.swap(blocks);
+}
+
+/**
+ * Add up the blocks, joining words and CRLFs that span blocks.
+ */
+void DocStats::total()
+{
+	TextStats stats;
+	int lineEnds(0);
+	bool inWord(false);
+	bool lastCR(false);
+
+	for (BlockList::const_iterator i = m_blocks.begin(); i != m_blocks.end(); ++i)
+	{
+		const BlockStats& block = (*i).Stats;
+
+		stats.Bytes += block.Bytes;
+		stats.Characters += block.Characters;
+		stats.Words += block.Words;
+		lineEnds += block.LineEnds;
+
+		if (inWord && block.LeadingWord)
+		{
+			--stats.Words;
+		}
+
+		if (lastCR && block.StartsWithLF)
+		{
+			--lineEnds;
+		}
+
+		if (block.Exit != BlockStats::exitUnchanged)
+		{
+			inWord = block.Exit == BlockStats::exitWord;
+		}
+
+		lastCR = block.EndsWithCR;
+	}
+
+	stats.Lines = lineEnds + 1;
+	m_stats = stats;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file docstats.h
+ * @brief Incremental document statistics
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef docstats_h__included
+#define docstats_h__included
+
+#include <vector>
+
+/**
+ * Counts for a whole document.
+ */
+struct TextStats
+{
+	TextStats() : Bytes(0), Characters(0), Words(0), Lines(1) {}
+
+	int Bytes;
+	/// UTF-8 code points, the same as Bytes for single byte text
+	int Characters;
+	int Words;
+	/// CR, LF and CRLF each end a line
+	int Lines;
+};
+
+/**
+ * Counts for one block of text, with enough about its edges that blocks
+ * can be scanned on their own and added together afterwards.
+ */
+struct BlockStats
+{
+	typedef enum
+	{
+		/// The block ends outside a word
+		exitSpace,
+		/// The block ends inside a word
+		exitWord,
+		/// No word or delimiter characters, the block leaves things as they were
+		exitUnchanged
+	} EExit;
+
+	BlockStats();
+
+	int Bytes;
+	int Characters;
+	/// Words started in the block, counting from outside a word
+	int Words;
+	int LineEnds;
+	/// The first word or delimiter character is a word character
+	bool LeadingWord;
+	bool StartsWithLF;
+	bool EndsWithCR;
+	EExit Exit;
+};
+
+/**
+ * Supplies document text to DocStats a range at a time.
+ */
+class IDocStatsSource
+{
+public:
+	virtual ~IDocStatsSource(){}
+
+	/**
+	 * Copy the text from start to end into buffer, which is big enough.
+	 */
+	virtual void GetText(int start, int end, char* buffer) = 0;
+};
+
+/**
+ * Word, character and line counts for a document, kept per block so that
+ * after an edit only the blocks it touched are scanned again. Blocks are
+ * scanned 64 bytes at a time building bit masks of character classes,
+ * with SSSE3 table lookups where the processor has them.
+ *
+ * A word starts with a letter or digit (or a byte from 0xC0 up, which is
+ * a letter in Windows-1252 and a lead byte in UTF-8) and runs until one of
+ * the delimiter characters.
+ */
+class DocStats
+{
+public:
+	enum { DefaultBlockSize = 65536 };
+
+	static const char* DefaultDelimiters;
+
+	explicit DocStats(const char* delimiters = DefaultDelimiters, int blockSize = DefaultBlockSize);
+
+	/**
+	 * Forget everything, the next Update scans the whole document.
+	 */
+	void Reset();
+
+	/**
+	 * Text was inserted, call after the document has changed.
+	 */
+	void Inserted(int pos, int length);
+
+	/**
+	 * Text was deleted, call after the document has changed.
+	 */
+	void Deleted(int pos, int length);
+
+	/**
+	 * Rescan whatever has changed, documentLength is used to catch
+	 * changes we weren't told about.
+	 */
+	void Update(IDocStatsSource& source, int documentLength);
+
+	/**
+	 * Like Update, but scan no more than maxBlocks blocks so that a big
+	 * document can be counted a piece at a time. GetStats isn't updated
+	 * until everything has been scanned.
+	 * @return true once the whole document is counted
+	 */
+	bool UpdateSome(IDocStatsSource& source, int documentLength, int maxBlocks);
+
+	/**
+	 * Counts as of the last Update.
+	 */
+	const TextStats& GetStats() const;
+
+	/**
+	 * Has the whole document been counted, so that Update only needs to
+	 * count the blocks changed since?
+	 */
+	bool IsCounted(int documentLength) const;
+
+	/**
+	 * Count a piece of text, useSimd is there so the tests can compare.
+	 */
+	void Scan(const char* text, int length, BlockStats& stats, bool useSimd = true) const;
+
+	/// Number of blocks scanned by the last Update
+	int GetLastScanned() const;
+
+private:
+	class Block
+	{
+	public:
+		Block(int length) : Length(length), Dirty(true) {}
+
+		int Length;
+		bool Dirty;
+		BlockStats Stats;
+	};
+
+	typedef std::vector<Block> BlockList;
+
+	/**
+	 * A set of bytes, as a table and as nibble lookups for pshufb.
+	 */
+	class ByteClass
+	{
+	public:
+		ByteClass();
+
+		void Add(unsigned char c);
+		void AddRange(unsigned char first, unsigned char last);
+		bool Contains(unsigned char c) const { return m_set[c]; }
+
+		unsigned char LowA[16], HighA[16];
+		unsigned char LowB[16], HighB[16];
+
+	private:
+		bool m_set[256];
+	};
+
+	bool update(IDocStatsSource& source, int documentLength, int maxBlocks);
+	void rebuild(int documentLength);
+	void splitAndMerge();
+	void total();
+
+	ByteClass m_word;
+	ByteClass m_delimiters;
+	BlockList m_blocks;
+	TextStats m_stats;
+	int m_blockSize;
+	int m_length;
+	int m_lastScanned;
+	bool m_valid;
+	/// Every block has been scanned since the last rebuild
+	bool m_counted;
+	bool m_dirty;
+	bool m_simd;
+	std::vector<char> m_buffer;
+};
+
+#endif // #ifndef docstats_h__included
@@ -0,0 +1,618 @@
+/**
+ * @file errorindex.cpp
+ * @brief Find error locations in tool output.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "errorindex.h"
+#include "third_party/scintilla/include/scilexer.h"
+
+#if defined (_DEBUG)
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using pnutils::threading::CritLock;
+
+namespace {
+
+const BuiltInErrorParsers s_builtInParsers;
+
+bool startsWith(const std::string& text, const char* prefix)
+{
+	return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+bool contains(const std::string& text, const char* part)
+{
+	return text.find(part) != std::string::npos;
+}
+
+bool isDigit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+bool isNonZeroDigit(char ch)
+{
+	return ch >= '1' && ch <= '9';
+}
+
+/**
+ * The word after "file(line)" in a message the errorlist lexer gives the
+ * Microsoft style.
+ */
+bool isMsMessageWord(const std::string& text, size_t pos)
+{
+	size_t end = pos;
+	while (end < text.size() && ((text[end] >= 'a' && text[end] <= 'z') || (text[end] >= 'A' && text[end] <= 'Z')))
+	{
+		++end;
+	}
+
+	static const char* words[] = { "error", "warning", "fatal", "catastrophic", "note", "remark" };
+	for (int i = 0; i < 6; ++i)
+	{
+		if (end - pos == strlen(words[i]) && _strnicmp(text.c_str() + pos, words[i], end - pos) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * The state machine at the end of the errorlist lexer's line recogniser,
+ * for GCC's file:line: and Microsoft's file(line): forms.
+ */
+int classifyCompilerLine(const std::string& text)
+{
+	enum { stInitial, stGccStart, stGccDigit, stMsStart, stMsDigit, stMsBracket, stMsDigitComma } state = stInitial;
+
+	bool initialTab = text[0] == '\t';
+	bool initialColonPart = false;
+
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		char ch = text[i];
+		char chNext = i + 1 < text.size() ? text[i + 1] : ' ';
+
+		switch (state)
+		{
+			case stInitial:
+				if (ch == ':')
+				{
+					if (chNext != '\\' && chNext != '/' && chNext != ' ')
+						state = stGccStart;
+					else if (chNext == ' ')
+						initialColonPart = true;
+				}
+				else if (ch == '(' && isNonZeroDigit(chNext) && !initialTab)
+				{
+					state = stMsStart;
+				}
+				else if (ch == '\t' && !initialTab)
+				{
+					// CTags
+					return SCE_ERR_DEFAULT;
+				}
+				break;
+
+			case stGccStart:
+				if (!isNonZeroDigit(ch))
+					return SCE_ERR_DEFAULT;
+				state = stGccDigit;
+				break;
+
+			case stGccDigit:
+				if (ch == ':')
+					return initialColonPart ? SCE_ERR_LUA : SCE_ERR_GCC;
+				if (!isDigit(ch))
+					return SCE_ERR_DEFAULT;
+				break;
+
+			case stMsStart:
+				if (!isDigit(ch))
+					return SCE_ERR_DEFAULT;
+				state = stMsDigit;
+				break;
+
+			case stMsDigit:
+				if (ch == ',')
+					state = stMsDigitComma;
+				else if (ch == ')')
+					state = stMsBracket;
+				else if (ch != ' ' && !isDigit(ch))
+					return SCE_ERR_DEFAULT;
+				break;
+
+			case stMsBracket:
+				if (ch == ' ' && chNext == ':')
+					return SCE_ERR_MS;
+				if (ch == ' ')
+					return isMsMessageWord(text, i + 1) ? SCE_ERR_MS : SCE_ERR_DEFAULT;
+				if (ch == ':' && chNext == ' ')
+					return isMsMessageWord(text, i + 2) ? SCE_ERR_MS : SCE_ERR_DEFAULT;
+				return SCE_ERR_DEFAULT;
+
+			case stMsDigitComma:
+				if (ch == ')')
+					return SCE_ERR_MS;
+				if (ch != ' ' && !isDigit(ch))
+					return SCE_ERR_DEFAULT;
+				break;
+		}
+	}
+
+	return SCE_ERR_DEFAULT;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////////
+// ErrorParser
+//////////////////////////////////////////////////////////////////////////////
+
+ErrorParser::ErrorParser(const std::string& expression) :
+	m_re(boost::xpressive::sregex::compile(expression))
+{
+}
+
+bool ErrorParser::Parse(const std::string& text, ErrorLocation& location) const
+{
+	boost::xpressive::smatch match;
+	if (!boost::xpressive::regex_search(text, match, m_re))
+	{
+		return false;
+	}
+
+	std::string linestr;
+	std::string colstr;
+
+	// Extract the named matches from the RE, noting if there was a line or column.
+	safe_get_submatch(match, location.File, "f");
+	location.Line = safe_get_submatch(match, linestr, "l") ? atoi(linestr.c_str()) : 0;
+	location.Column = safe_get_submatch(match, colstr, "c") ? atoi(colstr.c_str()) : 0;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BuiltInErrorParsers
+//////////////////////////////////////////////////////////////////////////////
+
+BuiltInErrorParsers::BuiltInErrorParsers() :
+	/*
+	 * Python errors:
+	 * File "T:\source\ipconfig\ipconfig.py", line 45
+	 */
+	m_python("File \"(?P<f>.+)\", line (?P<l>[0-9]+)"),
+
+	/*
+	 * Simple GCC errors:
+	 * filename.ext:linenumber: error string/whatever
+	 */
+	m_gcc("^(?P<f>.+?):(?P<l>[0-9]+):((?P<c>[0-9]+):)? .*"),
+
+	/*
+	 * Microsoft messages, derived from \s%f\(%l,%c\): and tested with NAnt output:
+	 * filename.ext(line,col): message
+	 */
+	m_ms("^\\s*(?P<f>.+)\\((?P<l>[0-9]+)(,(?P<c>[0-9]+))?\\)\\s*: "),
+
+	/*
+	 * Borland C++ errors, warnings and resource compiler warnings. Explanation
+	 * of this RE: http://www.pnotepad.org/devlog/archives/000086.html
+	 * Error E2034 clippert.cpp 207: message...
+	 * Warning W8070 clippert.cpp 208: message...
+	 * Error resources.rc 14 18: message (column line:)
+	 */
+	m_borland("^(Error|Warning) ((E|W)[0-9]{4} )?(?P<f>.+?) ((?P<c>[0-9]+) )?(?P<l>[0-9]+): .+"),
+
+	/*
+	 * lcc-win32 errors, styled the same as Borland ones.
+	 */
+	m_lcc("^(Error|Warning) (?P<f>.+): (?P<l>[0-9]+) .+"),
+
+	/*
+	 * Perl errors are not anchored to the start of the line, beginning with "at".
+	 * syntax error at P:\tex\packages\authorindex.pl line 103, near "){"
+	 * String found where operator expected at P:\tex\packages\authorindex.pl line 110
+	 */
+	m_perl("at (?P<f>.+) line (?P<l>[0-9]+)")
+{
+}
+
+const BuiltInErrorParsers& BuiltInErrorParsers::Get()
+{
+	return s_builtInParsers;
+}
+
+bool BuiltInErrorParsers::Parse(int style, const std::string& text, ErrorLocation& location) const
+{
+	switch (style)
+	{
+		case SCE_ERR_PYTHON:
+			return m_python.Parse(text, location);
+
+		case SCE_ERR_GCC:
+			return m_gcc.Parse(text, location);
+
+		case SCE_ERR_MS:
+			return m_ms.Parse(text, location);
+
+		case SCE_ERR_BORLAND:
+			return m_borland.Parse(text, location) || m_lcc.Parse(text, location);
+
+		case SCE_ERR_PERL:
+			return m_perl.Parse(text, location);
+	}
+
+	return false;
+}
+
+bool BuiltInErrorParsers::Parse(const std::string& text, ErrorLocation& location) const
+{
+	// Only the one expression for the line's style is tried, most lines have none:
+	return Parse(Classify(text), text, location);
+}
+
+/**
+ * Follows RecogniseErrorListLine in Scintilla's LexOthers.cxx, in the same
+ * order so that a line matching several formats gets the lexer's answer.
+ * Formats we have no parser for are only recognised so that they aren't
+ * mistaken for one we do.
+ */
+int BuiltInErrorParsers::Classify(const std::string& text)
+{
+	if (text.empty())
+	{
+		return SCE_ERR_DEFAULT;
+	}
+
+	switch (text[0])
+	{
+		case '>':
+		case '<':
+		case '!':
+		case '+':
+		case '-':
+			// Commands, return codes and diffs
+			return SCE_ERR_DEFAULT;
+	}
+
+	if (startsWith(text, "cf90-") || startsWith(text, "fortcom:"))
+	{
+		return SCE_ERR_DEFAULT;
+	}
+
+	if (contains(text, "File \"") && contains(text, ", line "))
+	{
+		return SCE_ERR_PYTHON;
+	}
+
+	if (contains(text, " in ") && contains(text, " on line "))
+	{
+		return SCE_ERR_PHP;
+	}
+
+	if (startsWith(text, "Error ") || startsWith(text, "Warning "))
+	{
+		// Intel Fortran uses the same words:
+		size_t at = text.find(" at (");
+		size_t close = text.find(") : ");
+		if (at != std::string::npos && close != std::string::npos && at < close)
+		{
+			return SCE_ERR_IFC;
+		}
+
+		return SCE_ERR_BORLAND;
+	}
+
+	if (contains(text, "at line ") && contains(text, "file "))
+	{
+		return SCE_ERR_LUA;
+	}
+
+	size_t at = text.find(" at ");
+	size_t line = text.find(" line ");
+	if (at != std::string::npos && line != std::string::npos && at < line)
+	{
+		return SCE_ERR_PERL;
+	}
+
+	if (startsWith(text, "   at ") || startsWith(text, "Line ") || startsWith(text, "line ") || startsWith(text, "\tat "))
+	{
+		// .NET and Java tracebacks, Lahey Fortran and HTML tidy, when they
+		// have the rest of their format, otherwise these fall through to the
+		// compiler formats:
+		if ((startsWith(text, "   at ") && contains(text, ":line "))
+			|| (startsWith(text, "Line ") && contains(text, ", file "))
+			|| (startsWith(text, "line ") && contains(text, " column "))
+			|| (startsWith(text, "\tat ") && contains(text, "(") && contains(text, ".java:")))
+		{
+			return SCE_ERR_DEFAULT;
+		}
+	}
+
+	return classifyCompilerLine(text);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ErrorIndex
+//////////////////////////////////////////////////////////////////////////////
+
+ErrorIndex::ErrorIndex() :
+	m_discarded(0),
+	m_generation(0),
+	m_hWndNotify(NULL),
+	m_notifyMessage(0),
+	m_workerGeneration(0),
+	m_line(0),
+	m_lastWasCR(false),
+	m_started(false),
+	m_queued(false),
+	m_thread(this, &ErrorIndex::run)
+{
+	m_idle.Set();
+}
+
+ErrorIndex::~ErrorIndex()
+{
+	m_thread.Stop();
+
+	for (std::deque<Job*>::iterator i = m_queue.begin(); i != m_queue.end(); ++i)
+	{
+		delete *i;
+	}
+}
+
+void ErrorIndex::SetNotifyWindow(HWND hWnd, UINT message)
+{
+	CritLock lock(m_cs);
+	m_hWndNotify = hWnd;
+	m_notifyMessage = message;
+}
+
+void ErrorIndex::SetParser(ErrorParserPtr parser)
+{
+	CritLock lock(m_cs);
+	m_parser = parser;
+}
+
+void ErrorIndex::Add(const char* text, size_t length)
+{
+	if (length == 0)
+	{
+		return;
+	}
+
+	Job* job = new Job;
+	job->Text.assign(text, length);
+
+	{
+		CritLock lock(m_cs);
+		job->Parser = m_parser;
+		job->Generation = m_generation;
+		m_queue.push_back(job);
+		m_idle.Reset();
+	}
+
+	if (!m_started)
+	{
+		// Most output views never show any tool output, so they don't get a thread:
+		m_thread.Start();
+		m_started = true;
+	}
+
+	m_queued.Set();
+}
+
+void ErrorIndex::Clear()
+{
+	CritLock lock(m_cs);
+
+	for (std::deque<Job*>::iterator i = m_queue.begin(); i != m_queue.end(); ++i)
+	{
+		delete *i;
+	}
+
+	m_queue.clear();
+	m_entries.clear();
+	m_idle.Set();
+	m_discarded = 0;
+	++m_generation;
+}
+
+void ErrorIndex::DiscardBefore(int firstLine)
+{
+	CritLock lock(m_cs);
+
+	while (m_entries.size() && m_entries.front().OutputLine < firstLine)
+	{
+		m_entries.pop_front();
+		++m_discarded;
+	}
+}
+
+void ErrorIndex::GetRange(size_t& begin, size_t& end)
+{
+	CritLock lock(m_cs);
+	begin = m_discarded;
+	end = m_discarded + m_entries.size();
+}
+
+bool ErrorIndex::GetEntry(size_t index, Entry& entry)
+{
+	CritLock lock(m_cs);
+
+	if (index < m_discarded || index - m_discarded >= m_entries.size())
+	{
+		return false;
+	}
+
+	entry = m_entries[index - m_discarded];
+	return true;
+}
+
+bool ErrorIndex::FindLine(int outputLine, size_t& index)
+{
+	CritLock lock(m_cs);
+
+	// Entries are in line order, so binary search:
+	size_t low(0), high(m_entries.size());
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		if (m_entries[mid].OutputLine < outputLine)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	if (low == m_entries.size() || m_entries[low].OutputLine != outputLine)
+	{
+		return false;
+	}
+
+	index = m_discarded + low;
+	return true;
+}
+
+bool ErrorIndex::WaitUntilIndexed(DWORD timeout)
+{
+	return m_idle.Wait(timeout) == WAIT_OBJECT_0;
+}
+
+void ErrorIndex::run(CSSThread* thread)
+{
+	HANDLE handles[2] = { thread->GetStopHandle(), m_queued.Get() };
+	bool added(false);
+
+	while (thread->GetCanRun())
+	{
+		Job* job(NULL);
+
+		{
+			CritLock lock(m_cs);
+			if (m_queue.size())
+			{
+				job = m_queue.front();
+				m_queue.pop_front();
+			}
+			else
+			{
+				// Whatever the last job found has been published by now:
+				m_idle.Set();
+			}
+		}
+
+		if (job != NULL)
+		{
+			if (job->Generation != m_workerGeneration)
+			{
+				// Cleared, start counting lines again:
+				m_workerGeneration = job->Generation;
+				m_partial.clear();
+				m_line = 0;
+				m_lastWasCR = false;
+			}
+
+			ENTRIES found;
+			index(*job, found);
+
+			if (found.size())
+			{
+				CritLock lock(m_cs);
+				if (job->Generation == m_generation)
+				{
+					m_entries.insert(m_entries.end(), found.begin(), found.end());
+					added = true;
+				}
+			}
+
+			delete job;
+		}
+		else
+		{
+			// Tell the view once we've caught up rather than for every chunk:
+			if (added)
+			{
+				CritLock lock(m_cs);
+				if (m_hWndNotify != NULL)
+				{
+					::PostMessage(m_hWndNotify, m_notifyMessage, 0, 0);
+				}
+
+				added = false;
+			}
+
+			::WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+		}
+	}
+}
+
+/**
+ * Split the output into lines the same way Scintilla does, so that our line
+ * numbers match the view's: \r\n, \n and \r all end a line. The last line
+ * is kept until we see its end.
+ */
+void ErrorIndex::index(Job& job, ENTRIES& found)
+{
+	const std::string& text = job.Text;
+	size_t pos(0);
+
+	while (pos < text.size())
+	{
+		if (m_lastWasCR)
+		{
+			m_lastWasCR = false;
+			if (text[pos] == '\n')
+			{
+				++pos;
+				continue;
+			}
+		}
+
+		size_t eol = text.find_first_of("\r\n", pos);
+		if (eol == std::string::npos)
+		{
+			m_partial.append(text, pos, std::string::npos);
+			break;
+		}
+
+		m_partial.append(text, pos, eol - pos);
+		m_lastWasCR = text[eol] == '\r';
+		pos = eol + 1;
+
+		indexLine(job.Parser, found);
+	}
+}
+
+void ErrorIndex::indexLine(const ErrorParserPtr& parser, ENTRIES& found)
+{
+	Entry entry;
+	bool matched = parser.get() != NULL ?
+		parser->Parse(m_partial, entry.Location) :
+		BuiltInErrorParsers::Get().Parse(m_partial, entry.Location);
+
+	if (matched)
+	{
+		entry.OutputLine = m_line;
+		found.push_back(entry);
+	}
+
+	m_partial.clear();
+	++m_line;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file errorindex.h
+ * @brief Find error locations in tool output.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef errorindex_h__included
+#define errorindex_h__included
+
+#include "include/ssthreads.h"
+#include "include/threading.h"
+
+#include <deque>
+
+/**
+ * Where a line of tool output says an error is.
+ */
+class ErrorLocation
+{
+	public:
+		ErrorLocation() : Line(0), Column(0) {}
+
+		std::string File;
+		/// 1-based, 0 if the output didn't give one
+		int Line;
+		/// 0 if the output didn't give one
+		int Column;
+};
+
+/**
+ * A compiled regular expression with named groups f, l and c for the file,
+ * line and column of an error. Parse doesn't change the parser, so it can
+ * be used from several threads at once.
+ */
+class ErrorParser
+{
+	public:
+		/**
+		 * @throws boost::xpressive::regex_error if expression is invalid
+		 */
+		explicit ErrorParser(const std::string& expression);
+
+		bool Parse(const std::string& text, ErrorLocation& location) const;
+
+	private:
+		boost::xpressive::sregex m_re;
+};
+
+typedef boost::shared_ptr<const ErrorParser> ErrorParserPtr;
+
+/**
+ * The parsers for the error formats styled by the output lexer. They're
+ * compiled once during static initialisation, before any thread that might
+ * use them has started.
+ */
+class BuiltInErrorParsers
+{
+	public:
+		static const BuiltInErrorParsers& Get();
+
+		/**
+		 * Parse text styled with one of the SCE_ERR_ styles.
+		 */
+		bool Parse(int style, const std::string& text, ErrorLocation& location) const;
+
+		/**
+		 * Parse a line in any of the built-in formats, it's classified the
+		 * way the output lexer would style it first.
+		 */
+		bool Parse(const std::string& text, ErrorLocation& location) const;
+
+		/**
+		 * The SCE_ERR_ style the output lexer gives a line of output.
+		 */
+		static int Classify(const std::string& text);
+
+		BuiltInErrorParsers();
+
+	private:
+		ErrorParser m_python;
+		ErrorParser m_gcc;
+		ErrorParser m_ms;
+		ErrorParser m_borland;
+		ErrorParser m_lcc;
+		ErrorParser m_perl;
+};
+
+/**
+ * Finds the errors in tool output on a worker thread as the output is added
+ * to a view, so that moving between errors and counting them doesn't need
+ * to look at the output again. Entries are numbered from the last Clear,
+ * and keep their number when older entries are discarded.
+ */
+class ErrorIndex
+{
+	public:
+		class Entry
+		{
+			public:
+				/// Line of the output, counted from the last Clear
+				int OutputLine;
+				ErrorLocation Location;
+		};
+
+		ErrorIndex();
+		~ErrorIndex();
+
+		/**
+		 * message is posted to hWnd when entries have been added.
+		 */
+		void SetNotifyWindow(HWND hWnd, UINT message);
+
+		/**
+		 * Parser for output added from now on, NULL for the built-in parsers.
+		 */
+		void SetParser(ErrorParserPtr parser);
+
+		/**
+		 * Queue output to be indexed, in the order it was added to the view.
+		 */
+		void Add(const char* text, size_t length);
+
+		/**
+		 * Forget all entries and any output still waiting to be indexed.
+		 */
+		void Clear();
+
+		/**
+		 * Forget entries for output lines before firstLine.
+		 */
+		void DiscardBefore(int firstLine);
+
+		/**
+		 * Entries available are numbered [begin, end).
+		 */
+		void GetRange(size_t& begin, size_t& end);
+
+		bool GetEntry(size_t index, Entry& entry);
+
+		/**
+		 * Find the entry for an output line.
+		 * @return false if the line isn't an error we know about
+		 */
+		bool FindLine(int outputLine, size_t& index);
+
+		/**
+		 * Wait until everything added so far has been indexed.
+		 * @return false if that took longer than timeout milliseconds
+		 */
+		bool WaitUntilIndexed(DWORD timeout);
+
+	private:
+		class Job
+		{
+			public:
+				std::string Text;
+				ErrorParserPtr Parser;
+				unsigned int Generation;
+		};
+
+		typedef std::deque<Entry> ENTRIES;
+
+		void run(CSSThread* thread);
+		void index(Job& job, ENTRIES& found);
+		void indexLine(const ErrorParserPtr& parser, ENTRIES& found);
+
+		pnutils::threading::CriticalSection m_cs;
+		std::deque<Job*> m_queue;
+		ENTRIES m_entries;
+		/// Number of entries discarded from the front of m_entries
+		size_t m_discarded;
+		/// Changed by Clear so that work already under way is thrown away
+		unsigned int m_generation;
+		ErrorParserPtr m_parser;
+		HWND m_hWndNotify;
+		UINT m_notifyMessage;
+
+		// Worker thread state:
+		unsigned int m_workerGeneration;
+		std::string m_partial;
+		int m_line;
+		bool m_lastWasCR;
+
+		bool m_started;
+		pnutils::threading::WinEvent m_queued;
+		/// Set while the worker has nothing left to index
+		pnutils::threading::ManualResetEvent m_idle;
+		CSSThreadT<ErrorIndex> m_thread;
+};
+
+#endif // #ifndef errorindex_h__included
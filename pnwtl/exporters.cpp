@@ -17,41 +17,153 @@
 
 void PrintfConduit::printf(const char* format, ...)
 {
-	va_list args;
-	va_start(args, format);
+	if (m_format.empty())
+	{
+		m_format.resize(256);
+	}
 
-	str.FormatV(format, args);
-	
-	puts(str);
+	// Try the buffer we have, then at most once more at the size asked for:
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		va_list args;
+		va_start(args, format);
+		int written = _vsnprintf(&m_format[0], m_format.size(), format, args);
+		va_end(args);
+
+		if (written >= 0 && written < static_cast<int>(m_format.size()))
+		{
+			write(&m_format[0], written);
+			return;
+		}
+
+		va_start(args, format);
+		int needed = _vscprintf(format, args);
+		va_end(args);
+
+		// -1 also means an argument couldn't be converted, a bigger buffer won't help:
+		if (needed < static_cast<int>(m_format.size()))
+		{
+			LOG(_T("PN2: Export output could not be formatted."));
+			return;
+		}
+
+		m_format.resize(needed + 1);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ScintillaStyledText class
+
+ScintillaStyledText::ScintillaStyledText(CScintilla* pScintilla) : m_pScintilla(pScintilla)
+{
+}
+
+int ScintillaStyledText::GetLength()
+{
+	return m_pScintilla->SPerform(SCI_GETLENGTH, 0, 0);
+}
+
+int ScintillaStyledText::GetTabWidth()
+{
+	return m_pScintilla->SPerform(SCI_GETTABWIDTH, 0, 0);
+}
+
+void ScintillaStyledText::Colourise(int start, int end)
+{
+	m_pScintilla->SPerform(SCI_COLOURISE, start, end);
+}
 
-	va_end(args);
+void ScintillaStyledText::GetStyledText(int start, int end, char* buffer)
+{
+	Scintilla::TextRange tr;
+	tr.chrg.cpMin = start;
+	tr.chrg.cpMax = end;
+	tr.lpstrText = buffer;
+	m_pScintilla->GetStyledText(&tr);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// BaseExporter class
+// StyleRunReader class
+
+StyleRunReader::StyleRunReader(IStyledTextSource* source, int start, int end, int chunkSize) : 
+	m_source(source), 
+	m_pos(start), 
+	m_end(end), 
+	m_chunkSize(chunkSize), 
+	m_index(0), 
+	m_count(0)
+{
+}
 
-BaseExporter::BaseExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla)
+bool StyleRunReader::Next(StyleRun& run)
 {
-	m_out = pOutput;
-	m_pStyles = pStyles;
-	m_pScintilla = pScintilla;
-	m_pSchemeName = lpszSchemeName;
+	if (m_index == m_count && !fill())
+	{
+		return false;
+	}
+
+	const unsigned char* styles = &m_styles[0];
+	int first = m_index;
+	unsigned char style = styles[first];
+	
+	int i = first + 1;
+	while (i < m_count && styles[i] == style)
+	{
+		i++;
+	}
+
+	run.Text = &m_text[first];
+	run.Length = i - first;
+	run.Style = style;
+
+	m_index = i;
+	return true;
 }
 
 /**
- * @return character at position.
+ * Read the next chunk and split the pairs into text and styles.
  */
-char BaseExporter::CharAt(int position)
+bool StyleRunReader::fill()
 {
-	return (char)( m_pScintilla->SPerform(SCI_GETCHARAT, position) & 0xFF );
+	if (m_pos >= m_end)
+	{
+		return false;
+	}
+
+	int length = m_end - m_pos;
+	if (length > m_chunkSize)
+	{
+		length = m_chunkSize;
+	}
+
+	m_styled.resize(length * 2 + 2);
+	m_text.resize(length);
+	m_styles.resize(length);
+
+	m_source->GetStyledText(m_pos, m_pos + length, &m_styled[0]);
+
+	const char* pairs = &m_styled[0];
+	for (int i = 0; i < length; i++)
+	{
+		m_text[i] = pairs[i * 2];
+		m_styles[i] = static_cast<unsigned char>(pairs[i * 2 + 1]);
+	}
+
+	m_pos += length;
+	m_index = 0;
+	m_count = length;
+	return true;
 }
 
-/**
- * @return style at position.
- */
-int BaseExporter::StyleAt(int position)
+////////////////////////////////////////////////////////////////////////////////
+// BaseExporter class
+
+BaseExporter::BaseExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource)
 {
-	return m_pScintilla->SPerform(SCI_GETSTYLEAT, position);
+	m_out = pOutput;
+	m_pStyles = pStyles;
+	m_source = pSource;
+	m_pSchemeName = lpszSchemeName;
 }
 
 /**
@@ -73,17 +185,12 @@ int BaseExporter::GetMaxStyleKey()
 	return maxKey;
 }
 
-int BaseExporter::SendEditor(long Msg, WPARAM wParam, LPARAM lParam)
-{
-	return m_pScintilla->SPerform(Msg, wParam, lParam);
-}
-
 void BaseExporter::Export(int start, int finish)
 {
-	SendEditor(SCI_COLOURISE, 0, -1);
+	m_source->Colourise(0, -1);
 	
 	if (finish < 0)
-		finish = SendEditor(SCI_GETLENGTH, 0, 0);;
+		finish = m_source->GetLength();
 
 	InternalExport(start, finish);
 }
@@ -101,14 +208,14 @@ LPCTSTR BaseExporter::GetFileMask()
 ////////////////////////////////////////////////////////////////////////////////
 // ExporterFactory class
 			
-BaseExporter* ExporterFactory::GetExporter(EExporterType type, IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla)
+BaseExporter* ExporterFactory::GetExporter(EExporterType type, IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource)
 {
 	switch(type)
 	{
 		case RTF:
-			return new RTFExporter(pOutput, lpszSchemeName, pStyles, pScintilla);
+			return new RTFExporter(pOutput, lpszSchemeName, pStyles, pSource);
 		case HTML:
-			return new HTMLExporter(pOutput, lpszSchemeName, pStyles, pScintilla);
+			return new HTMLExporter(pOutput, lpszSchemeName, pStyles, pSource);
 	}
 	
 	return NULL;
@@ -130,10 +237,7 @@ StringOutput::StringOutput(unsigned int baseSize)
 
 void StringOutput::puts(const char* str)
 {
-	int len = (int)strlen(str);
-	int startPos = m_buffer.size();
-	m_buffer.grow(startPos + len);
-	memcpy(&m_buffer[startPos], str, strlen(str));
+	write(str, (int)strlen(str));
 }
 
 void StringOutput::putc(const char ch)
@@ -143,6 +247,16 @@ void StringOutput::putc(const char ch)
 	m_buffer[startPos] = ch;
 }
 
+void StringOutput::write(const char* str, int length)
+{
+	if (length == 0)
+		return;
+
+	int startPos = m_buffer.size();
+	m_buffer.grow(startPos + length);
+	memcpy(&m_buffer[startPos], str, length);
+}
+
 const char* StringOutput::c_str()
 {
 	int size = m_buffer.size();
@@ -157,8 +271,10 @@ const char* StringOutput::c_str()
 /**
  * @param fileName to write output to.
  */
-FileOutput::FileOutput(LPCTSTR fileName)
+FileOutput::FileOutput(LPCTSTR fileName) : m_bFailed(false)
 {
+	m_buffer.reserve(BufferSize);
+
 	if(fileName)
 	{
 		m_bValid = m_file.Open(fileName, CFile::modeWrite | CFile::modeBinary);
@@ -168,10 +284,7 @@ FileOutput::FileOutput(LPCTSTR fileName)
 
 FileOutput::~FileOutput()
 {
-	if(m_bValid)
-	{
-		m_file.Close();
-	}
+	Close();
 }
 
 void FileOutput::SetFileName(LPCTSTR fileName)
@@ -187,20 +300,72 @@ bool FileOutput::IsValid()
 	return m_bValid;
 }
 
-void FileOutput::puts(const char* str)
+bool FileOutput::Close()
 {
-	if(m_bValid)
+	if(!m_bValid)
+	{
+		return false;
+	}
+
+	Flush();
+
+	if(!m_file.Close())
 	{
-		m_file.Write((void*)str, (UINT)strlen(str));
+		m_bFailed = true;
 	}
+
+	m_bValid = false;
+
+	return !m_bFailed;
+}
+
+void FileOutput::puts(const char* str)
+{
+	write(str, (int)strlen(str));
 }
 
 void FileOutput::putc(const char ch)
 {
-	if(m_bValid)
+	write(&ch, 1);
+}
+
+void FileOutput::write(const char* str, int length)
+{
+	if(!m_bValid || m_bFailed)
+	{
+		return;
+	}
+
+	if(m_buffer.size() + length > BufferSize)
 	{
-		m_file.Write((void*)&ch, 1);
+		Flush();
 	}
+
+	// Anything too big to buffer goes straight out:
+	if(length >= BufferSize)
+	{
+		if(m_file.Write((void*)str, (UINT)length) != 1)
+		{
+			m_bFailed = true;
+		}
+	}
+	else
+	{
+		m_buffer.insert(m_buffer.end(), str, str + length);
+	}
+}
+
+void FileOutput::Flush()
+{
+	if(m_bValid && !m_bFailed && m_buffer.size())
+	{
+		if(m_file.Write(&m_buffer[0], (UINT)m_buffer.size()) != 1)
+		{
+			m_bFailed = true;
+		}
+	}
+
+	m_buffer.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -16,6 +16,10 @@
 #include "scintillaif.h"
 
 #include <unordered_map>
+#include <vector>
+
+class StyleDetails;
+class StylesList;
 
 /**
  * Interface class defining an output conduit for exported data.
@@ -26,6 +30,12 @@ class IOutput
 		virtual void puts(const char* str) = 0;
 		virtual void putc(const char ch) = 0;
 		virtual void printf(const char* format, ...) = 0;
+
+		/**
+		 * Write length bytes from str, exporters hand over whole runs
+		 * of text this way rather than a character at a time.
+		 */
+		virtual void write(const char* str, int length) = 0;
 };
 
 /**
@@ -37,7 +47,91 @@ class PrintfConduit : public IOutput
 		virtual void printf(const char* format, ...);
 
 	protected:
-		CStringA str;
+		std::vector<char> m_format;
+};
+
+/**
+ * Interface to the styled text being exported, so that exporters
+ * can be run without an editor window.
+ */
+class IStyledTextSource
+{
+	public:
+		virtual ~IStyledTextSource(){}
+
+		virtual int GetLength() = 0;
+		virtual int GetTabWidth() = 0;
+
+		/**
+		 * Make sure the styles from start to end are up to date, an end
+		 * of -1 means the rest of the document.
+		 */
+		virtual void Colourise(int start, int end) = 0;
+
+		/**
+		 * Fill buffer with character and style byte pairs from start to end
+		 * followed by two nulls, the same layout as SCI_GETSTYLEDTEXT.
+		 */
+		virtual void GetStyledText(int start, int end, char* buffer) = 0;
+};
+
+/**
+ * IStyledTextSource for a Scintilla window.
+ */
+class ScintillaStyledText : public IStyledTextSource
+{
+	public:
+		explicit ScintillaStyledText(CScintilla* pScintilla);
+
+		virtual int GetLength();
+		virtual int GetTabWidth();
+		virtual void Colourise(int start, int end);
+		virtual void GetStyledText(int start, int end, char* buffer);
+
+	private:
+		CScintilla* m_pScintilla;
+};
+
+/**
+ * A run of characters that all share a style.
+ */
+struct StyleRun
+{
+	const char* Text;
+	int Length;
+	int Style;
+};
+
+/**
+ * Reads styled text from an IStyledTextSource a chunk at a time and
+ * splits it into style runs. A run never crosses a chunk boundary, so
+ * two runs in a row can have the same style.
+ */
+class StyleRunReader
+{
+	public:
+		enum { DefaultChunkSize = 65536 };
+
+		StyleRunReader(IStyledTextSource* source, int start, int end, int chunkSize = DefaultChunkSize);
+
+		/**
+		 * Get the next run, the text stays valid until the next call.
+		 * @return false when there is nothing left to read.
+		 */
+		bool Next(StyleRun& run);
+
+	private:
+		bool fill();
+
+		IStyledTextSource*	m_source;
+		int					m_pos;
+		int					m_end;
+		int					m_chunkSize;
+		int					m_index;
+		int					m_count;
+		std::vector<char>	m_styled;
+		std::vector<char>	m_text;
+		std::vector<unsigned char> m_styles;
 };
 
 /**
@@ -47,7 +141,7 @@ class PrintfConduit : public IOutput
 class BaseExporter
 {
 	public:
-		BaseExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla);
+		BaseExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource);
 		virtual ~BaseExporter(){}
 
 		void Export(int start, int finish);
@@ -58,15 +152,10 @@ class BaseExporter
 	protected:
 		virtual void InternalExport(int start, int finish) = 0;
 
-		char CharAt(int position);
-		int StyleAt(int position);
-
 		StyleDetails* GetStyle(int key);
 		int GetMaxStyleKey();
 
-		int SendEditor(long Msg, WPARAM wParam=0, LPARAM lParam=0);
-
-		CScintilla*	m_pScintilla;
+		IStyledTextSource*	m_source;
 		StylesList*	m_pStyles;
 		IOutput*	m_out;
 
@@ -79,7 +168,7 @@ class ExporterFactory
 		typedef enum { RTF, HTML } EExporterType;
 
 		static BaseExporter* GetExporter(EExporterType type, 
-			IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla);
+			IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource);
 
 	private:
 		ExporterFactory(){}
@@ -96,6 +185,7 @@ class StringOutput : public PrintfConduit
 
 		virtual void puts(const char* str);
 		virtual void putc(const char ch);
+		virtual void write(const char* str, int length);
 
 		const char* c_str();
 
@@ -105,23 +195,37 @@ class StringOutput : public PrintfConduit
 
 /**
  * This is a data exporter output class, it writes output into
- * a file opened on construction.
+ * a file opened on construction. Output is buffered and written
+ * in large blocks.
  */
 class FileOutput : public PrintfConduit
 {
 	public:
+		enum { BufferSize = 65536 };
+
 		FileOutput(LPCTSTR fileName);
 		~FileOutput();
 
 		void SetFileName(LPCTSTR fileName);
 		bool IsValid();
 
+		/// Write anything buffered and close the file.
+		/// @return false if any of the output failed to write
+		bool Close();
+
 		virtual void puts(const char* str);
 		virtual void putc(const char ch);
+		virtual void write(const char* str, int length);
+
+		/// Write anything still buffered to the file.
+		void Flush();
 
 	protected:
 		CFile	m_file;
 		bool	m_bValid;
+		/// Set by the first failed write, nothing more is written after it
+		bool	m_bFailed;
+		std::vector<char> m_buffer;
 };
 
 /**
@@ -131,7 +235,7 @@ class FileOutput : public PrintfConduit
 class RTFExporter : public BaseExporter
 {
 	public:
-		RTFExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla);
+		RTFExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource);
 
 		virtual LPCTSTR GetDefaultExtension();
 		virtual LPCTSTR GetFileMask();
@@ -140,12 +244,15 @@ class RTFExporter : public BaseExporter
 		virtual void InternalExport(int start, int end);
 
 	private:
+		void writeText(const char* text, int length, int tabSize, bool& prevCR);
+
 		// Utility Functions
 		int GetRTFHighlight(const char *rgb);
 		static int GetHexChar(char ch);
 		static int GetHexByte(const char *hexbyte);
 		std::string GetRTFStyleChange(StyleDetails* currentStyle, StyleDetails* newStyle);
 		
+		std::unordered_map<int, std::string> m_styleChanges;
 		std::unordered_map<int, int> m_colorMap;
 		std::unordered_map<std::wstring, int> m_fontMap;
 };
@@ -156,13 +263,16 @@ class RTFExporter : public BaseExporter
 class HTMLExporter : public BaseExporter
 {
 public:
-	HTMLExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla);
+	HTMLExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource);
 
 	virtual LPCTSTR GetDefaultExtension();
 	virtual LPCTSTR GetFileMask();
 
 protected:
 	virtual void InternalExport(int start, int end);
+
+private:
+	void writeText(const char* text, int length, int tabSize);
 };
 
 #ifdef TESTCODE
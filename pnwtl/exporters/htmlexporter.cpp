@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "../exporters.h"
+#include "../styles.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // HTMLExporter
@@ -44,8 +45,8 @@
 #define HTML_FONTFACE      "Courier New"
 #define HTML_COLOR         "#000"
 
-HTMLExporter::HTMLExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla)
-	: BaseExporter(pOutput, lpszSchemeName, pStyles, pScintilla)
+HTMLExporter::HTMLExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource)
+	: BaseExporter(pOutput, lpszSchemeName, pStyles, pSource)
 {
 }
 
@@ -60,18 +61,14 @@ LPCTSTR HTMLExporter::GetFileMask()
 
 void HTMLExporter::InternalExport(int start, int end)
 {
-	CString strFontFace(_T("Courier New"));
 	int  fontSize = 10;
-	bool useTabs = false;
 
-	int tabSize = SendEditor(SCI_GETTABWIDTH, 0, 0);
+	int tabSize = m_source->GetTabWidth();
 	if (tabSize == 0)
 		tabSize = 4;
-	if (!strFontFace.GetLength())
-		strFontFace = HTML_FONTFACE;
 
 	// Define a class name lookup table.
-	CStringA cssClassNames[STYLE_MAX + 1];
+	std::string cssClassNames[STYLE_MAX + 1];
 	
 	// Write the HTML header...
 	//@todo: add a way to select the DOCTYPE
@@ -83,8 +80,6 @@ void HTMLExporter::InternalExport(int start, int end)
 	m_out->puts(HTML_TITLECLOSE);
 	m_out->puts(HTML_CSSOPEN);
 
-	CStringA strTemp;
-
 	// Dump the styles into CSS classes
 	//@todo: add support for CSS files
 
@@ -92,24 +87,23 @@ void HTMLExporter::InternalExport(int start, int end)
 	if(pDefStyle)
 	{
 		// Apply Default style to the pre block (class name: pn2code)
-		strTemp.Format("pre.%scode\n", m_pSchemeName);
-		cssClassNames[STYLE_DEFAULT] = strTemp;
-		m_out->puts(cssClassNames[STYLE_DEFAULT]);
+		cssClassNames[STYLE_DEFAULT] = "pre.";
+		cssClassNames[STYLE_DEFAULT] += m_pSchemeName;
+		cssClassNames[STYLE_DEFAULT] += "code\n";
+		m_out->puts(cssClassNames[STYLE_DEFAULT].c_str());
 
 		m_out->puts(HTML_CSSCLASSOPEN HTML_CSSBKGNDCOLOR);
-		strTemp.Format("#%02X%02X%02X",
+		m_out->printf("#%02X%02X%02X",
 			GetRValue(pDefStyle->BackColor),
 			GetGValue(pDefStyle->BackColor),
 			GetBValue(pDefStyle->BackColor));
-		m_out->puts(strTemp);
 		m_out->puts(HTML_CSSPROPERTYEND);
 
 		m_out->puts(HTML_CSSFORECOLOR);
-		strTemp.Format("#%02X%02X%02X;",
+		m_out->printf("#%02X%02X%02X;",
 			GetRValue(pDefStyle->ForeColor),
 			GetGValue(pDefStyle->ForeColor),
 			GetBValue(pDefStyle->ForeColor));
-		m_out->puts(strTemp);
 		m_out->puts(HTML_CSSPROPERTYEND);
 
 		// SF Bug #107412 points to http://www.w3.org/TR/REC-CSS2/fonts.html#font-shorthand
@@ -124,15 +118,11 @@ void HTMLExporter::InternalExport(int start, int end)
 		if(pDefStyle->Bold)
 			m_out->puts("bold ");
 
-		strTemp.Format("%dpt ", pDefStyle->FontSize ? pDefStyle->FontSize : fontSize);
-		m_out->puts(strTemp);
+		m_out->printf("%dpt ", pDefStyle->FontSize ? pDefStyle->FontSize : fontSize);
 
 		m_out->putc('"');
 		if(pDefStyle->FontName.length())
-        {
-            strTemp = pDefStyle->FontName.c_str();
-			m_out->puts(strTemp);
-        }
+			m_out->puts(CT2CA(pDefStyle->FontName.c_str()));
 		else
 			m_out->puts(HTML_FONTFACE);
 		m_out->putc('"');
@@ -153,12 +143,18 @@ void HTMLExporter::InternalExport(int start, int end)
 			// Use the styles classname as CSS class name (if any), or create a
 			// generic one
 			if(pStyle->classname.length())
-				strTemp = pStyle->classname.c_str();
+			{
+				cssClassNames[istyle] = CT2CA(pStyle->classname.c_str());
+			}
 			else
-				strTemp.Format("%s%02d", m_pSchemeName, istyle);
-			cssClassNames[istyle] = strTemp;
+			{
+				char generated[64];
+				_snprintf(generated, sizeof(generated), "%s%02d", m_pSchemeName, istyle);
+				generated[sizeof(generated) - 1] = 0;
+				cssClassNames[istyle] = generated;
+			}
 			m_out->putc('.');
-			m_out->puts(cssClassNames[istyle]);
+			m_out->puts(cssClassNames[istyle].c_str());
 			m_out->puts(HTML_CSSCLASSOPEN);
 
 			// Add properties if they differ from the default style only
@@ -166,22 +162,20 @@ void HTMLExporter::InternalExport(int start, int end)
 			if(!pDefStyle || pStyle->BackColor != pDefStyle->BackColor)
 			{
 				m_out->puts(HTML_CSSBKGNDCOLOR);
-				strTemp.Format("#%02X%02X%02X",
+				m_out->printf("#%02X%02X%02X",
 					GetRValue(pStyle->BackColor),
 					GetGValue(pStyle->BackColor),
 					GetBValue(pStyle->BackColor));
-				m_out->puts(strTemp);
 				m_out->puts(HTML_CSSPROPERTYEND);
 			}
 
 			if(!pDefStyle || pStyle->ForeColor != pDefStyle->ForeColor)
 			{
 				m_out->puts(HTML_CSSFORECOLOR);
-				strTemp.Format("#%02X%02X%02X",
+				m_out->printf("#%02X%02X%02X",
 					GetRValue(pStyle->ForeColor),
 					GetGValue(pStyle->ForeColor),
 					GetBValue(pStyle->ForeColor));
-				m_out->puts(strTemp);
 				m_out->puts(HTML_CSSPROPERTYEND);
 			}
 
@@ -190,8 +184,7 @@ void HTMLExporter::InternalExport(int start, int end)
 				(!pDefStyle || pStyle->FontName != pDefStyle->FontName))
 			{
 				m_out->puts(HTML_CSSFONT);
-                strTemp = pStyle->FontName.c_str();
-				m_out->puts(strTemp);
+				m_out->puts(CT2CA(pStyle->FontName.c_str()));
 				m_out->puts(HTML_CSSENDFONT);
 			}
 
@@ -199,8 +192,7 @@ void HTMLExporter::InternalExport(int start, int end)
 				(!pDefStyle || pDefStyle->FontSize != pStyle->FontSize))
 			{
 				m_out->puts(HTML_CSSFONTSIZE);
-				strTemp.Format("%dpt", pStyle->FontSize);
-				m_out->puts(strTemp);
+				m_out->printf("%dpt", pStyle->FontSize);
 				m_out->puts(HTML_CSSPROPERTYEND);
 			}
 
@@ -228,15 +220,15 @@ void HTMLExporter::InternalExport(int start, int end)
 	m_out->puts(HTML_HEADCLOSE);
 	m_out->puts(HTML_BODYOPEN);
 
-	strTemp.Format(HTML_PREOPEN, m_pSchemeName);
-	m_out->puts((LPCSTR)strTemp);
+	m_out->printf(HTML_PREOPEN, m_pSchemeName);
 
 	int styleCurrent = -1;
 	bool closePrevious = false;
-	for(int i = start; i < end; i++)
+	StyleRunReader reader(m_source, start, end);
+	StyleRun run;
+	while (reader.Next(run))
 	{
-		char ch = CharAt(i);
-		int style = StyleAt(i);
+		int style = run.Style;
 		if(style > STYLE_DEFAULT)
 			style = 0;
 		if(style != styleCurrent && style != STYLE_DEFAULT)
@@ -245,10 +237,11 @@ void HTMLExporter::InternalExport(int start, int end)
 			if(closePrevious == true)
 				m_out->puts("</span>");
 
-			if(cssClassNames[style].GetLength() > 0)
+			if(cssClassNames[style].length() > 0)
 			{
-				strTemp.Format("<span class='%s'>", cssClassNames[style]);
-				m_out->puts(strTemp);
+				m_out->puts("<span class='");
+				m_out->write(cssClassNames[style].c_str(), (int)cssClassNames[style].length());
+				m_out->puts("'>");
 				closePrevious = true;
 /*				// inline styles; not recommend
 				m_out->puts("<span");
@@ -266,29 +259,7 @@ void HTMLExporter::InternalExport(int start, int end)
 			styleCurrent = style;
 		}
 
-		// Deal with special characters:
-		if(ch == '&')
-			m_out->puts("&amp;");
-		else if(ch == '"')
-			m_out->puts("&quot;");
-		else if(ch == '<')
-			m_out->puts("&lt;");
-		else if(ch == '>')
-			m_out->puts("&gt;");
-		else if(ch == '\t')
-		{
-			if(useTabs)
-				m_out->putc(ch);
-			else
-				for(int itab = 0; itab < tabSize; itab++)
-					m_out->putc(' ');
-		}
-		else if(ch == '\r')
-			;
-		else if(ch == '\n')
-			m_out->putc(ch);
-		else
-			m_out->putc(ch);
+		writeText(run.Text, run.Length, tabSize);
 	}
 
 	if(closePrevious == true)
@@ -297,6 +268,49 @@ void HTMLExporter::InternalExport(int start, int end)
 	m_out->puts(HTML_PRECLOSE HTML_BODYCLOSE HTML_END);
 }
 
+/**
+ * Write a run of text, escaping special characters. Everything between
+ * special characters goes out in a single write.
+ */
+void HTMLExporter::writeText(const char* text, int length, int tabSize)
+{
+	const char* plain = text;
+	const char* last = text + length;
+	for(const char* p = text; p != last; ++p)
+	{
+		const char* replacement;
+
+		// Deal with special characters:
+		switch(*p)
+		{
+			case '&':	replacement = "&amp;";	break;
+			case '"':	replacement = "&quot;";	break;
+			case '<':	replacement = "&lt;";	break;
+			case '>':	replacement = "&gt;";	break;
+			case '\t':	replacement = "";		break;
+			case '\r':	replacement = "";		break;
+			default:	continue;
+		}
+
+		if(p != plain)
+			m_out->write(plain, (int)(p - plain));
+		plain = p + 1;
+
+		if(*p == '\t')
+		{
+			for(int itab = 0; itab < tabSize; itab++)
+				m_out->putc(' ');
+		}
+		else
+		{
+			m_out->puts(replacement);
+		}
+	}
+
+	if(last != plain)
+		m_out->write(plain, (int)(last - plain));
+}
+
 #if 0
 void HTMLExporter::GetStyleChange(StyleDetails* pCurrent, StyleDetails* pNext, StyleDetails* pDelta)
 {
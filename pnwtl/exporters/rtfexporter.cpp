@@ -10,17 +10,14 @@
 
 #include "stdafx.h"
 #include "../exporters.h"
+#include "../styles.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // RTFExporter class
 
 #define RTF_HEADEROPEN    "{\\rtf1\\ansi\\deff0\\deftab720"
 #define RTF_FONTDEFOPEN   "{\\fonttbl"
-#ifdef _UNICODE
-#define RTF_FONTDEF       "{\\f%d\\fnil\\fcharset%u %S;}"
-#else
 #define RTF_FONTDEF       "{\\f%d\\fnil\\fcharset%u %s;}"
-#endif
 #define RTF_FONTDEFCLOSE  "}"
 #define RTF_COLORDEFOPEN  "{\\colortbl;"
 #define RTF_COLORDEF      "\\red%d\\green%d\\blue%d;"
@@ -54,8 +51,8 @@
 #define RTF_FONTFACE      "Courier New"
 #define RTF_COLOR         "#000000"
 
-RTFExporter::RTFExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, CScintilla* pScintilla)
-: BaseExporter(pOutput, lpszSchemeName, pStyles, pScintilla)
+RTFExporter::RTFExporter(IOutput* pOutput, LPCSTR lpszSchemeName, StylesList* pStyles, IStyledTextSource* pSource)
+: BaseExporter(pOutput, lpszSchemeName, pStyles, pSource)
 {
 
 }
@@ -179,9 +176,8 @@ void RTFExporter::InternalExport(int start, int end)
 {
 	int wysiwyg           = /*pOptions->GetRtfWYSIWYG()*/	1;
 	unsigned characterset = /*pOptions->GetRtfCharset()*/	0;
-	int tabs              = /*pOptions->GetRtfTabs()*/		1;
 
-	int tabSize = SendEditor(SCI_GETTABWIDTH, 0, 0);
+	int tabSize = m_source->GetTabWidth();
 	if (tabSize == 0)
 		tabSize = 4;
 	
@@ -190,7 +186,7 @@ void RTFExporter::InternalExport(int start, int end)
 
 	StyleDetails* pDefStyle = GetStyle(STYLE_DEFAULT);
 
-	m_out->printf(RTF_FONTDEF, 0, characterset, pDefStyle->FontName.c_str());
+	m_out->printf(RTF_FONTDEF, 0, characterset, (const char*)CT2CA(pDefStyle->FontName.c_str()));
 	
 	int fontIndex(1);
 
@@ -201,7 +197,7 @@ void RTFExporter::InternalExport(int start, int end)
 		{
 			if (m_fontMap.find(pStyle->FontName) == m_fontMap.end())
 			{
-				m_out->printf(RTF_FONTDEF, fontIndex, characterset, pStyle->FontName.c_str());
+				m_out->printf(RTF_FONTDEF, fontIndex, characterset, (const char*)CT2CA(pStyle->FontName.c_str()));
 				m_fontMap[pStyle->FontName] = fontIndex++;
 			}
 		}
@@ -246,38 +242,73 @@ void RTFExporter::InternalExport(int start, int end)
 
 	bool prevCR = false;
 	int styleCurrent = -1;
-	char ch;
-	int style;
-	std::string deltaStyle;
-	for (int i = start; i < end; i++)
+	StyleRunReader reader(m_source, start, end);
+	StyleRun run;
+	while (reader.Next(run))
 	{
-		ch = CharAt(i);
-		style = StyleAt(i);
+		int style = run.Style;
 		if (style > STYLE_DEFAULT)
 			style = 0;
 		if (style != styleCurrent)
 		{
-			StyleDetails* current = styleCurrent == -1 ? pDefStyle : GetStyle(styleCurrent);
-			if (current == NULL)
-			{
-				current = pDefStyle;
-			}
-
-			StyleDetails* newStyle = GetStyle(style);
-			if (newStyle == NULL)
+			// Style changes are worked out once for each pair of styles:
+			int key = ((styleCurrent + 1) << 8) | style;
+			auto change = m_styleChanges.find(key);
+			if (change == m_styleChanges.end())
 			{
-				newStyle = pDefStyle;
+				StyleDetails* current = styleCurrent == -1 ? pDefStyle : GetStyle(styleCurrent);
+				if (current == NULL)
+				{
+					current = pDefStyle;
+				}
+
+				StyleDetails* newStyle = GetStyle(style);
+				if (newStyle == NULL)
+				{
+					newStyle = pDefStyle;
+				}
+
+				change = m_styleChanges.insert(std::make_pair(key, GetRTFStyleChange(current, newStyle))).first;
 			}
 
-			std::string deltaStyle = GetRTFStyleChange(current, newStyle);
-			if (deltaStyle.size())
+			if (change->second.size())
 			{
-				m_out->puts(deltaStyle.c_str());
+				m_out->write(change->second.c_str(), (int)change->second.size());
 			}
 
 			styleCurrent = style;
 		}
 		
+		writeText(run.Text, run.Length, tabSize, prevCR);
+	}
+	m_out->puts(RTF_BODYCLOSE);
+}
+
+/**
+ * Write a run of text, escaping special characters. Everything between
+ * special characters goes out in a single write.
+ */
+void RTFExporter::writeText(const char* text, int length, int tabSize, bool& prevCR)
+{
+	int tabs              = /*pOptions->GetRtfTabs()*/		1;
+
+	const char* plain = text;
+	const char* last = text + length;
+	for (const char* p = text; p != last; ++p)
+	{
+		char ch = *p;
+		if (ch != '{' && ch != '}' && ch != '\\' && ch != '\t' && ch != '\n' && ch != '\r')
+		{
+			continue;
+		}
+
+		if (p != plain)
+		{
+			m_out->write(plain, (int)(p - plain));
+			prevCR = false;
+		}
+		plain = p + 1;
+
 		// Deal with special characters:
 		if (ch == '{')
 			m_out->puts("\\{");
@@ -300,12 +331,15 @@ void RTFExporter::InternalExport(int start, int end)
 		}
 		else if (ch == '\r')
 			m_out->puts(RTF_EOLN);
-		else
-			m_out->putc(ch);
 
 		prevCR = ch == '\r';
 	}
-	m_out->puts(RTF_BODYCLOSE);
+
+	if (last != plain)
+	{
+		m_out->write(plain, (int)(last - plain));
+		prevCR = false;
+	}
 }
 
 LPCTSTR RTFExporter::GetDefaultExtension()
@@ -521,9 +521,7 @@ uint64_t CFileName::GetFileAge()
 
 const tstring& CFileName::ToLower()
 {
-	std::transform (m_FileName.begin(), m_FileName.end(),    // source
-               m_FileName.begin(),             // destination
-               tolower);
+	MakeLower(m_FileName);
 
 	return m_FileName;
 }
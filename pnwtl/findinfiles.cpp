@@ -103,6 +103,9 @@ FIFThread::~FIFThread()
 
 void FIFThread::Run()
 {
+	Tracer::SetThreadName("Find in Files");
+	PNTRACE_SPAN("find", "FIFThread::Run");
+
 	// TODO: Change to true if using RegEx...
 	if(m_pSink)
 	{
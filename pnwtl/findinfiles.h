@@ -12,6 +12,9 @@
 #define findinfiles_h__included_8313F7A1_10AC_44dc_A29B_97395C2F76E9
 
 #include "include/ssthreads.h"
+#include "include/threading.h"
+
+#include <deque>
 
 class FIFSink
 {
@@ -98,47 +98,85 @@ protected:
 };
 
 //////////////////////////////////////////////////////////////////////////////
-// MagicFolderAdder
+// MagicFolderLister
 //////////////////////////////////////////////////////////////////////////////
 
-class MagicFolderAdder : public FolderAdder
+/**
+ * Lists a single directory level for a magic folder, reporting matching files
+ * and sub-folders without descending into them. This doesn't touch any
+ * project objects so it can be used from a worker thread.
+ */
+class MagicFolderLister : public RegExFileFinderImpl<MagicFolderLister, MagicFolderLister>
 {
+	typedef RegExFileFinderImpl<MagicFolderLister, MagicFolderLister> baseClass;
+	typedef FileFinderImpl<MagicFolderLister, MagicFolderLister, FileFinderData> finderClass;
+	friend baseClass;
+	friend finderClass;
+
 public:
-	void BuildFolder(MagicFolder* folder, LPCTSTR path, LPCTSTR filter, LPCTSTR basePath, LPCTSTR excludedFileFilter, LPCTSTR folderFilter, bool recurse)
+	typedef std::function<void (LPCTSTR name, bool isFolder)> FoundFunc;
+	typedef std::function<bool ()> ContinueFunc;
+
+	/**
+	 * @param found Called for each matching file or folder name
+	 * @param canContinue Polled between items, return false to cancel. May be empty.
+	 */
+	MagicFolderLister(const FoundFunc& found, const ContinueFunc& canContinue) : 
+		baseClass(this, &MagicFolderLister::onFind),
+		m_found(found),
+		m_continue(canContinue)
 	{
-		lpszBasePath = basePath;
-
-		pFolder = folder;
-		pCursor = pFolder;
+	}
 
+	bool List(LPCTSTR path, LPCTSTR filter, LPCTSTR excludedFileFilter, LPCTSTR folderFilter)
+	{
 		// make sure the path has a trailing slash, CPathName will do that.
 		CPathName pn(path);
 
-		sFilter = filter;
-		sExcludedFileFilter = excludedFileFilter;
-		sFolderFilter = folderFilter;
+		SetFolderFilters(filter, excludedFileFilter, folderFilter);
+
+		// Recurse so that folders are passed to shouldRecurse, which reports
+		// them and declines to go any deeper.
+		return FindMatching(pn.c_str(), true);
+	}
 
+	bool SetFolderFilters(LPCTSTR filter, LPCTSTR excludedFileFilter, LPCTSTR folderFilter)
+	{
 		ClearFilters();
-		SetFilters(filter, excludedFileFilter, NULL, folderFilter);
-		FindMatching(pn.c_str(), recurse);
+		return SetFilters(filter, excludedFileFilter, NULL, folderFilter);
+	}
+
+	/**
+	 * Would List report this item? Uses the filters from SetFolderFilters.
+	 */
+	bool Matches(LPCTSTR path, LPCTSTR name, bool isFolder)
+	{
+		return isFolder ? baseClass::shouldRecurse(path, name) : baseClass::shouldMatch(name);
 	}
 
 protected:
-	virtual Folder* newFolder(LPCTSTR path)
+	void onFind(LPCTSTR /*path*/, FileFinderData& file, bool& /*shouldContinue*/)
 	{
-		CPathName fn(path);
-		tstring dirName = fn.GetDirectoryName();
-		MagicFolder* mf = new MagicFolder(dirName.c_str(), path/*, lpszBasePath*/);
-		mf->SetFilter( sFilter.c_str() );
-		mf->SetExcludedFileFilter( sExcludedFileFilter.c_str() );
-		mf->SetFolderFilter( sFolderFilter.c_str() );
-		mf->SetGotContents(true);
-		return mf;
+		m_found(file.GetFilename(), false);
+	}
+
+	bool shouldRecurse(LPCTSTR path, LPCTSTR subfolder)
+	{
+		if (baseClass::shouldRecurse(path, subfolder))
+		{
+			m_found(subfolder, true);
+		}
+
+		return false;
+	}
+
+	bool shouldContinue()
+	{
+		return !m_continue || m_continue();
 	}
 
-	tstring sFilter;
-	tstring sExcludedFileFilter;
-	tstring sFolderFilter;
+	FoundFunc m_found;
+	ContinueFunc m_continue;
 };
 
 } // namespace Projects
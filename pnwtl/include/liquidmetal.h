@@ -125,8 +125,8 @@ private:
 	
     void fillArray(std::vector<double>& buffer, double value, int from = -1, int to = -1) const
     {
-        from = from == -1 ? 0 : max(from, 0);
-        to = to == -1 ? buffer.size() : min(to, buffer.size());
+        from = from == -1 ? 0 : (std::max)(from, 0);
+        to = to == -1 ? static_cast<int>(buffer.size()) : (std::min)(to, static_cast<int>(buffer.size()));
         for (int i = from; i < to; i++)
 	    { 
 		    buffer[i] = value; 
@@ -19,7 +19,7 @@
 class GenxXMLWriter
 {
 public:
-	GenxXMLWriter() : m_hFile(NULL), m_bInited(false)
+	GenxXMLWriter() : m_hFile(NULL), m_buffer(NULL), m_bInited(false)
 	{
 		m_writer = genxNew(NULL, NULL, NULL);
 	}
@@ -55,11 +55,30 @@ public:
 	}
 
 	/**
-	 * @return true if this writer currently has a file open for writing.
+	 * Prepare to write xml into a buffer in memory, the buffer must live
+	 * until Close is called.
+	 */
+	void StartBuffer(std::string& buffer)
+	{
+		if(!m_bInited)
+		{
+			initXmlBits();
+			m_bInited = true;
+		}
+
+		static genxSender sender = { &sendString, &sendBoundedString, &flushString };
+
+		m_buffer = &buffer;
+		genxSetUserData(m_writer, m_buffer);
+		genxStartDocSender(m_writer, &sender);
+	}
+
+	/**
+	 * @return true if this writer currently has a file or buffer open for writing.
 	 */
 	bool IsValid()
 	{
-		return (m_hFile != NULL) && (m_writer != NULL);
+		return (m_hFile != NULL || m_buffer != NULL) && (m_writer != NULL);
 	}
 
 	/**
@@ -77,8 +96,13 @@ public:
 			// error...
 		}
 
-		fclose(m_hFile);
-		m_hFile = NULL;
+		if (m_hFile != NULL)
+		{
+			fclose(m_hFile);
+			m_hFile = NULL;
+		}
+
+		m_buffer = NULL;
 	}
 
 	operator genxWriter ()
@@ -120,9 +144,29 @@ protected:
 		genxEndElement(m_writer);
 	}
 
+private:
+	static genxStatus sendString(void* userData, constUtf8 s)
+	{
+		static_cast<std::string*>(userData)->append(reinterpret_cast<const char*>(s));
+		return GENX_SUCCESS;
+	}
+
+	static genxStatus sendBoundedString(void* userData, constUtf8 start, constUtf8 end)
+	{
+		static_cast<std::string*>(userData)->append(reinterpret_cast<const char*>(start), end - start);
+		return GENX_SUCCESS;
+	}
+
+	static genxStatus flushString(void* /*userData*/)
+	{
+		return GENX_SUCCESS;
+	}
+
 protected:
 	genxWriter	m_writer;
 	FILE*		m_hFile;
+	/// Buffer being written to by StartBuffer, or NULL
+	std::string* m_buffer;
 	bool		m_bInited;
 };
 
@@ -0,0 +1,133 @@
+/**
+ * @file ringbuffer.h
+ * @brief Lock-free single producer, single consumer ring buffer.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef ringbuffer_h__included
+#define ringbuffer_h__included
+
+#include <vector>
+
+namespace pnutils {
+
+/**
+ * Fixed size ring buffer that one thread writes to while another reads
+ * from it, without either of them taking a lock. Only the writer moves
+ * m_head and only the reader moves m_tail, each publishes its index after
+ * the data it covers has been copied. Several writers must serialise with
+ * each other, the reader never waits for them.
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+	/**
+	 * @param capacity Number of elements, rounded up to a power of two.
+	 */
+	explicit RingBuffer(size_t capacity) : m_head(0), m_tail(0)
+	{
+		size_t size(1);
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+
+		m_buffer.resize(size);
+		m_mask = size - 1;
+	}
+
+	size_t Capacity() const
+	{
+		return m_buffer.size();
+	}
+
+	/**
+	 * Number of elements waiting to be read, exact only on the reader thread.
+	 */
+	size_t Size() const
+	{
+		return m_head - m_tail;
+	}
+
+	/**
+	 * Writer thread: append all of data, or nothing if there isn't room for it.
+	 * @return false if the buffer is too full
+	 */
+	bool Write(const T* data, size_t count)
+	{
+		size_t head(m_head);
+		if (count > m_buffer.size() - (head - m_tail))
+		{
+			return false;
+		}
+
+		size_t start(head & m_mask);
+		size_t first(min(count, m_buffer.size() - start));
+		std::copy(data, data + first, &m_buffer[start]);
+		std::copy(data + first, data + count, &m_buffer[0]);
+
+		// The data has to be visible before the new head is:
+		::MemoryBarrier();
+		m_head = head + count;
+
+		return true;
+	}
+
+	/**
+	 * Reader thread: append everything that's waiting to out.
+	 * @return number of elements read
+	 */
+	template <typename TContainer>
+	size_t ReadAll(TContainer& out)
+	{
+		size_t tail(m_tail);
+		size_t head(m_head);
+
+		// Don't read the data before we've seen the head that covers it:
+		::MemoryBarrier();
+
+		size_t count(head - tail);
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		size_t start(tail & m_mask);
+		size_t first(min(count, m_buffer.size() - start));
+		out.append(&m_buffer[start], first);
+		if (first < count)
+		{
+			out.append(&m_buffer[0], count - first);
+		}
+
+		// Finish copying before the writer may reuse the space:
+		::MemoryBarrier();
+		m_tail = head;
+
+		return count;
+	}
+
+	/**
+	 * Reader thread: throw away everything that's waiting.
+	 */
+	void Discard()
+	{
+		m_tail = m_head;
+	}
+
+private:
+	std::vector<T> m_buffer;
+	size_t m_mask;
+	// Free running indices, only ever masked to index into m_buffer:
+	volatile size_t m_head;
+	volatile size_t m_tail;
+};
+
+} // namespace pnutils
+
+#endif // #ifndef ringbuffer_h__included
@@ -0,0 +1,44 @@
+/**
+ * @file xpressiveutil.h
+ * @brief Helpers for boost::xpressive regular expressions.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef xpressiveutil_h__included
+#define xpressiveutil_h__included
+
+#include <boost/xpressive/xpressive.hpp>
+
+namespace boost { namespace xpressive {
+#ifdef _UNICODE
+	typedef wsregex tsregex;
+	typedef wsmatch tsmatch;
+#else
+	typedef sregex tsregex;
+	typedef smatch tsmatch;
+#endif
+}} // namespace boost::xpressive
+
+/**
+ * Get a named sub-match, returns false if the expression has no group
+ * with that name.
+ */
+template <typename match_type>
+bool safe_get_submatch(match_type& match, typename match_type::string_type& expr, typename match_type::char_type const *name)
+{
+	try
+	{
+		expr = match[name].str();
+		return true;
+	}
+	catch (boost::xpressive::regex_error&)
+	{
+		return false;
+	}
+}
+
+#endif // #ifndef xpressiveutil_h__included
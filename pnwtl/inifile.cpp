@@ -0,0 +1,471 @@
+/**
+ * @file inifile.cpp
+ * @brief Read and write ini files in memory.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "inifile.h"
+
+#include <stdio.h>
+
+namespace {
+
+/**
+ * Profile function names are case insensitive, we only fold ASCII.
+ */
+tstring normalise(LPCTSTR name)
+{
+	tstring result(name);
+	for (tstring::iterator i = result.begin(); i != result.end(); ++i)
+	{
+		if (*i >= _T('A') && *i <= _T('Z'))
+		{
+			*i = *i - _T('A') + _T('a');
+		}
+	}
+
+	return result;
+}
+
+bool isBlank(TCHAR c)
+{
+	return c == _T(' ') || c == _T('\t');
+}
+
+tstring trim(const TCHAR* begin, const TCHAR* end)
+{
+	while (begin < end && isBlank(*begin))
+	{
+		++begin;
+	}
+
+	while (end > begin && isBlank(*(end - 1)))
+	{
+		--end;
+	}
+
+	return tstring(begin, end);
+}
+
+bool endsWithNewline(const tstring& text)
+{
+	return text.size() && (text[text.size() - 1] == _T('\n') || text[text.size() - 1] == _T('\r'));
+}
+
+FILE* openFile(LPCTSTR filename, LPCTSTR mode)
+{
+#if defined(_WIN32)
+	return _tfopen(filename, mode);
+#else
+	return fopen(filename, mode);
+#endif
+}
+
+bool readFile(LPCTSTR filename, std::vector<unsigned char>& data)
+{
+	FILE* file = openFile(filename, _T("rb"));
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	unsigned char buffer[16384];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + read);
+	}
+
+	bool ok = ferror(file) == 0;
+	fclose(file);
+
+	return ok;
+}
+
+/**
+ * The profile functions write UTF-16 files if there's a byte order mark,
+ * and ANSI otherwise.
+ */
+void decode(const std::vector<unsigned char>& data, tstring& text)
+{
+	text.clear();
+	if (data.empty())
+	{
+		return;
+	}
+
+	const char* bytes = reinterpret_cast<const char*>(&data[0]);
+	size_t length = data.size();
+
+#if defined(_UNICODE)
+	if (length >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+	{
+		text.assign(reinterpret_cast<const wchar_t*>(bytes + 2), (length - 2) / sizeof(wchar_t));
+		return;
+	}
+
+	UINT codePage = CP_ACP;
+	if (length >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+	{
+		codePage = CP_UTF8;
+		bytes += 3;
+		length -= 3;
+	}
+
+	int chars = ::MultiByteToWideChar(codePage, 0, bytes, static_cast<int>(length), NULL, 0);
+	if (chars > 0)
+	{
+		text.resize(chars);
+		::MultiByteToWideChar(codePage, 0, bytes, static_cast<int>(length), &text[0], chars);
+	}
+#else
+	if (length >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+	{
+		bytes += 3;
+		length -= 3;
+	}
+
+	text.assign(bytes, length);
+#endif
+}
+
+/**
+ * Write to a temporary file and move it over the old one, so that nobody
+ * sees half a file.
+ */
+bool replaceFile(LPCTSTR filename, const tstring& text)
+{
+	tstring temp(filename);
+	temp += _T(".tmp");
+
+	FILE* file = openFile(temp.c_str(), _T("wb"));
+	if (file == NULL)
+	{
+		return false;
+	}
+
+#if defined(_UNICODE)
+	// Keep the file UTF-16 so that the profile functions can read everything we write:
+	const unsigned char bom[2] = { 0xFF, 0xFE };
+	bool ok = fwrite(bom, 1, sizeof(bom), file) == sizeof(bom);
+#else
+	bool ok = true;
+#endif
+
+	if (ok && text.size())
+	{
+		ok = fwrite(text.c_str(), sizeof(TCHAR), text.size(), file) == text.size();
+	}
+
+	ok = fclose(file) == 0 && ok;
+
+#if defined(_WIN32)
+	ok = ok && ::MoveFileEx(temp.c_str(), filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+	if (!ok)
+	{
+		::DeleteFile(temp.c_str());
+	}
+#else
+	ok = ok && rename(temp.c_str(), filename) == 0;
+	if (!ok)
+	{
+		remove(temp.c_str());
+	}
+#endif
+
+	return ok;
+}
+
+} // namespace
+
+IniFile::IniFile() : m_dirty(false)
+{
+}
+
+IniFile::~IniFile()
+{
+	Clear();
+}
+
+bool IniFile::Load(LPCTSTR filename)
+{
+	std::vector<unsigned char> data;
+	if (!readFile(filename, data))
+	{
+		Clear();
+		return false;
+	}
+
+	tstring text;
+	decode(data, text);
+	Parse(text.c_str(), text.size());
+
+	return true;
+}
+
+void IniFile::Parse(const TCHAR* text, size_t length)
+{
+	Clear();
+
+	const TCHAR* end = text + length;
+	const TCHAR* p = text;
+	IniSection* section(NULL);
+
+	while (p < end)
+	{
+		const TCHAR* lineEnd = p;
+		while (lineEnd < end && *lineEnd != _T('\r') && *lineEnd != _T('\n'))
+		{
+			++lineEnd;
+		}
+
+		const TCHAR* next = lineEnd;
+		if (next < end && *next == _T('\r'))
+		{
+			++next;
+		}
+
+		if (next < end && *next == _T('\n'))
+		{
+			++next;
+		}
+
+		const TCHAR* first = p;
+		while (first < lineEnd && isBlank(*first))
+		{
+			++first;
+		}
+
+		const TCHAR* close = first;
+		if (first < lineEnd && *first == _T('['))
+		{
+			while (close < lineEnd && *close != _T(']'))
+			{
+				++close;
+			}
+		}
+
+		if (first < lineEnd && *first == _T('[') && close < lineEnd)
+		{
+			tstring name(trim(first + 1, close));
+			section = find(name.c_str());
+			if (section == NULL)
+			{
+				section = new IniSection;
+				section->Name = name;
+				m_sections.push_back(section);
+				m_index.insert(SECTION_MAP::value_type(normalise(name.c_str()), section));
+			}
+		}
+		else if (section != NULL)
+		{
+			const TCHAR* equals = first;
+			while (equals < lineEnd && *equals != _T('='))
+			{
+				++equals;
+			}
+
+			if (equals < lineEnd && *first != _T(';'))
+			{
+				tstring key(trim(first, equals));
+				tstring value(trim(equals + 1, lineEnd));
+
+				if (value.size() >= 2 && (value[0] == _T('"') || value[0] == _T('\'')) && value[value.size() - 1] == value[0])
+				{
+					value = value.substr(1, value.size() - 2);
+				}
+
+				// Like the profile functions, the first of a repeated key wins:
+				if (section->Values.insert(IniKeyMap::value_type(normalise(key.c_str()), value)).second)
+				{
+					section->Keys.push_back(key);
+				}
+			}
+		}
+
+		if (section != NULL)
+		{
+			section->Text.append(p, next);
+		}
+		else
+		{
+			m_preamble.append(p, next);
+		}
+
+		p = next;
+	}
+}
+
+bool IniFile::Save(LPCTSTR filename)
+{
+	// Start from what's on disk now, somebody else may have changed other sections:
+	IniFile current;
+	current.Load(filename);
+
+	for (SECTIONS::const_iterator i = m_sections.begin(); i != m_sections.end(); ++i)
+	{
+		if ((*i)->Dirty)
+		{
+			IniSection* section = current.findOrAdd((*i)->Name.c_str());
+			section->Keys = (*i)->Keys;
+			section->Values = (*i)->Values;
+			section->Dirty = true;
+		}
+	}
+
+	tstring text;
+	current.Write(text);
+
+	if (!replaceFile(filename, text))
+	{
+		return false;
+	}
+
+	current.Parse(text.c_str(), text.size());
+	swap(current);
+
+	return true;
+}
+
+void IniFile::Write(tstring& text) const
+{
+	text = m_preamble;
+
+	for (SECTIONS::const_iterator i = m_sections.begin(); i != m_sections.end(); ++i)
+	{
+		if (text.size() && !endsWithNewline(text))
+		{
+			text += _T("\r\n");
+		}
+
+		if ((*i)->Dirty || (*i)->Text.empty())
+		{
+			writeSection(*(*i), text);
+		}
+		else
+		{
+			text += (*i)->Text;
+		}
+	}
+}
+
+const tstring* IniFile::Get(LPCTSTR section, LPCTSTR key) const
+{
+	IniSection* s = find(section);
+	if (s == NULL)
+	{
+		return NULL;
+	}
+
+	IniKeyMap::const_iterator i = s->Values.find(normalise(key));
+	if (i == s->Values.end())
+	{
+		return NULL;
+	}
+
+	return &(*i).second;
+}
+
+void IniFile::Set(LPCTSTR section, LPCTSTR key, LPCTSTR value)
+{
+	IniSection* s = findOrAdd(section);
+
+	std::pair<IniKeyMap::iterator, bool> result = s->Values.insert(IniKeyMap::value_type(normalise(key), value));
+	if (result.second)
+	{
+		s->Keys.push_back(key);
+	}
+	else if ((*result.first).second == value)
+	{
+		return;
+	}
+	else
+	{
+		(*result.first).second = value;
+	}
+
+	s->Dirty = true;
+	m_dirty = true;
+}
+
+void IniFile::ClearSection(LPCTSTR section)
+{
+	IniSection* s = find(section);
+	if (s == NULL || s->Keys.empty())
+	{
+		return;
+	}
+
+	s->Keys.clear();
+	s->Values.clear();
+	s->Dirty = true;
+	m_dirty = true;
+}
+
+bool IniFile::IsDirty() const
+{
+	return m_dirty;
+}
+
+void IniFile::Clear()
+{
+	for (SECTIONS::iterator i = m_sections.begin(); i != m_sections.end(); ++i)
+	{
+		delete *i;
+	}
+
+	m_sections.clear();
+	m_index.clear();
+	m_preamble.clear();
+	m_dirty = false;
+}
+
+IniSection* IniFile::find(LPCTSTR section) const
+{
+	SECTION_MAP::const_iterator i = m_index.find(normalise(section));
+	return i != m_index.end() ? (*i).second : NULL;
+}
+
+IniSection* IniFile::findOrAdd(LPCTSTR section)
+{
+	IniSection* s = find(section);
+	if (s == NULL)
+	{
+		s = new IniSection;
+		s->Name = section;
+		m_sections.push_back(s);
+		m_index.insert(SECTION_MAP::value_type(normalise(section), s));
+	}
+
+	return s;
+}
+
+void IniFile::writeSection(const IniSection& section, tstring& text) const
+{
+	text += _T("[");
+	text += section.Name;
+	text += _T("]\r\n");
+
+	for (std::vector<tstring>::const_iterator i = section.Keys.begin(); i != section.Keys.end(); ++i)
+	{
+		IniKeyMap::const_iterator value = section.Values.find(normalise((*i).c_str()));
+
+		text += *i;
+		text += _T("=");
+		text += (*value).second;
+		text += _T("\r\n");
+	}
+}
+
+void IniFile::swap(IniFile& other)
+{
+	m_preamble.swap(other.m_preamble);
+	m_sections.swap(other.m_sections);
+	m_index.swap(other.m_index);
+	std::swap(m_dirty, other.m_dirty);
+}
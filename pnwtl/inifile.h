@@ -0,0 +1,117 @@
+/**
+ * @file inifile.h
+ * @brief Read and write ini files in memory.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef inifile_h__included
+#define inifile_h__included
+
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Values in one section, by key. Keys are stored lower case, like the
+ * profile functions ini files are case insensitive.
+ */
+class IniKeyMap : public std::unordered_map<tstring, tstring> {};
+
+/**
+ * One section of an ini file.
+ */
+class IniSection
+{
+	public:
+		IniSection() : Dirty(false) {}
+
+		/// Name as it appears in the file
+		tstring Name;
+		/// Keys as they appear in the file, in file order
+		std::vector<tstring> Keys;
+		IniKeyMap Values;
+		/// The section as it was read, written back unchanged unless Dirty
+		tstring Text;
+		bool Dirty;
+};
+
+/**
+ * An ini file parsed into memory. Lookups don't touch the disk, and changes
+ * are written back in one go by Save. This follows the profile functions
+ * closely enough to share files with them: names are case insensitive,
+ * whitespace around keys and values is ignored and quotes around a value
+ * are removed.
+ */
+class IniFile
+{
+	public:
+		IniFile();
+		~IniFile();
+
+		/**
+		 * Replace the contents with the file, which may be UTF-16 with a
+		 * byte order mark, UTF-8 with one, or in the ANSI code page.
+		 * @return false if the file couldn't be read, the contents are empty
+		 */
+		bool Load(LPCTSTR filename);
+
+		/**
+		 * Replace the contents with ini text.
+		 */
+		void Parse(const TCHAR* text, size_t length);
+
+		/**
+		 * Write changed sections to filename, keeping the rest of the file as
+		 * it is on disk now. The file is replaced in one step, so readers see
+		 * either the old or the new file. Afterwards the contents match the
+		 * file that was written.
+		 */
+		bool Save(LPCTSTR filename);
+
+		/**
+		 * Format the contents as ini text.
+		 */
+		void Write(tstring& text) const;
+
+		/**
+		 * @return the value, or NULL if there isn't one
+		 */
+		const tstring* Get(LPCTSTR section, LPCTSTR key) const;
+
+		void Set(LPCTSTR section, LPCTSTR key, LPCTSTR value);
+
+		/**
+		 * Remove all the keys in a section.
+		 */
+		void ClearSection(LPCTSTR section);
+
+		/**
+		 * @return true if anything has been changed since the last Load, Parse or Save
+		 */
+		bool IsDirty() const;
+
+		void Clear();
+
+	private:
+		typedef std::vector<IniSection*> SECTIONS;
+		typedef std::unordered_map<tstring, IniSection*> SECTION_MAP;
+
+		IniFile(const IniFile&);
+		IniFile& operator=(const IniFile&);
+
+		IniSection* find(LPCTSTR section) const;
+		IniSection* findOrAdd(LPCTSTR section);
+		void writeSection(const IniSection& section, tstring& text) const;
+		void swap(IniFile& other);
+
+		/// Whatever comes before the first section
+		tstring m_preamble;
+		SECTIONS m_sections;
+		SECTION_MAP m_index;
+		bool m_dirty;
+};
+
+#endif // #ifndef inifile_h__included
@@ -0,0 +1,195 @@
+/**
+ * @file keymap.cpp
+ * @brief Keyboard command maps
+ * @author Simon Steele
+ * @note Copyright (c) 2006-2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "keymap.h"
+
+namespace {
+
+/**
+ * Key and modifiers packed the same way as the extension command map keys.
+ */
+inline unsigned short keyCode(unsigned char key, unsigned char modifiers)
+{
+	return static_cast<unsigned short>(key | (modifiers << 8));
+}
+
+/**
+ * Bindings are stored as bytes, anything else can't be in the map.
+ */
+inline bool validKey(int key, int modifiers)
+{
+	return (key & ~0xff) == 0 && (modifiers & ~0xff) == 0;
+}
+
+} // namespace
+
+namespace Commands
+{
+
+KeyBindings::KeyBindings() : kmap(0), len(0), alloc(0)
+{
+}
+
+KeyBindings::KeyBindings(const KeyBindings& copy) : kmap(0), len(0), alloc(0)
+{
+	len = copy.len;
+	if(len)
+	{
+		KeyToCommand* kNew = new KeyToCommand[copy.len+5];
+		if(!kNew)
+			return;
+		for (int k = 0; k < len; k++)
+			kNew[k] = copy.kmap[k];
+
+		alloc = copy.len+5;
+		kmap = kNew;
+		kindex = copy.kindex;
+	}
+
+	extkmap = copy.extkmap;
+	for(ExtensionCommands::iterator i = extkmap.begin(); i != extkmap.end(); ++i)
+	{
+		extindex[(*i).first] = &(*i).second;
+	}
+}
+
+KeyBindings::~KeyBindings()
+{
+	Clear();
+}
+
+void KeyBindings::Clear()
+{
+	delete []kmap;
+	kmap = 0;
+	len = 0;
+	alloc = 0;
+	kindex.clear();
+}
+
+void KeyBindings::AssignCmdKey(int key, int modifiers, unsigned int msg)
+{
+	// Check there's no extended command with this setup...
+	RemoveExtended(key, modifiers);
+	// ...and assign
+	internalAssign(key, modifiers, msg);
+}
+
+void KeyBindings::RemoveCmdKey(int key, int modifiers, unsigned int msg)
+{
+	if(!validKey(key, modifiers))
+		return;
+
+	KeyIndex::iterator found = kindex.find( keyCode(key, modifiers) );
+	if(found == kindex.end() || kmap[(*found).second].msg != msg)
+		return;
+
+	int ixRemove = (*found).second;
+	kindex.erase(found);
+
+	// Close the gap and move the index entries of everything after it along
+	for(int ixArr(ixRemove); ixArr < len-1; ++ixArr)
+	{
+		kmap[ixArr] = kmap[ixArr+1];
+		kindex[keyCode(kmap[ixArr].key, kmap[ixArr].modifiers)] = ixArr;
+	}
+
+	len--;
+}
+
+void KeyBindings::AddExtended(const ExtensionCommand& command)
+{
+	// Make sure there's no classic command on this id already.
+	unsigned int cmd = Find(command.key, command.modifiers);
+	if(cmd != 0)
+		RemoveCmdKey(command.key, command.modifiers, cmd);
+
+	// Insert it
+	std::pair<ExtensionCommands::iterator, bool> inserted =
+		extkmap.insert( ExtensionCommands::value_type( keyCode(command.key, command.modifiers), command ) );
+	if(inserted.second)
+		extindex[(*inserted.first).first] = &(*inserted.first).second;
+}
+
+void KeyBindings::RemoveExtended(unsigned char key, unsigned char modifiers)
+{
+	unsigned short code = keyCode(key, modifiers);
+	if(extindex.erase(code))
+		extkmap.erase(code);
+}
+
+unsigned int KeyBindings::Find(int key, int modifiers)
+{
+	if(!validKey(key, modifiers))
+		return 0;
+
+	KeyIndex::const_iterator i = kindex.find( keyCode(key, modifiers) );
+	if(i != kindex.end())
+		return kmap[(*i).second].msg;
+	return 0;
+}
+
+const ExtensionCommand* KeyBindings::FindExtended(unsigned char key, unsigned char modifiers)
+{
+	ExtensionIndex::const_iterator i = extindex.find( keyCode(key, modifiers) );
+	if( i != extindex.end() )
+		return (*i).second;
+	return NULL;
+}
+
+size_t KeyBindings::GetCount() const
+{
+	return len;
+}
+
+size_t KeyBindings::GetExtendedCount() const
+{
+	return extkmap.size();
+}
+
+const KeyToCommand* KeyBindings::GetMappings() const
+{
+	return kmap;
+}
+
+const ExtensionCommands& KeyBindings::GetExtendedMappings() const
+{
+	return extkmap;
+}
+
+void KeyBindings::internalAssign(int key, int modifiers, unsigned int msg)
+{
+	unsigned short code = keyCode(static_cast<unsigned char>(key), static_cast<unsigned char>(modifiers));
+	KeyIndex::const_iterator existing = kindex.find(code);
+	if (existing != kindex.end())
+	{
+		kmap[(*existing).second].msg = msg;
+		return;
+	}
+
+	if ((len+1) >= alloc) {
+		KeyToCommand *ktcNew = new KeyToCommand[alloc + 5];
+		if (!ktcNew)
+			return;
+		for (int k = 0; k < len; k++)
+			ktcNew[k] = kmap[k];
+		alloc += 5;
+		delete []kmap;
+		kmap = ktcNew;
+	}
+	kmap[len].key = key;
+	kmap[len].modifiers = modifiers;
+	kmap[len].msg = msg;
+	kindex[code] = len;
+	len++;
+}
+
+} // namespace Commands
@@ -0,0 +1,90 @@
+/**
+ * @file keymap.h
+ * @brief Keyboard command maps
+ * @author Simon Steele
+ * @note Copyright (c) 2006-2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef keymap_h__included
+#define keymap_h__included
+
+#include <unordered_map>
+
+/**
+ * Simple keyboard command struct
+ */
+struct KeyToCommand
+{
+	unsigned char modifiers;
+	unsigned char key;
+	unsigned int msg;
+};
+
+/**
+ * This is for commands that have a command string (like scripts)
+ */
+class ExtensionCommand : public KeyToCommand
+{
+public:
+	std::string command;
+};
+
+typedef std::map<unsigned short, ExtensionCommand> ExtensionCommands;
+
+namespace Commands {
+
+/**
+ * Key bindings, both plain commands and extension commands. The binding
+ * tables are kept in order for saving and building accelerators, lookups
+ * by key go through hashed indexes on (key, modifiers) that are kept up
+ * to date as bindings are added and removed. A key is bound to either a
+ * command or an extension command, never both.
+ */
+class KeyBindings {
+public:
+	KeyBindings();
+	KeyBindings(const KeyBindings& copy);
+	~KeyBindings();
+
+	void Clear();
+
+	void AssignCmdKey(int key, int modifiers, unsigned int msg);
+	void RemoveCmdKey(int key, int modifiers, unsigned int msg);
+
+	void AddExtended(const ExtensionCommand& command);
+	void RemoveExtended(unsigned char key, unsigned char modifiers);
+
+	unsigned int Find(int key, int modifiers);	// 0 returned on failure
+	const ExtensionCommand* FindExtended(unsigned char key, unsigned char modifiers);
+
+	size_t GetCount() const;
+	size_t GetExtendedCount() const;
+
+	const KeyToCommand* GetMappings() const;
+	const ExtensionCommands& GetExtendedMappings() const;
+
+protected:
+	/// Position in kmap by key code
+	typedef std::unordered_map<unsigned short, int> KeyIndex;
+	/// Entry in extkmap by key code, map entries don't move
+	typedef std::unordered_map<unsigned short, ExtensionCommand*> ExtensionIndex;
+
+	void internalAssign(int key, int modifiers, unsigned int msg);
+
+	KeyToCommand *kmap;
+	ExtensionCommands extkmap;
+	KeyIndex kindex;
+	ExtensionIndex extindex;
+	int len;
+	int alloc;
+
+private:
+	KeyBindings& operator = (const KeyBindings& copy);
+};
+
+}
+
+#endif // #ifndef keymap_h__included
@@ -16,6 +16,7 @@
 #include "folderadder.h"
 
 #include <algorithm>
+#include <unordered_map>
 
 #define u(x) (constUtf8)x
 
@@ -70,6 +71,8 @@ MagicFolder::MagicFolder(LPCTSTR name_, /*LPCTSTR path_, */LPCTSTR base_)
 	read = false;
 	
 	cache = NULL;
+	m_changed = false;
+	m_snapshot = NULL;
 
 	filter = _T("*");
 	excludedFileFilter = FolderAdder::getDefaultExcludedFileFilter();
@@ -80,20 +83,35 @@ MagicFolder::~MagicFolder()
 {
 	if(cache != NULL)
 		delete cache;
+
+	if(m_snapshot != NULL)
+		delete m_snapshot;
+}
+
+void MagicFolder::HandleReadCache(XMLParser* parser, XMLParseState* parent, const std::string* document)
+{
+	if(document != NULL)
+		m_snapshot = new MagicFolderSnapshot;
+
+	cache = new MagicFolderCache(name.c_str(), parser, parent, document, m_snapshot);
 }
 
-void MagicFolder::HandleReadCache(XMLParser* parser, XMLParseState* parent)
+void MagicFolder::SetDirty()
 {
-	cache = new MagicFolderCache(name.c_str(), parser, parent);
+	// If we're already marked then so is everything above us, and the project
+	// is already dirty, so bursts of changes stop here:
+	if(m_changed)
+		return;
+
+	m_changed = true;
+	Folder::SetDirty();
 }
 
 const FOLDER_LIST& MagicFolder::GetFolders()
 {
 	if (!read)
 	{
-		m_canNotify = false;
 		Refresh();
-		m_canNotify = true;
 	}
 
 	return children;
@@ -103,9 +121,7 @@ const FILE_LIST& MagicFolder::GetFiles()
 {
 	if (!read)
 	{
-		m_canNotify = false;
 		Refresh();
-		m_canNotify = true;
 	}
 
 	return files;
@@ -113,16 +129,249 @@ const FILE_LIST& MagicFolder::GetFiles()
 
 void MagicFolder::Refresh()
 {
+	BeginLoad();
+
+	MagicFolderLister lister(
+		[this] (LPCTSTR name, bool isFolder) { AddLoadedItem(name, isFolder); },
+		MagicFolderLister::ContinueFunc());
+	lister.List(basePath, filter.c_str(), excludedFileFilter.c_str(), folderFilter.c_str());
+
+	EndLoad();
+}
+
+void MagicFolder::BeginLoad()
+{
+	// Let the watcher drop anything it's showing for the old contents, they
+	// then go quietly (the file index still sees them go).
+	notify(pcRefresh, this);
+
+	bool canNotify = m_canNotify;
+	m_canNotify = false;
 	Clear();
+	m_canNotify = canNotify;
 
-	MagicFolderAdder mfa;
-	
-	//TODO: remove parameter duplication here...
-	mfa.BuildFolder(this, basePath.c_str(), filter.c_str(), basePath.c_str(), excludedFileFilter.c_str(), folderFilter.c_str(), true);
+	read = false;
+
+	// The root magic folder gets its own user data from the cache too:
+	if(cache != NULL && userData.GetCount() == 0)
+	{
+		Folder* cached = cache->GetCachedFolder(this);
+		if(cached != NULL)
+			userData = cached->GetUserData();
+	}
+}
+
+/**
+ * Add a file or sub-folder found in this folder's directory. Sub-folders are
+ * not read until their own contents are asked for.
+ */
+ProjectType* MagicFolder::AddLoadedItem(LPCTSTR name, bool isFolder)
+{
+	bool canNotify = m_canNotify;
+	m_canNotify = false;
 
+	ProjectType* added = createItem(name, isFolder);
+
+	// Reading the folder isn't a change to the project, so no SetDirty here and
+	// the watcher isn't told, but the workspace file index still sees this.
+	notify(pcAdd, added);
+
+	m_canNotify = canNotify;
+
+	return added;
+}
+
+void MagicFolder::EndLoad()
+{
 	read = true;
 }
 
+/**
+ * Split a watcher path into the folder part and the last element.
+ */
+static void splitChangePath(LPCTSTR path, tstring& folderPath, tstring& name)
+{
+	tstring p(path);
+	size_t slash = p.rfind(_T('\\'));
+	if(slash == tstring::npos)
+	{
+		folderPath.clear();
+		name = p;
+	}
+	else
+	{
+		folderPath = p.substr(0, slash);
+		name = p.substr(slash + 1);
+	}
+}
+
+void MagicFolder::ApplyAdd(LPCTSTR path, bool isFolder)
+{
+	tstring folderPath, name;
+	splitChangePath(path, folderPath, name);
+
+	MagicFolder* target = findLoadedFolder(folderPath);
+	if(target == NULL || target->findChildFile(name.c_str()) != NULL || target->findChild(name.c_str()) != NULL)
+		return;
+
+	ProjectType* added = target->createItem(name.c_str(), isFolder);
+	target->notify(pcAdd, added);
+}
+
+void MagicFolder::ApplyRemove(LPCTSTR path)
+{
+	tstring folderPath, name;
+	splitChangePath(path, folderPath, name);
+
+	MagicFolder* target = findLoadedFolder(folderPath);
+	if(target != NULL)
+		target->removeItem(name.c_str());
+}
+
+void MagicFolder::ApplyRename(LPCTSTR oldPath, LPCTSTR newPath, bool isFolder)
+{
+	tstring oldFolderPath, oldName;
+	splitChangePath(oldPath, oldFolderPath, oldName);
+
+	tstring newFolderPath, newName;
+	splitChangePath(newPath, newFolderPath, newName);
+
+	// Files renamed in place keep their File object, and with it their user data:
+	if(!isFolder && _tcsicmp(oldFolderPath.c_str(), newFolderPath.c_str()) == 0)
+	{
+		MagicFolder* target = findLoadedFolder(oldFolderPath);
+		File* file = target != NULL ? target->findChildFile(oldName.c_str()) : NULL;
+		if(file != NULL && target->findChildFile(newName.c_str()) == NULL)
+		{
+			file->Renamed(newName.c_str());
+			return;
+		}
+	}
+
+	// Folders (whose files all change path) and moved files go and come back:
+	ApplyRemove(oldPath);
+	ApplyAdd(newPath, isFolder);
+}
+
+/**
+ * Make a new file or sub-folder with cached user data applied, without
+ * telling anyone.
+ */
+ProjectType* MagicFolder::createItem(LPCTSTR name, bool isFolder)
+{
+	tstring path(basePath);
+	path += name;
+
+	MagicFolderCache* theCache = getCache();
+
+	if(isFolder)
+	{
+		MagicFolder* mf = new MagicFolder(name, path.c_str());
+		mf->SetFilter(filter.c_str());
+		mf->SetExcludedFileFilter(excludedFileFilter.c_str());
+		mf->SetFolderFilter(folderFilter.c_str());
+		mf->SetParent(this);
+		children.insert(children.end(), mf);
+
+		if(theCache != NULL)
+		{
+			Folder* cached = theCache->GetCachedFolder(mf);
+			if(cached != NULL)
+				mf->GetUserData() = cached->GetUserData();
+		}
+
+		return mf;
+	}
+	else
+	{
+		File* file = new File(basePath, path.c_str(), this);
+		files.insert(files.end(), file);
+
+		if(theCache != NULL)
+		{
+			File* cached = theCache->GetCachedFile(this, name);
+			if(cached != NULL)
+				file->GetUserData() = cached->GetUserData();
+		}
+
+		return file;
+	}
+}
+
+/**
+ * Find the sub-folder at relativePath (separated by backslashes), only if it
+ * and every folder on the way to it has been read.
+ */
+MagicFolder* MagicFolder::findLoadedFolder(const tstring& relativePath)
+{
+	MagicFolder* current = this;
+	size_t start = 0;
+
+	while(current != NULL && current->read)
+	{
+		if(start >= relativePath.size())
+			return current;
+
+		size_t end = relativePath.find(_T('\\'), start);
+		if(end == tstring::npos)
+			end = relativePath.size();
+
+		tstring name(relativePath, start, end - start);
+		current = current->findChild(name.c_str());
+		start = end + 1;
+	}
+
+	return NULL;
+}
+
+MagicFolder* MagicFolder::findChild(LPCTSTR name)
+{
+	for(FL_IT i = children.begin(); i != children.end(); ++i)
+	{
+		if((*i)->GetType() == ptMagicFolder && _tcsicmp((*i)->GetName(), name) == 0)
+			return static_cast<MagicFolder*>(*i);
+	}
+
+	return NULL;
+}
+
+File* MagicFolder::findChildFile(LPCTSTR name)
+{
+	for(FILE_IT i = files.begin(); i != files.end(); ++i)
+	{
+		if(_tcsicmp((*i)->GetDisplayName(), name) == 0)
+			return (*i);
+	}
+
+	return NULL;
+}
+
+/**
+ * Remove the file or sub-folder called name, telling the watcher.
+ */
+bool MagicFolder::removeItem(LPCTSTR name)
+{
+	File* file = findChildFile(name);
+	if(file != NULL)
+	{
+		files.erase(std::remove(files.begin(), files.end(), file), files.end());
+		notify(pcRemove, file);
+		delete file;
+		return true;
+	}
+
+	MagicFolder* child = findChild(name);
+	if(child != NULL)
+	{
+		children.erase(std::remove(children.begin(), children.end(), child), children.end());
+		notify(pcRemove, child);
+		delete child;
+		return true;
+	}
+
+	return false;
+}
+
 //
 //void MagicFolder::WriteDefinition(SProjectWriter* definition)
 //{
@@ -146,6 +395,35 @@ void MagicFolder::SetGotContents(bool bGotContents)
 	read = bGotContents;
 }
 
+bool MagicFolder::GetGotContents() const
+{
+	return read;
+}
+
+MagicFolderSource MagicFolder::GetSource() const
+{
+	MagicFolderSource source;
+	source.Path = GetFullPath();
+	source.Filter = filter;
+	source.ExcludedFiles = excludedFileFilter;
+	source.ExcludedFolders = folderFilter;
+	return source;
+}
+
+/**
+ * Only the top magic folder reads the cache from the project file, find it.
+ */
+MagicFolderCache* MagicFolder::getCache()
+{
+	MagicFolder* mf = this;
+	while(mf->cache == NULL && mf->GetParent() != NULL && mf->GetParent()->GetType() == ptMagicFolder)
+	{
+		mf = static_cast<MagicFolder*>(mf->GetParent());
+	}
+
+	return mf->cache;
+}
+
 tstring MagicFolder::getMagicFolderPath(MagicFolder* last)
 {
 	if(last->GetParent()->GetType() != ptMagicFolder)
@@ -167,16 +445,14 @@ tstring MagicFolder::GetFolderCachePath()
 {
 	tstring thePath = getMagicFolderPath(this);
 
-	std::transform (thePath.begin(), thePath.end(),    // source
-               thePath.begin(),					// destination
-               tolower);
+	MakeLower(thePath);
 
 	return thePath;
 }
 
 LPCTSTR MagicFolder::GetFullPath() const
 {
-	return basePath.c_str();
+	return basePath;
 }
 
 void MagicFolder::SetFullPath(LPCTSTR newPath)
@@ -218,7 +494,7 @@ bool MagicFolder::RenameFolder(LPCTSTR newName)
 	CPathName fp(basePath);
 	fp.ChangeLastElement(newName);
 	
-	if(::MoveFile(basePath.c_str(), fp.c_str()) != 0)
+	if(::MoveFile(basePath, fp.c_str()) != 0)
 	{
 		basePath = fp.c_str();
 		return true;
@@ -247,6 +523,18 @@ class MagicFolderCache::FolderMap : public stdext::hash_map<tstring, Folder*>
 		}
 };
 
+//////////////////////////////////////////////////////////////////////////////
+// MagicFolderCache::FileMap
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Cached files keyed by folder cache path plus lower-case filename, the
+ * files themselves are owned by the folders in FolderMap.
+ */
+class MagicFolderCache::FileMap : public std::unordered_map<tstring, File*>
+{
+};
+
 //////////////////////////////////////////////////////////////////////////////
 // MagicFolderCache Helper Functions
 //////////////////////////////////////////////////////////////////////////////
@@ -275,9 +563,7 @@ SStringStack* newStringStackItem(SStringStack* last, LPCTSTR newPathElement)
 		
 		item->val += _T('\\');
 
-		std::transform (item->val.begin(), item->val.end(),    // source
-               item->val.begin(),					// destination
-               tolower);
+		MakeLower(item->val);
 	}
 	else
 	{
@@ -292,24 +578,31 @@ SStringStack* newStringStackItem(SStringStack* last, LPCTSTR newPathElement)
 // MagicFolderCache
 //////////////////////////////////////////////////////////////////////////////
 
-MagicFolderCache::MagicFolderCache(LPCTSTR name, XMLParser* parser, XMLParseState* parent)
+MagicFolderCache::MagicFolderCache(LPCTSTR name, XMLParser* parser, XMLParseState* parent, const std::string* document, MagicFolderSnapshot* snapshot)
 {
 	_depth = 0;
 	_parent = parent;
 	_parser = parser;
+	_document = document;
+	_snapshot = snapshot;
 	_pathStack = newStringStackItem(NULL, NULL);
 	_map = new FolderMap;
+	_files = new FileMap;
 	
 	// Set up the root folder...
 	_current = new Folder(name, _T(""));
 	_map->insert(MagicFolderCache::FolderMap::value_type(_pathStack->val, _current));
 
+	// We're created for the start of the top MagicFolder element:
+	startRange();
+
 	STATE( PS_FOLDER );
 	_parser->SetParseState(this);
 }
 
 MagicFolderCache::~MagicFolderCache()
 {
+	delete _files;
 	delete _map;
 }
 
@@ -325,6 +618,22 @@ Folder* MagicFolderCache::GetCachedFolder(MagicFolder* actual)
 		return NULL;
 }
 
+File* MagicFolderCache::GetCachedFile(MagicFolder* actual, LPCTSTR filename)
+{
+	tstring key = actual->GetFolderCachePath();
+	tstring name(filename);
+	MakeLower(name);
+	key += name;
+
+	MagicFolderCache::FileMap::const_iterator i = _files->find(key);
+	if(i != _files->end())
+	{
+		return (*i).second;
+	}
+	else
+		return NULL;
+}
+
 void MagicFolderCache::startElement(XML_CSTR name, const XMLAttributes& atts)
 {
 	if( IN_STATE( PS_FOLDER ) )
@@ -339,6 +648,8 @@ void MagicFolderCache::startElement(XML_CSTR name, const XMLAttributes& atts)
 			// Store a folder object which will hold configuration etc.
 			_current = new Folder(_pathStack->val.c_str(), _T(""));
 			_map->insert(MagicFolderCache::FolderMap::value_type(_pathStack->val, _current));
+
+			startRange();
 		}
 		else if( MATCH("File") )
 		{
@@ -362,8 +673,12 @@ void MagicFolderCache::endElement(XML_CSTR name)
 	{
 		if( MATCH("MagicFolder") )
 		{
+			endRange();
+
 			if(_depth == 0)
 			{
+				finishSnapshot();
+
 				_parser->SetParseState(_parent);
 				
 				// Get rid of the last path stack element.
@@ -401,9 +716,70 @@ void MagicFolderCache::characterData(XML_CSTR data, int len)
 	
 }
 
+/**
+ * Note where the MagicFolder element that is starting begins in the document,
+ * until we see its end it's assumed to be an empty element.
+ */
+void MagicFolderCache::startRange()
+{
+	if(_snapshot == NULL)
+		return;
+
+	XML_Parser parser = _parser->GetParser();
+	size_t start = static_cast<size_t>(XML_GetCurrentByteIndex(parser));
+	size_t length = static_cast<size_t>(XML_GetCurrentByteCount(parser));
+	_snapshot->Ranges[_pathStack->val] = MagicFolderSnapshot::Range(start, start + length);
+}
+
+void MagicFolderCache::endRange()
+{
+	if(_snapshot == NULL)
+		return;
+
+	// There are no bytes for the end of an empty element, the start tag was all of it.
+	XML_Parser parser = _parser->GetParser();
+	int length = XML_GetCurrentByteCount(parser);
+	if(length > 0)
+	{
+		_snapshot->Ranges[_pathStack->val].End = static_cast<size_t>(XML_GetCurrentByteIndex(parser)) + length;
+	}
+}
+
+/**
+ * Keep the XML for the whole top-level MagicFolder with element positions
+ * relative to it.
+ */
+void MagicFolderCache::finishSnapshot()
+{
+	if(_snapshot == NULL)
+		return;
+
+	MagicFolderSnapshot::RANGE_MAP& ranges = _snapshot->Ranges;
+	MagicFolderSnapshot::Range top = ranges[_pathStack->val];
+
+	if(top.End <= top.Start || top.End > _document->size())
+	{
+		ranges.clear();
+		return;
+	}
+
+	_snapshot->Xml.assign(*_document, top.Start, top.End - top.Start);
+
+	for(MagicFolderSnapshot::RANGE_MAP::iterator i = ranges.begin(); i != ranges.end(); ++i)
+	{
+		(*i).second.Start -= top.Start;
+		(*i).second.End -= top.Start;
+	}
+}
+
 void MagicFolderCache::processFile(const XMLAttributes& atts)
 {
 	_currentFile = _current->AddFile(ATTVAL(_T("path")));
+
+	tstring key(_currentFile->GetDisplayName());
+	MakeLower(key);
+	key.insert(0, _pathStack->val);
+	_files->insert(MagicFolderCache::FileMap::value_type(key, _currentFile));
 }
 
 void MagicFolderCache::processUserData(XML_CSTR name, const XMLAttributes& atts)
@@ -0,0 +1,525 @@
+/**
+ * @file magicfolderchanges.cpp
+ * @brief Turn directory notifications into changes for a magic folder.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "project.h"
+#include "magicfolderchanges.h"
+
+#include "include/filefinder.h"
+#include "include/filematcher.h"
+#include "folderadder.h"
+
+#if defined (_DEBUG)
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace Projects;
+
+/// Size of the buffer for each directory, 64k is the most that works over a network
+#define MAGICFOLDER_WATCHBUFFER	65536
+
+//////////////////////////////////////////////////////////////////////////////
+// Win32DirectoryWatchBackend
+//////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/**
+ * ReadDirectoryChangesW on each directory, with the reads completing
+ * through one I/O completion port.
+ */
+class Win32DirectoryWatchBackend : public DirectoryWatchBackend
+{
+	public:
+		Win32DirectoryWatchBackend();
+		virtual ~Win32DirectoryWatchBackend();
+
+		virtual bool Start(const tstring& path, int cookie);
+		virtual void Stop(int cookie);
+		virtual EWaitResult Wait(int& cookie, DIRECTORY_CHANGES& changes);
+		virtual void Wake();
+		virtual bool Exists(const tstring& path, bool& isFolder);
+
+	private:
+		class Watch
+		{
+			public:
+				Watch(int cookie) : Cookie(cookie), Directory(INVALID_HANDLE_VALUE), Pending(false), Stopping(false)
+				{
+					memset(&Overlapped, 0, sizeof(Overlapped));
+				}
+
+				int Cookie;
+				HANDLE Directory;
+				OVERLAPPED Overlapped;
+				/// Is a read outstanding?
+				bool Pending;
+				/// Waiting for the cancelled read to complete before deleting
+				bool Stopping;
+				/// DWORD aligned as ReadDirectoryChangesW requires
+				DWORD Buffer[MAGICFOLDER_WATCHBUFFER / sizeof(DWORD)];
+		};
+
+		typedef std::map<int, Watch*> WATCH_MAP;
+
+		bool read(Watch* watch);
+		void release(Watch* watch);
+		void parse(Watch* watch, DIRECTORY_CHANGES& changes);
+
+		HANDLE m_port;
+		WATCH_MAP m_watches;
+		/// Watches waiting for their cancelled reads
+		int m_stopping;
+};
+
+Win32DirectoryWatchBackend::Win32DirectoryWatchBackend() : m_stopping(0)
+{
+	m_port = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+}
+
+Win32DirectoryWatchBackend::~Win32DirectoryWatchBackend()
+{
+	while (!m_watches.empty())
+	{
+		Stop((*m_watches.begin()).first);
+	}
+
+	// Wait for the cancelled reads so the buffers can be freed:
+	while (m_stopping > 0)
+	{
+		DWORD bytes(0);
+		ULONG_PTR key(0);
+		LPOVERLAPPED overlapped(NULL);
+		::GetQueuedCompletionStatus(m_port, &bytes, &key, &overlapped, 1000);
+
+		if (overlapped == NULL)
+		{
+			// Timed out or a wake-up call, only give up on the former.
+			if (::GetLastError() == WAIT_TIMEOUT)
+				break;
+			continue;
+		}
+
+		--m_stopping;
+		delete reinterpret_cast<Watch*>(key);
+	}
+
+	::CloseHandle(m_port);
+}
+
+bool Win32DirectoryWatchBackend::Start(const tstring& path, int cookie)
+{
+	Watch* watch = new Watch(cookie);
+
+	watch->Directory = ::CreateFile(path.c_str(),
+		FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		NULL);
+
+	if (watch->Directory == INVALID_HANDLE_VALUE)
+	{
+		LOG(_T("PN2: Could not watch magic folder directory."));
+		delete watch;
+		return false;
+	}
+
+	if (::CreateIoCompletionPort(watch->Directory, m_port, reinterpret_cast<ULONG_PTR>(watch), 0) == NULL
+		|| !read(watch))
+	{
+		LOG(_T("PN2: Could not watch magic folder directory."));
+		::CloseHandle(watch->Directory);
+		delete watch;
+		return false;
+	}
+
+	m_watches.insert(WATCH_MAP::value_type(cookie, watch));
+
+	return true;
+}
+
+void Win32DirectoryWatchBackend::Stop(int cookie)
+{
+	WATCH_MAP::iterator i = m_watches.find(cookie);
+	if (i == m_watches.end())
+	{
+		return;
+	}
+
+	Watch* watch = (*i).second;
+	m_watches.erase(i);
+
+	release(watch);
+}
+
+DirectoryWatchBackend::EWaitResult Win32DirectoryWatchBackend::Wait(int& cookie, DIRECTORY_CHANGES& changes)
+{
+	for (;;)
+	{
+		DWORD bytes(0);
+		ULONG_PTR key(0);
+		LPOVERLAPPED overlapped(NULL);
+		BOOL ok = ::GetQueuedCompletionStatus(m_port, &bytes, &key, &overlapped, INFINITE);
+
+		if (overlapped == NULL)
+		{
+			// Woken up, or the port has gone.
+			return ok ? wrWoken : wrClosed;
+		}
+
+		Watch* watch = reinterpret_cast<Watch*>(key);
+		watch->Pending = false;
+
+		if (watch->Stopping)
+		{
+			--m_stopping;
+			delete watch;
+			continue;
+		}
+
+		cookie = watch->Cookie;
+
+		if (!ok)
+		{
+			return wrFailed;
+		}
+
+		if (bytes == 0)
+		{
+			// The buffer overflowed, we don't know what changed.
+			return read(watch) ? wrOverflow : wrFailed;
+		}
+
+		parse(watch, changes);
+
+		// Without another read we'd miss changes, so the folder has to be read again:
+		return read(watch) ? wrChanges : wrFailed;
+	}
+}
+
+void Win32DirectoryWatchBackend::Wake()
+{
+	::PostQueuedCompletionStatus(m_port, 0, 0, NULL);
+}
+
+bool Win32DirectoryWatchBackend::Exists(const tstring& path, bool& isFolder)
+{
+	DWORD attributes = ::GetFileAttributes(path.c_str());
+	if (attributes == INVALID_FILE_ATTRIBUTES)
+	{
+		isFolder = false;
+		return false;
+	}
+
+	isFolder = (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+	return true;
+}
+
+bool Win32DirectoryWatchBackend::read(Watch* watch)
+{
+	memset(&watch->Overlapped, 0, sizeof(watch->Overlapped));
+
+	watch->Pending = ::ReadDirectoryChangesW(watch->Directory,
+		watch->Buffer,
+		sizeof(watch->Buffer),
+		TRUE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME,
+		NULL,
+		&watch->Overlapped,
+		NULL) != FALSE;
+
+	return watch->Pending;
+}
+
+void Win32DirectoryWatchBackend::release(Watch* watch)
+{
+	if (watch->Pending)
+	{
+		// The read completes (cancelled) through the port, delete it then.
+		watch->Stopping = true;
+		++m_stopping;
+		::CancelIo(watch->Directory);
+		::CloseHandle(watch->Directory);
+	}
+	else
+	{
+		::CloseHandle(watch->Directory);
+		delete watch;
+	}
+}
+
+void Win32DirectoryWatchBackend::parse(Watch* watch, DIRECTORY_CHANGES& changes)
+{
+	const BYTE* p = reinterpret_cast<const BYTE*>(watch->Buffer);
+
+	for (;;)
+	{
+		const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+		tstring path(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+		switch (info->Action)
+		{
+		case FILE_ACTION_ADDED:
+			changes.push_back(DirectoryChange(DirectoryChange::dcAdded, path));
+			break;
+
+		case FILE_ACTION_REMOVED:
+			changes.push_back(DirectoryChange(DirectoryChange::dcRemoved, path));
+			break;
+
+		case FILE_ACTION_RENAMED_OLD_NAME:
+			changes.push_back(DirectoryChange(DirectoryChange::dcRenamedOldName, path));
+			break;
+
+		case FILE_ACTION_RENAMED_NEW_NAME:
+			changes.push_back(DirectoryChange(DirectoryChange::dcRenamedNewName, path));
+			break;
+		}
+
+		if (info->NextEntryOffset == 0)
+			break;
+
+		p += info->NextEntryOffset;
+	}
+}
+
+} // namespace
+
+DirectoryWatchBackend* DirectoryWatchBackend::Create()
+{
+	return new Win32DirectoryWatchBackend();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// MagicFolderChangeCollector
+//////////////////////////////////////////////////////////////////////////////
+
+MagicFolderChangeCollector::MagicFolderChangeCollector(DirectoryWatchBackend& backend, const tstring& path, LPCTSTR filter, LPCTSTR excludedFileFilter, LPCTSTR folderFilter) :
+	m_backend(backend),
+	m_path(path),
+	m_filters(new MagicFolderLister(MagicFolderLister::FoundFunc(), MagicFolderLister::ContinueFunc()))
+{
+	m_filters->SetFolderFilters(filter, excludedFileFilter, folderFilter);
+}
+
+MagicFolderChangeCollector::~MagicFolderChangeCollector()
+{
+	delete m_filters;
+}
+
+const tstring& MagicFolderChangeCollector::GetPath() const
+{
+	return m_path;
+}
+
+void MagicFolderChangeCollector::Collect(const DIRECTORY_CHANGES& notifications, MAGICFOLDER_CHANGES& changes)
+{
+	OPERATIONS operations;
+
+	for (DIRECTORY_CHANGES::const_iterator i = notifications.begin(); i != notifications.end(); ++i)
+	{
+		switch ((*i).Action)
+		{
+		case DirectoryChange::dcAdded:
+			add(operations, (*i).Path);
+			break;
+
+		case DirectoryChange::dcRemoved:
+			remove(operations, (*i).Path);
+			break;
+
+		case DirectoryChange::dcRenamedOldName:
+			// An old name that never got a new one has gone somewhere we can't see:
+			if (!m_renamedFrom.empty())
+			{
+				remove(operations, m_renamedFrom);
+			}
+
+			m_renamedFrom = (*i).Path;
+			break;
+
+		case DirectoryChange::dcRenamedNewName:
+			if (m_renamedFrom.empty())
+			{
+				add(operations, (*i).Path);
+			}
+			else
+			{
+				rename(operations, m_renamedFrom, (*i).Path);
+				m_renamedFrom.clear();
+			}
+			break;
+		}
+	}
+
+	for (OPERATIONS::const_iterator i = operations.begin(); i != operations.end(); ++i)
+	{
+		const Operation& op = *i;
+
+		switch (op.Action)
+		{
+		case DirectoryChange::dcAdded:
+			{
+				bool isFolder;
+				if (existingMatches(op.Path, isFolder))
+				{
+					changes.push_back(MagicFolderChange(MagicFolderChange::mcAdded, op.Path, isFolder));
+				}
+			}
+			break;
+
+		case DirectoryChange::dcRemoved:
+			// We can't tell what this was any more, folders just ignore names they don't have.
+			changes.push_back(MagicFolderChange(MagicFolderChange::mcRemoved, op.Path, false));
+			break;
+
+		case DirectoryChange::dcRenamedNewName:
+			{
+				// The old name has gone, so it's matched as whatever the new one is:
+				bool isFolder;
+				bool newMatches = existingMatches(op.Path, isFolder);
+				bool oldMatches = matches(op.OldPath, isFolder);
+
+				if (oldMatches && newMatches)
+				{
+					MagicFolderChange change(MagicFolderChange::mcRenamed, op.Path, isFolder);
+					change.OldPath = op.OldPath;
+					changes.push_back(change);
+				}
+				else if (oldMatches)
+				{
+					changes.push_back(MagicFolderChange(MagicFolderChange::mcRemoved, op.OldPath, isFolder));
+				}
+				else if (newMatches)
+				{
+					changes.push_back(MagicFolderChange(MagicFolderChange::mcAdded, op.Path, isFolder));
+				}
+			}
+			break;
+		}
+	}
+}
+
+void MagicFolderChangeCollector::add(OPERATIONS& operations, const tstring& path)
+{
+	int last = findLast(operations, path);
+	if (last != -1 && operations[last].Action == DirectoryChange::dcAdded)
+	{
+		return;
+	}
+
+	operations.push_back(Operation(DirectoryChange::dcAdded, path));
+}
+
+void MagicFolderChangeCollector::remove(OPERATIONS& operations, const tstring& path)
+{
+	int last = findLast(operations, path);
+	if (last != -1)
+	{
+		Operation& op = operations[last];
+
+		if (op.Action == DirectoryChange::dcAdded)
+		{
+			// Came and went, nobody needs to know:
+			operations.erase(operations.begin() + last);
+			return;
+		}
+
+		if (op.Action == DirectoryChange::dcRenamedNewName)
+		{
+			// What was removed is whatever had the old name:
+			op.Action = DirectoryChange::dcRemoved;
+			op.Path = op.OldPath;
+			op.OldPath.clear();
+			return;
+		}
+	}
+
+	operations.push_back(Operation(DirectoryChange::dcRemoved, path));
+}
+
+void MagicFolderChangeCollector::rename(OPERATIONS& operations, const tstring& oldPath, const tstring& newPath)
+{
+	int last = findLast(operations, oldPath);
+	if (last != -1)
+	{
+		Operation& op = operations[last];
+
+		if (op.Action == DirectoryChange::dcAdded)
+		{
+			op.Path = newPath;
+			return;
+		}
+
+		if (op.Action == DirectoryChange::dcRenamedNewName)
+		{
+			if (op.OldPath == newPath)
+			{
+				// Renamed back again:
+				operations.erase(operations.begin() + last);
+			}
+			else
+			{
+				op.Path = newPath;
+			}
+			return;
+		}
+	}
+
+	Operation op(DirectoryChange::dcRenamedNewName, newPath);
+	op.OldPath = oldPath;
+	operations.push_back(op);
+}
+
+/**
+ * @return index of the last operation that left an item at path, or -1
+ */
+int MagicFolderChangeCollector::findLast(const OPERATIONS& operations, const tstring& path)
+{
+	for (int i = static_cast<int>(operations.size()) - 1; i >= 0; --i)
+	{
+		if (_tcsicmp(operations[i].Path.c_str(), path.c_str()) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Does an item that exists now pass the folder filters? The last element of
+ * path is matched, the folders above it were matched when they were added.
+ */
+bool MagicFolderChangeCollector::existingMatches(const tstring& path, bool& isFolder)
+{
+	tstring fullPath(m_path);
+	fullPath += path;
+
+	if (!m_backend.Exists(fullPath, isFolder))
+	{
+		// Gone again already.
+		return false;
+	}
+
+	return matches(path, isFolder);
+}
+
+bool MagicFolderChangeCollector::matches(const tstring& path, bool isFolder)
+{
+	size_t slash = path.rfind(_T('\\'));
+	tstring name(slash == tstring::npos ? path : path.substr(slash + 1));
+
+	return m_filters->Matches(m_path.c_str(), name.c_str(), isFolder);
+}
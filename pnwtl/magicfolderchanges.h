@@ -0,0 +1,173 @@
+/**
+ * @file magicfolderchanges.h
+ * @brief Turn directory notifications into changes for a magic folder.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef magicfolderchanges_h__included
+#define magicfolderchanges_h__included
+
+#include <vector>
+
+namespace Projects
+{
+
+class MagicFolderLister;
+
+/**
+ * A file or folder added, removed or renamed somewhere below a watched
+ * magic folder. Paths are relative to the magic folder's directory.
+ */
+class MagicFolderChange
+{
+	public:
+		typedef enum { mcAdded, mcRemoved, mcRenamed } EChangeType;
+
+		MagicFolderChange(EChangeType type, const tstring& path, bool isFolder) : Type(type), Path(path), IsFolder(isFolder) {}
+
+		EChangeType Type;
+		/// Path of the item, the new path for renames
+		tstring Path;
+		/// Old path for renames
+		tstring OldPath;
+		/// Is the (added or renamed) item a folder?
+		bool IsFolder;
+};
+
+typedef std::vector<MagicFolderChange> MAGICFOLDER_CHANGES;
+
+/**
+ * One notification for a watched directory, as the file system reports it.
+ * A rename comes as an old name followed by a new name, not always from
+ * the same read.
+ */
+class DirectoryChange
+{
+	public:
+		typedef enum { dcAdded, dcRemoved, dcRenamedOldName, dcRenamedNewName } EAction;
+
+		DirectoryChange(EAction action, const tstring& path) : Action(action), Path(path) {}
+
+		EAction Action;
+		/// Relative to the watched directory
+		tstring Path;
+};
+
+typedef std::vector<DirectoryChange> DIRECTORY_CHANGES;
+
+/**
+ * Where the notifications for watched directory trees come from. All calls
+ * except Wake are made on the watching thread. Create picks the
+ * implementation for the platform, tests supply their own.
+ */
+class DirectoryWatchBackend
+{
+	public:
+		typedef enum {
+			/// Changes for a watch
+			wrChanges,
+			/// More changed than could be reported, the watch must be read again
+			wrOverflow,
+			/// The watch failed, probably because the directory has gone
+			wrFailed,
+			/// Wake was called
+			wrWoken,
+			/// Nothing more will be reported
+			wrClosed
+		} EWaitResult;
+
+		virtual ~DirectoryWatchBackend() {}
+
+		static DirectoryWatchBackend* Create();
+
+		/**
+		 * Watch path and everything below it.
+		 * @param path Directory with a trailing slash
+		 * @param cookie Returned by Wait with the changes for this watch
+		 */
+		virtual bool Start(const tstring& path, int cookie) = 0;
+
+		/**
+		 * Stop a watch, nothing more is returned for cookie.
+		 */
+		virtual void Stop(int cookie) = 0;
+
+		/**
+		 * Wait for something to happen to one of the watches, or for Wake.
+		 * @param cookie Set to the watch for all but wrWoken and wrClosed
+		 * @param changes Filled in for wrChanges
+		 */
+		virtual EWaitResult Wait(int& cookie, DIRECTORY_CHANGES& changes) = 0;
+
+		/**
+		 * Make Wait return wrWoken, from any thread.
+		 */
+		virtual void Wake() = 0;
+
+		/**
+		 * @return false if path doesn't exist, otherwise whether it's a folder in isFolder
+		 */
+		virtual bool Exists(const tstring& path, bool& isFolder) = 0;
+};
+
+/**
+ * Turns the notifications for one watched magic folder into the changes
+ * that pass its filters. Within each call to Collect, changes that undo or
+ * build on earlier ones are folded together: an item added and removed
+ * again is never reported, an added item that's then renamed is added
+ * with its new name, and a chain of renames is one rename.
+ */
+class MagicFolderChangeCollector
+{
+	public:
+		/**
+		 * @param path Directory being watched, with a trailing slash
+		 */
+		MagicFolderChangeCollector(DirectoryWatchBackend& backend, const tstring& path, LPCTSTR filter, LPCTSTR excludedFileFilter, LPCTSTR folderFilter);
+		~MagicFolderChangeCollector();
+
+		/**
+		 * Append the changes for a read's notifications to changes.
+		 */
+		void Collect(const DIRECTORY_CHANGES& notifications, MAGICFOLDER_CHANGES& changes);
+
+		const tstring& GetPath() const;
+
+	private:
+		class Operation
+		{
+			public:
+				Operation(DirectoryChange::EAction action, const tstring& path) : Action(action), Path(path) {}
+
+				/// dcAdded, dcRemoved, or dcRenamedNewName for a rename
+				DirectoryChange::EAction Action;
+				tstring Path;
+				tstring OldPath;
+		};
+
+		typedef std::vector<Operation> OPERATIONS;
+
+		MagicFolderChangeCollector(const MagicFolderChangeCollector&);
+		MagicFolderChangeCollector& operator=(const MagicFolderChangeCollector&);
+
+		void add(OPERATIONS& operations, const tstring& path);
+		void remove(OPERATIONS& operations, const tstring& path);
+		void rename(OPERATIONS& operations, const tstring& oldPath, const tstring& newPath);
+		int findLast(const OPERATIONS& operations, const tstring& path);
+		bool existingMatches(const tstring& path, bool& isFolder);
+		bool matches(const tstring& path, bool isFolder);
+
+		DirectoryWatchBackend& m_backend;
+		tstring m_path;
+		/// Old name from a read that ended halfway through a rename
+		tstring m_renamedFrom;
+		MagicFolderLister* m_filters;
+};
+
+} // namespace Projects
+
+#endif // #ifndef magicfolderchanges_h__included
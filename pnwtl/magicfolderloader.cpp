@@ -0,0 +1,238 @@
+/**
+ * @file magicfolderloader.cpp
+ * @brief Asynchronous magic folder enumeration.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes 
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "project.h"
+#include "magicfolderloader.h"
+
+#include "include/filefinder.h"
+#include "include/filematcher.h"
+#include "folderadder.h"
+
+#if defined (_DEBUG)
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace Projects;
+using pnutils::threading::CritLock;
+
+/// Number of items posted to the window in each batch
+#define MAGICFOLDER_BATCHSIZE	256
+
+MagicFolderLoader::MagicFolderLoader(HWND target) : 
+	m_target(target),
+	m_nextCookie(1),
+	m_requested(false),
+	m_thread(this, &MagicFolderLoader::run)
+{
+	m_thread.Start();
+}
+
+MagicFolderLoader::~MagicFolderLoader()
+{
+	CancelAll();
+	m_thread.Stop();
+}
+
+int MagicFolderLoader::Load(MagicFolder* folder)
+{
+	Request request;
+	request.Folder = folder;
+	request.Path = folder->GetFullPath();
+	request.Filter = folder->GetFilter();
+	request.ExcludedFiles = folder->GetExcludedFileFilter();
+	request.ExcludedFolders = folder->GetFolderFilter();
+
+	{
+		CritLock lock(m_cs);
+		request.Cookie = m_nextCookie++;
+		m_queue.push_back(request);
+		m_active.insert(request.Cookie);
+	}
+
+	m_requested.Set();
+
+	return request.Cookie;
+}
+
+void MagicFolderLoader::Cancel(int cookie)
+{
+	CritLock lock(m_cs);
+	m_active.erase(cookie);
+}
+
+void MagicFolderLoader::CancelAll()
+{
+	CritLock lock(m_cs);
+	m_active.clear();
+	m_queue.clear();
+}
+
+void MagicFolderLoader::run(CSSThread* thread)
+{
+	HANDLE handles[2] = { thread->GetStopHandle(), m_requested.Get() };
+
+	while (thread->GetCanRun())
+	{
+		Request request;
+		bool haveRequest(false);
+
+		{
+			CritLock lock(m_cs);
+			if (m_queue.size())
+			{
+				request = m_queue.front();
+				m_queue.pop_front();
+				haveRequest = true;
+			}
+		}
+
+		if (haveRequest)
+		{
+			if (isActive(request.Cookie))
+			{
+				list(thread, request);
+			}
+		}
+		else
+		{
+			::WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+		}
+	}
+}
+
+void MagicFolderLoader::list(CSSThread* thread, const Request& request)
+{
+	MagicFolderBatch* batch = new MagicFolderBatch(request.Folder, request.Cookie);
+
+	MagicFolderLister lister(
+		[&] (LPCTSTR name, bool isFolder) {
+			if (isFolder)
+			{
+				batch->Folders.push_back(name);
+			}
+			else
+			{
+				batch->Files.push_back(name);
+			}
+
+			if (batch->Folders.size() + batch->Files.size() >= MAGICFOLDER_BATCHSIZE)
+			{
+				post(batch);
+				batch = new MagicFolderBatch(request.Folder, request.Cookie);
+			}
+		},
+		[&] () -> bool {
+			return thread->GetCanRun() && isActive(request.Cookie);
+		});
+
+	lister.List(request.Path.c_str(), request.Filter.c_str(), request.ExcludedFiles.c_str(), request.ExcludedFolders.c_str());
+
+	if (isActive(request.Cookie))
+	{
+		batch->Last = true;
+		post(batch);
+	}
+	else
+	{
+		delete batch;
+	}
+
+	Cancel(request.Cookie);
+}
+
+bool MagicFolderLoader::isActive(int cookie)
+{
+	CritLock lock(m_cs);
+	return m_active.find(cookie) != m_active.end();
+}
+
+void MagicFolderLoader::post(MagicFolderBatch* batch)
+{
+	if (!::PostMessage(m_target, PN_MAGICFOLDERBATCH, 0, reinterpret_cast<LPARAM>(batch)))
+	{
+		delete batch;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ProjectFileIterator
+//////////////////////////////////////////////////////////////////////////////
+
+ProjectFileIterator::ProjectFileIterator(Folder* folder, const std::unordered_set<tstring>& exclude) :
+	m_exclude(exclude)
+{
+	MAGICFOLDER_SOURCES unread;
+	folder->GetAllFiles([this] (LPCTSTR filename) { add(filename); }, unread);
+
+	m_unread.assign(unread.begin(), unread.end());
+}
+
+bool ProjectFileIterator::Next(tstring& file)
+{
+	while (m_files.empty())
+	{
+		if (m_unread.empty())
+		{
+			return false;
+		}
+
+		listNext();
+	}
+
+	file = m_files.front();
+	m_files.pop_front();
+	return true;
+}
+
+void ProjectFileIterator::add(const tstring& filename)
+{
+	if (m_exclude.find(filename) != m_exclude.end())
+	{
+		return;
+	}
+
+	tstring key(filename);
+	MakeLower(key);
+
+	if (m_seen.insert(key).second)
+	{
+		m_files.push_back(filename);
+	}
+}
+
+/**
+ * List one level of the next unread magic folder, its sub-folders are
+ * listed in turn.
+ */
+void ProjectFileIterator::listNext()
+{
+	MagicFolderSource source(m_unread.front());
+	m_unread.pop_front();
+
+	MagicFolderLister lister(
+		[&] (LPCTSTR name, bool isFolder) {
+			if (isFolder)
+			{
+				MagicFolderSource child(source);
+				child.Path = CPathName(source.Path + name).c_str();
+				m_unread.push_back(child);
+			}
+			else
+			{
+				add(source.Path + name);
+			}
+		},
+		MagicFolderLister::ContinueFunc());
+
+	lister.List(source.Path.c_str(), source.Filter.c_str(), source.ExcludedFiles.c_str(), source.ExcludedFolders.c_str());
+}
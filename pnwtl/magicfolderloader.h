@@ -0,0 +1,125 @@
+/**
+ * @file magicfolderloader.h
+ * @brief Asynchronous magic folder enumeration.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes 
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef magicfolderloader_h__included
+#define magicfolderloader_h__included
+
+#include "include/ssthreads.h"
+#include "include/threading.h"
+#include "findinfiles.h"
+
+#include <deque>
+#include <set>
+#include <unordered_set>
+
+namespace Projects
+{
+
+/**
+ * Part of the listing of a magic folder's directory, posted to the target
+ * window as the LPARAM of a PN_MAGICFOLDERBATCH message. The receiver owns
+ * the batch and must delete it.
+ */
+class MagicFolderBatch
+{
+	public:
+		MagicFolderBatch(MagicFolder* folder, int cookie) : Folder(folder), Cookie(cookie), Last(false) {}
+
+		/// Folder the listing is for, only valid if Cookie is still current
+		MagicFolder* Folder;
+		int Cookie;
+		std::vector<tstring> Folders;
+		std::vector<tstring> Files;
+		/// Is this the end of the listing?
+		bool Last;
+};
+
+/**
+ * Lists magic folder directories one level at a time on a worker thread,
+ * posting the results back to a window in batches. Loads can be cancelled,
+ * after which no more batches for them are posted.
+ */
+class MagicFolderLoader
+{
+	public:
+		explicit MagicFolderLoader(HWND target);
+		~MagicFolderLoader();
+
+		/**
+		 * Queue a listing of folder's directory.
+		 * @returns cookie identifying this load in MagicFolderBatch
+		 */
+		int Load(MagicFolder* folder);
+
+		/**
+		 * Stop a load, batches already posted must be discarded by the receiver.
+		 */
+		void Cancel(int cookie);
+
+		void CancelAll();
+
+	private:
+		class Request
+		{
+			public:
+				int Cookie;
+				MagicFolder* Folder;
+				tstring Path;
+				tstring Filter;
+				tstring ExcludedFiles;
+				tstring ExcludedFolders;
+		};
+
+		void run(CSSThread* thread);
+		void list(CSSThread* thread, const Request& request);
+		bool isActive(int cookie);
+		void post(MagicFolderBatch* batch);
+
+		HWND m_target;
+		int m_nextCookie;
+		std::deque<Request> m_queue;
+		std::set<int> m_active;
+		pnutils::threading::CriticalSection m_cs;
+		pnutils::threading::WinEvent m_requested;
+		CSSThreadT<MagicFolderLoader> m_thread;
+};
+
+/**
+ * The files in a project, or a folder in one, for find in files. Files the
+ * project already has are collected straight away. Magic folders that
+ * haven't been read are listed as Next reaches them, on the searching
+ * thread, so the UI thread never waits for the disk. The project isn't
+ * touched after construction.
+ */
+class ProjectFileIterator : public FileIterator
+{
+	public:
+		/**
+		 * @param exclude Files to leave out, matched exactly
+		 */
+		ProjectFileIterator(Folder* folder, const std::unordered_set<tstring>& exclude);
+		virtual ~ProjectFileIterator() {}
+
+		virtual bool Next(tstring& file);
+
+	private:
+		void add(const tstring& filename);
+		void listNext();
+
+		std::deque<tstring> m_files;
+		std::deque<MagicFolderSource> m_unread;
+		/// Lower case, so each file is searched once
+		std::unordered_set<tstring> m_seen;
+		std::unordered_set<tstring> m_exclude;
+};
+
+} // namespace Projects
+
+#endif // #ifndef magicfolderloader_h__included
@@ -0,0 +1,242 @@
+/**
+ * @file magicfolderwatcher.cpp
+ * @brief Watch magic folder directories for changes.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "project.h"
+#include "magicfolderwatcher.h"
+
+#if defined (_DEBUG)
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace Projects;
+using pnutils::threading::CritLock;
+
+//////////////////////////////////////////////////////////////////////////////
+// MagicFolderWatcher::DirectoryWatch
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * State for one watched directory tree, owned by the worker thread once
+ * it has been started.
+ */
+class MagicFolderWatcher::DirectoryWatch
+{
+	public:
+		DirectoryWatch(DirectoryWatchBackend& backend, MagicFolder* folder, const tstring& path) :
+			Cookie(0),
+			Folder(folder),
+			Changes(backend, path, folder->GetFilter(), folder->GetExcludedFileFilter(), folder->GetFolderFilter())
+		{
+		}
+
+		int Cookie;
+		MagicFolder* Folder;
+		MagicFolderChangeCollector Changes;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// MagicFolderWatcher
+//////////////////////////////////////////////////////////////////////////////
+
+MagicFolderWatcher::MagicFolderWatcher(HWND target) :
+	m_target(target),
+	m_backend(DirectoryWatchBackend::Create()),
+	m_nextCookie(1),
+	m_thread(this, &MagicFolderWatcher::run)
+{
+	m_thread.Start();
+}
+
+MagicFolderWatcher::~MagicFolderWatcher()
+{
+	m_thread.SetCanRun(false);
+	m_backend->Wake();
+	m_thread.Stop();
+
+	delete m_backend;
+
+	// Anything the worker never got to:
+	for(std::deque<Command>::const_iterator i = m_commands.begin(); i != m_commands.end(); ++i)
+	{
+		delete (*i).Watch;
+	}
+}
+
+int MagicFolderWatcher::Watch(MagicFolder* folder)
+{
+	CPathName pn(folder->GetFullPath());
+	DirectoryWatch* watch = new DirectoryWatch(*m_backend, folder, pn.c_str());
+
+	int cookie;
+
+	{
+		CritLock lock(m_cs);
+		cookie = m_nextCookie++;
+		watch->Cookie = cookie;
+		m_commands.push_back(Command(watch, cookie));
+	}
+
+	m_backend->Wake();
+
+	return cookie;
+}
+
+void MagicFolderWatcher::Unwatch(int cookie)
+{
+	{
+		CritLock lock(m_cs);
+		m_commands.push_back(Command(NULL, cookie));
+	}
+
+	m_backend->Wake();
+}
+
+void MagicFolderWatcher::UnwatchAll()
+{
+	// Cookie 0 stops everything.
+	Unwatch(0);
+}
+
+void MagicFolderWatcher::run(CSSThread* thread)
+{
+	while (thread->GetCanRun())
+	{
+		int cookie(0);
+		DIRECTORY_CHANGES notifications;
+		DirectoryWatchBackend::EWaitResult result = m_backend->Wait(cookie, notifications);
+
+		if (result == DirectoryWatchBackend::wrClosed)
+		{
+			break;
+		}
+
+		if (result == DirectoryWatchBackend::wrWoken)
+		{
+			// Woken up to run commands, or to stop.
+			runCommands();
+			continue;
+		}
+
+		WATCH_MAP::iterator w = m_watches.find(cookie);
+		if (w == m_watches.end())
+		{
+			continue;
+		}
+
+		DirectoryWatch* watch = (*w).second;
+
+		switch (result)
+		{
+		case DirectoryWatchBackend::wrChanges:
+			{
+				MagicFolderChangeBatch* batch = new MagicFolderChangeBatch(watch->Folder, watch->Cookie);
+				watch->Changes.Collect(notifications, batch->Changes);
+
+				if (batch->Changes.size())
+				{
+					post(batch);
+				}
+				else
+				{
+					delete batch;
+				}
+			}
+			break;
+
+		case DirectoryWatchBackend::wrOverflow:
+			rescan(watch);
+			break;
+
+		case DirectoryWatchBackend::wrFailed:
+			// The directory has probably gone, let the folder be read again
+			// and stop watching it.
+			rescan(watch);
+			stop(watch);
+			break;
+		}
+	}
+
+	while (!m_watches.empty())
+	{
+		stop((*m_watches.begin()).second);
+	}
+}
+
+void MagicFolderWatcher::runCommands()
+{
+	std::deque<Command> commands;
+
+	{
+		CritLock lock(m_cs);
+		commands.swap(m_commands);
+	}
+
+	for (std::deque<Command>::const_iterator i = commands.begin(); i != commands.end(); ++i)
+	{
+		if ((*i).Watch != NULL)
+		{
+			start((*i).Watch);
+		}
+		else if ((*i).Cookie == 0)
+		{
+			while (!m_watches.empty())
+			{
+				stop((*m_watches.begin()).second);
+			}
+		}
+		else
+		{
+			WATCH_MAP::iterator w = m_watches.find((*i).Cookie);
+			if (w != m_watches.end())
+			{
+				stop((*w).second);
+			}
+		}
+	}
+}
+
+void MagicFolderWatcher::start(DirectoryWatch* watch)
+{
+	if (!m_backend->Start(watch->Changes.GetPath(), watch->Cookie))
+	{
+		delete watch;
+		return;
+	}
+
+	m_watches.insert(WATCH_MAP::value_type(watch->Cookie, watch));
+}
+
+void MagicFolderWatcher::stop(DirectoryWatch* watch)
+{
+	m_watches.erase(watch->Cookie);
+	m_backend->Stop(watch->Cookie);
+	delete watch;
+}
+
+/**
+ * We don't know what changed, have the whole folder read again.
+ */
+void MagicFolderWatcher::rescan(DirectoryWatch* watch)
+{
+	MagicFolderChangeBatch* batch = new MagicFolderChangeBatch(watch->Folder, watch->Cookie);
+	batch->Rescan = true;
+	post(batch);
+}
+
+void MagicFolderWatcher::post(MagicFolderChangeBatch* batch)
+{
+	if (!::PostMessage(m_target, PN_MAGICFOLDERCHANGES, 0, reinterpret_cast<LPARAM>(batch)))
+	{
+		delete batch;
+	}
+}
@@ -0,0 +1,102 @@
+/**
+ * @file magicfolderwatcher.h
+ * @brief Watch magic folder directories for changes.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef magicfolderwatcher_h__included
+#define magicfolderwatcher_h__included
+
+#include "include/ssthreads.h"
+#include "include/threading.h"
+#include "magicfolderchanges.h"
+
+#include <deque>
+#include <map>
+
+namespace Projects
+{
+
+/**
+ * Changes to a watched magic folder, posted to the target window as the
+ * LPARAM of a PN_MAGICFOLDERCHANGES message. The receiver owns the batch
+ * and must delete it.
+ */
+class MagicFolderChangeBatch
+{
+	public:
+		MagicFolderChangeBatch(MagicFolder* folder, int cookie) : Folder(folder), Cookie(cookie), Rescan(false) {}
+
+		/// Folder being watched, only valid if Cookie is still current
+		MagicFolder* Folder;
+		int Cookie;
+		MAGICFOLDER_CHANGES Changes;
+		/// Changes were lost, the whole folder must be read again
+		bool Rescan;
+};
+
+/**
+ * Watches the directory trees of top-level magic folders for changes on a
+ * worker thread using a DirectoryWatchBackend, and posts the changes that
+ * pass each folder's filters back to a window. Like MagicFolderLoader, the
+ * worker never touches the project objects.
+ */
+class MagicFolderWatcher
+{
+	public:
+		explicit MagicFolderWatcher(HWND target);
+		~MagicFolderWatcher();
+
+		/**
+		 * Start watching folder's directory and everything below it with its
+		 * current path and filters.
+		 * @returns cookie identifying this watch in MagicFolderChangeBatch
+		 */
+		int Watch(MagicFolder* folder);
+
+		/**
+		 * Stop a watch, batches already posted must be discarded by the receiver.
+		 */
+		void Unwatch(int cookie);
+
+		void UnwatchAll();
+
+	private:
+		class DirectoryWatch;
+
+		class Command
+		{
+			public:
+				Command(DirectoryWatch* watch, int cookie) : Watch(watch), Cookie(cookie) {}
+
+				/// Watch to start, or NULL to stop the watch for Cookie
+				DirectoryWatch* Watch;
+				int Cookie;
+		};
+
+		typedef std::map<int, DirectoryWatch*> WATCH_MAP;
+
+		void run(CSSThread* thread);
+		void runCommands();
+		void start(DirectoryWatch* watch);
+		void stop(DirectoryWatch* watch);
+		void rescan(DirectoryWatch* watch);
+		void post(MagicFolderChangeBatch* batch);
+
+		HWND m_target;
+		DirectoryWatchBackend* m_backend;
+		int m_nextCookie;
+		std::deque<Command> m_commands;
+		/// Only used on the worker thread
+		WATCH_MAP m_watches;
+		pnutils::threading::CriticalSection m_cs;
+		CSSThreadT<MagicFolderWatcher> m_thread;
+};
+
+} // namespace Projects
+
+#endif // #ifndef magicfolderwatcher_h__included
@@ -20,12 +20,15 @@
 #include "workspacestate.h"		// Save Workspace State
 #include "ScriptRegistry.h"		// Scripts Registry
 #include "findinfiles.h"		// Find in Files
+#include "batchexport.h"		// Batch HTML/RTF export
 #include "project.h"			// Projects
 #include "projectprops.h"		// Project Properties
 #include "textclips.h"			// Text Clips
 #include "textclips/clipmanager.h" // Text Clips Manager
 #include "SchemeConfig.h"		// Scheme Configuration
 #include "projectholder.h"
+#include "projectsaver.h"
+#include "magicfolderloader.h"
 #include "version.h"
 #include "updatecheck.h"
 #include "singleinstance.h"
@@ -139,6 +142,8 @@ EditorFactory& CMainFrame::GetFactory()
 
 bool CMainFrame::OpenFile(LPCTSTR pathname, Scheme* pScheme, EPNEncoding encoding)
 {
+	PNTRACE_SPAN("file", "CMainFrame::OpenFile");
+
 	DocumentList docs;
 	this->GetOpenDocuments(docs);
 	if (docs.size() == 1)
@@ -420,6 +425,20 @@ BOOL CMainFrame::OnIdle()
 		{
 			bChild = true;
 			bCanSave = pChild->GetModified();
+
+			// The first word count of a document is left until now, and done a
+			// piece at a time:
+			CTextView* pView = pChild->GetTextView();
+			if(pView->CountTextStats())
+			{
+				UpdateStatusBar();
+			}
+			else if(!pView->HaveTextStats())
+			{
+				// WTL only calls OnIdle again after another message, this one
+				// waits behind any input that's queued up:
+				PostMessage(WM_NULL);
+			}
 		}
 	}
 	else
@@ -592,6 +611,17 @@ LRESULT CMainFrame::OnClose(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/,
 
 		FindInFiles::GetInstance()->Stop();
 
+		if(BatchExport::HasInstance())
+			BatchExport::GetInstance()->Stop();
+
+		// Projects saved on the way out still get to report failures:
+		if(Projects::ProjectSaver::HasInstance())
+		{
+			Projects::ProjectSaver::GetInstance()->WaitAll();
+			handleProjectSaveFailures();
+			Projects::ProjectSaver::GetInstance()->SetNotifyWindow(NULL, 0);
+		}
+
 		::ImageList_Destroy( m_hILMain );
 		::ImageList_Destroy( m_hILMainD );
 
@@ -903,7 +933,7 @@ LRESULT CMainFrame::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/
 
 	m_StatusBar.SubclassWindow(m_hWndStatusBar);
 	m_StatusBar.SetPanes(statusBarPanes, sizeof(statusBarPanes) / sizeof(int), false);
-	m_StatusBar.SetPaneWidth(ID_POS_PANE, 120);
+	m_StatusBar.SetPaneWidth(ID_POS_PANE, 190);
 	m_StatusBar.SetPaneWidth(ID_MOD_PANE, 70);
 	m_StatusBar.SetPaneWidth(ID_ENC_PANE, 70);
 	m_StatusBar.SetPaneWidth(ID_LINEENDS_PANE, 50);
@@ -985,9 +1015,26 @@ LRESULT CMainFrame::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/
 
 	setupToolsUI();
 
+	//////////////////////////////////////////////////////////////
+	// Text Clips:
+
+	// Bring the parsed clips cache up to date in the background, so
+	// the first clip expansion for each scheme doesn't parse XML.
+	tstring clipsPath, userClipsPath, clipCacheFile;
+	OPTIONS->GetPNPath(clipsPath, PNPATH_CLIPS);
+	OPTIONS->GetPNPath(userClipsPath, PNPATH_USERCLIPS);
+	OPTIONS->GetPNPath(clipCacheFile, PNPATH_USERSETTINGS);
+	clipCacheFile += _T("clips.cache");
+
+	TextClips::ClipSetCachePtr clipCache(new TextClips::ClipSetCache(clipCacheFile.c_str()));
+	m_pTextClips->SetCache(clipCache);
+	clipCache->WarmAsync(clipsPath.c_str(), userClipsPath.c_str());
+
 	// Load extensions...
 	g_Context.ExtApp->LoadExtensions();
 
+	Projects::ProjectSaver::GetInstance()->SetNotifyWindow(m_hWnd, PN_PROJECTSAVEFAILED);
+
 	DragAcceptFiles(TRUE);
 
 	PostMessage(PN_INITIALISEFRAME);
@@ -1764,6 +1811,21 @@ LRESULT CMainFrame::OnCloseAllOther(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lPara
 	return 0;
 }
 
+/**
+ * A tool has finished, start any that were waiting for it.
+ */
+LRESULT CMainFrame::OnRunQueuedTools(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	ToolOwner::GetInstance()->RunQueuedTools();
+	return 0;
+}
+
+LRESULT CMainFrame::OnProjectSaveFailed(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	handleProjectSaveFailures();
+	return 0;
+}
+
 /**
  * Called when the system is shutting down or the user is being logged off. Return
  * zero to prevent shutdown. We ask the user to save any modified files, and only if they
@@ -1956,6 +2018,25 @@ LRESULT CMainFrame::OnStopTools(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndC
 	return 0;
 }
 
+/**
+ * Next or previous error in the current document's own output if it's showing,
+ * otherwise in the main output window.
+ */
+LRESULT CMainFrame::OnNextError(WORD /*wNotifyCode*/, WORD wID, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	COutputView* pOutput = m_pOutputWnd;
+
+	CChildFrame* pChild = CChildFrame::FromHandle(GetCurrentEditor());
+	if(pChild != NULL && pChild->IsOutputVisible())
+	{
+		pOutput = pChild->GetOutputWindow();
+	}
+
+	pOutput->GoToError(wID == ID_OUTPUT_NEXTERROR);
+
+	return 0;
+}
+
 /**
  * User wants to record a script/macro, we delegate to any registered instance of extensions::IRecorder
  */
@@ -2300,9 +2381,6 @@ void CMainFrame::FindInFiles(SearchOptions* options)
 	case extensions::fifActiveProjectFiles:
 		{
 			FindInFiles::GetInstance()->Stop();
-			
-			FileItPtr pIterable(new StringListIterator());
-			StringListIterator* files = static_cast<StringListIterator*>(pIterable.get());
 
 			Projects::Workspace* pAW = g_Context.m_frame->GetActiveWorkspace();
 			if(pAW)
@@ -2310,29 +2388,24 @@ void CMainFrame::FindInFiles(SearchOptions* options)
 				Projects::Project* pAP = pAW->GetActiveProject();
 				if(pAP)
 				{
-					pAP->GetAllFiles(files->GetList());
-					
-					// Remove any modified documents (we need to do this differently)
+					// Skip any modified documents (we need to do this differently)
+					std::unordered_set<tstring> modified;
 					DocumentList list;
 					g_Context.m_frame->GetOpenDocuments(list);
 					for(DocumentList::const_iterator i = list.begin();
 						i != list.end();
 						++i)
 					{ 
-						tstring cfn1 = (*i)->GetFileName();
-						for(std::vector<tstring>::iterator k = files->GetList().begin();
-							k != files->GetList().end();
-							++k)
+						if ((*i)->GetFrame()->GetModified())
 						{
-							if (cfn1 == (*k) && (*i)->GetFrame()->GetModified())
-							{
-								k = files->GetList().erase(k);
-								break;
-							}
+							modified.insert((*i)->GetFileName());
 						}
 					}
 
-					// Start the search
+					// Magic folders that haven't been read yet are listed by the
+					// search thread as it gets to them:
+					FileItPtr pIterable(new Projects::ProjectFileIterator(pAP, modified));
+
 					FindInFiles::GetInstance()->Start(
 						options->GetFindText(),
 						pIterable,
@@ -3138,6 +3211,48 @@ DWORD CMainFrame::SaveWorkspace(Projects::Workspace* pWorkspace)
 	return IDOK;
 }
 
+/**
+ * Project files are written in the background and marked clean when they're
+ * queued. Anything that then failed to write is made dirty again, so that
+ * it's saved or asked about later, and the user is told.
+ */
+void CMainFrame::handleProjectSaveFailures()
+{
+	std::vector<tstring> failed;
+	Projects::ProjectSaver::GetInstance()->TakeFailures(failed);
+
+	for(std::vector<tstring>::const_iterator i = failed.begin(); i != failed.end(); ++i)
+	{
+		LPCTSTR filename = (*i).c_str();
+		bool bProjectFile = false;
+
+		Projects::Workspace* workspace = GetActiveWorkspace();
+		if(workspace != NULL)
+		{
+			if(_tcsicmp(workspace->GetFileName(), filename) == 0)
+			{
+				workspace->SetDirty();
+				bProjectFile = true;
+			}
+
+			Projects::PROJECT_LIST projects = workspace->GetProjects();
+			for(Projects::PL_CIT j = projects.begin(); j != projects.end(); ++j)
+			{
+				if(_tcsicmp((*j)->GetFileName().c_str(), filename) == 0)
+				{
+					(*j)->SetDirty();
+					bProjectFile = true;
+				}
+			}
+		}
+
+		// Anything else is a project's view state:
+		tstring msg(bProjectFile ? _T("Could not open the project file for writing: ") : _T("Could not open the project data file for writing: "));
+		msg += filename;
+		UNEXPECTED(msg.c_str());
+	}
+}
+
 bool CMainFrame::SaveProjects(Projects::Workspace* pWorkspace)
 {
 	// It's not a real workspace, just a holder for a 
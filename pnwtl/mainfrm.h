@@ -124,6 +124,8 @@ public:
 		MESSAGE_HANDLER(PN_MDISETMENU, OnMDISetMenu)
 		MESSAGE_HANDLER(PN_UPDATECHILDUI, OnUpdateChildUIState)
 		MESSAGE_HANDLER(PN_CLOSEALLOTHER, OnCloseAllOther)
+		MESSAGE_HANDLER(PN_RUNQUEUEDTOOLS, OnRunQueuedTools)
+		MESSAGE_HANDLER(PN_PROJECTSAVEFAILED, OnProjectSaveFailed)
 		MESSAGE_HANDLER(WM_QUERYENDSESSION, OnQueryEndSession)
 		MESSAGE_HANDLER(WM_ENDSESSION, OnEndSession)
 		
@@ -161,6 +163,8 @@ public:
 		COMMAND_ID_HANDLER(ID_TOOLS_OPTIONS, OnOptions)
 		COMMAND_ID_HANDLER(ID_TOOLS_DUMMY, OnOptions)
 		COMMAND_ID_HANDLER(ID_TOOLS_STOPTOOLS, OnStopTools)
+		COMMAND_ID_HANDLER(ID_OUTPUT_NEXTERROR, OnNextError)
+		COMMAND_ID_HANDLER(ID_OUTPUT_PREVIOUSERROR, OnNextError)
 		COMMAND_ID_HANDLER(ID_TOOLS_RECORDSCRIPT, OnRecordScript)
 		COMMAND_ID_HANDLER(ID_TOOLS_STOPRECORDING, OnStopRecording)
 		COMMAND_ID_HANDLER(ID_HELP_WEB_PN, OnWebPNHome)
@@ -264,6 +268,8 @@ public:
 	LRESULT OnMDISetMenu(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 	LRESULT OnUpdateChildUIState(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 	LRESULT OnCloseAllOther(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT OnRunQueuedTools(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT OnProjectSaveFailed(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 	LRESULT OnQueryEndSession(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 	LRESULT OnEndSession(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
     
@@ -310,6 +316,7 @@ public:
 	LRESULT OnFindInFiles(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnOptions(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnStopTools(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+	LRESULT OnNextError(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnRecordScript(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnStopRecording(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 
@@ -432,6 +439,7 @@ private:
 	bool CloseWorkspaceFiles(Projects::Workspace* pWorkspace);
 	bool EnumWorkspaceWindows(SWorkspaceWindowsStruct* pWWS);
 	bool CheckSaveWorkspace();
+	void handleProjectSaveFailures();
 	
 	bool closeAll(bool shuttingDown);
 
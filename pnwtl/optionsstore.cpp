@@ -0,0 +1,354 @@
+/**
+ * @file optionsstore.cpp
+ * @brief Option values by group and name, looked up without allocating.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "optionsstore.h"
+
+#include <algorithm>
+
+namespace {
+
+const size_t InitialBuckets = 256;
+
+/**
+ * FNV-1a over the characters of group, a dot and name; name may be NULL
+ * when group is already the whole key.
+ */
+size_t hashKey(LPCTSTR group, LPCTSTR name)
+{
+	size_t hash = 2166136261U;
+
+	for (LPCTSTR p = group; *p; ++p)
+	{
+		hash = (hash ^ static_cast<size_t>(*p)) * 16777619U;
+	}
+
+	if (name != NULL)
+	{
+		hash = (hash ^ static_cast<size_t>(_T('.'))) * 16777619U;
+
+		for (LPCTSTR p = name; *p; ++p)
+		{
+			hash = (hash ^ static_cast<size_t>(*p)) * 16777619U;
+		}
+	}
+
+	return hash;
+}
+
+bool keyEquals(const tstring& key, LPCTSTR group, LPCTSTR name)
+{
+	LPCTSTR k = key.c_str();
+
+	for (; *group; ++group, ++k)
+	{
+		if (*k != *group)
+		{
+			return false;
+		}
+	}
+
+	if (name != NULL)
+	{
+		if (*k++ != _T('.'))
+		{
+			return false;
+		}
+
+		for (; *name; ++name, ++k)
+		{
+			if (*k != *name)
+			{
+				return false;
+			}
+		}
+	}
+
+	return *k == 0;
+}
+
+template <typename T>
+void formatUnsigned(T value, tstring& text)
+{
+	TCHAR buf[24];
+	TCHAR* p = buf + 24;
+
+	do
+	{
+		*--p = static_cast<TCHAR>(_T('0') + (value % 10));
+		value /= 10;
+	}
+	while (value != 0);
+
+	text.append(p, buf + 24);
+}
+
+class HandleKeyLess
+{
+public:
+	HandleKeyLess(const OptionsStore& store) : m_store(store) {}
+
+	bool operator()(OptionsStore::Handle a, OptionsStore::Handle b) const
+	{
+		return m_store.GetKey(a) < m_store.GetKey(b);
+	}
+
+private:
+	const OptionsStore& m_store;
+};
+
+} // namespace
+
+const OptionsStore::Handle OptionsStore::NoHandle = static_cast<size_t>(-1);
+
+OptionsStore::OptionsStore()
+{
+	rehash(InitialBuckets);
+}
+
+OptionsStore::Handle OptionsStore::Find(LPCTSTR group, LPCTSTR name) const
+{
+	return find(hashKey(group, name), group, name);
+}
+
+OptionsStore::Handle OptionsStore::Intern(LPCTSTR group, LPCTSTR name)
+{
+	size_t hash = hashKey(group, name);
+	Handle handle = find(hash, group, name);
+	if (handle != NoHandle)
+	{
+		return handle;
+	}
+
+	tstring key(group);
+	key += _T('.');
+	key += name;
+
+	return add(key, hash);
+}
+
+void OptionsStore::Load(const tstring& key, const tstring& value)
+{
+	size_t hash = hashKey(key.c_str(), NULL);
+	Handle handle = find(hash, key.c_str(), NULL);
+	if (handle == NoHandle)
+	{
+		handle = add(key, hash);
+	}
+
+	if (!m_entries[handle].HasValue)
+	{
+		setValue(m_entries[handle], value);
+	}
+}
+
+bool OptionsStore::HasValue(Handle handle) const
+{
+	return m_entries[handle].HasValue;
+}
+
+const tstring& OptionsStore::GetKey(Handle handle) const
+{
+	return m_entries[handle].Key;
+}
+
+const tstring& OptionsStore::GetString(Handle handle) const
+{
+	return m_entries[handle].Value;
+}
+
+int OptionsStore::GetInt(Handle handle) const
+{
+	const Entry& entry = m_entries[handle];
+	if ((entry.Cached & cachedInt) == 0)
+	{
+		entry.Int = _ttoi(entry.Value.c_str());
+		entry.Cached |= cachedInt;
+	}
+
+	return entry.Int;
+}
+
+uint64_t OptionsStore::GetUInt64(Handle handle) const
+{
+	const Entry& entry = m_entries[handle];
+	if ((entry.Cached & cachedUInt64) == 0)
+	{
+		TCHAR* end(NULL);
+		entry.UInt64 = _tcstoui64(entry.Value.c_str(), &end, 10);
+		entry.Cached |= cachedUInt64;
+	}
+
+	return entry.UInt64;
+}
+
+bool OptionsStore::GetBool(Handle handle) const
+{
+	const Entry& entry = m_entries[handle];
+	if ((entry.Cached & cachedBool) == 0)
+	{
+		entry.Bool = entry.Value.size() && (entry.Value[0] == _T('t') || entry.Value[0] == _T('T'));
+		entry.Cached |= cachedBool;
+	}
+
+	return entry.Bool;
+}
+
+void OptionsStore::Set(Handle handle, LPCTSTR value)
+{
+	Entry& entry = m_entries[handle];
+	if (entry.HasValue && entry.Value == value)
+	{
+		return;
+	}
+
+	entry.Value = value;
+	entry.HasValue = true;
+	entry.Cached = 0;
+}
+
+void OptionsStore::Set(Handle handle, int value)
+{
+	Entry& entry = m_entries[handle];
+	entry.Value.clear();
+
+	if (value < 0)
+	{
+		entry.Value += _T('-');
+		formatUnsigned(0U - static_cast<unsigned int>(value), entry.Value);
+	}
+	else
+	{
+		formatUnsigned(static_cast<unsigned int>(value), entry.Value);
+	}
+
+	entry.HasValue = true;
+	entry.Int = value;
+	entry.Cached = cachedInt;
+}
+
+void OptionsStore::Set(Handle handle, uint64_t value)
+{
+	Entry& entry = m_entries[handle];
+	entry.Value.clear();
+	formatUnsigned(value, entry.Value);
+
+	entry.HasValue = true;
+	entry.UInt64 = value;
+	entry.Cached = cachedUInt64;
+}
+
+void OptionsStore::Set(Handle handle, bool value)
+{
+	Entry& entry = m_entries[handle];
+	entry.Value = value ? _T("true") : _T("false");
+
+	entry.HasValue = true;
+	entry.Bool = value;
+	entry.Cached = cachedBool;
+}
+
+size_t OptionsStore::Size() const
+{
+	return m_entries.size();
+}
+
+void OptionsStore::GetSorted(std::vector<Handle>& handles) const
+{
+	handles.clear();
+
+	for (Handle i = 0; i < m_entries.size(); ++i)
+	{
+		if (m_entries[i].HasValue)
+		{
+			handles.push_back(i);
+		}
+	}
+
+	std::sort(handles.begin(), handles.end(), HandleKeyLess(*this));
+}
+
+void OptionsStore::Clear()
+{
+	m_entries.clear();
+	rehash(InitialBuckets);
+}
+
+OptionsStore::Handle OptionsStore::find(size_t hash, LPCTSTR group, LPCTSTR name) const
+{
+	size_t mask = m_buckets.size() - 1;
+
+	for (size_t i = hash & mask; m_buckets[i] != NoHandle; i = (i + 1) & mask)
+	{
+		const Entry& entry = m_entries[m_buckets[i]];
+		if (entry.Hash == hash && keyEquals(entry.Key, group, name))
+		{
+			return m_buckets[i];
+		}
+	}
+
+	return NoHandle;
+}
+
+OptionsStore::Handle OptionsStore::add(const tstring& key, size_t hash)
+{
+	// Keep the table at most half full so that probe sequences stay short:
+	if ((m_entries.size() + 1) * 2 > m_buckets.size())
+	{
+		rehash(m_buckets.size() * 2);
+	}
+
+	Handle handle = m_entries.size();
+
+	m_entries.push_back(Entry());
+	Entry& entry = m_entries.back();
+	entry.Key = key;
+	entry.Hash = hash;
+	entry.HasValue = false;
+	entry.Cached = 0;
+	entry.Int = 0;
+	entry.UInt64 = 0;
+	entry.Bool = false;
+
+	size_t mask = m_buckets.size() - 1;
+	size_t i = hash & mask;
+	while (m_buckets[i] != NoHandle)
+	{
+		i = (i + 1) & mask;
+	}
+
+	m_buckets[i] = handle;
+
+	return handle;
+}
+
+void OptionsStore::setValue(Entry& entry, const tstring& value)
+{
+	entry.Value = value;
+	entry.HasValue = true;
+	entry.Cached = 0;
+}
+
+void OptionsStore::rehash(size_t buckets)
+{
+	m_buckets.assign(buckets, NoHandle);
+
+	size_t mask = buckets - 1;
+	for (Handle handle = 0; handle < m_entries.size(); ++handle)
+	{
+		size_t i = m_entries[handle].Hash & mask;
+		while (m_buckets[i] != NoHandle)
+		{
+			i = (i + 1) & mask;
+		}
+
+		m_buckets[i] = handle;
+	}
+}
@@ -0,0 +1,108 @@
+/**
+ * @file optionsstore.h
+ * @brief Option values by group and name, looked up without allocating.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef optionsstore_h__included
+#define optionsstore_h__included
+
+#include <vector>
+
+/**
+ * Option values keyed by "group.name". Each key is interned the first time
+ * it's seen and gets a handle that stays valid until Clear, so looking an
+ * option up hashes and compares the group and name in place rather than
+ * building the key. The last number or boolean read from each value is
+ * kept, so reading the same option again doesn't parse it again.
+ */
+class OptionsStore
+{
+	public:
+		typedef size_t Handle;
+		static const Handle NoHandle;
+
+		OptionsStore();
+
+		/**
+		 * @return handle for the key, or NoHandle if it has never been seen
+		 */
+		Handle Find(LPCTSTR group, LPCTSTR name) const;
+
+		/**
+		 * @return handle for the key, adding it without a value if it's new
+		 */
+		Handle Intern(LPCTSTR group, LPCTSTR name);
+
+		/**
+		 * Add a value read from storage. The first value for a key is kept.
+		 */
+		void Load(const tstring& key, const tstring& value);
+
+		bool HasValue(Handle handle) const;
+
+		const tstring& GetKey(Handle handle) const;
+		const tstring& GetString(Handle handle) const;
+		int GetInt(Handle handle) const;
+		uint64_t GetUInt64(Handle handle) const;
+
+		/**
+		 * Values starting with t or T are true.
+		 */
+		bool GetBool(Handle handle) const;
+
+		void Set(Handle handle, LPCTSTR value);
+		void Set(Handle handle, int value);
+		void Set(Handle handle, uint64_t value);
+		void Set(Handle handle, bool value);
+
+		/**
+		 * @return one more than the largest handle
+		 */
+		size_t Size() const;
+
+		/**
+		 * Handles of the keys that have values, sorted by key.
+		 */
+		void GetSorted(std::vector<Handle>& handles) const;
+
+		void Clear();
+
+	private:
+		enum ECached
+		{
+			cachedInt = 1,
+			cachedUInt64 = 2,
+			cachedBool = 4
+		};
+
+		class Entry
+		{
+			public:
+				tstring Key;
+				size_t Hash;
+				tstring Value;
+				bool HasValue;
+
+				/// Which of the typed values below match Value
+				mutable unsigned int Cached;
+				mutable int Int;
+				mutable uint64_t UInt64;
+				mutable bool Bool;
+		};
+
+		Handle find(size_t hash, LPCTSTR group, LPCTSTR name) const;
+		Handle add(const tstring& key, size_t hash);
+		void setValue(Entry& entry, const tstring& value);
+		void rehash(size_t buckets);
+
+		std::vector<Entry> m_entries;
+		/// Open addressing index into m_entries, the size is a power of two
+		std::vector<Handle> m_buckets;
+};
+
+#endif // #ifndef optionsstore_h__included
@@ -17,12 +17,33 @@
 #include "scaccessor.h"
 #include "project.h"
 
+using pnutils::threading::CritLock;
+
+/// Characters of tool output that can be waiting for the UI thread
+#define OUTPUT_BUFFER_SIZE		(1024 * 1024)
+/// Don't add output to the view more often than this, about once a frame
+#define OUTPUT_FLUSH_INTERVAL	16
+/// A tool thread waiting for room looks again at least this often
+#define OUTPUT_WRITER_WAIT		50
+/// Scintilla uses timer ids 1 and 2 on its own window
+#define TIMER_FLUSHOUTPUT		0x10
+/// m_currentError before next or previous error has been used
+#define NO_ERROR_SELECTED		static_cast<size_t>(-1)
+
 //////////////////////////////////////////////////////////////////////////////
 // COutputView
 //////////////////////////////////////////////////////////////////////////////
 
 COutputView::COutputView() : 
-	Views::View(Views::vtOutput)
+	Views::View(Views::vtOutput),
+	m_pending(OUTPUT_BUFFER_SIZE),
+	m_drained(true),
+	m_closed(0),
+	m_flushRequested(0),
+	m_lastFlush(0),
+	m_maxLines(0),
+	m_linesTrimmed(0),
+	m_currentError(NO_ERROR_SELECTED)
 {
 	m_bCustom = false;
 }
@@ -89,113 +110,63 @@ bool COutputView::ExpandMatchedPath(CFileName& fn)
 }
 
 /**
- * @brief Uses any regular expression string to try and match an error.
- * @param style - style that the error is displayed in.
- * @param position - position of the character clicked.
- * @param re - Regular Expression object.
+ * @brief Open the file an error refers to and go to its line and column.
  */
-bool COutputView::HandleREError(boost::xpressive::sregex& re, int style, int position)
+bool COutputView::OpenErrorLocation(const ErrorLocation& location)
 {
 	bool bRet = true;
 
-	Scintilla::TextRange tr;
-				
-	ExtendStyleRange(position, style, &tr);
-	std::string buf;
-	buf.resize(tr.chrg.cpMax - tr.chrg.cpMin + 1);
-	tr.lpstrText = &buf[0];
-	GetTextRange(&tr);
-	buf.resize(tr.chrg.cpMax - tr.chrg.cpMin);
-
-	boost::xpressive::smatch match;
-	if( boost::xpressive::regex_search(buf, match, re) )
+	if(location.File.size())
 	{
-		std::string filename;
-		std::string linestr;
-		std::string colstr;
-        
-		// Extract the named matches from the RE, noting if there was a line or column.
-		bool bFile = safe_get_submatch(match, filename, "f");
-		bool bLine = safe_get_submatch(match, linestr, "l");
-		bool bCol = safe_get_submatch(match, colstr, "c");
-
-//#ifdef _DEBUG
-//			tstring dbgout = _T("Matched file (");
-//			dbgout += filename;
-//			dbgout += _T(") line (");
-//			dbgout += linestr;
-//			dbgout += _T(") col (");
-//			dbgout += colstr;
-//			dbgout += _T(")\n");
-//			LOG(dbgout.c_str());
-//#endif
-
-		if(bFile)
+		//First check if the file exists as is, if it does then we go with that,
+		//else we try to resolve it.
+		CA2CT filenameConv(location.File.c_str());
+		CFileName fn(filenameConv);
+		fn.Sanitise();
+
+		if( fn.IsRelativePath() )
 		{
-			//First check if the file exists as is, if it does then we go with that,
-			//else we try to resolve it.
-			CA2CT filenameConv(filename.c_str());
-			CFileName fn(filenameConv);
+			ExpandMatchedPath(fn);
 			fn.Sanitise();
-
-//#ifdef _DEBUG
-//			dbgout = _T("After sanitise, filename = ");
-//			dbgout += fn.c_str();
-//			dbgout += _T("\n");
-//			LOG(dbgout.c_str());
-//#endif
-
-			if( fn.IsRelativePath() )
-			{
-				ExpandMatchedPath(fn);
-				fn.Sanitise();
-			}
-
-			if(FileExists(fn.c_str()))
-			{
-				// If the file's already open, just switch to it, otherwise open it.
-				if( !g_Context.m_frame->CheckAlreadyOpen(fn.c_str(), eSwitch) )
-					g_Context.m_frame->Open(fn.c_str());
-			}
-			else
-			{
-				tstring msg = _T("Could not locate ");
-				msg += filenameConv;
-				msg += _T(". If the file exists, see help under \"Output\" to fix this.");
-				g_Context.m_frame->SetStatusText(msg.c_str());
-				bRet = false;
-			}
 		}
 
-		if(bRet)
+		if(FileExists(fn.c_str()))
+		{
+			// If the file's already open, just switch to it, otherwise open it.
+			if( !g_Context.m_frame->CheckAlreadyOpen(fn.c_str(), eSwitch) )
+				g_Context.m_frame->Open(fn.c_str());
+		}
+		else
 		{
-			CChildFrame* pWnd = CChildFrame::FromHandle(GetCurrentEditor());
-			CTextView* pView = pWnd->GetTextView();
+			tstring msg = _T("Could not locate ");
+			msg += filenameConv;
+			msg += _T(". If the file exists, see help under \"Output\" to fix this.");
+			g_Context.m_frame->SetStatusText(msg.c_str());
+			bRet = false;
+		}
+	}
 
-			if( bLine )
-			{
-				int line = atoi(linestr.c_str());
+	if(bRet)
+	{
+		CChildFrame* pWnd = CChildFrame::FromHandle(GetCurrentEditor());
+		CTextView* pView = pWnd->GetTextView();
 
-				if(pView)
+		if( location.Line > 0 )
+		{
+			if(pView)
+			{
+				pView->GotoLine(location.Line - 1);
+				
+				if( location.Column > 0 )
 				{
-					pView->GotoLine(line-1);
-					
-					if( bCol )
-					{
-						long lPos = pView->GetCurrentPos();
-						long column = atol(colstr.c_str());
-						lPos += column;
-						pView->SetCurrentPos(lPos);
-					}
+					long lPos = pView->GetCurrentPos();
+					lPos += location.Column;
+					pView->SetCurrentPos(lPos);
 				}
 			}
-
-			::SetFocus(pView->m_hWnd);
 		}
-	}
-	else
-	{
-		bRet = false;
+
+		::SetFocus(pView->m_hWnd);
 	}
 
 	return bRet;
@@ -209,26 +180,8 @@ bool COutputView::LocateInProjects(LPCTSTR part, tstring& full)
 	Projects::Workspace* pWs = g_Context.m_frame->GetActiveWorkspace();
 	if(pWs)
 	{
-		// Try the active project first.
-		Projects::Project* pActive = pWs->GetActiveProject();
-		Projects::File* pFile = pActive->FindRelativeFile(part);
-
-		// If we didn't find it in the active project, look in the rest.
-		if(!pFile)
-		{
-			for(Projects::PL_CIT i = pWs->GetProjects().begin();
-				i != pWs->GetProjects().end();
-				++i)
-			{
-				// try anything but the active project again.
-				if((*i) != pActive)
-				{
-					pFile = (*i)->FindRelativeFile(part);
-					if(pFile)
-						break;
-				}
-			}
-		}
+		// Prefer a match in the active project, then try the rest.
+		Projects::File* pFile = pWs->FindRelativeFile(part, NULL, pWs->GetActiveProject());
 
 		// if we found one, return the full file name.
 		if(pFile)
@@ -242,148 +195,110 @@ bool COutputView::LocateInProjects(LPCTSTR part, tstring& full)
 }
 
 /**
- * @brief Calls HandleREError with a pre-built regular expression handler.
+ * Handle when a hotspot is clicked.
  */
-void COutputView::HandleCustomError(int style, int position)
+LRESULT COutputView::OnHotSpotClicked(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& /*bHandled*/)
 {
-	HandleREError(*m_pRE, style, position);
-}
+	int style = static_cast<int>(wParam);
+	int position = static_cast<int>(lParam);
 
-/**
- * @brief Builds a regular expression object from reDef and then calls HandleREError.
- */
-bool COutputView::BuildAndHandleREError(int style, int position, const char* reDef)
-{
-	try
+	if(m_bCustom && (style != SCE_CUSTOM_ERROR || !m_customParser.get()))
 	{
-		boost::xpressive::sregex re = boost::xpressive::sregex::compile(std::string(reDef));
-		return HandleREError(re, style, position);
+		return 0;
 	}
-	catch (boost::xpressive::regex_error& ex)
+
+	Scintilla::TextRange tr;
+	ExtendStyleRange(position, style, &tr);
+	std::string buf;
+	buf.resize(tr.chrg.cpMax - tr.chrg.cpMin + 1);
+	tr.lpstrText = &buf[0];
+	GetTextRange(&tr);
+	buf.resize(tr.chrg.cpMax - tr.chrg.cpMin);
+
+	ErrorLocation location;
+	bool bMatched = m_bCustom ?
+		m_customParser->Parse(buf, location) :
+		BuiltInErrorParsers::Get().Parse(style, buf, location);
+
+	if(bMatched)
 	{
-		CA2CT errorMessage(ex.what());
-		::MessageBox(m_hWnd, errorMessage, _T("PN2 - Regular Expression Error"), MB_OK);
+		// Next and previous error carry on from here:
+		size_t index;
+		if(m_errors.FindLine(LineFromPosition(position) + m_linesTrimmed, index))
+		{
+			m_currentError = index;
+		}
+
+		OpenErrorLocation(location);
 	}
 
-	return false;
+	return 0;
 }
 
 /**
- * @brief Parse a simple GCC error string:
- * filename.ext:linenumber: error string/whatever
+ * Go to the next or previous error found in the output, and to where it
+ * says the error is.
  */
-void COutputView::HandleGCCError(int style, int position)
+void COutputView::GoToError(bool bNext)
 {
-	BuildAndHandleREError(style, position, "(?P<f>.+?):(?P<l>[0-9]+):((?P<c>[0-9]+):)? .*");
-}
+	size_t begin, end;
+	m_errors.GetRange(begin, end);
 
-/**
- * @brief Parse a microsoft message string:
- *      filename.ext(line,col): message
- * Derived from: \s%f\(%l,%c\): 
- *
- * Currently tested with NAnt output.
- */
-void COutputView::HandleMSError(int style, int position)
-{
-	BuildAndHandleREError(style, position, "\\s*(?P<f>.+)\\((?P<l>[0-9]+)(,(?P<c>[0-9]+))?\\)\\s*: ");
-}
+	if(begin == end)
+	{
+		g_Context.m_frame->SetStatusText(_T("No errors found in the output."));
+		return;
+	}
 
-/**
- * @brief Parse Borland C++ errors, warnings and resource compiler warnings...
- *
- * Also handle lcc-win32 errors.
- *
- * Error E2034 clippert.cpp 207: message...
- * Warning W8070 clippert.cpp 208: message...
- * Error resources.rc 14 18: message (column line:)
- */
-void COutputView::HandleBorlandCPPError(int style, int position)
-{
-	// Explanation of this RE: http://www.pnotepad.org/devlog/archives/000086.html
-	
-	if( !BuildAndHandleREError(style, position, "(Error|Warning) ((E|W)[0-9]{4} )?(?P<f>.+?) ((?P<c>[0-9]+) )?(?P<l>[0-9]+): .+") )
+	size_t index;
+	if(m_currentError == NO_ERROR_SELECTED || m_currentError < begin || m_currentError >= end)
 	{
-		// Didn't match borland C++, try lcc-win32:
-		BuildAndHandleREError(style, position, "(Error|Warning) (?P<f>.+): (?P<l>[0-9]+) .+");
+		index = bNext ? begin : end - 1;
+	}
+	else if(bNext ? m_currentError + 1 < end : m_currentError > begin)
+	{
+		index = bNext ? m_currentError + 1 : m_currentError - 1;
+	}
+	else
+	{
+		::MessageBeep(MB_OK);
+		return;
 	}
-}
 
-/**
- * @brief Parse perl errors...
- *
- * Perl errors are not anchored to the start of the line, beginning with "at".
- * syntax error at P:\tex\packages\authorindex.pl line 103, near "){"
- * String found where operator expected at P:\tex\packages\authorindex.pl line 110
- * Bareword "AUXFILE" not allowed while "strict subs" in use at P:\tex\packages\authorindex.pl line 100
- *
- * It might be nice in the future to handle the (near "expression") part of 
- * the string - although perhaps un-necessary.
- */
-void COutputView::HandlePerlError(int style, int position)
-{
-	BuildAndHandleREError(style, position, "at (?P<f>.+) line (?P<l>[0-9]+)");
-}
+	ErrorIndex::Entry entry;
+	if(!m_errors.GetEntry(index, entry))
+	{
+		return;
+	}
 
-/**
- * @brief Parse python errors
- * 
- * File "T:\source\ipconfig\ipconfig.py", line 45
- */
-void COutputView::HandlePythonError(int style, int position)
-{
-	BuildAndHandleREError(style, position, "File \"(?P<f>.+)\", line (?P<l>[0-9]+)");
-}
+	m_currentError = index;
 
-/**
- * Handle when a hotspot is clicked.
- */
-LRESULT COutputView::OnHotSpotClicked(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, BOOL& /*bHandled*/)
-{
-	if(!m_bCustom)
-	{
-		switch(wParam)
-		{
-			case SCE_ERR_PYTHON:
-			{
-				HandlePythonError(wParam, lParam);
-			}
-			break;
+	int line = entry.OutputLine - m_linesTrimmed;
+	EnsureVisibleEnforcePolicy(line);
+	SetSel(PositionFromLine(line), GetLineEndPosition(line));
 
-			case SCE_ERR_GCC:
-			{
-				HandleGCCError(wParam, lParam);
-			}
-			break;
+	OpenErrorLocation(entry.Location);
 
-			case SCE_ERR_MS:
-			{
-				HandleMSError(wParam, lParam);
-			}
-			break;
+	updateErrorStatus();
+}
 
-			case SCE_ERR_BORLAND: // Borland C++
-			{
-				HandleBorlandCPPError(wParam, lParam);
-			}
-			break;
+void COutputView::updateErrorStatus()
+{
+	size_t begin, end;
+	m_errors.GetRange(begin, end);
 
-			case SCE_ERR_PERL:
-			{
-				HandlePerlError(wParam, lParam);
-			}
-			break;
-		}
+	TCHAR buffer[100];
+	if(m_currentError != NO_ERROR_SELECTED && m_currentError >= begin && m_currentError < end)
+	{
+		_sntprintf(buffer, 100, _T("Error %d of %d in the output."), static_cast<int>(m_currentError - begin + 1), static_cast<int>(end - begin));
 	}
 	else
 	{
-		if( wParam == 20 )
-		{
-			HandleCustomError(wParam, lParam);
-		}
+		_sntprintf(buffer, 100, _T("%d errors found in the output."), static_cast<int>(end - begin));
 	}
 
-	return 0;
+	buffer[99] = NULL;
+	g_Context.m_frame->SetStatusText(buffer);
 }
 
 /**
@@ -422,6 +337,10 @@ void COutputView::SafeAppendText(LPCSTR s, int len, bool bScrollToView)
 		len = strlen(s);
 	SendMessage(SCI_APPENDTEXT, len, reinterpret_cast<LPARAM>(s));
 
+	m_errors.Add(s, len);
+
+	trimOutput();
+
 	if(bScrollToView)
 	{
 		int line = SendMessage(SCI_GETLENGTH, 0, 0);
@@ -431,17 +350,128 @@ void COutputView::SafeAppendText(LPCSTR s, int len, bool bScrollToView)
 	}
 }
 
+/**
+ * Called on tool threads as well as the UI thread. The output is only queued
+ * here, the UI thread adds everything queued since the last time in one go.
+ * When the queue is full a tool thread waits for the UI thread to empty it,
+ * so a tool producing output faster than it can be shown is slowed down
+ * rather than losing any.
+ */
 void COutputView::AddToolOutput(LPCTSTR output, int nLength)
 {
-	// TODO: Argh, the inefficiency...
 	if (nLength == -1)
 	{
 		nLength = _tcslen(output);
 	}
 
-	tstring opconv(output, nLength);
-	CT2CA outputconv(opconv.c_str());
-	SafeAppendText(outputconv, -1);
+	if (nLength == 0)
+	{
+		return;
+	}
+
+	while (nLength > 0)
+	{
+		// More than the queue holds goes in pieces:
+		int piece = min(nLength, static_cast<int>(m_pending.Capacity()));
+
+		// Reset before trying, so a flush after a failed write still wakes us:
+		m_drained.Reset();
+
+		bool written;
+		{
+			CritLock lock(m_pendingWriters);
+			written = m_pending.Write(output, piece);
+		}
+
+		if (written)
+		{
+			output += piece;
+			nLength -= piece;
+			continue;
+		}
+
+		if (::IsWindow(m_hWnd) && ::GetWindowThreadProcessId(m_hWnd, NULL) == ::GetCurrentThreadId())
+		{
+			// We're the reader, so we can make room rather than wait for ourselves:
+			flushOutput();
+			tstring text(output, nLength);
+			CT2CA outputconv(text.c_str());
+			SafeAppendText(outputconv, -1);
+			return;
+		}
+
+		if (m_closed)
+		{
+			// Nothing is left to show it:
+			return;
+		}
+
+		requestFlush();
+		m_drained.Wait(OUTPUT_WRITER_WAIT);
+	}
+
+	requestFlush();
+}
+
+/**
+ * Ask the UI thread to flush, unless it's already been asked.
+ */
+void COutputView::requestFlush()
+{
+	if (::InterlockedExchange(&m_flushRequested, 1) == 0 && ::IsWindow(m_hWnd))
+	{
+		PostMessage(PN_FLUSHOUTPUT);
+	}
+}
+
+/**
+ * UI thread: add all queued output to the view with a single conversion,
+ * append and scroll.
+ */
+void COutputView::flushOutput()
+{
+	// Output queued from now on needs another flush:
+	::InterlockedExchange(&m_flushRequested, 0);
+	m_lastFlush = ::GetTickCount();
+
+	m_flushBuffer.clear();
+	m_pending.ReadAll(m_flushBuffer);
+
+	// Let any tool thread waiting for room carry on:
+	m_drained.Set();
+
+	if (m_flushBuffer.size())
+	{
+		CT2CA outputconv(m_flushBuffer.c_str());
+		SafeAppendText(outputconv, -1);
+	}
+}
+
+/**
+ * Remove the oldest lines if there are more than the configured maximum.
+ */
+void COutputView::trimOutput()
+{
+	if (m_maxLines <= 0)
+	{
+		return;
+	}
+
+	int lines = GetLineCount();
+	if (lines <= m_maxLines)
+	{
+		return;
+	}
+
+	SetTargetStart(0);
+	SetTargetEnd(PositionFromLine(lines - m_maxLines));
+	ReplaceTarget(0, "");
+
+	m_linesTrimmed += lines - m_maxLines;
+	m_errors.DiscardBefore(m_linesTrimmed);
+
+	// Otherwise the undo history keeps every line we've removed:
+	EmptyUndoBuffer();
 }
 
 void COutputView::SetToolBasePath(LPCTSTR path)
@@ -455,19 +485,33 @@ void COutputView::SetToolParser(bool bBuiltIn, const char* customExpression)
 	{
 		m_bCustom = true;
 		SetRE(customExpression, false);
+
+		// SetRE reports a bad expression, the index then uses the built-in formats:
+		try
+		{
+			m_customParser.reset(new ErrorParser(m_customre));
+		}
+		catch (boost::xpressive::regex_error&)
+		{
+			m_customParser.reset();
+		}
 	}
 	else
 	{
 		m_bCustom = false;
+		m_customParser.reset();
 		SetOutputLexer();
 	}
 
+	m_errors.SetParser(m_customParser);
+
 	SetWrapMode(OPTIONS->Get(PNSK_INTERFACE, _T("OutputWrap"), false) ? SC_WRAP_WORD : SC_WRAP_NONE);
 }
 
 void COutputView::ClearOutput()
 {
-	ClearAll();
+	// Queued output has to be thrown away by the UI thread, which reads it:
+	SendMessage(WM_COMMAND, ID_OUTPUT_CLEAR, 0);
 }
 
 void COutputView::ShowOutput()
@@ -482,8 +526,14 @@ void COutputView::HideOutput()
 
 LRESULT COutputView::OnClear(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
 {
+	m_pending.Discard();
+	m_drained.Set();
 	ClearAll();
 
+	m_errors.Clear();
+	m_linesTrimmed = 0;
+	m_currentError = NO_ERROR_SELECTED;
+
 	return 0;
 }
 
@@ -507,6 +557,13 @@ LRESULT COutputView::OnCopy(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/
 	return 0;
 }
 
+LRESULT COutputView::OnNextError(WORD /*wNotifyCode*/, WORD wID, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	GoToError(wID == ID_OUTPUT_NEXTERROR);
+
+	return 0;
+}
+
 /**
  * Toggle word-wrap for the output view
  */
@@ -560,7 +617,64 @@ LRESULT COutputView::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*
 			IMAGE_ICON, ::GetSystemMetrics(SM_CXSMICON), ::GetSystemMetrics(SM_CYSMICON), LR_DEFAULTCOLOR);
 	SetIcon(hIconSmall, FALSE);
 
+	m_maxLines = OPTIONS->Get(PNSK_INTERFACE, _T("OutputMaxLines"), 0);
+	m_errors.SetNotifyWindow(m_hWnd, PN_ERRORINDEXUPDATED);
+
+	// Output queued before we had a window:
+	if (m_flushRequested)
+	{
+		PostMessage(PN_FLUSHOUTPUT);
+	}
+
+	bHandled = FALSE;
+
+	return 0;
+}
+
+LRESULT COutputView::OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled)
+{
+	// Tool threads waiting for room would never get it now:
+	::InterlockedExchange(&m_closed, 1);
+	m_drained.Set();
+
 	bHandled = FALSE;
 
 	return 0;
-}
\ No newline at end of file
+}
+
+LRESULT COutputView::OnFlushOutput(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	DWORD elapsed = ::GetTickCount() - m_lastFlush;
+	if (elapsed < OUTPUT_FLUSH_INTERVAL)
+	{
+		// Flushed too recently, wait for the rest of the frame to collect more:
+		SetTimer(TIMER_FLUSHOUTPUT, OUTPUT_FLUSH_INTERVAL - elapsed);
+	}
+	else
+	{
+		flushOutput();
+	}
+
+	return 0;
+}
+
+LRESULT COutputView::OnTimer(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOOL& bHandled)
+{
+	if (wParam != TIMER_FLUSHOUTPUT)
+	{
+		bHandled = FALSE;
+		return 0;
+	}
+
+	KillTimer(TIMER_FLUSHOUTPUT);
+	flushOutput();
+
+	return 0;
+}
+
+LRESULT COutputView::OnErrorIndexUpdated(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+{
+	updateErrorStatus();
+
+	return 0;
+}
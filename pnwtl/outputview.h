@@ -14,6 +14,9 @@
 #include "outputscintilla.h"
 #include "ScintillaWTL.h"
 #include "views/view.h"
+#include "errorindex.h"
+#include "include/ringbuffer.h"
+#include "include/threading.h"
 
 /**
  * Scintilla window with special output handling.
@@ -33,8 +36,14 @@ public:
 		COMMAND_ID_HANDLER(ID_EDIT_CUT, OnCut)
 		COMMAND_ID_HANDLER(ID_EDIT_COPY, OnCopy)
 		COMMAND_ID_HANDLER(ID_OUTPUT_WORDWRAP, OnWordWrap)
+		COMMAND_ID_HANDLER(ID_OUTPUT_NEXTERROR, OnNextError)
+		COMMAND_ID_HANDLER(ID_OUTPUT_PREVIOUSERROR, OnNextError)
 		MESSAGE_HANDLER(PN_HANDLEHSCLICK, OnHotSpotClicked)
+		MESSAGE_HANDLER(PN_FLUSHOUTPUT, OnFlushOutput)
+		MESSAGE_HANDLER(PN_ERRORINDEXUPDATED, OnErrorIndexUpdated)
+		MESSAGE_HANDLER(WM_TIMER, OnTimer)
 		MESSAGE_HANDLER(WM_CREATE, OnCreate)
+		MESSAGE_HANDLER(WM_DESTROY, OnDestroy)
 		CHAIN_MSG_MAP(baseClass)
 	END_MSG_MAP()
 
@@ -42,6 +51,8 @@ public:
 
 	void SafeAppendText(LPCSTR s, int len = -1, bool bScrollToView = true);
 
+	void GoToError(bool bNext);
+
 	virtual int HandleNotify(LPARAM lParam);
 
 	// Implement ITextOutput
@@ -59,37 +70,61 @@ public:
 
 protected:
 	LRESULT OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 	LRESULT OnHotSpotClicked(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT OnFlushOutput(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT OnTimer(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT OnErrorIndexUpdated(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 
-	// Built-in error handlers...
-	void HandleGCCError(int style, int position);
-	void HandleBorlandCPPError(int style, int position);
-	void HandlePerlError(int style, int position);
-	void HandlePythonError(int style, int position);
-	void HandleMSError(int style, int position);
-	
-	void HandleCustomError(int style, int position);
+	bool OpenErrorLocation(const ErrorLocation& location);
 
 	bool ExpandMatchedPath(CFileName& fn);
 	bool LocateInProjects(LPCTSTR part, tstring& full);
 
-	bool HandleREError(boost::xpressive::sregex& re, int style, int position);
-	bool BuildAndHandleREError(int style, int position, const char* reDef);
-
 	LRESULT OnClear(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnHide(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnCut(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnCopy(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT OnWordWrap(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+	LRESULT OnNextError(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 
 	void OnFirstShow();
 
+	void requestFlush();
+	void flushOutput();
+	void trimOutput();
+	void updateErrorStatus();
+
 	void SetOutputLexer();
 	void SetCustomLexer();
 
 private:
 	bool			m_bCustom;
 	tstring			m_basepath;
+
+	/// Tool output waiting to be added to the view, written by tool threads
+	pnutils::RingBuffer<TCHAR> m_pending;
+	/// Serialises writers of m_pending, the UI thread never takes it
+	pnutils::threading::CriticalSection m_pendingWriters;
+	/// Set each time the UI thread empties m_pending, tool threads wait on it when it's full
+	pnutils::threading::WinEvent m_drained;
+	/// Non-zero once the window has gone, writers stop waiting for room
+	volatile LONG	m_closed;
+	/// Non-zero while a flush has been asked for but hasn't happened yet
+	volatile LONG	m_flushRequested;
+	DWORD			m_lastFlush;
+	/// Reused for each flush
+	tstring			m_flushBuffer;
+	/// Oldest lines are removed past this many, 0 for no limit
+	int				m_maxLines;
+	/// Lines removed from the top since the output was cleared
+	int				m_linesTrimmed;
+
+	/// Errors found in the output, and the one we last went to
+	ErrorIndex		m_errors;
+	size_t			m_currentError;
+	/// Compiled once per tool run when the tool has its own parse pattern
+	ErrorParserPtr	m_customParser;
 };
 
 #endif
\ No newline at end of file
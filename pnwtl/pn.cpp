@@ -131,6 +131,12 @@ int Run(LPTSTR /*lpstrCmdLine*/ = NULL, int nCmdShow = SW_SHOWDEFAULT)
 				// Force exit after running command-line args
 				return 0;
 			}
+			else if(_tcsicmp(&arg.c_str()[1], _T("-trace")) == 0)
+			{
+				// Record timings from here on, written out as we exit
+				Tracer::Enable(true);
+				Tracer::SetThreadName("UI");
+			}
 			else if(_tcsicmp(&arg.c_str()[1], _T("-safemode")) == 0)
 			{
 				theApp->SetCanLoadExtensions(false);
@@ -196,6 +202,15 @@ int Run(LPTSTR /*lpstrCmdLine*/ = NULL, int nCmdShow = SW_SHOWDEFAULT)
 
 	int nRet = theLoop.Run();
 
+	if(Tracer::IsEnabled())
+	{
+		// Load into chrome://tracing to see where the time went
+		tstring tracePath;
+		OPTIONS->GetPNPath(tracePath, PNPATH_USERSETTINGS);
+		tracePath += _T("trace.json");
+		Tracer::WriteChromeTrace(tracePath.c_str());
+	}
+
 	delete theApp;
 
 	_Module.RemoveMessageLoop();
@@ -34,6 +34,12 @@
 #define	PN_COMPLETECLIP		(WM_APP+22)
 #define PN_INSERTCLIPTEXT   (WM_APP+23)
 #define PN_SETSCHEME		(WM_APP+24)
+#define PN_MAGICFOLDERBATCH	(WM_APP+25)
+#define PN_MAGICFOLDERCHANGES	(WM_APP+26)
+#define PN_FLUSHOUTPUT		(WM_APP+27)
+#define PN_ERRORINDEXUPDATED	(WM_APP+28)
+#define PN_RUNQUEUEDTOOLS	(WM_APP+29)
+#define PN_PROJECTSAVEFAILED	(WM_APP+30)
 
 // Command IDs used around the place...
 #define PN_MDIACTIVATE		0x1
@@ -104,6 +110,7 @@ typedef enum {
 
 #include "pnutils.h"
 #include "pnstrings.h"
+#include "tracing.h"
 #include "include/singleton.h"
 #include "l10n.h"
 
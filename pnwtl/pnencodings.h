@@ -0,0 +1,38 @@
+/**
+ * @file pnencodings.h
+ * @brief Line ending and encoding types.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ *
+ * Kept apart from pntypes.h so the file handling code that only needs these
+ * can be built without the rest of the editor, see benchmarks/CMakeLists.txt.
+ */
+
+#ifndef pnencodings_h__included
+#define pnencodings_h__included
+
+#include "third_party/scintilla/include/Scintilla.h"
+
+typedef enum { PNSF_Windows = SC_EOL_CRLF, PNSF_Mac = SC_EOL_CR, PNSF_Unix = SC_EOL_LF, PNSF_NoChange} EPNSaveFormat;
+
+typedef enum {
+	eUnknown,
+	eUtf16BigEndian,
+	eUtf16LittleEndian,  // Default on Windows
+	eUtf8,
+	eUtf8NoBOM,
+	eLast
+} EPNEncoding;
+
+static const unsigned char BOMLengthLookup [eLast] = {
+	0,
+	2,
+	2,
+	3,
+	0
+};
+
+#endif // #ifndef pnencodings_h__included
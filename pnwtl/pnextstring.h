@@ -11,6 +11,8 @@
 #ifndef string_h__included
 #define string_h__included
 
+#include <stdexcept>
+
 namespace PN {
 
 /**
@@ -148,7 +150,7 @@ private:
 				}
 				else
 				{
-					throw std::exception("out of memory in AsciiString.allocate");
+					throw std::runtime_error("out of memory in AsciiString.allocate");
 				}
 			}
 		}
@@ -146,6 +146,17 @@ static void Trim(TStringType& str)
 		str.erase(str.begin(), str.end());
 }
 
+/**
+ * Lower-case a path or file name in place so it can be compared or used as a
+ * key without regard to case. This uses the system's case mapping, so names
+ * that aren't plain ASCII are folded the same way the file system folds them.
+ */
+static void MakeLower(tstring& str)
+{
+	if(!str.empty())
+		::CharLowerBuff(&str[0], static_cast<DWORD>(str.size()));
+}
+
 /**
  * Exception that can be thrown from a format string builder
  * to abort the build 
@@ -16,6 +16,7 @@ typedef __int64				int64_t;
 
 #include "third_party/scintilla/include/scintilla.h"
 #include "searchoptions.h"
+#include "pnencodings.h"
 
 typedef struct tagPrintOptions
 {
@@ -117,25 +118,6 @@ private:
 	unsigned long iFlags;
 };
 
-typedef enum { PNSF_Windows = SC_EOL_CRLF, PNSF_Mac = SC_EOL_CR, PNSF_Unix = SC_EOL_LF, PNSF_NoChange} EPNSaveFormat;
-
-typedef enum {
-	eUnknown,
-	eUtf16BigEndian,
-	eUtf16LittleEndian,  // Default on Windows
-	eUtf8,
-	eUtf8NoBOM,
-	eLast
-} EPNEncoding;
-
-static const unsigned char BOMLengthLookup [eLast] = {
-	0,
-	2,
-	2,
-	3,
-	0
-};
-
 typedef enum {
 	eOpenAgain,
 	eWarnOpen,
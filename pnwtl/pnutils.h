@@ -581,35 +581,6 @@ class CNumberCombo : public CComboBox
 		}
 };
 
-#ifdef _DEBUG
-
-/**
- * @brief operation timer class - allows simple timing within scope operators.
- *
- * note: Only available in debug builds.
- */
-class OpTimer
-{
-	public:
-		OpTimer()
-		{
-			dwTicksStart = GetTickCount();
-		}
-
-		~OpTimer()
-		{
-			DWORD diffTicks = GetTickCount() - dwTicksStart;
-			TCHAR buffer[50];
-			_sntprintf(buffer, 50, _T("OpTimer recorded %d Milliseconds.\n"), diffTicks);
-			::OutputDebugString(buffer);
-		}
-
-	protected:
-		DWORD dwTicksStart;
-};
-
-#endif
-
 class FileInformation
 {
 public:
@@ -13,6 +13,7 @@
 #include "project.h"
 
 #include "projectwriter.h"
+#include "projectsaver.h"
 
 #include "include/filefinder.h"
 #include "include/filematcher.h"
@@ -75,6 +76,85 @@ namespace Projects
 			str = _T("error"); \
 	}
 
+//////////////////////////////////////////////////////////////////////////////
+// PooledPath
+//////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+typedef std::unordered_map<tstring, int> PATH_POOL;
+
+// Map elements never move, so the strings they hold stay put too:
+PATH_POOL s_pathPool;
+
+} // namespace
+
+PooledPath::PooledPath() : m_entry(NULL)
+{
+}
+
+PooledPath::PooledPath(LPCTSTR path) : m_entry(NULL)
+{
+	acquire(path);
+}
+
+PooledPath::PooledPath(const PooledPath& other) : m_entry(other.m_entry)
+{
+	if(m_entry != NULL)
+		m_entry->second++;
+}
+
+PooledPath::~PooledPath()
+{
+	release();
+}
+
+PooledPath& PooledPath::operator=(const PooledPath& other)
+{
+	std::pair<const tstring, int>* entry = other.m_entry;
+	if(entry != NULL)
+		entry->second++;
+	release();
+	m_entry = entry;
+	return *this;
+}
+
+PooledPath& PooledPath::operator=(LPCTSTR path)
+{
+	// Take the new reference first, path may be this one's own string:
+	PooledPath old(*this);
+	release();
+	acquire(path);
+	return *this;
+}
+
+PooledPath::operator LPCTSTR() const
+{
+	return m_entry != NULL ? m_entry->first.c_str() : NULL;
+}
+
+void PooledPath::acquire(LPCTSTR path)
+{
+	if(path == NULL)
+		return;
+
+	m_entry = &*s_pathPool.insert(PATH_POOL::value_type(tstring(path), 0)).first;
+	m_entry->second++;
+}
+
+void PooledPath::release()
+{
+	if(m_entry == NULL)
+		return;
+
+	if(--m_entry->second == 0)
+	{
+		s_pathPool.erase(s_pathPool.find(m_entry->first));
+	}
+
+	m_entry = NULL;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // ProjectType
 //////////////////////////////////////////////////////////////////////////////
@@ -101,10 +181,11 @@ UserData& ProjectType::GetUserData()
 File::File(LPCTSTR basePath, LPCTSTR path, Projects::Folder* parent) : ProjectType(ptFile)
 {
 	CFileName fn(path);
+	tstring rel;
 
 	if(fn.IsRelativePath() && _tcslen(basePath) > 0)
 	{
-		relPath = path;
+		rel = path;
 		fn.Root(basePath);
 	}
 	else
@@ -114,22 +195,23 @@ File::File(LPCTSTR basePath, LPCTSTR path, Projects::Folder* parent) : ProjectTy
 		{
 			// This will do its best to make a relative path, eventually
 			// giving up and returning the full path if it's unreasonable to make one.
-			relPath = fn.GetRelativePath(basePath);
+			rel = fn.GetRelativePath(basePath);
 		}
 		else
 		{
-			relPath = fn.GetFileName();
+			rel = fn.GetFileName();
 		}
 	}
 	
-	displayName = fn.GetFileName();
 	fullPath = fn;
+	nameStart = fullPath.size() - fn.GetFileName().size();
+	setRelativePath(rel);
 	parentFolder = parent;
 }
 
 LPCTSTR File::GetDisplayName()
 {
-	return displayName.c_str();
+	return fullPath.c_str() + nameStart;
 }
 
 LPCTSTR File::GetFileName()
@@ -144,7 +226,7 @@ Projects::Folder* File::GetFolder()
 
 LPCTSTR File::GetRelativePath()
 {
-	return relPath.c_str();
+	return relPath != NULL ? relPath : fullPath.c_str() + relStart;
 }
 
 void File::SetFolder(Projects::Folder* folder)
@@ -168,21 +250,10 @@ bool File::Rename(LPCTSTR newFilePart)
 	{
 		if( MoveFile(fullPath.c_str(), fn2.c_str()) != 0 )
 		{
-			fullPath = fn2;
-			displayName = newFilePart;
-
-			CFileName fnRel(relPath.c_str());
-			if(fnRel.IsRelativePath())
-			{
-				relPath = fnRel.GetPath();
-				relPath += fnRel.GetFileName();
-			}
-			else
-			{
-				relPath = fullPath;
-			}
+			setFilePart(newFilePart);
 
 			SetDirty();
+			parentFolder->notify(pcEdit, this);
 
 			return true;
 		}
@@ -195,6 +266,55 @@ bool File::Rename(LPCTSTR newFilePart)
 	return false;
 }
 
+void File::Renamed(LPCTSTR newFilePart)
+{
+	setFilePart(newFilePart);
+
+	parentFolder->notify(pcEdit, this);
+}
+
+void File::setFilePart(LPCTSTR newFilePart)
+{
+	CFileName fnRel(GetRelativePath());
+
+	CFileName fn(fullPath.c_str());
+	CFileName fn2(newFilePart);
+	fn2.Root(fn.GetPath().c_str());
+
+	fullPath = fn2;
+	nameStart = fullPath.size() - _tcslen(newFilePart);
+
+	if(fnRel.IsRelativePath())
+	{
+		tstring rel = fnRel.GetPath();
+		rel += newFilePart;
+		setRelativePath(rel);
+	}
+	else
+	{
+		setRelativePath(fullPath);
+	}
+}
+
+/**
+ * Most relative paths are the tail of the full path, only those that aren't
+ * (e.g. ..\foo.txt) need storing separately.
+ */
+void File::setRelativePath(const tstring& path)
+{
+	size_t length = path.size();
+	if(length <= fullPath.size() && fullPath.compare(fullPath.size() - length, length, path) == 0)
+	{
+		relStart = fullPath.size() - length;
+		relPath = NULL;
+	}
+	else
+	{
+		relStart = 0;
+		relPath = path.c_str();
+	}
+}
+
 //void File::WriteDefinition(SProjectWriter* definition)
 //{
 //	genxStartElement(definition->eFile);
@@ -228,6 +348,7 @@ void File::SetDirty()
 Folder::Folder() : ProjectType(ptFolder), m_canNotify(true)
 {
 	parent = NULL;
+	basePath = _T("");
 }
 
 Folder::Folder(LPCTSTR name_, LPCTSTR basepath) : ProjectType(ptFolder), m_canNotify(true)
@@ -258,7 +379,7 @@ LPCTSTR Folder::GetName()
 
 LPCTSTR Folder::GetBasePath()
 {
-	return basePath.c_str();
+	return basePath;
 }
 
 const FOLDER_LIST& Folder::GetFolders()
@@ -273,14 +394,37 @@ const FILE_LIST& Folder::GetFiles()
 
 File* Folder::FindFile(LPCTSTR filename)
 {
+	Project* project = GetProject();
+	if(project != NULL && project->GetWorkspace() != NULL)
+		return project->GetWorkspace()->FindFile(filename, this);
+
 	CFileName cfn1(filename);
-	const tstring& fn1 = cfn1.ToLower();
+	return findFile(cfn1.ToLower());
+}
+
+/**
+ * Find a file purely by it's filename part, ignore all path.
+ */
+File* Folder::FindRelativeFile(LPCTSTR filename)
+{
+	Project* project = GetProject();
+	if(project != NULL && project->GetWorkspace() != NULL)
+		return project->GetWorkspace()->FindRelativeFile(filename, this);
 
+	CFileName cfn1(filename);
+	cfn1.ToLower();
+	return findRelativeFile(cfn1.GetFileName());
+}
+
+/**
+ * Search this folder for a file when it isn't indexed by a workspace.
+ * @param filename Lower-case full path
+ */
+File* Folder::findFile(const tstring& filename)
+{
 	for(FILE_IT i = files.begin(); i != files.end(); ++i)
 	{
-		CFileName cfn2((*i)->GetFileName());
-
-		if(fn1 == cfn2.ToLower())
+		if(_tcsicmp(filename.c_str(), (*i)->GetFileName()) == 0)
 			return (*i);
 	}
 
@@ -288,7 +432,7 @@ File* Folder::FindFile(LPCTSTR filename)
 
 	for(FL_IT j = children.begin(); j != children.end(); ++j)
 	{
-		pF = (*j)->FindFile(filename);
+		pF = (*j)->findFile(filename);
 		if(pF)
 			return pF;
 	}
@@ -297,22 +441,14 @@ File* Folder::FindFile(LPCTSTR filename)
 }
 
 /**
- * Find a file purely by it's filename part, ignore all path.
+ * Search this folder for a file by name when it isn't indexed by a workspace.
+ * @param filename Lower-case filename part
  */
-File* Folder::FindRelativeFile(LPCTSTR filename)
+File* Folder::findRelativeFile(const tstring& filename)
 {
-	CFileName cfn1(filename);
-	cfn1.ToLower();
-	const tstring& fn1 = cfn1.GetFileName();
-
-	tstring tmp;
-
 	for(FILE_IT i = files.begin(); i != files.end(); ++i)
 	{
-		CFileName cfn2((*i)->GetFileName());
-		cfn2.ToLower();
-
-		if(fn1 == cfn2.GetFileName())
+		if(_tcsicmp(filename.c_str(), (*i)->GetDisplayName()) == 0)
 			return (*i);
 	}
 
@@ -320,7 +456,7 @@ File* Folder::FindRelativeFile(LPCTSTR filename)
 
 	for(FL_IT j = children.begin(); j != children.end(); ++j)
 	{
-		pF = (*j)->FindRelativeFile(filename);
+		pF = (*j)->findRelativeFile(filename);
 		if(pF)
 			return pF;
 	}
@@ -338,7 +474,7 @@ void Folder::AddChild(Folder* folder)
 
 File* Folder::AddFile(LPCTSTR file)
 {
-	File* pFile = new File(basePath.c_str(), file, this);
+	File* pFile = new File(basePath, file, this);
 	files.insert(files.end(), pFile);
 	
 	SetDirty();
@@ -361,7 +497,7 @@ void Folder::AddFile(File* file)
 Folder* Folder::AddFolder(LPCTSTR path, LPCTSTR filter, bool recursive)
 {
 	FolderAdder fa;
-	Folder* folder = fa.GetFolder(path, filter, basePath.c_str(), recursive);
+	Folder* folder = fa.GetFolder(path, filter, basePath, recursive);
 	AddChild(folder);
 	SetDirty();
 	
@@ -382,7 +518,7 @@ void Folder::RemoveFile(File* file)
 
 void Folder::DetachChild(Folder* folder)
 {
-	children.remove(folder);
+	children.erase(std::remove(children.begin(), children.end(), folder), children.end());
 	
 	SetDirty();
 	notify(pcRemove, folder);
@@ -390,7 +526,7 @@ void Folder::DetachChild(Folder* folder)
 
 void Folder::DetachFile(File* file)
 {
-	files.remove(file);
+	files.erase(std::remove(files.begin(), files.end(), file), files.end());
 	
 	SetDirty();
 	notify(pcRemove, file);
@@ -398,6 +534,9 @@ void Folder::DetachFile(File* file)
 
 void Folder::Clear()
 {
+	// Notify before deleting anything so the contents can be unindexed.
+	notify(pcClear, this);
+
 	for(FL_IT i = children.begin(); i != children.end(); ++i)
 	{
 		delete (*i);
@@ -411,8 +550,6 @@ void Folder::Clear()
 	}
 
 	files.clear();
-
-	notify(pcClear, this);
 }
 
 void Folder::SetParent(Folder* folder)
@@ -571,44 +708,76 @@ void Folder::notify(PROJECT_CHANGE_TYPE changeType, ProjectType* changeItem)
 
 void Folder::notify(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem)
 {
-	if (m_canNotify && parent != NULL)
+	if (parent != NULL)
 	{
-		parent->notify(changeType, changeContainer, changeItem);
+		if (m_canNotify)
+			parent->notify(changeType, changeContainer, changeItem);
+		else
+			parent->updateIndex(changeType, changeContainer, changeItem);
+	}
+}
+
+/**
+ * Pass a change up to the workspace file index without telling the watcher,
+ * used while notifications are suppressed (e.g. magic folder enumeration).
+ */
+void Folder::updateIndex(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem)
+{
+	if (parent != NULL)
+	{
+		parent->updateIndex(changeType, changeContainer, changeItem);
 	}
 }
 
 void Folder::GetAllFiles(std::vector<tstring>& files)
 {
+	GetAllFiles([&files] (LPCTSTR filename) { files.push_back(filename); });
+}
+
+/**
+ * Call callback once for each distinct (case-insensitive) file in this folder
+ * and all of its children, as each one is found.
+ */
+void Folder::GetAllFiles(const FileCallback& callback)
+{
+	std::unordered_set<tstring> seen;
+	getAllFiles(callback, seen, NULL);
+}
+
+void Folder::GetAllFiles(const FileCallback& callback, MAGICFOLDER_SOURCES& unread)
+{
+	std::unordered_set<tstring> seen;
+	getAllFiles(callback, seen, &unread);
+}
+
+void Folder::getAllFiles(const FileCallback& callback, std::unordered_set<tstring>& seen, MAGICFOLDER_SOURCES* unread)
+{
+	// Reading this would mean going to disk, leave it to the caller:
+	if(unread != NULL && GetType() == ptMagicFolder && !static_cast<MagicFolder*>(this)->GetGotContents())
+	{
+		unread->push_back(static_cast<MagicFolder*>(this)->GetSource());
+		return;
+	}
+
 	for(FOLDER_LIST::const_iterator i = GetFolders().begin();
 		i != GetFolders().end();
 		++i)
 	{
-		(*i)->GetAllFiles(files);
+		(*i)->getAllFiles(callback, seen, unread);
 	}
 
+	tstring key;
+
 	for(FILE_LIST::const_iterator j = GetFiles().begin();
 		j != GetFiles().end();
 		++j)
 	{
-		bool found = false;
-		
-		for(std::vector<tstring>::const_iterator k = files.begin();
-			k != files.end();
-			++k)
-		{
-			CFileName cfn1(*k);
-			const tstring& fn1 = cfn1.ToLower();
-			CFileName cfn2((*j)->GetFileName());
-
-			if (fn1 == cfn2.ToLower())
-			{
-				found = true;
-			}
-		}
+		key = (*j)->GetFileName();
+		MakeLower(key);
 		
-		if (found == false)
+		if (seen.insert(key).second)
 		{
-			files.push_back((*j)->GetFileName());
+			callback((*j)->GetFileName());
 		}
 	}
 }
@@ -620,7 +789,7 @@ void Folder::GetAllFiles(std::vector<tstring>& files)
 bool Project::CreateEmptyProject(LPCTSTR projectname, LPCTSTR filename, LPCTSTR templateGuid)
 {
 	Project Fake;
-	Fake.basePath = CFileName(filename).GetPath();
+	Fake.basePath = CFileName(filename).GetPath().c_str();
 	Fake.SetName(projectname);
 	Fake.fileName = filename;
 
@@ -630,6 +799,7 @@ bool Project::CreateEmptyProject(LPCTSTR projectname, LPCTSTR filename, LPCTSTR
 	}
 
 	Fake.Save();
+	ProjectSaver::GetInstance()->Wait(filename);
 
 	return FileExists(filename);
 }
@@ -645,6 +815,7 @@ Project::Project()
 	
 	m_template = NULL;
 	m_viewState = NULL;
+	theDocument = NULL;
 }
 
 Project::Project(LPCTSTR projectFile) : Folder()
@@ -654,12 +825,16 @@ Project::Project(LPCTSTR projectFile) : Folder()
 	type = ptProject;
 
 	fileName = projectFile;
+
+	// We may have only just saved it:
+	ProjectSaver::GetInstance()->Wait(projectFile);
 	bExists = FileExists(projectFile);
 		
-	basePath = CFileName(projectFile).GetPath();
+	basePath = CFileName(projectFile).GetPath().c_str();
 
 	m_template = NULL;
 	m_viewState = NULL;
+	theDocument = NULL;
 
 	if(bExists)
 	{
@@ -684,16 +859,19 @@ bool Project::Exists()
 
 void Project::Save()
 {
-	ProjectWriter writer;
-	
-	writer.Start(fileName.c_str());
-	
-	if (writer.IsValid())
+	std::string xml;
+
 	{
+		PNTRACE_SPAN("project", "Project::Save serialise");
+
+		ProjectWriter writer;
+		writer.StartBuffer(xml);
 		writer.WriteProject(this);
 		writer.Close();
 	}
-	else
+
+	// The file is written in the background:
+	if (!ProjectSaver::GetInstance()->Save(fileName.c_str(), xml))
 	{
 		UNEXPECTED(_T("Could not open the project file for writing"));
 		return;
@@ -730,13 +908,69 @@ void Project::notify(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, Pr
 	}
 }
 
+void Project::updateIndex(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem)
+{
+	if(parentWorkspace != NULL)
+	{
+		parentWorkspace->updateIndex(changeType, changeContainer, changeItem);
+	}
+}
+
 void Project::setWorkspace(Workspace* workspace)
 {
 	parentWorkspace = workspace;
 }
 
+Workspace* Project::GetWorkspace() const
+{
+	return parentWorkspace;
+}
+
+/**
+ * Can XML from this document be copied into one written by genx? Only
+ * if it's UTF-8.
+ */
+static bool isUtf8Document(const std::string& document)
+{
+	// UTF-16, with or without a BOM:
+	if (document.size() >= 2 && (document[0] == 0 || document[1] == 0 || (unsigned char)document[0] >= 0xfe))
+		return false;
+
+	size_t declStart = document.find("<?xml");
+	if (declStart == std::string::npos || declStart > 3)
+		return true;
+
+	size_t declEnd = document.find("?>", declStart);
+	std::string decl(document, declStart, declEnd == std::string::npos ? std::string::npos : declEnd - declStart);
+	for (std::string::iterator i = decl.begin(); i != decl.end(); ++i)
+	{
+		*i = static_cast<char>(tolower(static_cast<unsigned char>(*i)));
+	}
+
+	size_t encoding = decl.find("encoding");
+	return encoding == std::string::npos || decl.find("utf-8", encoding) != std::string::npos;
+}
+
+/**
+ * Does the start tag being parsed declare any namespaces? Magic folder XML
+ * is only kept if it doesn't rely on declarations from outside it.
+ */
+static bool startTagDeclaresNamespaces(XMLParser* parser, const std::string& document)
+{
+	XML_Parser p = parser->GetParser();
+	size_t start = static_cast<size_t>(XML_GetCurrentByteIndex(p));
+	size_t end = start + XML_GetCurrentByteCount(p);
+	if (end > document.size())
+		return true;
+
+	const char xmlns[] = "xmlns";
+	return std::search(document.begin() + start, document.begin() + end, xmlns, xmlns + 5) != document.begin() + end;
+}
+
 void Project::parse()
 {
+	PNTRACE_SPAN("project", "Project::parse");
+
 	currentFolder = this;
 	parseState = PS_START;
 	udNestingLevel = 0;
@@ -746,15 +980,22 @@ void Project::parse()
 	XMLParser parser(true);
 	theParser = &parser;
 	parser.SetParseState(this);
+
+	// The whole file is kept while parsing so magic folders can keep their XML:
+	std::string document;
+	theDocument = &document;
+
 	try
 	{
-		parser.LoadFile(fileName.c_str());
+		parser.LoadDocument(fileName.c_str(), document);
 	}
 	catch (XMLParserException& ex)
 	{
 		::OutputDebugString(ex.GetMessage());
 	}
+
 	theParser = NULL;
+	theDocument = NULL;
 }
 
 void Project::startElement(XML_CSTR name, const XMLAttributes& atts)
@@ -763,6 +1004,9 @@ void Project::startElement(XML_CSTR name, const XMLAttributes& atts)
 	{
 		if( MATCH( PROJECTNODE ) )
 		{
+			if(theDocument != NULL && (!isUtf8Document(*theDocument) || startTagDeclaresNamespaces(theParser, *theDocument)))
+				theDocument = NULL;
+
 			processProject(atts);
 			STATE(PS_PROJECT);
 		}
@@ -904,8 +1148,11 @@ void Project::processProject(const XMLAttributes& atts)
 
 void Project::processFolder(const XMLAttributes& atts)
 {
+	if(theDocument != NULL && startTagDeclaresNamespaces(theParser, *theDocument))
+		theDocument = NULL;
+
 	Xml_Tcs nm( ATTVAL(_T("name")) );
-	Folder* folder = new Folder(nm, basePath.c_str());
+	Folder* folder = new Folder(nm, basePath);
 	currentFolder->AddChild(folder);
 	currentFolder = folder;
 }
@@ -930,7 +1177,7 @@ void Project::processMagicFolder(const XMLAttributes& atts)
 	CPathName mfPath(path);
 	if(mfPath.IsRelativePath())
 	{
-		mfPath.Root( basePath.c_str() );
+		mfPath.Root( basePath );
 	}
 
 	MagicFolder* mf = new MagicFolder(name, mfPath.c_str());
@@ -949,7 +1196,10 @@ void Project::processMagicFolder(const XMLAttributes& atts)
 	// This will pass over the XML Parsing to the MagicFolder
 	// until the MagicFolder element finishes, when it will
 	// set the handling back to us for the next element.
-	mf->HandleReadCache(theParser, this);
+	mf->HandleReadCache(theParser, this, theDocument);
+
+	if(mf->m_snapshot != NULL)
+		mf->m_snapshot->Signature = ProjectWriter::GetMagicFolderSignature(mf);
 }
 
 void Project::processUserData(XML_CSTR name, const XMLAttributes& atts)
@@ -1030,6 +1280,141 @@ void Project::SaveViewState()
 	}
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// FileIndex
+//////////////////////////////////////////////////////////////////////////////
+
+void FileIndex::Add(ProjectType* item)
+{
+	if(item->GetType() == ptFile)
+		addFile(static_cast<File*>(item));
+	else if(item->GetType() != ptWorkspace)
+		addFolder(static_cast<Folder*>(item));
+}
+
+void FileIndex::Remove(ProjectType* item)
+{
+	if(item->GetType() == ptFile)
+		removeFile(static_cast<File*>(item));
+	else if(item->GetType() != ptWorkspace)
+		removeFolder(static_cast<Folder*>(item));
+}
+
+void FileIndex::Clear()
+{
+	byPath.clear();
+	byName.clear();
+	keys.clear();
+}
+
+File* FileIndex::Find(LPCTSTR filename, Folder* within) const
+{
+	CFileName cfn(filename);
+	std::pair<MAP_FILES::const_iterator, MAP_FILES::const_iterator> range = byPath.equal_range(cfn.ToLower());
+
+	for(MAP_FILES::const_iterator i = range.first; i != range.second; ++i)
+	{
+		if(within == NULL || contains(within, (*i).second))
+			return (*i).second;
+	}
+
+	return NULL;
+}
+
+File* FileIndex::FindByName(LPCTSTR filename, Folder* within, Folder* preferred) const
+{
+	CFileName cfn(filename);
+	cfn.ToLower();
+	std::pair<MAP_FILES::const_iterator, MAP_FILES::const_iterator> range = byName.equal_range(cfn.GetFileName());
+
+	File* found = NULL;
+
+	for(MAP_FILES::const_iterator i = range.first; i != range.second; ++i)
+	{
+		if(within != NULL && !contains(within, (*i).second))
+			continue;
+
+		if(preferred == NULL || contains(preferred, (*i).second))
+			return (*i).second;
+
+		if(found == NULL)
+			found = (*i).second;
+	}
+
+	return found;
+}
+
+void FileIndex::addFile(File* file)
+{
+	// Re-adding a file (e.g. after a rename) replaces its old keys.
+	removeFile(file);
+
+	CFileName cfn(file->GetFileName());
+	FileKeys fileKeys;
+	fileKeys.first = cfn.ToLower();
+	fileKeys.second = cfn.GetFileName();
+
+	byPath.insert(MAP_FILES::value_type(fileKeys.first, file));
+	byName.insert(MAP_FILES::value_type(fileKeys.second, file));
+	keys.insert(MAP_KEYS::value_type(file, fileKeys));
+}
+
+void FileIndex::removeFile(File* file)
+{
+	MAP_KEYS::iterator i = keys.find(file);
+	if(i == keys.end())
+		return;
+
+	erase(byPath, (*i).second.first, file);
+	erase(byName, (*i).second.second, file);
+	keys.erase(i);
+}
+
+void FileIndex::addFolder(Folder* folder)
+{
+	for(FILE_IT i = folder->files.begin(); i != folder->files.end(); ++i)
+		addFile(*i);
+
+	for(FL_IT j = folder->children.begin(); j != folder->children.end(); ++j)
+		addFolder(*j);
+}
+
+void FileIndex::removeFolder(Folder* folder)
+{
+	for(FILE_IT i = folder->files.begin(); i != folder->files.end(); ++i)
+		removeFile(*i);
+
+	for(FL_IT j = folder->children.begin(); j != folder->children.end(); ++j)
+		removeFolder(*j);
+}
+
+void FileIndex::erase(MAP_FILES& map, const tstring& key, File* file)
+{
+	std::pair<MAP_FILES::iterator, MAP_FILES::iterator> range = map.equal_range(key);
+	for(MAP_FILES::iterator i = range.first; i != range.second; ++i)
+	{
+		if((*i).second == file)
+		{
+			map.erase(i);
+			return;
+		}
+	}
+}
+
+/**
+ * Is file somewhere below folder?
+ */
+bool FileIndex::contains(Folder* folder, File* file)
+{
+	for(Folder* f = file->GetFolder(); f != NULL; f = f->GetParent())
+	{
+		if(f == folder)
+			return true;
+	}
+
+	return false;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Workspace
 //////////////////////////////////////////////////////////////////////////////
@@ -1100,6 +1485,7 @@ void Workspace::DetachProject(Project* project)
 {
 	projects.remove(project);
 	project->setWorkspace(NULL);
+	fileIndex.Remove(project);
 
 	if(activeProject == project)
 	{
@@ -1154,17 +1540,11 @@ void Workspace::Save()
 	if(fileName.size() == 0)
 		return;
 
-	FILE* hFile = _tfopen(fileName.c_str(), _T("wb"));
+	std::string xml;
+	GenxXMLWriter writer;
+	writer.StartBuffer(xml);
 
-	if(hFile == NULL)
-	{
-		UNEXPECTED(_T("Could not open the project file for writing"));
-		return;
-	}
-
-	genxWriter w = genxNew(NULL, NULL, NULL);
-
-	genxStartDocFile(w, hFile);
+	genxWriter w = writer;
 	genxStartElementLiteral(w, NULL, u("Workspace"));
 	
 	Tcs_Utf8 nameconv(name.c_str());
@@ -1188,9 +1568,13 @@ void Workspace::Save()
 	}
 
 	genxEndElement(w);
-	genxDispose(w);
+	writer.Close();
 
-	fclose(hFile);
+	if (!ProjectSaver::GetInstance()->Save(fileName.c_str(), xml))
+	{
+		UNEXPECTED(_T("Could not open the project file for writing"));
+		return;
+	}
 
 	ClearDirty();
 }
@@ -1222,18 +1606,23 @@ void Workspace::SetDirty()
 	bDirty = true;
 }
 
-File* Workspace::FindFile(LPCTSTR filename)
+/**
+ * Find a file by its full path.
+ * @param within Only search below this folder, may be NULL.
+ */
+File* Workspace::FindFile(LPCTSTR filename, Folder* within)
 {
-	File* pF = NULL;
-	
-	for(PL_IT i = projects.begin(); i != projects.end(); ++i)
-	{
-		pF = (*i)->FindFile(filename);
-		if(pF)
-			return pF;
-	}
+	return fileIndex.Find(filename, within);
+}
 
-	return pF;
+/**
+ * Find a file purely by its filename part, ignoring all path.
+ * @param within Only search below this folder, may be NULL.
+ * @param preferred Prefer files in this folder (e.g. the active project), may be NULL.
+ */
+File* Workspace::FindRelativeFile(LPCTSTR filename, Folder* within, Folder* preferred)
+{
+	return fileIndex.FindByName(filename, within, preferred);
 }
 
 Projects::Project* Workspace::GetActiveProject()
@@ -1250,6 +1639,8 @@ void Workspace::SetActiveProject(Projects::Project* project)
 
 void Workspace::Notify(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem)
 {
+	updateIndex(changeType, changeContainer, changeItem);
+
 	if(watcher != NULL)
 	{
 		watcher->OnProjectItemChange(changeType, changeContainer, changeItem);
@@ -1261,6 +1652,42 @@ void Workspace::SetWatcher(IProjectWatcher* newWatcher)
 	watcher = newWatcher;
 }
 
+/**
+ * Keep the file index up to date, this sees every change including those
+ * made while notifications to the watcher are suppressed.
+ */
+void Workspace::updateIndex(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem)
+{
+	switch(changeType)
+	{
+		case pcAdd:
+			fileIndex.Add(changeItem);
+			break;
+
+		case pcRemove:
+		case pcClear:
+			fileIndex.Remove(changeItem);
+			break;
+
+		case pcEdit:
+			if(changeItem->GetType() == ptFile)
+				fileIndex.Add(changeItem);
+			break;
+
+		// These don't change which files there are:
+		case pcDirty:
+		case pcClean:
+		case pcActive:
+		case pcRefresh:
+			break;
+
+		default:
+			// A new kind of change, decide what it means for the index:
+			PNASSERT(false);
+			break;
+	}
+}
+
 void Workspace::startElement(LPCTSTR name, const XMLAttributes& atts)
 {
 	if ( IN_STATE(PS_START) )
@@ -1301,6 +1728,8 @@ void Workspace::endElement(LPCTSTR name)
 
 void Workspace::Clear()
 {
+	fileIndex.Clear();
+
 	for(PL_IT i = projects.begin(); i != projects.end(); ++i)
 	{
 		delete (*i);
@@ -1311,6 +1740,8 @@ void Workspace::Clear()
 
 void Workspace::parse()
 {
+	ProjectSaver::GetInstance()->Wait(fileName.c_str());
+
 	parseState = PS_START;
 	
 	XMLParser parser;
@@ -1388,6 +1819,8 @@ tstring ProjectViewState::GetFolderPath(Folder* folder)
 
 void ProjectViewState::Load(LPCTSTR filename)
 {
+	ProjectSaver::GetInstance()->Wait(filename);
+
 	if(!FileExists(filename))
 		return;
 
@@ -1411,17 +1844,11 @@ void ProjectViewState::Load(LPCTSTR filename)
 
 void ProjectViewState::Save(LPCTSTR filename)
 {
-	FILE* hFile = _tfopen(filename, _T("wb"));
+	std::string xml;
+	GenxXMLWriter writer;
+	writer.StartBuffer(xml);
 
-	if(hFile == NULL)
-	{
-		UNEXPECTED(_T("Could not open the project data file for writing"));
-		return;
-	}
-
-	genxWriter w = genxNew(NULL, NULL, NULL);
-
-	genxStartDocFile(w, hFile);
+	genxWriter w = writer;
 	genxStartElementLiteral(w, NULL, u("pd"));
 	genxStartElementLiteral(w, NULL, u("ViewState"));
 
@@ -1436,9 +1863,12 @@ void ProjectViewState::Save(LPCTSTR filename)
 
 	genxEndElement(w);
 	genxEndElement(w);
-	genxDispose(w);
+	writer.Close();
 
-	fclose(hFile);
+	if (!ProjectSaver::GetInstance()->Save(filename, xml))
+	{
+		UNEXPECTED(_T("Could not open the project data file for writing"));
+	}
 }
 
 void ProjectViewState::Clear()
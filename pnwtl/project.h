@@ -13,6 +13,10 @@
 
 #include "projectmeta.h"
 
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+
 namespace Projects
 {
 
@@ -28,19 +32,38 @@ class File;
 class ProjectTemplate;
 class ProjectWriter;
 class MagicFolder;
+class FileIndex;
 
-typedef std::list<Folder*>		FOLDER_LIST;
+typedef std::vector<Folder*>	FOLDER_LIST;
 typedef FOLDER_LIST::iterator	FL_IT;
 
-typedef std::list<File*>		FILE_LIST;
+typedef std::vector<File*>		FILE_LIST;
 typedef FILE_LIST::iterator		FILE_IT;
 
+typedef std::function<void (LPCTSTR filename)> FileCallback;
+
+/**
+ * Where a magic folder that hasn't been read yet finds its contents, so
+ * they can be listed on another thread without touching the project.
+ */
+class MagicFolderSource
+{
+	public:
+		/// With a trailing slash
+		tstring Path;
+		tstring Filter;
+		tstring ExcludedFiles;
+		tstring ExcludedFolders;
+};
+
+typedef std::vector<MagicFolderSource> MAGICFOLDER_SOURCES;
+
 typedef enum {ptFile, ptFolder, ptMagicFolder, ptProject, ptWorkspace} PROJECT_TYPE;
-typedef enum {pcAdd, pcRemove, pcEdit, pcClear, pcDirty, pcClean, pcActive} PROJECT_CHANGE_TYPE;
+typedef enum {pcAdd, pcRemove, pcEdit, pcClear, pcDirty, pcClean, pcActive, pcRefresh} PROJECT_CHANGE_TYPE;
 
 class FolderAdder;
-class MagicFolderAdder;
 class MagicFolderCache;
+class MagicFolderSnapshot;
 
 template <class TProjectItem>
 struct ProjectTypeTraits { };
@@ -51,6 +74,35 @@ template<> struct ProjectTypeTraits<MagicFolder> { static inline PROJECT_TYPE Ge
 template<> struct ProjectTypeTraits<Project> { static inline PROJECT_TYPE GetType() { return ptProject; } static inline bool CanChangeFrom(PROJECT_TYPE type) { return type == ptProject; } };
 template<> struct ProjectTypeTraits<Workspace> { static inline PROJECT_TYPE GetType() { return ptWorkspace; } static inline bool CanChangeFrom(PROJECT_TYPE type) { return type == ptWorkspace; } };
 
+/**
+ * A path shared by many project items, such as the base path of every folder
+ * in a tree. Equal paths share one reference counted copy, which is freed
+ * with the last item using it. Project items are only created, changed and
+ * destroyed on the UI thread so the pool takes no lock.
+ */
+class PooledPath
+{
+	public:
+		PooledPath();
+		explicit PooledPath(LPCTSTR path);
+		PooledPath(const PooledPath& other);
+		~PooledPath();
+
+		PooledPath& operator=(const PooledPath& other);
+
+		/// NULL clears the path
+		PooledPath& operator=(LPCTSTR path);
+
+		/// NULL when no path is set
+		operator LPCTSTR() const;
+
+	private:
+		void acquire(LPCTSTR path);
+		void release();
+
+		std::pair<const tstring, int>* m_entry;
+};
+
 /**
  * Base-type for all Projects objects
  */
@@ -112,13 +164,23 @@ class File : public ProjectType
 
 		bool Rename(LPCTSTR newFilePart);		
 
+		/**
+		 * The file has been renamed on disk by someone else, update to match.
+		 */
+		void Renamed(LPCTSTR newFilePart);
+
 	protected:
 		void SetFolder(Folder* folder);
+		void setFilePart(LPCTSTR newFilePart);
+		void setRelativePath(const tstring& path);
 
 	protected:
-		tstring displayName;
+		/// The display name and usually the relative path are the tail of fullPath
 		tstring fullPath;
-		tstring relPath;
+		size_t	nameStart;
+		size_t	relStart;
+		/// Pooled relative path when it isn't the tail of fullPath, else NULL
+		PooledPath	relPath;
 		Folder*	parentFolder;
 };
 
@@ -128,6 +190,7 @@ class File : public ProjectType
 class Folder : public ProjectType
 {
 	friend class File;
+	friend class FileIndex;
 
 	public:
 		explicit Folder();
@@ -149,6 +212,13 @@ class Folder : public ProjectType
 		virtual const FILE_LIST&	GetFiles();
 
 		void GetAllFiles(std::vector<tstring>& files);
+		void GetAllFiles(const FileCallback& callback);
+
+		/**
+		 * Like GetAllFiles, but magic folders that haven't been read are
+		 * added to unread instead of being read from disk now.
+		 */
+		void GetAllFiles(const FileCallback& callback, MAGICFOLDER_SOURCES& unread);
 
 		File* FindFile(LPCTSTR filename);
 		File* FindRelativeFile(LPCTSTR filename);
@@ -174,11 +244,17 @@ class Folder : public ProjectType
 		virtual void notify(PROJECT_CHANGE_TYPE changeType);
 		virtual void notify(PROJECT_CHANGE_TYPE changeType, ProjectType* changeItem);
 		virtual void notify(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem);
+		virtual void updateIndex(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem);
+
+		File* findFile(const tstring& filename);
+		File* findRelativeFile(const tstring& filename);
+
+		void getAllFiles(const FileCallback& callback, std::unordered_set<tstring>& seen, MAGICFOLDER_SOURCES* unread);
 
 	protected:
 		bool		m_canNotify;
 		tstring		name;
-		tstring		basePath;
+		PooledPath	basePath;
 		FOLDER_LIST	children;
 		FILE_LIST	files;
 		Folder*		parent;
@@ -188,6 +264,7 @@ class MagicFolder : public Folder
 {
 	friend class MagicFolderCache;
 	friend class Project;
+	friend class ProjectWriter;
 
 	public:
 		MagicFolder(LPCTSTR name_, /*LPCTSTR path,*/ LPCTSTR basePath);
@@ -197,9 +274,36 @@ class MagicFolder : public Folder
 		virtual const FILE_LIST&	GetFiles();
 
 		void SetGotContents(bool bGotContents);
+		bool GetGotContents() const;
 
+		MagicFolderSource GetSource() const;
+
+		/**
+		 * Read the contents of this folder (one directory level) now.
+		 */
 		void Refresh();
 
+		/**
+		 * Fill in the contents from a directory listing, used by Refresh and
+		 * when applying the results of an asynchronous MagicFolderLoader.
+		 * Cached user data is applied to each item as it's added. None of
+		 * these mark the project dirty, the watcher only sees a pcRefresh
+		 * for this folder from BeginLoad.
+		 */
+		void BeginLoad();
+		ProjectType* AddLoadedItem(LPCTSTR name, bool isFolder);
+		void EndLoad();
+
+		/**
+		 * Apply a change seen by a directory watcher, paths are relative to
+		 * this folder's directory. Changes inside folders that haven't been
+		 * read are ignored, they're picked up when the folder is read. The
+		 * watcher is told about each change but the project isn't dirtied.
+		 */
+		void ApplyAdd(LPCTSTR path, bool isFolder);
+		void ApplyRemove(LPCTSTR path);
+		void ApplyRename(LPCTSTR oldPath, LPCTSTR newPath, bool isFolder);
+
 		LPCTSTR GetFullPath() const;
 		void SetFullPath(LPCTSTR newPath);
 
@@ -214,10 +318,28 @@ class MagicFolder : public Folder
 
 		bool RenameFolder(LPCTSTR newName);
 
+		/**
+		 * Marks this folder as changed since the project was saved, so it
+		 * can't be written from the last saved XML.
+		 */
+		virtual void SetDirty();
+
 	protected:
 		tstring GetFolderCachePath();
 
-		void HandleReadCache(XMLParser* parser, XMLParseState* parent);
+		/**
+		 * @param document Whole project file being parsed, if it can be used
+		 * to keep the XML for this folder, otherwise NULL
+		 */
+		void HandleReadCache(XMLParser* parser, XMLParseState* parent, const std::string* document);
+
+		MagicFolderCache* getCache();
+
+		ProjectType* createItem(LPCTSTR name, bool isFolder);
+		MagicFolder* findLoadedFolder(const tstring& relativePath);
+		MagicFolder* findChild(LPCTSTR name);
+		File* findChildFile(LPCTSTR name);
+		bool removeItem(LPCTSTR name);
 
 		static tstring getMagicFolderPath(MagicFolder* last);
 
@@ -228,6 +350,40 @@ class MagicFolder : public Folder
 		tstring				folderFilter;		
 		bool				read;
 		MagicFolderCache*	cache;
+		/// SetDirty has been called since the last load or save
+		bool				m_changed;
+		/// XML last loaded or saved, top-level magic folders only
+		MagicFolderSnapshot* m_snapshot;
+};
+
+/**
+ * The XML last loaded or saved for a top-level magic folder, along with
+ * where each magic folder element inside it is, keyed by folder cache path
+ * (see MagicFolderCache). Magic folders that haven't changed since are
+ * written straight from this rather than being serialised again, and
+ * folders that have never been read don't need reading to be saved.
+ */
+class MagicFolderSnapshot
+{
+	public:
+		class Range
+		{
+			public:
+				Range() : Start(0), End(0) {}
+				Range(size_t start, size_t end) : Start(start), End(end) {}
+
+				size_t Start;
+				size_t End;
+		};
+
+		typedef std::map<tstring, Range> RANGE_MAP;
+
+		/// UTF-8 XML of the whole top-level MagicFolder element
+		std::string Xml;
+		/// Element positions in Xml
+		RANGE_MAP Ranges;
+		/// Attributes of the top-level element, see ProjectWriter
+		tstring Signature;
 };
 
 typedef struct tagTStringStack
@@ -249,10 +405,16 @@ typedef struct tagTStringStack
 class MagicFolderCache : XMLParseState
 {
 	public:
-		MagicFolderCache(LPCTSTR name, XMLParser* parser, XMLParseState* parent);
+		/**
+		 * @param document Whole document being parsed, may be NULL
+		 * @param snapshot Filled in with the XML of the magic folder from
+		 * document, may be NULL
+		 */
+		MagicFolderCache(LPCTSTR name, XMLParser* parser, XMLParseState* parent, const std::string* document, MagicFolderSnapshot* snapshot);
 		~MagicFolderCache();
 
 		Folder* GetCachedFolder(MagicFolder* actual);
+		File* GetCachedFile(MagicFolder* actual, LPCTSTR filename);
 
 		virtual void startElement(LPCTSTR name, const XMLAttributes& atts);
 		virtual void endElement(LPCTSTR name);
@@ -261,9 +423,13 @@ class MagicFolderCache : XMLParseState
 	protected:
 		void processUserData(LPCTSTR name, const XMLAttributes& atts);
 		void processFile(const XMLAttributes& atts);
+		void startRange();
+		void endRange();
+		void finishSnapshot();
 
 	protected:
 		class FolderMap;
+		class FileMap;
 
 		XMLParser*		_parser;
 		XMLParseState*	_parent;
@@ -271,7 +437,10 @@ class MagicFolderCache : XMLParseState
 		Folder*			_current;
 		File*			_currentFile;
 		FolderMap*		_map;
+		FileMap*		_files;
 		int				_depth;
+		const std::string*	_document;
+		MagicFolderSnapshot*	_snapshot;
 
 		// Like Project
 		Folder*			currentFolder;
@@ -308,6 +477,8 @@ class Project : public Folder, XMLParseState
 		ProjectTemplate* GetTemplate() const;
 		ProjectViewState* GetViewState();
 
+		Workspace* GetWorkspace() const;
+
 		void SaveViewState();
 
 	//Implement XMLParseState
@@ -323,6 +494,7 @@ class Project : public Folder, XMLParseState
 		friend class ProjectWriter;
 
 		virtual void notify(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem);
+		virtual void updateIndex(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem);
 
 		void setWorkspace(Workspace* workspace);
 
@@ -338,6 +510,8 @@ class Project : public Folder, XMLParseState
 
 	protected:
 		XMLParser*			theParser;
+		/// Whole file being parsed, NULL if magic folders can't use it
+		const std::string*	theDocument;
 		Folder*				currentFolder;
 		File*				lastParsedFile;
 		XmlNode*			lastNode;
@@ -359,11 +533,68 @@ typedef std::list<Project*>		PROJECT_LIST;
 typedef PROJECT_LIST::iterator	PL_IT;
 typedef PROJECT_LIST::const_iterator	PL_CIT;
 
+/**
+ * @brief Case-folded index of the files in a workspace.
+ *
+ * Files are indexed by full path and by filename part. The index walks the
+ * raw folder contents, so magic folders are only included once they have
+ * been enumerated.
+ */
+class FileIndex
+{
+	public:
+		/**
+		 * Add a file, or all of the files below a folder or project. Adding a
+		 * file again updates its keys.
+		 */
+		void Add(ProjectType* item);
+		
+		/**
+		 * Remove a file, or all of the files below a folder or project.
+		 */
+		void Remove(ProjectType* item);
+		
+		void Clear();
+
+		/**
+		 * Find a file by its full path.
+		 * @param within Only return files below this folder, may be NULL.
+		 */
+		File* Find(LPCTSTR filename, Folder* within) const;
+
+		/**
+		 * Find a file purely by its filename part, ignoring any path.
+		 * @param within Only return files below this folder, may be NULL.
+		 * @param preferred Prefer files below this folder, may be NULL.
+		 */
+		File* FindByName(LPCTSTR filename, Folder* within, Folder* preferred) const;
+
+	protected:
+		typedef std::unordered_multimap<tstring, File*> MAP_FILES;
+		typedef std::pair<tstring, tstring> FileKeys;
+		typedef std::unordered_map<File*, FileKeys> MAP_KEYS;
+
+		void addFile(File* file);
+		void removeFile(File* file);
+		void addFolder(Folder* folder);
+		void removeFolder(Folder* folder);
+
+		static void erase(MAP_FILES& map, const tstring& key, File* file);
+		static bool contains(Folder* folder, File* file);
+
+	protected:
+		MAP_FILES	byPath;
+		MAP_FILES	byName;
+		MAP_KEYS	keys;
+};
+
 /**
  * @brief Represents a collection of Projects.
  */
 class Workspace : public ProjectType, XMLParseState
 {
+	friend class Project;
+
 	public:
 		Workspace();
 		Workspace(LPCTSTR projectFile);
@@ -392,7 +623,8 @@ class Workspace : public ProjectType, XMLParseState
 		bool IsDirty(bool bRecurse = true);
 		virtual void SetDirty();
 
-		File* FindFile(LPCTSTR filename);
+		File* FindFile(LPCTSTR filename, Folder* within = NULL);
+		File* FindRelativeFile(LPCTSTR filename, Folder* within = NULL, Folder* preferred = NULL);
 
 		Projects::Project* GetActiveProject();
 		void SetActiveProject(Projects::Project* project);
@@ -411,6 +643,7 @@ class Workspace : public ProjectType, XMLParseState
 	protected:
 		void parse();
 		void Clear();
+		void updateIndex(PROJECT_CHANGE_TYPE changeType, Folder* changeContainer, ProjectType* changeItem);
 
 	protected:
 		int					parseState;
@@ -420,6 +653,7 @@ class Workspace : public ProjectType, XMLParseState
 		bool				bDirty;
 		Projects::Project*	activeProject;
 		IProjectWatcher*	watcher;
+		FileIndex			fileIndex;
 };
 
 class ProjectViewState : XMLParseState
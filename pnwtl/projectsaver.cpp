@@ -0,0 +1,304 @@
+/**
+ * @file projectsaver.cpp
+ * @brief Write project and workspace files in the background.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "projectsaver.h"
+#include "include/tempfile.h"
+
+#if defined (_DEBUG)
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace Projects;
+using pnutils::threading::CritLock;
+
+//////////////////////////////////////////////////////////////////////////////
+// ProjectSaveQueue
+//////////////////////////////////////////////////////////////////////////////
+
+ProjectSaveQueue::ProjectSaveQueue()
+{
+}
+
+ProjectSaveQueue::~ProjectSaveQueue()
+{
+	for (std::deque<ProjectSaveJob*>::iterator i = m_queue.begin(); i != m_queue.end(); ++i)
+	{
+		delete (*i);
+	}
+}
+
+bool ProjectSaveQueue::Coalesce(LPCTSTR filename, std::string& contents)
+{
+	for (std::deque<ProjectSaveJob*>::iterator i = m_queue.begin(); i != m_queue.end(); ++i)
+	{
+		if (_tcsicmp((*i)->FileName.c_str(), filename) == 0)
+		{
+			(*i)->Contents.swap(contents);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ProjectSaveQueue::Add(ProjectSaveJob* job)
+{
+	m_queue.push_back(job);
+}
+
+ProjectSaveJob* ProjectSaveQueue::Next()
+{
+	if (m_queue.empty())
+	{
+		return NULL;
+	}
+
+	ProjectSaveJob* job = m_queue.front();
+	m_queue.pop_front();
+	m_writing = job->FileName;
+
+	return job;
+}
+
+void ProjectSaveQueue::Done()
+{
+	m_writing.clear();
+}
+
+bool ProjectSaveQueue::IsBusy(LPCTSTR filename) const
+{
+	if (_tcsicmp(m_writing.c_str(), filename) == 0)
+	{
+		return true;
+	}
+
+	for (std::deque<ProjectSaveJob*>::const_iterator i = m_queue.begin(); i != m_queue.end(); ++i)
+	{
+		if (_tcsicmp((*i)->FileName.c_str(), filename) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ProjectSaveQueue::IsIdle() const
+{
+	return m_queue.empty() && m_writing.empty();
+}
+
+size_t ProjectSaveQueue::GetCount() const
+{
+	return m_queue.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ProjectSaver
+//////////////////////////////////////////////////////////////////////////////
+
+ProjectSaver::ProjectSaver() :
+	m_hWndNotify(NULL),
+	m_notifyMessage(0),
+	m_queued(false),
+	m_written(true),
+	m_thread(this, &ProjectSaver::run)
+{
+	m_thread.Start();
+}
+
+ProjectSaver::~ProjectSaver()
+{
+	WaitAll();
+	m_thread.Stop();
+}
+
+bool ProjectSaver::Save(LPCTSTR filename, std::string& contents)
+{
+	{
+		CritLock lock(m_cs);
+
+		// A save of this file that hasn't started yet just gets the new contents:
+		if (m_queue.Coalesce(filename, contents))
+		{
+			return true;
+		}
+	}
+
+	TempFileName temp(filename, NULL, true, true);
+
+	HANDLE hFile = ::CreateFile(temp.t_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	ProjectSaveJob* job = new ProjectSaveJob;
+	job->FileName = filename;
+	job->TempFileName = temp.t_str();
+	job->File = hFile;
+	job->Contents.swap(contents);
+
+	{
+		CritLock lock(m_cs);
+		m_queue.Add(job);
+	}
+
+	m_queued.Set();
+
+	return true;
+}
+
+void ProjectSaver::Wait(LPCTSTR filename)
+{
+	for (;;)
+	{
+		{
+			CritLock lock(m_cs);
+			if (!m_queue.IsBusy(filename))
+			{
+				return;
+			}
+
+			m_written.Reset();
+		}
+
+		m_written.Wait(INFINITE);
+	}
+}
+
+void ProjectSaver::WaitAll()
+{
+	for (;;)
+	{
+		{
+			CritLock lock(m_cs);
+			if (m_queue.IsIdle())
+			{
+				return;
+			}
+
+			m_written.Reset();
+		}
+
+		m_written.Wait(INFINITE);
+	}
+}
+
+void ProjectSaver::SetNotifyWindow(HWND hWnd, UINT message)
+{
+	CritLock lock(m_cs);
+	m_hWndNotify = hWnd;
+	m_notifyMessage = message;
+}
+
+void ProjectSaver::TakeFailures(std::vector<tstring>& failed)
+{
+	CritLock lock(m_cs);
+	failed.insert(failed.end(), m_failed.begin(), m_failed.end());
+	m_failed.clear();
+}
+
+void ProjectSaver::run(CSSThread* thread)
+{
+	HANDLE handles[2] = { thread->GetStopHandle(), m_queued.Get() };
+
+	while (thread->GetCanRun())
+	{
+		ProjectSaveJob* job(NULL);
+
+		{
+			CritLock lock(m_cs);
+			job = m_queue.Next();
+		}
+
+		if (job != NULL)
+		{
+			if (!write(*job))
+			{
+				failed(job->FileName);
+			}
+
+			delete job;
+
+			{
+				CritLock lock(m_cs);
+				m_queue.Done();
+			}
+
+			m_written.Set();
+		}
+		else
+		{
+			::WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+		}
+	}
+}
+
+bool ProjectSaver::write(ProjectSaveJob& job)
+{
+	PNTRACE_SPAN("project", "ProjectSaver::write");
+
+	DWORD written(0);
+	bool ok = ::WriteFile(job.File, job.Contents.data(), static_cast<DWORD>(job.Contents.size()), &written, NULL) != FALSE
+		&& written == job.Contents.size();
+
+	::CloseHandle(job.File);
+
+	if (ok)
+	{
+		// ReplaceFile keeps the attributes of the original, it has to exist though:
+		if (FileExists(job.FileName.c_str()))
+		{
+			ok = ::ReplaceFile(job.FileName.c_str(), job.TempFileName.c_str(), NULL, REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL) != FALSE;
+		}
+		else
+		{
+			ok = ::MoveFileEx(job.TempFileName.c_str(), job.FileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+		}
+	}
+
+	if (!ok)
+	{
+		::DeleteFile(job.TempFileName.c_str());
+	}
+
+	return ok;
+}
+
+/**
+ * The project was marked clean when it was queued, the UI has to know it
+ * wasn't saved after all.
+ */
+void ProjectSaver::failed(const tstring& filename)
+{
+	tstring msg(_T("PN2: Failed to write "));
+	msg += filename;
+	msg += _T("\n");
+	LOG(msg.c_str());
+
+	HWND hWndNotify;
+	UINT notifyMessage;
+
+	{
+		CritLock lock(m_cs);
+		m_failed.push_back(filename);
+		hWndNotify = m_hWndNotify;
+		notifyMessage = m_notifyMessage;
+	}
+
+	if (hWndNotify != NULL)
+	{
+		::PostMessage(hWndNotify, notifyMessage, 0, 0);
+	}
+}
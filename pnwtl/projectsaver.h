@@ -0,0 +1,163 @@
+/**
+ * @file projectsaver.h
+ * @brief Write project and workspace files in the background.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef projectsaver_h__included
+#define projectsaver_h__included
+
+#include "include/ssthreads.h"
+#include "include/threading.h"
+
+#include <deque>
+#include <vector>
+
+namespace Projects
+{
+
+/**
+ * A serialised file waiting to be written, see ProjectSaver.
+ */
+class ProjectSaveJob
+{
+	public:
+		tstring FileName;
+		tstring TempFileName;
+		/// Open handle to TempFileName
+		HANDLE File;
+		std::string Contents;
+};
+
+/**
+ * The saves waiting for ProjectSaver's worker, and the one it's writing.
+ * Saving a file that's already queued replaces the contents of the queued
+ * save. This isn't locked, ProjectSaver holds its lock around each call.
+ */
+class ProjectSaveQueue
+{
+	public:
+		ProjectSaveQueue();
+
+		/**
+		 * Deletes any jobs that were never written.
+		 */
+		~ProjectSaveQueue();
+
+		/**
+		 * If a save of filename is queued and hasn't started, swap contents
+		 * into it.
+		 * @return true if contents was taken by a queued save
+		 */
+		bool Coalesce(LPCTSTR filename, std::string& contents);
+
+		/**
+		 * Queue a job, the queue owns it until it's returned by Next.
+		 */
+		void Add(ProjectSaveJob* job);
+
+		/**
+		 * Take the next job to write, it's busy until Done is called.
+		 * @return NULL if there's nothing queued
+		 */
+		ProjectSaveJob* Next();
+
+		/**
+		 * The job returned by Next has been written, or failed.
+		 */
+		void Done();
+
+		/**
+		 * @return true if a save of filename is queued or being written
+		 */
+		bool IsBusy(LPCTSTR filename) const;
+
+		/**
+		 * @return true if nothing is queued or being written
+		 */
+		bool IsIdle() const;
+
+		size_t GetCount() const;
+
+	private:
+		ProjectSaveQueue(const ProjectSaveQueue&);
+		ProjectSaveQueue& operator=(const ProjectSaveQueue&);
+
+		std::deque<ProjectSaveJob*> m_queue;
+		/// File being written by the worker, empty if none
+		tstring m_writing;
+};
+
+/**
+ * Writes serialised project, workspace and view state files on a worker
+ * thread. Each file is written in one go to a temporary file next to it
+ * which then replaces the original, so a failed save never leaves a half
+ * written project behind. Saves of a file that haven't started yet are
+ * replaced by later saves of the same file, so a burst of saves costs one
+ * write.
+ */
+class ProjectSaver : public Singleton<ProjectSaver, SINGLETON_AUTO_DELETE>
+{
+	friend class Singleton<ProjectSaver, SINGLETON_AUTO_DELETE>;
+
+	public:
+		/**
+		 * Writes anything still queued before stopping.
+		 */
+		~ProjectSaver();
+
+		/**
+		 * Queue contents to be written to filename. The temporary file is
+		 * created straight away so that failures can be reported to the
+		 * user, contents is swapped out to avoid copying it.
+		 * @return false if the file can't be written
+		 */
+		bool Save(LPCTSTR filename, std::string& contents);
+
+		/**
+		 * Wait for any queued or running save of filename, call this before
+		 * reading a file that may have just been saved.
+		 */
+		void Wait(LPCTSTR filename);
+
+		/**
+		 * Wait for all queued and running saves.
+		 */
+		void WaitAll();
+
+		/**
+		 * message is posted to hWnd when a file couldn't be written, call
+		 * TakeFailures from there to find out which.
+		 */
+		void SetNotifyWindow(HWND hWnd, UINT message);
+
+		/**
+		 * Move the names of the files that couldn't be written since the
+		 * last call into failed.
+		 */
+		void TakeFailures(std::vector<tstring>& failed);
+
+	private:
+		ProjectSaver();
+
+		void run(CSSThread* thread);
+		bool write(ProjectSaveJob& job);
+		void failed(const tstring& filename);
+
+		ProjectSaveQueue m_queue;
+		std::vector<tstring> m_failed;
+		HWND m_hWndNotify;
+		UINT m_notifyMessage;
+		pnutils::threading::CriticalSection m_cs;
+		pnutils::threading::WinEvent m_queued;
+		pnutils::threading::WinEvent m_written;
+		CSSThreadT<ProjectSaver> m_thread;
+};
+
+} // namespace Projects
+
+#endif // #ifndef projectsaver_h__included
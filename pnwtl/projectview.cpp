@@ -14,11 +14,14 @@
 #include "include/filefinder.h"
 #include "project.h"
 #include "projectprops.h"
+#include "magicfolderloader.h"
+#include "magicfolderwatcher.h"
 #include "projectview.h"
 #include "pndialogs.h"
 #include "MagicFolderWiz.h"
 #include "projpropsview.h"
 #include "ExplorerMenu.h"
+#include "batchexport.h"
 
 using namespace Projects;
 
@@ -36,7 +39,9 @@ CProjectTreeCtrl::CProjectTreeCtrl() :
 	processNotifications(true),
 	shellImages(new ShellImageList()),
 	m_explorerMenu(new ShellContextMenu()),
-	m_addingMagicFolder(false)
+	m_addingMagicFolder(false),
+	m_magicLoader(NULL),
+	m_magicWatcher(NULL)
 {
 	projectIcon = shellImages->AddIcon( ::LoadIcon( _Module.m_hInst, MAKEINTRESOURCE(IDI_PROJECTFOLDER)) );
 	badProjectIcon = shellImages->AddIcon( ::LoadIcon( _Module.m_hInst, MAKEINTRESOURCE(IDI_BADPROJECT)) );
@@ -54,6 +59,8 @@ CProjectTreeCtrl::~CProjectTreeCtrl()
 
 	delete shellImages;
 	delete m_explorerMenu;
+	delete m_magicLoader;
+	delete m_magicWatcher;
 }
 
 HWND CProjectTreeCtrl::Create(HWND hWndParent, _U_RECT rect, LPCTSTR szWindowName ,
@@ -64,6 +71,9 @@ HWND CProjectTreeCtrl::Create(HWND hWndParent, _U_RECT rect, LPCTSTR szWindowNam
 
 	SetImageList(shellImages->GetImageList(), TVSIL_NORMAL);
 
+	m_magicLoader = new MagicFolderLoader(hWndRet);
+	m_magicWatcher = new MagicFolderWatcher(hWndRet);
+
 	// Create an IDropTarget helper
 	CComObject<DropTarget>::CreateInstance(&m_pDropTarget);
 	m_pDropTarget->AddRef();
@@ -114,6 +124,15 @@ void CProjectTreeCtrl::SetWorkspace(Projects::Workspace* ws)
 
 	workspace = ws;
 
+	// Nothing still loading or watched belongs to the new tree:
+	if(m_magicLoader != NULL)
+		m_magicLoader->CancelAll();
+	m_magicLoads.clear();
+
+	if(m_magicWatcher != NULL)
+		m_magicWatcher->UnwatchAll();
+	m_magicWatches.clear();
+
 	clearTree();
 
 	if(workspace != NULL)
@@ -143,34 +162,61 @@ void CProjectTreeCtrl::OnProjectItemChange(PROJECT_CHANGE_TYPE changeType, Proje
 				// Added a file.
 				PNASSERT(changeContainer != NULL);
 				HTREEITEM hParent = findFolder(changeContainer);
-				PNASSERT(hParent != NULL);
 
-				HTREEITEM hLastFolder = getLastFolderItem(hParent);
-				
 				if(hParent != NULL)
 				{
-					addFileNode(CastProjectItem<File>(changeItem), hParent, hLastFolder);
-					SortChildren(hParent);
-					Expand(hParent);
+					if(changeContainer->GetType() == ptMagicFolder)
+					{
+						// Found on disk, don't disturb the view. Folders not
+						// built yet pick the file up when they're expanded.
+						if(m_unbuilt.find(changeContainer) == m_unbuilt.end())
+						{
+							addFileNode(CastProjectItem<File>(changeItem), hParent, getLastFolderItem(hParent));
+							sort(hParent);
+						}
+					}
+					else
+					{
+						if(!ensureBuilt(changeContainer, hParent))
+							addFileNode(CastProjectItem<File>(changeItem), hParent, getLastFolderItem(hParent));
+
+						SortChildren(hParent);
+						Expand(hParent);
+					}
 				}
 			}
 			else if(changeItem->GetType() == ptFolder || changeItem->GetType() == ptMagicFolder)
 			{
 				PNASSERT(changeContainer != NULL);
 				HTREEITEM hParent = findFolder(changeContainer);
-				PNASSERT(hParent != NULL);
 
 				if(hParent != NULL)
 				{
 					Projects::Folder* folder = CastProjectItem<Projects::Folder>(changeItem);
-					
-					FOLDER_LIST fl;
-					fl.push_back(folder);
+					bool magic = changeContainer->GetType() == ptMagicFolder;
+
+					if(m_unbuilt.find(changeContainer) != m_unbuilt.end())
+					{
+						// The new folder is shown along with the rest:
+						if(!magic)
+						{
+							ensureBuilt(changeContainer, hParent);
+							Expand(hParent);
+						}
+					}
+					else
+					{
+						FOLDER_LIST fl;
+						fl.push_back(folder);
 
-					ProjectViewState state;
-					buildFolders(hParent, fl, state);
+						ProjectViewState state;
+						buildFolders(hParent, fl, state);
 
-					Expand(hParent);
+						if(magic)
+							sort(hParent);
+						else
+							Expand(hParent);
+					}
 				}
 			}
 			else if(changeItem->GetType() == ptProject)
@@ -221,19 +267,56 @@ void CProjectTreeCtrl::OnProjectItemChange(PROJECT_CHANGE_TYPE changeType, Proje
 		{
 			if(changeItem->GetType() == ptFile)
 			{
-				// Removed a file.
+				// Removed a file, which may never have been shown.
 				PNASSERT(changeContainer != NULL);
-				HTREEITEM hParent = findFolder(changeContainer);
-				PNASSERT(hParent != NULL);
-
-				HTREEITEM hItem = findItem(changeItem, hParent);
-				DeleteItem( hItem );
+				HTREEITEM hItem = findItem(changeItem, NULL);
+				if(hItem != NULL)
+					DeleteItem( hItem );
 			}
 			else if (changeItem->GetType() == ptMagicFolder)
 			{
+				cancelMagicFolderLoads(CastProjectItem<Projects::Folder>(changeItem));
+				unwatchMagicFolders(CastProjectItem<Projects::Folder>(changeItem));
+
 				HTREEITEM hFolder = findFolder(CastProjectItem<Projects::Folder>(changeItem));
-				PNASSERT(hFolder != NULL);
-				DeleteItem(hFolder);
+				if(hFolder != NULL)
+					DeleteItem(hFolder);
+			}
+		}
+		break;
+
+		case pcEdit:
+		{
+			if(changeItem->GetType() == ptFile)
+			{
+				// A file has been renamed.
+				HTREEITEM hFile = findItem(changeItem, NULL);
+				if(hFile != NULL)
+				{
+					File* file = CastProjectItem<File>(changeItem);
+					SetItemText(hFile, file->GetDisplayName());
+
+					int index = shellImages->IndexForFile( file->GetFileName() );
+					SetItemImage(hFile, index, index);
+
+					sort(GetParentItem(hFile));
+				}
+			}
+		}
+		break;
+
+		case pcRefresh:
+		{
+			// A magic folder is being read again by someone else, anything we
+			// have for its old contents is about to go away.
+			MagicFolder* folder = CastProjectItem<MagicFolder>(changeItem);
+			cancelMagicFolderLoads(folder);
+
+			HTREEITEM hFolder = findFolder(folder);
+			if(hFolder != NULL)
+			{
+				Expand(hFolder, TVE_COLLAPSE | TVE_COLLAPSERESET);
+				resetMagicFolderNode(hFolder);
 			}
 		}
 		break;
@@ -243,7 +326,7 @@ void CProjectTreeCtrl::OnProjectItemChange(PROJECT_CHANGE_TYPE changeType, Proje
 HTREEITEM CProjectTreeCtrl::addFileNode(File* file, HTREEITEM hParent, HTREEITEM hInsertAfter)
 {
 	HTREEITEM hFile = InsertItem( file->GetDisplayName(), 0, 0, hParent, hInsertAfter );
-	SetItemData(hFile, reinterpret_cast<DWORD_PTR>( file ));
+	setNodeItem(hFile, file);
 
 	int index = shellImages->IndexForFile( file->GetFileName() );
 	SetItemImage(hFile, index, index);
@@ -254,7 +337,14 @@ HTREEITEM CProjectTreeCtrl::addFileNode(File* file, HTREEITEM hParent, HTREEITEM
 HTREEITEM CProjectTreeCtrl::addFolderNode(Projects::Folder* folder, HTREEITEM hParent, HTREEITEM hInsertAfter)
 {
 	HTREEITEM hFolder = InsertItem( folder->GetName(), 0, 0, hParent, hInsertAfter );
-	SetItemData(hFolder, reinterpret_cast<DWORD_PTR>( folder ));
+	setNodeItem(hFolder, folder);
+
+	// The expand button comes from the folder itself, see OnGetDispInfo:
+	TVITEM tvi = {0};
+	tvi.mask = TVIF_CHILDREN;
+	tvi.hItem = hFolder;
+	tvi.cChildren = I_CHILDRENCALLBACK;
+	SetItem(&tvi);
 
 	if(folder->GetType() == ptMagicFolder)
 		SetItemImage(hFolder, magicFolderIcon, magicFolderIcon);
@@ -268,7 +358,7 @@ void CProjectTreeCtrl::buildTree()
 	SetRedraw(FALSE);
 
 	HTREEITEM hTopItem = InsertItem( workspace->GetName(), workspaceIcon, workspaceIcon, NULL, NULL );
-	SetItemData(hTopItem, reinterpret_cast<DWORD_PTR>( workspace ));
+	setNodeItem(hTopItem, workspace);
 	const PROJECT_LIST& projects = workspace->GetProjects();
 
 	for(PROJECT_LIST::const_iterator i = projects.begin(); i != projects.end(); ++i)
@@ -289,7 +379,7 @@ HTREEITEM CProjectTreeCtrl::buildProject(HTREEITEM hParentNode, Projects::Projec
 		projname += _T(" *");
 	HTREEITEM hProject = InsertItem( projname.c_str(), projectIcon, projectIcon, hParentNode, hInsertAfter );
 	ProjectType* pPT = static_cast<ProjectType*>(pj);
-	SetItemData(hProject, reinterpret_cast<DWORD_PTR>( pPT ));
+	setNodeItem(hProject, pPT);
 
 	if(pj->Exists())
 	{
@@ -319,28 +409,79 @@ HTREEITEM CProjectTreeCtrl::buildProject(HTREEITEM hParentNode, Projects::Projec
 HTREEITEM CProjectTreeCtrl::buildFolders(HTREEITEM hParentNode, const FOLDER_LIST& folders, Projects::ProjectViewState& viewState)
 {
 	HTREEITEM hFolder = getLastFolderItem(hParentNode);
-	HTREEITEM hLastChild = NULL;
 
 	for(FOLDER_LIST::const_iterator i = folders.begin(); i != folders.end(); ++i)
 	{
 		hFolder = addFolderNode((*i), hParentNode, hFolder);
-		
-		const FOLDER_LIST& folders2 = (*i)->GetFolders();
-		if( folders2.size() > 0 )
-			hLastChild = buildFolders(hFolder, folders2, viewState);
 
-		const FILE_LIST& files = (*i)->GetFiles();
-		hLastChild = buildFiles(hFolder, hLastChild, files);
+		if((*i)->GetType() == ptMagicFolder)
+		{
+			// Magic folders are only read when they're expanded.
+			MagicFolder* mf = static_cast<MagicFolder*>(*i);
+			bool expand = viewState.ShouldExpand(mf);
 
-		sort(hFolder);
+			// Changes on disk are picked up by watching the top of each tree:
+			if(mf->GetParent() == NULL || mf->GetParent()->GetType() != ptMagicFolder)
+				watchMagicFolder(mf);
+
+			if(mf->GetGotContents())
+			{
+				if(expand)
+				{
+					buildFolderContents(mf, hFolder, viewState);
+					Expand(hFolder);
+				}
+				else
+				{
+					m_unbuilt.insert(mf);
+				}
+			}
+			else
+			{
+				// Expand doesn't send TVN_ITEMEXPANDING, so start reading here
+				// and expand when the first items arrive.
+				resetMagicFolderNode(hFolder);
+				if(expand)
+					loadMagicFolder(mf, hFolder, true);
+			}
 
+			continue;
+		}
+		
+		// Collapsed folders get their children when they're first expanded:
 		if( viewState.ShouldExpand((*i)) )
+		{
+			buildFolderContents((*i), hFolder, viewState);
 			Expand(hFolder);
+		}
+		else
+		{
+			m_unbuilt.insert(*i);
+		}
 	}
 
 	return hFolder;
 }
 
+/**
+ * Add the children of a folder node, sub-folders are only built if the
+ * view state says they're expanded.
+ */
+void CProjectTreeCtrl::buildFolderContents(Projects::Folder* folder, HTREEITEM hFolderNode, Projects::ProjectViewState& viewState)
+{
+	m_unbuilt.erase(folder);
+
+	HTREEITEM hLastChild = NULL;
+
+	const FOLDER_LIST& folders = folder->GetFolders();
+	if( folders.size() > 0 )
+		hLastChild = buildFolders(hFolderNode, folders, viewState);
+
+	buildFiles(hFolderNode, hLastChild, folder->GetFiles());
+
+	sort(hFolderNode);
+}
+
 HTREEITEM CProjectTreeCtrl::buildFiles(HTREEITEM hParentNode, HTREEITEM hInsertAfter, const FILE_LIST& files)
 {
 	HTREEITEM hFile = hInsertAfter;
@@ -363,10 +504,28 @@ void CProjectTreeCtrl::clearNode(HTREEITEM hItem)
 	}	
 }
 
+/**
+ * Build the children of folder's node if that hasn't happened yet.
+ * @return true if the children were built now
+ */
+bool CProjectTreeCtrl::ensureBuilt(Projects::Folder* folder, HTREEITEM hFolderNode)
+{
+	if(m_unbuilt.find(folder) == m_unbuilt.end())
+		return false;
+
+	SetRedraw(FALSE);
+	buildFolderContents(folder, hFolderNode, *folder->GetProject()->GetViewState());
+	SetRedraw(TRUE);
+
+	return true;
+}
+
 void CProjectTreeCtrl::clearTree()
 {
 	SetRedraw(FALSE);
 	DeleteAllItems();
+	m_nodes.clear();
+	m_unbuilt.clear();
 	SetRedraw(TRUE);
 }
 
@@ -440,6 +599,7 @@ void CProjectTreeCtrl::doContextMenu(LPPOINT pt)
 			case ptFolder:
 			{
 				CSPopupMenu popup(IDR_POPUP_PROJECTFOLDER);
+				updateExportItems(popup);
 				g_Context.m_frame->TrackPopupMenu(popup, 0, pt->x, pt->y, NULL, m_hWnd);
 			}
 			break;
@@ -456,6 +616,8 @@ void CProjectTreeCtrl::doContextMenu(LPPOINT pt)
 					popup.EnableMenuItem(ID_PROJECT_REMOVE, false);
 				}
 
+				updateExportItems(popup);
+
 				g_Context.m_frame->TrackPopupMenu(popup, 0, pt->x, pt->y, NULL, m_hWnd);
 			}
 			break;
@@ -486,6 +648,8 @@ void CProjectTreeCtrl::doContextMenu(LPPOINT pt)
 						::SetMenuItemInfo(popup, ID_PROJECT_SETACTIVEPROJECT, FALSE, &mii);
 					}
 
+					updateExportItems(popup);
+
 					g_Context.m_frame->TrackPopupMenu(popup, 0, pt->x, pt->y, NULL, m_hWnd);
 				}
 				else
@@ -507,27 +671,15 @@ void CProjectTreeCtrl::doContextMenu(LPPOINT pt)
 	}
 }
 
-HTREEITEM CProjectTreeCtrl::findItem(Projects::ProjectType* item, HTREEITEM startat)
+/**
+ * Find the node for item, every item is only shown once so startat is
+ * no longer needed to narrow the search.
+ */
+HTREEITEM CProjectTreeCtrl::findItem(Projects::ProjectType* item, HTREEITEM /*startat*/)
 {
-	HTREEITEM hN = startat != NULL ? startat : GetRootItem();
-	while(hN)
-	{
-		if(GetItemData(hN) == reinterpret_cast<DWORD_PTR>(item))
-		{
-			return hN;
-		}
-
-		// If we have children, walk'em...
-		HTREEITEM hChild = GetChildItem( hN );
-		if(hChild != NULL)
-		{
-			HTREEITEM ret = findItem(item, hChild);
-			if(ret)
-				return ret;
-		}
-
-		hN = GetNextSiblingItem( hN );
-	}
+	NODE_MAP::const_iterator i = m_nodes.find(item);
+	if(i != m_nodes.end())
+		return (*i).second;
 
 	return NULL;
 }
@@ -636,6 +788,8 @@ void CProjectTreeCtrl::handleRemove()
 			{
 				Projects::Folder* pFolder = reinterpret_cast<Projects::Folder*>( GetItemData((*i)) );
 				Projects::Folder* pParent = pFolder->GetParent();
+				cancelMagicFolderLoads(pFolder);
+				unwatchMagicFolders(pFolder);
 				pParent->RemoveChild(pFolder);
 				DeleteItem((*i));
 			}
@@ -693,6 +847,8 @@ void CProjectTreeCtrl::handleRemove()
 					}
 				}
 
+				cancelMagicFolderLoads(pProject);
+				unwatchMagicFolders(pProject);
 				workspace->RemoveProject(pProject);
 				DeleteItem((*i));
 			}
@@ -721,30 +877,97 @@ void CProjectTreeCtrl::openAll(Projects::Folder* folder)
 
 void CProjectTreeCtrl::refreshMagicFolder(Projects::MagicFolder* folder, HTREEITEM hFolderNode)
 {
-	// Tell the magic folder that we've not got it's contents any more.
-	folder->SetGotContents(false);
+	// Read the folder again in the background, the new contents replace the
+	// old ones as they arrive.
+	loadMagicFolder(folder, hFolderNode, true);
+}
 
-	clearNode(hFolderNode);
+/**
+ * Start reading a magic folder in the background, the results arrive
+ * in PN_MAGICFOLDERBATCH messages.
+ */
+void CProjectTreeCtrl::loadMagicFolder(Projects::MagicFolder* folder, HTREEITEM hFolderNode, bool expand)
+{
+	// Anything already loading in or below this folder is out of date:
+	cancelMagicFolderLoads(folder);
 
-	// Use for expansion state etc.
-	ProjectViewState state;
+	clearNode(hFolderNode);
+	m_unbuilt.erase(folder);
 
+	bool process = processNotifications;
 	processNotifications = false;
+	folder->BeginLoad();
+	processNotifications = process;
 
-	HTREEITEM hLastChild = NULL;
+	m_magicLoads[folder] = MagicFolderLoad(m_magicLoader->Load(folder), expand);
+}
 
-	const FOLDER_LIST& folders2 = folder->GetFolders();
-	if( folders2.size() > 0 )
-		hLastChild = buildFolders(hFolderNode, folders2, state);
+/**
+ * Is folder the same as container, or somewhere below it?
+ */
+static bool isWithin(Projects::Folder* folder, Projects::Folder* container)
+{
+	while(folder != NULL && folder != container)
+		folder = folder->GetParent();
 
-	const FILE_LIST& files = folder->GetFiles();
-	hLastChild = buildFiles(hFolderNode, hLastChild, files);
+	return folder != NULL;
+}
 
-	sort(hFolderNode);
+/**
+ * Cancel background reads of container and any magic folders below it.
+ */
+void CProjectTreeCtrl::cancelMagicFolderLoads(Projects::Folder* container)
+{
+	for(MAGICLOAD_MAP::iterator i = m_magicLoads.begin(); i != m_magicLoads.end(); )
+	{
+		if(isWithin((*i).first, container))
+		{
+			m_magicLoader->Cancel((*i).second.Cookie);
+			i = m_magicLoads.erase(i);
+		}
+		else
+			++i;
+	}
+}
 
-	Expand(hFolderNode);
+/**
+ * Watch a top-level magic folder's directory tree for changes, replacing
+ * any existing watch.
+ */
+void CProjectTreeCtrl::watchMagicFolder(Projects::MagicFolder* folder)
+{
+	MAGICWATCH_MAP::iterator i = m_magicWatches.find(folder);
+	if(i != m_magicWatches.end())
+		m_magicWatcher->Unwatch((*i).second);
+
+	m_magicWatches[folder] = m_magicWatcher->Watch(folder);
+}
+
+/**
+ * Stop watching container and any magic folders below it.
+ */
+void CProjectTreeCtrl::unwatchMagicFolders(Projects::Folder* container)
+{
+	for(MAGICWATCH_MAP::iterator i = m_magicWatches.begin(); i != m_magicWatches.end(); )
+	{
+		if(isWithin((*i).first, container))
+		{
+			m_magicWatcher->Unwatch((*i).second);
+			i = m_magicWatches.erase(i);
+		}
+		else
+			++i;
+	}
+}
 
-	processNotifications = true;	
+/**
+ * Show an unread magic folder with no children, OnGetDispInfo gives it
+ * an expand button.
+ */
+void CProjectTreeCtrl::resetMagicFolderNode(HTREEITEM hFolderNode)
+{
+	clearNode(hFolderNode);
+	m_unbuilt.erase(GetProjectItem<ProjectType>(hFolderNode));
 }
 
 void CProjectTreeCtrl::handleRightClick(LPPOINT pt)
@@ -809,6 +1032,16 @@ void CProjectTreeCtrl::setMagicFolderProps(Projects::UserData& ud, Projects::Mag
 			refreshMagicFolder(folder, hFolder);
 		}
 	}
+
+	// Watch with the new path and filters:
+	if(m_magicWatches.find(folder) != m_magicWatches.end())
+		watchMagicFolder(folder);
+}
+
+void CProjectTreeCtrl::setNodeItem(HTREEITEM hNode, Projects::ProjectType* item)
+{
+	SetItemData(hNode, reinterpret_cast<DWORD_PTR>( item ));
+	m_nodes[item] = hNode;
 }
 
 void CProjectTreeCtrl::setStatus(Projects::ProjectType* selection)
@@ -889,6 +1122,156 @@ void CProjectTreeCtrl::storeViewState(Projects::ProjectViewState* vs, HTREEITEM
 	}
 }
 
+LRESULT CProjectTreeCtrl::OnMagicFolderChanges(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/)
+{
+	std::auto_ptr<MagicFolderChangeBatch> batch(reinterpret_cast<MagicFolderChangeBatch*>(lParam));
+
+	// Changes for folders no longer watched are ignored, the folder may not exist any more.
+	MAGICWATCH_MAP::const_iterator i = m_magicWatches.find(batch->Folder);
+	if(i == m_magicWatches.end() || (*i).second != batch->Cookie)
+		return 0;
+
+	MagicFolder* folder = batch->Folder;
+
+	if(batch->Rescan)
+	{
+		// We missed something, read it all again if we've read it at all:
+		HTREEITEM hFolderNode = findFolder(folder);
+		if(hFolderNode != NULL && folder->GetGotContents())
+			loadMagicFolder(folder, hFolderNode, (GetItemState(hFolderNode, TVIS_EXPANDED) & TVIS_EXPANDED) != 0);
+
+		return 0;
+	}
+
+	// Each change updates the view through OnProjectItemChange:
+	SetRedraw(FALSE);
+
+	for(std::vector<MagicFolderChange>::const_iterator j = batch->Changes.begin(); j != batch->Changes.end(); ++j)
+	{
+		switch((*j).Type)
+		{
+		case MagicFolderChange::mcAdded:
+			folder->ApplyAdd((*j).Path.c_str(), (*j).IsFolder);
+			break;
+
+		case MagicFolderChange::mcRemoved:
+			folder->ApplyRemove((*j).Path.c_str());
+			break;
+
+		case MagicFolderChange::mcRenamed:
+			folder->ApplyRename((*j).OldPath.c_str(), (*j).Path.c_str(), (*j).IsFolder);
+			break;
+		}
+	}
+
+	SetRedraw(TRUE);
+
+	return 0;
+}
+
+LRESULT CProjectTreeCtrl::OnDeleteItem(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/)
+{
+	LPNMTREEVIEW pnmtv = reinterpret_cast<LPNMTREEVIEW>(pnmh);
+	ProjectType* item = reinterpret_cast<ProjectType*>(pnmtv->itemOld.lParam);
+
+	// item may already have been deleted, so it's only used as a key:
+	NODE_MAP::iterator i = m_nodes.find(item);
+	if(i != m_nodes.end() && (*i).second == pnmtv->itemOld.hItem)
+	{
+		m_nodes.erase(i);
+		m_unbuilt.erase(item);
+	}
+
+	return 0;
+}
+
+/**
+ * Folder nodes ask whether they have children, so folders that haven't been
+ * built yet get an expand button without adding anything to the tree.
+ */
+LRESULT CProjectTreeCtrl::OnGetDispInfo(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/)
+{
+	LPNMTVDISPINFO pdi = reinterpret_cast<LPNMTVDISPINFO>(pnmh);
+	if((pdi->item.mask & TVIF_CHILDREN) == 0)
+		return 0;
+
+	ProjectType* pt = reinterpret_cast<ProjectType*>(pdi->item.lParam);
+	if(pt == NULL || pt->GetType() == ptFile || pt->GetType() == ptWorkspace)
+	{
+		pdi->item.cChildren = 0;
+		return 0;
+	}
+
+	Projects::Folder* folder = static_cast<Projects::Folder*>(pt);
+
+	// Unread magic folders always look like they have something in them:
+	if(folder->GetType() == ptMagicFolder && !static_cast<MagicFolder*>(folder)->GetGotContents())
+		pdi->item.cChildren = 1;
+	else
+		pdi->item.cChildren = (folder->GetFolders().size() > 0 || folder->GetFiles().size() > 0) ? 1 : 0;
+
+	return 0;
+}
+
+LRESULT CProjectTreeCtrl::OnItemExpanding(int /*idCtrl*/, LPNMHDR pnmh, BOOL& bHandled)
+{
+	// CMSTreeViewCtrl handles this too.
+	bHandled = FALSE;
+
+	LPNMTREEVIEW pnmtv = reinterpret_cast<LPNMTREEVIEW>(pnmh);
+	HTREEITEM hItem = pnmtv->itemNew.hItem;
+	ProjectType* pt = reinterpret_cast<ProjectType*>( GetItemData(hItem) );
+
+	if(pt == NULL)
+		return 0;
+
+	if(pt->GetType() == ptFolder)
+	{
+		if(pnmtv->action & TVE_EXPAND)
+			ensureBuilt(static_cast<Projects::Folder*>(pt), hItem);
+
+		return 0;
+	}
+
+	if(pt->GetType() != ptMagicFolder)
+		return 0;
+
+	MagicFolder* folder = static_cast<MagicFolder*>(pt);
+	bool loading = m_magicLoads.find(folder) != m_magicLoads.end();
+
+	if(pnmtv->action & TVE_EXPAND)
+	{
+		if(loading)
+			return 0;
+
+		if(!folder->GetGotContents())
+		{
+			// The tree won't keep an empty node expanded, so expand again
+			// when the first items arrive.
+			loadMagicFolder(folder, hItem, true);
+		}
+		else if(!ensureBuilt(folder, hItem) && GetChildItem(hItem) == NULL)
+		{
+			// Read by someone else since the node was reset.
+			ProjectViewState state;
+			buildFolderContents(folder, hItem, state);
+		}
+	}
+	else if((pnmtv->action & TVE_COLLAPSE) && loading)
+	{
+		// Give up part way through, it's read again next time it's expanded.
+		cancelMagicFolderLoads(folder);
+
+		processNotifications = false;
+		folder->BeginLoad();
+		processNotifications = true;
+
+		resetMagicFolderNode(hItem);
+	}
+
+	return 0;
+}
+
 LRESULT CProjectTreeCtrl::OnSelChanged(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/)
 {
 	LPNMTREEVIEW n = (LPNMTREEVIEW)pnmh;
@@ -1264,6 +1647,80 @@ LRESULT CProjectTreeCtrl::OnOpenAll(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*h
 	return 0;
 }
 
+/**
+ * Export every file in the selected folders to HTML or RTF, in the background.
+ */
+LRESULT CProjectTreeCtrl::OnExport(WORD /*wNotifyCode*/, WORD wID, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	if(lastItem == NULL || lastItem->GetType() == ptFile || lastItem->GetType() == ptWorkspace)
+		return 0;
+
+	FileItPtr pIterable(new StringListIterator());
+	std::vector<tstring>& files = static_cast<StringListIterator*>(pIterable.get())->GetList();
+
+	// Output keeps the layout below the first folder selected:
+	tstring basePath;
+
+	HTREEITEM sel = GetFirstSelectedItem();
+	while(sel)
+	{
+		Projects::Folder* pF = GetProjectItem<Projects::Folder>(sel);
+		
+		pF->GetAllFiles(files);
+		if(basePath.empty() && pF->GetBasePath() != NULL)
+			basePath = pF->GetBasePath();
+
+		sel = GetNextSelectedItem(sel);
+	}
+
+	if(files.empty())
+		return 0;
+
+	CString strTitle;
+	strTitle.LoadString(IDS_BROWSEEXPORTROOT);
+
+	CPNFolderDialog fd(m_hWnd, basePath.c_str(), strTitle);
+	if(fd.DoModal() != IDOK)
+		return 0;
+
+	extensions::ITextOutput* output = g_Context.m_frame->GetGlobalOutputWindow();
+	output->ShowOutput();
+
+	// The menu doesn't offer export while one is running, but the folder
+	// dialog gave an earlier one time to start:
+	if(!BatchExport::GetInstance()->Start(
+		wID == ID_PROJECT_EXPORTHTML ? ExporterFactory::HTML : ExporterFactory::RTF,
+		pIterable,
+		basePath.c_str(),
+		fd.GetFolderPath(),
+		BatchExportSinkPtr(new OutputExportSink(output))))
+	{
+		output->AddToolOutput(_T("> An export is already running, cancel it first.\n"));
+	}
+
+	return 0;
+}
+
+LRESULT CProjectTreeCtrl::OnCancelExport(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+{
+	if(BatchExport::HasInstance())
+		BatchExport::GetInstance()->Cancel();
+
+	return 0;
+}
+
+/**
+ * Only one export runs at a time, offer to start one or to cancel it.
+ */
+void CProjectTreeCtrl::updateExportItems(CSPopupMenu& popup)
+{
+	bool running = BatchExport::HasInstance() && BatchExport::GetInstance()->IsRunning();
+
+	popup.EnableMenuItem(ID_PROJECT_EXPORTHTML, !running);
+	popup.EnableMenuItem(ID_PROJECT_EXPORTRTF, !running);
+	popup.EnableMenuItem(ID_PROJECT_CANCELEXPORT, running);
+}
+
 LRESULT CProjectTreeCtrl::OnRemove(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
 {
 	if(lastItem == NULL)
@@ -1511,7 +1968,7 @@ LRESULT	CProjectTreeCtrl::OnMagicAddFile(WORD /*wNotifyCode*/, WORD /*wID*/, HWN
 		// belongs in this magic folder.
 		CFileName fncompare(sd.GetSingleFileName());
 		fncompare.ToLower();
-		std::transform(path.begin(), path.end(), path.begin(), tolower);
+		MakeLower(path);
 		
 		if(fncompare.GetPath() != path)
 		{
@@ -1556,6 +2013,9 @@ LRESULT	CProjectTreeCtrl::OnMagicAddFolder(WORD /*wNotifyCode*/, WORD /*wID*/, H
 	temp->SetExcludedFileFilter(mf->GetExcludedFileFilter());
 	temp->SetFolderFilter(mf->GetFolderFilter());
 	temp->SetGotContents(true);
+
+	// The new node has to be shown to edit its name:
+	ensureBuilt(mf, hLastItem);
 	mf->AddChild(temp);
 
 	// Adding the child should have resulted in a node being added to the tree:
@@ -1827,6 +2287,86 @@ LRESULT CProjectTreeCtrl::OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*l
 		ATLASSERT(SUCCEEDED(hr));
 	}
 
+	// Stop the loader and watcher before the window goes, nothing more can
+	// be posted to us.
+	delete m_magicLoader;
+	m_magicLoader = NULL;
+	m_magicLoads.clear();
+
+	delete m_magicWatcher;
+	m_magicWatcher = NULL;
+	m_magicWatches.clear();
+
+	return 0;
+}
+
+LRESULT CProjectTreeCtrl::OnMagicFolderBatch(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam, BOOL& /*bHandled*/)
+{
+	std::auto_ptr<MagicFolderBatch> batch(reinterpret_cast<MagicFolderBatch*>(lParam));
+
+	// Batches from cancelled loads are ignored, the folder may not exist any more.
+	MAGICLOAD_MAP::iterator i = m_magicLoads.find(batch->Folder);
+	if(i == m_magicLoads.end() || (*i).second.Cookie != batch->Cookie)
+		return 0;
+
+	MagicFolder* folder = batch->Folder;
+	HTREEITEM hFolderNode = findFolder(folder);
+	if(hFolderNode == NULL)
+	{
+		cancelMagicFolderLoads(folder);
+		return 0;
+	}
+
+	ProjectViewState* viewState = folder->GetProject()->GetViewState();
+
+	// Folders go before files, after any from earlier batches:
+	HTREEITEM hLastFolder = TVI_FIRST;
+	for(HTREEITEM hN = GetChildItem(hFolderNode); hN != NULL; hN = GetNextSiblingItem(hN))
+	{
+		if(GetProjectItem<ProjectType>(hN)->GetType() == ptFile)
+			break;
+		hLastFolder = hN;
+	}
+
+	SetRedraw(FALSE);
+
+	for(std::vector<tstring>::const_iterator j = batch->Folders.begin(); j != batch->Folders.end(); ++j)
+	{
+		MagicFolder* child = static_cast<MagicFolder*>( folder->AddLoadedItem((*j).c_str(), true) );
+		hLastFolder = addFolderNode(child, hFolderNode, hLastFolder);
+		resetMagicFolderNode(hLastFolder);
+
+		if(viewState->ShouldExpand(child))
+			loadMagicFolder(child, hLastFolder, true);
+	}
+
+	for(std::vector<tstring>::const_iterator k = batch->Files.begin(); k != batch->Files.end(); ++k)
+	{
+		File* file = static_cast<File*>( folder->AddLoadedItem((*k).c_str(), false) );
+		addFileNode(file, hFolderNode, TVI_LAST);
+	}
+
+	// loadMagicFolder for a child may have invalidated i:
+	MagicFolderLoad& load = m_magicLoads[folder];
+
+	if(load.Expand && GetChildItem(hFolderNode) != NULL)
+	{
+		Expand(hFolderNode);
+		load.Expand = false;
+	}
+
+	if(batch->Last)
+	{
+		folder->EndLoad();
+		m_magicLoads.erase(folder);
+
+		// Read now, so an empty folder loses its expand button:
+		if(GetChildItem(hFolderNode) != NULL)
+			sort(hFolderNode);
+	}
+
+	SetRedraw(TRUE);
+
 	return 0;
 }
 
@@ -2365,6 +2905,12 @@ int CProjectTreeCtrl::CompareWorker(LPARAM lParam1, LPARAM lParam2, LPARAM caseS
 	PROJECT_TYPE t1 = pt1->GetType();
 	PROJECT_TYPE t2 = pt2->GetType();
 
+	// Magic folders sort with the other folders:
+	if(t1 == ptMagicFolder)
+		t1 = ptFolder;
+	if(t2 == ptMagicFolder)
+		t2 = ptFolder;
+
 	if(t1 == ptFolder && t2 == ptFile)
 	{
 		return -1;
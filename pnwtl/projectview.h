@@ -16,6 +16,12 @@
 
 class ShellImageList;
 class ShellContextMenu;
+class CSPopupMenu;
+
+namespace Projects {
+	class MagicFolderLoader;
+	class MagicFolderWatcher;
+}
 
 class CProjectTreeCtrl : public CMSTreeViewCtrl, Projects::IProjectWatcher, CThemeImpl<CProjectTreeCtrl>
 {
@@ -24,6 +30,26 @@ class CProjectTreeCtrl : public CMSTreeViewCtrl, Projects::IProjectWatcher, CThe
 	typedef DropTargetImpl<CProjectTreeCtrl> DropTarget;
 	friend class DropTarget;
 
+	/**
+	 * A magic folder being read in the background.
+	 */
+	class MagicFolderLoad
+	{
+	public:
+		MagicFolderLoad() : Cookie(0), Expand(false) {}
+		MagicFolderLoad(int cookie, bool expand) : Cookie(cookie), Expand(expand) {}
+
+		/// Identifies the load in MagicFolderBatch
+		int Cookie;
+		/// Expand the node once the first items arrive
+		bool Expand;
+	};
+
+	typedef std::map<Projects::MagicFolder*, MagicFolderLoad> MAGICLOAD_MAP;
+	typedef std::map<Projects::MagicFolder*, int> MAGICWATCH_MAP;
+	typedef std::unordered_map<Projects::ProjectType*, HTREEITEM> NODE_MAP;
+	typedef std::unordered_set<Projects::ProjectType*> ITEM_SET;
+
 public:
 	DECLARE_WND_CLASS(_T("ProjectTree"))
 
@@ -43,6 +69,14 @@ public:
 		MESSAGE_HANDLER(WM_MOUSEWHEEL, OnMouseWheel)
 		MESSAGE_HANDLER(WM_TIMER, OnTimer)
 
+		// Magic Folders...
+		REFLECTED_NOTIFY_CODE_HANDLER(TVN_ITEMEXPANDING, OnItemExpanding)
+		MESSAGE_HANDLER(PN_MAGICFOLDERBATCH, OnMagicFolderBatch)
+		MESSAGE_HANDLER(PN_MAGICFOLDERCHANGES, OnMagicFolderChanges)
+
+		REFLECTED_NOTIFY_CODE_HANDLER(TVN_DELETEITEM, OnDeleteItem)
+		REFLECTED_NOTIFY_CODE_HANDLER(TVN_GETDISPINFO, OnGetDispInfo)
+
 		REFLECTED_NOTIFY_CODE_HANDLER(TVN_ENDLABELEDIT, OnEndLabelEdit)
 		REFLECTED_NOTIFY_CODE_HANDLER(NM_RCLICK, OnRightClick)
 		
@@ -52,6 +86,9 @@ public:
 		COMMAND_ID_HANDLER(ID_PROJECT_ADDFOLDER, OnAddFolder)
 		COMMAND_ID_HANDLER(ID_PROJECT_ADDMAGICFOLDER, OnAddMagicFolder)
 		COMMAND_ID_HANDLER(ID_PROJECT_OPENALLFILES, OnOpenAll)
+		COMMAND_ID_HANDLER(ID_PROJECT_EXPORTHTML, OnExport)
+		COMMAND_ID_HANDLER(ID_PROJECT_EXPORTRTF, OnExport)
+		COMMAND_ID_HANDLER(ID_PROJECT_CANCELEXPORT, OnCancelExport)
 		COMMAND_ID_HANDLER(ID_PROJECT_REMOVE, OnRemove)
 		COMMAND_ID_HANDLER(ID_PROJECT_DELETE, OnDelete)
 		COMMAND_ID_HANDLER(ID_PROJECT_SETACTIVEPROJECT, OnSetActiveProject)
@@ -92,24 +129,33 @@ private:
 	HTREEITEM	addFileNode(Projects::File* file, HTREEITEM hParent, HTREEITEM hInsertAfter);
 	HTREEITEM	addFolderNode(Projects::Folder* folder, HTREEITEM hParent, HTREEITEM hInsertAfter);
 	void		buildTree();
+	void		buildFolderContents(Projects::Folder* folder, HTREEITEM hFolderNode, Projects::ProjectViewState& viewState);
 	HTREEITEM	buildProject(HTREEITEM hParentNode, Projects::Project* pj, HTREEITEM hInsertAfter = NULL);
 	HTREEITEM	buildFolders(HTREEITEM hParentNode, const Projects::FOLDER_LIST& folders, Projects::ProjectViewState& viewState);
 	HTREEITEM	buildFiles(HTREEITEM hParentNode, HTREEITEM hInsertAfter, const Projects::FILE_LIST& files);
+	void		cancelMagicFolderLoads(Projects::Folder* container);
 	void		clearNode(HTREEITEM hItem);
 	void		clearTree();
 	void		doContextMenu(LPPOINT pt);
+	bool		ensureBuilt(Projects::Folder* folder, HTREEITEM hFolderNode);
 	HTREEITEM	findItem(Projects::ProjectType* item, HTREEITEM startat);
 	HTREEITEM	findFolder(Projects::Folder* folder);
 	HTREEITEM	getLastFolderItem(HTREEITEM hParentNode);
 	void		getMagicFolderProps(Projects::UserData& ud, Projects::MagicFolder* folder, Projects::PropGroupList& groups);
 	void		handleRemove();
 	void		handleRightClick(LPPOINT pt);
+	void		loadMagicFolder(Projects::MagicFolder* folder, HTREEITEM hFolderNode, bool expand);
 	void		openAll(Projects::Folder* folder);
 	void		refreshMagicFolder(Projects::MagicFolder* folder, HTREEITEM hNode);
+	void		resetMagicFolderNode(HTREEITEM hFolderNode);
 	void		setMagicFolderProps(Projects::UserData& ud, Projects::MagicFolder* folder);
+	void		setNodeItem(HTREEITEM hNode, Projects::ProjectType* item);
 	void		setStatus(Projects::ProjectType* selection);
 	void		sort(HTREEITEM hFolderNode, bool bSortFolders = false, bool bRecurse = false);
 	void		storeViewState(Projects::ProjectViewState* vs, HTREEITEM hTreeItem);
+	void		unwatchMagicFolders(Projects::Folder* container);
+	void		updateExportItems(CSPopupMenu& popup);
+	void		watchMagicFolder(Projects::MagicFolder* folder);
 	
 
 	// IDropTarget Drop
@@ -142,6 +188,9 @@ private:
 	LRESULT		OnRightClick(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/);
 	LRESULT		OnEndLabelEdit(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/);
 	LRESULT		OnBeginDrag(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/);
+	LRESULT		OnItemExpanding(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/);
+	LRESULT		OnDeleteItem(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/);
+	LRESULT		OnGetDispInfo(int /*idCtrl*/, LPNMHDR pnmh, BOOL& /*bHandled*/);
 
 	// Command Handlers
 	LRESULT		OnNewProject(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
@@ -151,6 +200,8 @@ private:
 	LRESULT		OnAddFolder(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT		OnAddMagicFolder(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT		OnOpenAll(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+	LRESULT		OnExport(WORD /*wNotifyCode*/, WORD wID, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
+	LRESULT		OnCancelExport(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT		OnRemove(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT		OnDelete(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
 	LRESULT		OnSetActiveProject(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/);
@@ -176,6 +227,8 @@ private:
 	LRESULT		OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 	LRESULT		OnKeyDown(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 	LRESULT		OnContextMenu(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT		OnMagicFolderBatch(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
+	LRESULT		OnMagicFolderChanges(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/);
 
 	template <class TProjectItem>
 	TProjectItem* GetProjectItem(HTREEITEM node)
@@ -220,6 +273,15 @@ private:
 	CComObject<DropTarget>* m_pDropTarget;
 	ShellContextMenu*		m_explorerMenu;
 	bool					m_addingMagicFolder;
+	Projects::MagicFolderLoader* m_magicLoader;
+	MAGICLOAD_MAP			m_magicLoads;
+	Projects::MagicFolderWatcher* m_magicWatcher;
+	/// Top-level magic folders being watched, and the cookie for each watch
+	MAGICWATCH_MAP			m_magicWatches;
+	/// Tree node for each project item shown
+	NODE_MAP				m_nodes;
+	/// Folders shown without their children, which are added when first expanded
+	ITEM_SET				m_unbuilt;
 };
 
 class CProjectDocker : public CWindowImpl<CProjectDocker>// CPNDockingWindow<CProjectDocker>
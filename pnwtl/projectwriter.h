@@ -19,7 +19,9 @@ namespace Projects
 #define u(x) (constUtf8)x
 
 /**
- * Write project XML files based on the object model.
+ * Write project XML files based on the object model. When writing to a
+ * buffer, top-level magic folders keep the XML written for them and any
+ * magic folder that hasn't changed since is copied from there next time.
  */
 class ProjectWriter : public GenxXMLWriter
 {
@@ -51,6 +53,24 @@ public:
 		genxEndElement(m_writer);
 	}
 
+	/**
+	 * Everything written in the top-level MagicFolder element's attributes, if
+	 * this changes the XML kept for the folder can't be used.
+	 */
+	static tstring GetMagicFolderSignature(MagicFolder* folder)
+	{
+		tstring signature(folder->GetName());
+		signature += _T('|');
+		signature += getRelativePath(folder);
+		signature += _T('|');
+		signature += folder->GetFilter();
+		signature += _T('|');
+		signature += folder->GetExcludedFileFilter();
+		signature += _T('|');
+		signature += folder->GetFolderFilter();
+		return signature;
+	}
+
 protected:
 	virtual void initXmlBits()
 	{
@@ -95,7 +115,7 @@ private:
 		{
 			if ((*i)->GetType() == ptMagicFolder)
 			{
-				writeMagicFolder(static_cast<MagicFolder*>(*i));
+				writeTopMagicFolder(static_cast<MagicFolder*>(*i));
 			}
 			else
 			{
@@ -112,21 +132,144 @@ private:
 		}
 	}
 
-	void writeMagicFolder(MagicFolder* folder)
+	static tstring getRelativePath(MagicFolder* folder)
+	{
+		CFileName cfn( folder->GetBasePath() );
+		return cfn.GetRelativePath( folder->GetParent()->GetBasePath() );
+	}
+
+	/**
+	 * Write a top-level magic folder, straight from the XML kept last time if
+	 * nothing in it has changed.
+	 */
+	void writeTopMagicFolder(MagicFolder* folder)
+	{
+		if (m_buffer == NULL)
+		{
+			// Writing to a file, there's nothing to keep the XML in:
+			writeMagicFolder(folder, NULL, NULL, 0);
+			return;
+		}
+
+		tstring signature(GetMagicFolderSignature(folder));
+		MagicFolderSnapshot* old = folder->m_snapshot;
+
+		startContent();
+		size_t start = m_buffer->size();
+
+		if (!folder->m_changed && old != NULL && !old->Xml.empty() && old->Signature == signature)
+		{
+			m_buffer->append(old->Xml);
+			return;
+		}
+
+		MagicFolderSnapshot* updated = new MagicFolderSnapshot;
+		writeMagicFolder(folder, old, updated, start);
+		updated->Xml.assign(*m_buffer, start, m_buffer->size() - start);
+		updated->Signature = signature;
+
+		folder->m_snapshot = updated;
+		delete old;
+	}
+
+	/**
+	 * Write a magic folder inside another, copying it from the old XML if it
+	 * hasn't changed. The positions of anything written are recorded in
+	 * updated relative to base.
+	 */
+	void writeChildMagicFolder(MagicFolder* folder, const MagicFolderSnapshot* old, MagicFolderSnapshot* updated, size_t base)
+	{
+		if (updated != NULL && old != NULL && !folder->m_changed)
+		{
+			tstring path(folder->GetFolderCachePath());
+			MagicFolderSnapshot::RANGE_MAP::const_iterator range = old->Ranges.find(path);
+
+			if (range != old->Ranges.end() && (*range).second.Start < (*range).second.End && (*range).second.End <= old->Xml.size())
+			{
+				const MagicFolderSnapshot::Range& from = (*range).second;
+
+				startContent();
+				size_t start = m_buffer->size() - base;
+				m_buffer->append(old->Xml, from.Start, from.End - from.Start);
+
+				// Everything inside it moves along with it:
+				for (MagicFolderSnapshot::RANGE_MAP::const_iterator i = range;
+					i != old->Ranges.end() && (*i).first.compare(0, path.size(), path) == 0;
+					++i)
+				{
+					updated->Ranges[(*i).first] = MagicFolderSnapshot::Range((*i).second.Start - from.Start + start, (*i).second.End - from.Start + start);
+				}
+
+				return;
+			}
+		}
+
+		writeMagicFolder(folder, old, updated, base);
+	}
+
+	void writeMagicFolder(MagicFolder* folder, const MagicFolderSnapshot* old, MagicFolderSnapshot* updated, size_t base)
 	{
+		size_t start(0);
+		if (updated != NULL)
+		{
+			startContent();
+			start = m_buffer->size() - base;
+		}
+
 		genxStartElement(m_eMagicFolder);
 		addAttributeConvertUTF8(m_aName, folder->GetName());
 		
-		CFileName cfn( folder->GetBasePath() );
-		tstring relPath = cfn.GetRelativePath( folder->GetParent()->GetBasePath() );
+		tstring relPath = getRelativePath(folder);
 		addAttributeConvertUTF8(m_aPath, relPath.c_str());
 		addAttributeConvertUTF8(m_aFilter, folder->GetFilter());
 		addAttributeConvertUTF8(m_aExcludedFiles, folder->GetExcludedFileFilter());
 		addAttributeConvertUTF8(m_aExcludedFolders, folder->GetFolderFilter());
 
-		writeFolderContents(folder);
+		folder->GetUserData().Write(this);
+
+		// A folder that's never been read has nothing new inside it, unless
+		// it changed itself, in which case it's read now so nothing is lost:
+		if (updated == NULL || folder->GetGotContents() || folder->m_changed)
+		{
+			for(FOLDER_LIST::const_iterator i = folder->GetFolders().begin();
+				i != folder->GetFolders().end();
+				++i)
+			{
+				if ((*i)->GetType() == ptMagicFolder)
+				{
+					writeChildMagicFolder(static_cast<MagicFolder*>(*i), old, updated, base);
+				}
+				else
+				{
+					writeFolder((*i));
+				}
+			}
+
+			for(FILE_LIST::const_iterator j = folder->GetFiles().begin(); 
+				j != folder->GetFiles().end(); 
+				++j)
+			{
+				writeFile((*j));
+			}
+		}
 
 		genxEndElement(m_writer);
+
+		folder->m_changed = false;
+
+		if (updated != NULL)
+		{
+			updated->Ranges[folder->GetFolderCachePath()] = MagicFolderSnapshot::Range(start, m_buffer->size() - base);
+		}
+	}
+
+	/**
+	 * Make sure any pending start tag is written so we can add to the
+	 * buffer directly.
+	 */
+	void startContent()
+	{
+		genxAddText(m_writer, u(""));
 	}
 
 	void writeFolder(Folder* folder)
@@ -39,10 +39,15 @@ App::App(boost::python::handle<>& obj, extensions::IPN* app) : m_app(app), main_
 
 	m_outputShown = false;
 	m_output = NULL;
+	m_charFlushTimer = 0;
 }
 
 App::~App()
 {
+	if (m_charFlushTimer != 0)
+	{
+		::KillTimer(NULL, m_charFlushTimer);
+	}
 }
 
 /**
@@ -95,7 +100,14 @@ void App::OnNewDocument(extensions::IDocumentPtr& doc)
 }
 
 void App::OnAppClose()
-{	
+{
+	if (m_charFlushTimer != 0)
+	{
+		::KillTimer(NULL, m_charFlushTimer);
+		m_charFlushTimer = 0;
+	}
+
+	m_charFlushes.clear();
 }
 
 void App::OnDocSelected(extensions::IDocumentPtr& doc)
@@ -346,6 +358,81 @@ void App::SetOutputBasePath(const wchar_t* path)
 	}
 }
 
+Recorder* App::GetRecorder()
+{
+	return static_cast<Recorder*>(m_recorder.get());
+}
+
+DocEventFilter& App::GetEventFilter()
+{
+	return m_eventFilter;
+}
+
+bool App::IsOnCharAddedReplaced()
+{
+	if (m_glueOnCharAdded.ptr() == Py_None)
+	{
+		return false;
+	}
+
+	PyObject* current = PyObject_GetAttrString(m_glue.ptr(), "onCharAdded");
+	if (current == NULL)
+	{
+		PyErr_Clear();
+		return false;
+	}
+
+	bool replaced = current != m_glueOnCharAdded.ptr();
+	Py_DECREF(current);
+
+	return replaced;
+}
+
+void App::QueueFlushChars(boost::shared_ptr<DocSink> sink)
+{
+	for (SinkList::const_iterator i = m_charFlushes.begin(); i != m_charFlushes.end(); ++i)
+	{
+		if ((*i).lock() == sink)
+		{
+			return;
+		}
+	}
+
+	m_charFlushes.push_back(sink);
+
+	// Timer messages come after any input waiting, so this fires once the burst is over:
+	if (m_charFlushTimer == 0)
+	{
+		m_charFlushTimer = ::SetTimer(NULL, 0, 0, &App::flushCharsTimerProc);
+	}
+}
+
+void CALLBACK App::flushCharsTimerProc(HWND /*hWnd*/, UINT /*uMsg*/, UINT_PTR /*idEvent*/, DWORD /*dwTime*/)
+{
+	if (g_app != NULL)
+	{
+		g_app->flushQueuedChars();
+	}
+}
+
+void App::flushQueuedChars()
+{
+	::KillTimer(NULL, m_charFlushTimer);
+	m_charFlushTimer = 0;
+
+	SinkList sinks;
+	sinks.swap(m_charFlushes);
+
+	for (SinkList::const_iterator i = sinks.begin(); i != sinks.end(); ++i)
+	{
+		boost::shared_ptr<DocSink> sink((*i).lock());
+		if (sink.get())
+		{
+			sink->FlushChars();
+		}
+	}
+}
+
 bool App::ensureOutput()
 {
 	if(m_output == NULL)
@@ -383,6 +470,7 @@ void App::loadInitScript()
 		runFile(szpath);
 
 		m_glue = main_module.attr("glue");
+		m_glueOnCharAdded = m_glue.attr("onCharAdded");
 	}
 	catch(boost::python::error_already_set&)
 	{
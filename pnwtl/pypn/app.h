@@ -10,6 +10,13 @@
 #ifndef APP_H_INCLUDED
 #define APP_H_INCLUDED
 
+#include "eventfilter.h"
+
+#include <boost/weak_ptr.hpp>
+
+class DocSink;
+class Recorder;
+
 /**
  * This class manages the environment for the plugin, storing
  * the links to IPN and acting as the main event sink.
@@ -52,7 +59,30 @@ public:
 	void SetOutputDefaultParser();
 	void SetOutputBasePath(const wchar_t* path);
 
+	/**
+	 * The characters scripts have registered for, shared by all documents.
+	 */
+	DocEventFilter& GetEventFilter();
+
+	/**
+	 * Scripts written before the filter replace glue.onCharAdded outright
+	 * rather than registering, they still see every character.
+	 */
+	bool IsOnCharAddedReplaced();
+
+	/**
+	 * Flush the characters waiting in sink once the input queue is empty.
+	 */
+	void QueueFlushChars(boost::shared_ptr<DocSink> sink);
+
+	Recorder* GetRecorder();
+
 private:
+	typedef std::vector< boost::weak_ptr<DocSink> > SinkList;
+
+	static void CALLBACK flushCharsTimerProc(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+	void flushQueuedChars();
+
 	bool ensureOutput();
 	void loadInitScript();
 	void runFile(const char* filename);
@@ -65,7 +95,12 @@ private:
 	boost::python::object main_module;
 	boost::python::object main_namespace;
 	boost::python::object m_glue;
+	/// glue.onCharAdded as glue defined it
+	boost::python::object m_glueOnCharAdded;
 	bool m_outputShown;
+	DocEventFilter m_eventFilter;
+	SinkList m_charFlushes;
+	UINT_PTR m_charFlushTimer;
 };
 
 extern App* g_app;
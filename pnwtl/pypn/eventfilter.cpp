@@ -0,0 +1,88 @@
+/**
+ * @file eventfilter.cpp
+ * @brief Which document events scripts want to hear about
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#include "stdafx.h"
+#include "eventfilter.h"
+
+#include <string.h>
+
+DocEventFilter::DocEventFilter()
+{
+	memset(m_chars, 0, sizeof(m_chars));
+	memset(m_batchedChars, 0, sizeof(m_batchedChars));
+}
+
+void DocEventFilter::SetChars(const char* chars, bool anyChar)
+{
+	fill(m_chars, chars, anyChar);
+}
+
+void DocEventFilter::SetBatchedChars(const char* chars, bool anyChar)
+{
+	fill(m_batchedChars, chars, anyChar);
+}
+
+bool DocEventFilter::WantsChars() const
+{
+	for (size_t i = 0; i < sizeof(m_chars) / sizeof(m_chars[0]); ++i)
+	{
+		if (m_chars[i] != 0 || m_batchedChars[i] != 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void DocEventFilter::fill(CharSet& set, const char* chars, bool anyChar)
+{
+	memset(set, anyChar ? 0xFF : 0, sizeof(set));
+
+	if (chars != NULL)
+	{
+		for (const unsigned char* p = reinterpret_cast<const unsigned char*>(chars); *p; ++p)
+		{
+			set[*p >> 5] |= 1U << (*p & 31);
+		}
+	}
+}
+
+CharBatch::CharBatch(const DocEventFilter& filter) : m_filter(filter)
+{
+}
+
+bool CharBatch::Add(char c, bool morePending)
+{
+	if (m_filter.WantsBatchedChar(c))
+	{
+		m_pending += c;
+	}
+
+	// Indenters work from the caret position, so a line end can't wait for the rest:
+	bool lineEnd = c == '\r' || c == '\n';
+
+	return m_pending.size() && (!morePending || lineEnd || m_pending.size() >= MaxPending);
+}
+
+bool CharBatch::HasPending() const
+{
+	return m_pending.size() != 0;
+}
+
+void CharBatch::Take(std::string& chars)
+{
+	chars.clear();
+	chars.swap(m_pending);
+}
+
+void CharBatch::Clear()
+{
+	m_pending.clear();
+}
@@ -0,0 +1,112 @@
+/**
+ * @file eventfilter.h
+ * @brief Which document events scripts want to hear about
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#ifndef eventfilter_h__included
+#define eventfilter_h__included
+
+#ifdef _MSC_VER
+	#pragma once
+#endif
+
+#include <string>
+
+/**
+ * The typed characters that scripts have registered for. Nothing is wanted
+ * until a script asks, so typing into documents without listeners never
+ * calls into Python.
+ *
+ * Most handlers get each character as it's typed, before the next one is
+ * handled. Handlers that registered for batched delivery are kept apart and
+ * get bursts of typing in one call.
+ */
+class DocEventFilter
+{
+public:
+	DocEventFilter();
+
+	/**
+	 * Replace the characters handed to glue.onCharAdded as they're typed.
+	 * @param chars characters to listen for, may be NULL
+	 * @param anyChar true to listen for every character
+	 */
+	void SetChars(const char* chars, bool anyChar);
+
+	/**
+	 * Replace the characters collected for glue.onCharsAdded.
+	 */
+	void SetBatchedChars(const char* chars, bool anyChar);
+
+	bool WantsChar(char c) const
+	{
+		return contains(m_chars, c);
+	}
+
+	bool WantsBatchedChar(char c) const
+	{
+		return contains(m_batchedChars, c);
+	}
+
+	/**
+	 * @return true if any character at all is wanted, either way
+	 */
+	bool WantsChars() const;
+
+private:
+	typedef unsigned int CharSet[256 / 32];
+
+	static bool contains(const CharSet& set, char c)
+	{
+		unsigned char uc = static_cast<unsigned char>(c);
+		return (set[uc >> 5] & (1U << (uc & 31))) != 0;
+	}
+
+	static void fill(CharSet& set, const char* chars, bool anyChar);
+
+	CharSet m_chars;
+	CharSet m_batchedChars;
+};
+
+/**
+ * Collects the characters typed into one document that batched handlers
+ * want, so that a burst of them, such as typeahead while a script is busy,
+ * is handed to the scripts in a single call.
+ */
+class CharBatch
+{
+public:
+	/// Dispatch regardless once this many characters are waiting
+	static const size_t MaxPending = 4096;
+
+	explicit CharBatch(const DocEventFilter& filter);
+
+	/**
+	 * Add a typed character, it's ignored unless a batched handler wants
+	 * it. A line end ends a burst.
+	 * @param morePending true if more input is waiting to be processed
+	 * @return true if the waiting characters should be dispatched now
+	 */
+	bool Add(char c, bool morePending);
+
+	bool HasPending() const;
+
+	/**
+	 * Move the waiting characters into chars.
+	 */
+	void Take(std::string& chars);
+
+	void Clear();
+
+private:
+	CharBatch& operator=(const CharBatch&);
+
+	const DocEventFilter& m_filter;
+	std::string m_pending;
+};
+
+#endif // #ifndef eventfilter_h__included
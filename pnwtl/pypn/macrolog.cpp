@@ -0,0 +1,339 @@
+/**
+ * @file macrolog.cpp
+ * @brief Compact log of recorded editor actions
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#include "stdafx.h"
+#include "macrolog.h"
+
+#include <string.h>
+
+#include "../third_party/scintilla/include/Scintilla.h"
+
+namespace
+{
+
+/**
+ * Messages recorded with a string in lParam, the text has to be copied
+ * because the pointer is only good for the duration of the notification.
+ */
+bool takesString(int message)
+{
+	switch (message)
+	{
+	case SCI_ADDTEXT:
+	case SCI_INSERTTEXT:
+	case SCI_REPLACESEL:
+	case SCI_APPENDTEXT:
+	case SCI_SEARCHNEXT:
+	case SCI_SEARCHPREV:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * For these wParam is the length of the text, which needn't be terminated.
+ */
+bool takesLength(int message)
+{
+	return message == SCI_ADDTEXT || message == SCI_APPENDTEXT;
+}
+
+bool isLineEnd(char c)
+{
+	return c == '\r' || c == '\n';
+}
+
+/// Zig-zag encoding keeps small negative numbers small
+uintptr_t encodeSigned(intptr_t value)
+{
+	return (static_cast<uintptr_t>(value) << 1) ^ static_cast<uintptr_t>(value >> (sizeof(intptr_t) * 8 - 1));
+}
+
+intptr_t decodeSigned(uintptr_t value)
+{
+	return static_cast<intptr_t>(value >> 1) ^ -static_cast<intptr_t>(value & 1);
+}
+
+} // namespace
+
+MacroLog::MacroLog() : m_count(0), m_hasMessage(false), m_message(0), m_wParam(0), m_lParam(0), m_repeat(0)
+{
+}
+
+void MacroLog::Record(int message, uintptr_t wParam, intptr_t lParam)
+{
+	if (message == SCI_REPLACESEL)
+	{
+		const char* text = reinterpret_cast<const char*>(lParam);
+		size_t length = text != NULL ? strlen(text) : 0;
+
+		// Replacing the selection with nothing deletes it, that can't be merged:
+		if (length == 0)
+		{
+			flushText();
+			flushMessage();
+			writeNumber(opText);
+			writeNumber(SCI_REPLACESEL);
+			writeNumber(0);
+			writeNumber(0);
+			++m_count;
+			return;
+		}
+
+		flushMessage();
+
+		// Start a new insertion at the start of each line, like the scripts do:
+		if (m_text.size() && isLineEnd(m_text[m_text.size() - 1]) && !isLineEnd(text[0]))
+		{
+			flushText();
+		}
+
+		m_text.append(text, length);
+		return;
+	}
+
+	flushText();
+
+	if (takesString(message))
+	{
+		flushMessage();
+
+		const char* text = reinterpret_cast<const char*>(lParam);
+		size_t length = 0;
+		if (text != NULL)
+		{
+			length = takesLength(message) ? static_cast<size_t>(wParam) : strlen(text);
+		}
+
+		writeNumber(opText);
+		writeNumber(static_cast<uintptr_t>(message));
+		writeNumber(wParam);
+		writeNumber(length);
+		m_log.insert(m_log.end(), reinterpret_cast<const unsigned char*>(text), reinterpret_cast<const unsigned char*>(text) + length);
+		++m_count;
+		return;
+	}
+
+	if (m_hasMessage && m_message == message && m_wParam == wParam && m_lParam == lParam)
+	{
+		++m_repeat;
+		return;
+	}
+
+	flushMessage();
+
+	m_hasMessage = true;
+	m_message = message;
+	m_wParam = wParam;
+	m_lParam = lParam;
+	m_repeat = 1;
+}
+
+void MacroLog::RecordSearch(int index)
+{
+	flushText();
+	flushMessage();
+
+	writeNumber(opSearch);
+	writeNumber(static_cast<uintptr_t>(index));
+	++m_count;
+}
+
+void MacroLog::Finish()
+{
+	flushText();
+	flushMessage();
+}
+
+bool MacroLog::Next(size_t& pos, MacroAction& action) const
+{
+	uintptr_t op, value;
+	if (!readNumber(pos, op))
+	{
+		return false;
+	}
+
+	action.HasText = false;
+	action.Text.clear();
+	action.Repeat = 1;
+	action.Index = 0;
+	action.Message = 0;
+	action.WParam = 0;
+	action.LParam = 0;
+
+	switch (op)
+	{
+	case opMessage:
+		{
+			action.Type = MacroAction::maMessage;
+
+			uintptr_t lParam, repeat;
+			if (!readNumber(pos, value) || !readNumber(pos, action.WParam) || !readNumber(pos, lParam) || !readNumber(pos, repeat))
+			{
+				return false;
+			}
+
+			action.Message = static_cast<int>(value);
+			action.LParam = decodeSigned(lParam);
+			action.Repeat = static_cast<int>(repeat);
+		}
+		break;
+
+	case opText:
+		{
+			action.Type = MacroAction::maMessage;
+			action.HasText = true;
+
+			uintptr_t length;
+			if (!readNumber(pos, value) || !readNumber(pos, action.WParam) || !readNumber(pos, length) || length > m_log.size() - pos)
+			{
+				return false;
+			}
+
+			action.Message = static_cast<int>(value);
+			if (length)
+			{
+				action.Text.assign(reinterpret_cast<const char*>(&m_log[pos]), length);
+			}
+
+			pos += length;
+		}
+		break;
+
+	case opSearch:
+		{
+			action.Type = MacroAction::maSearch;
+
+			if (!readNumber(pos, value))
+			{
+				return false;
+			}
+
+			action.Index = static_cast<int>(value);
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+void MacroLog::Replay(IMacroTarget& target) const
+{
+	MacroAction action;
+	size_t pos(0);
+
+	while (Next(pos, action))
+	{
+		if (action.Type == MacroAction::maSearch)
+		{
+			target.Search(action.Index);
+			continue;
+		}
+
+		intptr_t lParam = action.HasText ? reinterpret_cast<intptr_t>(action.Text.c_str()) : action.LParam;
+
+		for (int i = 0; i < action.Repeat; ++i)
+		{
+			target.Perform(action.Message, action.WParam, lParam);
+		}
+	}
+}
+
+size_t MacroLog::GetCount() const
+{
+	return m_count;
+}
+
+size_t MacroLog::GetSize() const
+{
+	return m_log.size();
+}
+
+bool MacroLog::IsEmpty() const
+{
+	return m_count == 0 && m_text.empty() && !m_hasMessage;
+}
+
+void MacroLog::Clear()
+{
+	m_log.clear();
+	m_count = 0;
+	m_text.clear();
+	m_hasMessage = false;
+}
+
+void MacroLog::flushText()
+{
+	if (m_text.empty())
+	{
+		return;
+	}
+
+	writeNumber(opText);
+	writeNumber(SCI_REPLACESEL);
+	writeNumber(0);
+	writeNumber(m_text.size());
+	m_log.insert(m_log.end(), m_text.begin(), m_text.end());
+	++m_count;
+
+	m_text.clear();
+}
+
+void MacroLog::flushMessage()
+{
+	if (!m_hasMessage)
+	{
+		return;
+	}
+
+	writeNumber(opMessage);
+	writeNumber(static_cast<uintptr_t>(m_message));
+	writeNumber(m_wParam);
+	writeNumber(encodeSigned(m_lParam));
+	writeNumber(static_cast<uintptr_t>(m_repeat));
+	++m_count;
+
+	m_hasMessage = false;
+}
+
+/**
+ * Seven bits at a time, low bits first, the top bit says there's more.
+ */
+void MacroLog::writeNumber(uintptr_t value)
+{
+	while (value >= 0x80)
+	{
+		m_log.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+
+	m_log.push_back(static_cast<unsigned char>(value));
+}
+
+bool MacroLog::readNumber(size_t& pos, uintptr_t& value) const
+{
+	value = 0;
+
+	for (int shift = 0; pos < m_log.size() && shift < static_cast<int>(sizeof(uintptr_t) * 8); shift += 7)
+	{
+		unsigned char b = m_log[pos++];
+		value |= static_cast<uintptr_t>(b & 0x7F) << shift;
+
+		if ((b & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
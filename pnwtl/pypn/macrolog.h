@@ -0,0 +1,138 @@
+/**
+ * @file macrolog.h
+ * @brief Compact log of recorded editor actions
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#ifndef macrolog_h__included
+#define macrolog_h__included
+
+#ifdef _MSC_VER
+	#pragma once
+#endif
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * One action read back from a MacroLog.
+ */
+class MacroAction
+{
+public:
+	typedef enum
+	{
+		/// A Scintilla message, Text is set if it takes a string
+		maMessage,
+		/// A search, Index says which one
+		maSearch
+	} EType;
+
+	EType Type;
+	int Message;
+	uintptr_t WParam;
+	intptr_t LParam;
+	bool HasText;
+	std::string Text;
+	/// How many times in a row the message was sent
+	int Repeat;
+	int Index;
+};
+
+/**
+ * Something a MacroLog can be played back into.
+ */
+class IMacroTarget
+{
+public:
+	virtual ~IMacroTarget(){}
+
+	/**
+	 * Send a Scintilla message, for messages that take a string lParam
+	 * points at the text.
+	 */
+	virtual void Perform(int message, uintptr_t wParam, intptr_t lParam) = 0;
+
+	/**
+	 * Repeat the search recorded with index.
+	 */
+	virtual void Search(int index) = 0;
+};
+
+/**
+ * Recorded Scintilla messages and searches, stored as variable length
+ * records in one buffer. Strings are copied in as they're recorded. Runs
+ * of typed text become a single ReplaceSel a line at a time, and runs of
+ * the same message, such as cursor moves, become one record with a count.
+ */
+class MacroLog
+{
+public:
+	MacroLog();
+
+	/**
+	 * Record a Scintilla message as reported by SCN_MACRORECORD.
+	 */
+	void Record(int message, uintptr_t wParam, intptr_t lParam);
+
+	/**
+	 * Record a search, the caller keeps what it needs to repeat it by index.
+	 */
+	void RecordSearch(int index);
+
+	/**
+	 * Write out whatever is still being coalesced, call before reading.
+	 */
+	void Finish();
+
+	/**
+	 * Read the action at pos and move pos on to the next one.
+	 * @return false at the end of the log
+	 */
+	bool Next(size_t& pos, MacroAction& action) const;
+
+	/**
+	 * Play every action into target, call Finish first.
+	 */
+	void Replay(IMacroTarget& target) const;
+
+	/// Number of records
+	size_t GetCount() const;
+	/// Size of the log in bytes
+	size_t GetSize() const;
+	bool IsEmpty() const;
+
+	void Clear();
+
+private:
+	typedef enum
+	{
+		opMessage = 1,
+		opText = 2,
+		opSearch = 3
+	} EOp;
+
+	void flushText();
+	void flushMessage();
+	void writeNumber(uintptr_t value);
+	bool readNumber(size_t& pos, uintptr_t& value) const;
+
+	std::vector<unsigned char> m_log;
+	size_t m_count;
+
+	/// Typed text not yet written
+	std::string m_text;
+
+	/// A repeated message not yet written
+	bool m_hasMessage;
+	int m_message;
+	uintptr_t m_wParam;
+	intptr_t m_lParam;
+	int m_repeat;
+};
+
+#endif // #ifndef macrolog_h__included
@@ -10,6 +10,7 @@
 #include "stdafx.h"
 #include "sinks.h"
 #include "app.h"
+#include "recorder.h"
 
 using namespace extensions;
 using namespace boost::python;
@@ -233,6 +234,45 @@ void PNSetClipboardText(const char* text)
 	}
 }
 
+/**
+ * Set which typed characters are passed on to glue.onCharAdded.
+ */
+void ListenForChars(const char* chars, bool anyChar)
+{
+	g_app->GetEventFilter().SetChars(chars, anyChar);
+}
+
+/**
+ * Set which typed characters are collected for glue.onCharsAdded.
+ */
+void ListenForBatchedChars(const char* chars, bool anyChar)
+{
+	g_app->GetEventFilter().SetBatchedChars(chars, anyChar);
+}
+
+/**
+ * Keys for glue.addDocEventHandler.
+ */
+typedef enum
+{
+	deLoad = 1,
+	deBeforeSave = 2,
+	deAfterSave = 4,
+	deModifiedChanged = 8,
+	deWriteProtectChanged = 16
+} EDocEvent;
+
+/**
+ * Play the last recording into the current document as one undo action.
+ */
+bool ReplayLastRecording(bool suppressRedraw)
+{
+	IDocumentPtr doc(g_app->GetPN()->GetCurrentDocument());
+	Recorder* recorder = g_app->GetRecorder();
+
+	return recorder != NULL && recorder->ReplayLast(doc, suppressRedraw);
+}
+
 } // namespace
 
 #define CONSTANT(x) scope().attr(#x) = x
@@ -270,6 +310,10 @@ BOOST_PYTHON_MODULE(pn)
 
 	def("SetClipboardText", &PNSetClipboardText, "Set clipboard text");
 
+	def("ListenForChars", &ListenForChars, "Set the typed characters that glue.onCharAdded is called for, and whether it's called for every character");
+	def("ListenForBatchedChars", &ListenForBatchedChars, "Set the typed characters collected into bursts for glue.onCharsAdded, and whether every character is");
+	def("ReplayLastRecording", &ReplayLastRecording, "Play the last recording into the current document as one undo action, optionally without redrawing until it's done");
+
 	CONSTANT(IDOK);
 	CONSTANT(IDCANCEL);
 	CONSTANT(IDYES);
@@ -282,6 +326,12 @@ BOOST_PYTHON_MODULE(pn)
 	CONSTANT(MB_ICONQUESTION);
 	CONSTANT(MB_ICONERROR);
 
+	scope().attr("DOCEVENT_LOAD") = static_cast<unsigned int>(deLoad);
+	scope().attr("DOCEVENT_SAVE") = static_cast<unsigned int>(deBeforeSave);
+	scope().attr("DOCEVENT_SAVED") = static_cast<unsigned int>(deAfterSave);
+	scope().attr("DOCEVENT_MODIFIEDCHANGED") = static_cast<unsigned int>(deModifiedChanged);
+	scope().attr("DOCEVENT_WRITEPROTECTCHANGED") = static_cast<unsigned int>(deWriteProtectChanged);
+
 	enum_<FindNextResult>("FindNextResult")
 		.value("fnNotFound", fnNotFound)
 		.value("fnFound", fnFound)
@@ -16,6 +16,16 @@ BOOST_PYTHON_MODULE(scintilla)
 {
 	boost::python::docstring_options docstring_options(true);
 
+object textBufferView = class_< TextBufferView, boost::shared_ptr<TextBufferView>, boost::noncopyable >("TextBufferView", "Read-only document text, raises once the text has changed. memoryview(view) reads the text without copying it", no_init)
+	.add_property("valid", &TextBufferView::IsValid)
+	.def("__len__", &TextBufferView::Length)
+	.def("__getitem__", &TextBufferView::GetItem)
+	.def("tobytes", &TextBufferView::ToBytes, "Copy the text")
+	.def("find", &TextBufferView::Find, (arg("sub"), arg("start") = 0), "Offset of the first sub at or after start, or -1")
+	;
+
+TextBufferView::AddBufferProtocol(textBufferView);
+
 class_< PNScintilla, boost::noncopyable >("Scintilla", init<extensions::IDocument*>() )
 	.def("IndentLine", &PNScintilla::IndentLine)
 /*++Autogenerated*/
@@ -214,6 +224,8 @@ class_< PNScintilla, boost::noncopyable >("Scintilla", init<extensions::IDocumen
 	.def("GetStyledText", &PNScintilla::GetStyledText)
 	.def("GetText", &PNScintilla::GetTextAsString, "Get n characters from the document text")
 	.def("GetTextRange", &PNScintilla::GetTextRangeAsString)
+	.def("ReadText", &PNScintilla::ReadText, "Call a function with a TextBufferView of the document text, valid until the function returns or the text changes")
+	.def("ReadTextRange", &PNScintilla::ReadTextRange, "Call a function with a TextBufferView of the text from start to end, valid until the function returns or the text changes")
 	.def("GotoLine", &PNScintilla::GotoLine)
 	.def("GotoPos", &PNScintilla::GotoPos)
 	.def("GrabFocus", &PNScintilla::GrabFocus)
@@ -297,6 +309,7 @@ class_< PNScintilla, boost::noncopyable >("Scintilla", init<extensions::IDocumen
 	.def("ReleaseDocument", &PNScintilla::ReleaseDocument)
 	.def("ReplaceSel", &PNScintilla::ReplaceSel)
 	.def("ReplaceTarget", &PNScintilla::ReplaceTarget)
+	.def("ReplaceMany", &PNScintilla::ReplaceMany, "Make a list of (start, end, text) replacements as one undo action")
 	.def("ReplaceTargetRE", &PNScintilla::ReplaceTargetRE)
 	.def("ScrollCaret", &PNScintilla::ScrollCaret)
 	.def("SearchAnchor", &PNScintilla::SearchAnchor)
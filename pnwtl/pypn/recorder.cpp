@@ -12,10 +12,59 @@
 #include "recorder.h"
 #include "App.h"
 
+#include "../third_party/scintilla/include/Scintilla.h"
+
+/**
+ * Plays a MacroLog back into a document.
+ */
+class Recorder::DocumentTarget : public IMacroTarget
+{
+public:
+	DocumentTarget(extensions::IDocumentPtr& doc, const SearchList& searches) : m_doc(doc), m_searches(searches)
+	{
+	}
+
+	virtual void Perform(int message, uintptr_t wParam, intptr_t lParam)
+	{
+		m_doc->SendEditorMessage(message, wParam, lParam);
+	}
+
+	virtual void Search(int index)
+	{
+		if (index < 0 || index >= static_cast<int>(m_searches.size()))
+		{
+			return;
+		}
+
+		SearchOptions options(m_searches[index].Options);
+
+		switch (m_searches[index].Type)
+		{
+		case stFindNext:
+			m_doc->FindNext(&options);
+			break;
+		case stReplace:
+			m_doc->Replace(&options);
+			break;
+		case stReplaceAll:
+			m_doc->ReplaceAll(&options);
+			break;
+		}
+	}
+
+private:
+	extensions::IDocumentPtr& m_doc;
+	const SearchList& m_searches;
+};
+
 Recorder::Recorder(App* app) : m_app(app), m_pn(app->GetPN()), m_glue(app->PyPnGlue())
 {
 }
 
+/**
+ * Called for every recorded Scintilla message, these go into the native log
+ * and are only turned into script when the recording stops.
+ */
 void Recorder::RecordScintillaAction(int message, WPARAM wParam, LPARAM lParam)
 {
 	if (!m_recorder.get())
@@ -23,15 +72,7 @@ void Recorder::RecordScintillaAction(int message, WPARAM wParam, LPARAM lParam)
 		return;
 	}
 
-	try
-	{
-		boost::python::call_method<void>(m_recorder.get(), "recordScintillaAction", message, wParam, lParam);
-	}
-	catch(boost::python::error_already_set&)
-	{
-		std::string s = getPythonErrorString();
-		m_app->AddOutput(s.c_str());
-	}
+	m_log.Record(message, wParam, lParam);
 }
 
 /**
@@ -44,15 +85,13 @@ void Recorder::RecordSearchAction(SearchType type, const extensions::ISearchOpti
 		return;
 	}
 
-	try
-	{
-		boost::python::call_method<void>(m_recorder.get(), "recordSearchAction", type, SearchOptions(*options), result);
-	}
-	catch(boost::python::error_already_set&)
-	{
-		std::string s = getPythonErrorString();
-		m_app->AddOutput(s.c_str());
-	}
+	RecordedSearch search;
+	search.Type = type;
+	search.Options = SearchOptions(*options);
+	search.Result = result;
+
+	m_log.RecordSearch(static_cast<int>(m_searches.size()));
+	m_searches.push_back(search);
 }
 
 /**
@@ -62,6 +101,9 @@ void Recorder::StartRecording()
 {
 	// Make sure we have no recordings in progress.
 	StopRecording();
+
+	m_log.Clear();
+	m_searches.clear();
 	
 	try
 	{
@@ -87,8 +129,11 @@ void Recorder::StopRecording()
 	// Store the document that's currently being edited.
 	extensions::IDocumentPtr currentDoc(m_pn->GetCurrentDocument());
 
+	m_log.Finish();
+
 	try
 	{
+		writeScript();
 		boost::python::call_method<void>(m_recorder.get(), "stopRecording");
 	}
 	catch(boost::python::error_already_set&)
@@ -99,7 +144,66 @@ void Recorder::StopRecording()
 
 	m_recorder.reset();
 
+	// Keep the recording for ReplayLast:
+	std::swap(m_log, m_lastLog);
+	m_searches.swap(m_lastSearches);
+	m_log.Clear();
+	m_searches.clear();
+
 	// Reactivate the document we had when we were called, making sure
 	// that we haven't stolen the user's focus.
 	currentDoc->Activate();
-}
\ No newline at end of file
+}
+
+bool Recorder::ReplayLast(extensions::IDocumentPtr& doc, bool suppressRedraw)
+{
+	if (!doc.get() || m_lastLog.IsEmpty())
+	{
+		return false;
+	}
+
+	HWND hWndEditor = doc->GetScintillaHWND();
+	if (suppressRedraw)
+	{
+		::SendMessage(hWndEditor, WM_SETREDRAW, FALSE, 0);
+	}
+
+	doc->SendEditorMessage(SCI_BEGINUNDOACTION, 0, 0);
+
+	DocumentTarget target(doc, m_lastSearches);
+	m_lastLog.Replay(target);
+
+	doc->SendEditorMessage(SCI_ENDUNDOACTION, 0, 0);
+
+	if (suppressRedraw)
+	{
+		::SendMessage(hWndEditor, WM_SETREDRAW, TRUE, 0);
+		::InvalidateRect(hWndEditor, NULL, TRUE);
+	}
+
+	return true;
+}
+
+/**
+ * Hand the coalesced actions to the python recorder, which turns them into
+ * script. Strings are passed as pointers into the log just as Scintilla
+ * passes them.
+ */
+void Recorder::writeScript()
+{
+	MacroAction action;
+	size_t pos(0);
+
+	while (m_log.Next(pos, action))
+	{
+		if (action.Type == MacroAction::maSearch)
+		{
+			const RecordedSearch& search = m_searches[action.Index];
+			boost::python::call_method<void>(m_recorder.get(), "recordSearchAction", search.Type, search.Options, search.Result);
+			continue;
+		}
+
+		LPARAM lParam = action.HasText ? reinterpret_cast<LPARAM>(action.Text.c_str()) : static_cast<LPARAM>(action.LParam);
+		boost::python::call_method<void>(m_recorder.get(), "recordScintillaAction", action.Message, static_cast<WPARAM>(action.WParam), lParam, action.Repeat);
+	}
+}
@@ -11,6 +11,7 @@
 #define recorder_h__included
 
 #include "../extiface.h"
+#include "macrolog.h"
 
 class App;
 
@@ -49,11 +50,43 @@ public:
 	 */
 	virtual void StopRecording();
 
+	/**
+	 * Play the last recording back into doc as one undo action.
+	 * @param suppressRedraw true to leave the editor alone until it's done
+	 * @return false if there's nothing recorded
+	 */
+	bool ReplayLast(extensions::IDocumentPtr& doc, bool suppressRedraw);
+
 private:
+	/**
+	 * Everything needed to repeat a search, kept by index in the log.
+	 */
+	class RecordedSearch
+	{
+	public:
+		SearchType Type;
+		SearchOptions Options;
+		FindNextResult Result;
+	};
+
+	typedef std::vector<RecordedSearch> SearchList;
+
+	class DocumentTarget;
+
+	void writeScript();
+
 	App* m_app;
 	boost::python::object& m_glue;
 	boost::python::handle<> m_recorder;
 	extensions::IPN* m_pn;
+
+	/// The recording in progress
+	MacroLog m_log;
+	SearchList m_searches;
+
+	/// The last finished recording
+	MacroLog m_lastLog;
+	SearchList m_lastSearches;
 };
 
 #endif // #ifndef recorder_h__included
\ No newline at end of file
@@ -9,6 +9,25 @@ def indenter(scheme):
 		return f
 	return decorator
 
+def char_added(scheme, chars=None, batched=False):
+	""" Call the function with each character typed into a document using
+	scheme, or only with those in chars. With batched it's called once a
+	burst of typing is over, with all of those characters in one string """
+	def decorator(f):
+		s = glue.getSchemeConfig(scheme)
+		s.char_added_chars = chars
+		s.char_added_batched = batched
+		s.on_char_added = f
+		return f
+	return decorator
+
+def doc_event(event):
+	""" Call the function for a document event, one of the pn.DOCEVENT_ values """
+	def decorator(f):
+		glue.addDocEventHandler(event, f)
+		return f
+	return decorator
+
 def script(name=None, group="Python", auto_undo=True):
 	def decorator(f):
 		""" Decorator code """
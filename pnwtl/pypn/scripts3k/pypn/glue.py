@@ -10,11 +10,42 @@ schemes = {}
 scripts = {}
 oldstdout = None
 
-class SchemeMapping:
+# Document event handlers, by DOCEVENT_ flag:
+docEventHandlers = {}
+
+class SchemeMapping(object):
+	""" Handlers for one scheme, PN is told which characters they want
+	whenever they're changed """
 	def __init__(self, name):
 		self.name = name
-		self.on_char_added = None
-		self.indenter = None
+		self._on_char_added = None
+		self._char_added_chars = None
+		self._char_added_batched = False
+		self._indenter = None
+	
+	def _setOnCharAdded(self, f):
+		self._on_char_added = f
+		updateCharListeners()
+	
+	def _setCharAddedChars(self, chars):
+		self._char_added_chars = chars
+		updateCharListeners()
+	
+	def _setCharAddedBatched(self, batched):
+		self._char_added_batched = batched
+		updateCharListeners()
+	
+	def _setIndenter(self, f):
+		self._indenter = f
+		updateCharListeners()
+	
+	on_char_added = property(lambda self: self._on_char_added, _setOnCharAdded)
+	# The characters on_char_added wants, None for all of them
+	char_added_chars = property(lambda self: self._char_added_chars, _setCharAddedChars)
+	# True to have on_char_added called once a burst of typing is over, with
+	# all the characters it wants from the burst, rather than with each one
+	char_added_batched = property(lambda self: self._char_added_batched, _setCharAddedBatched)
+	indenter = property(lambda self: self._indenter, _setIndenter)
 
 class StdOutCapture:
 	""" Simple output capturer """
@@ -48,34 +79,89 @@ def onCharAdded(c, doc):
 		
 	scheme = schemes[doc.CurrentScheme]
 	
-	if scheme and scheme.on_char_added != None:
+	if scheme.on_char_added != None and not scheme.char_added_batched and wantsChar(scheme, c):
 		scheme.on_char_added(c, doc)
 		
 	if not (c == '\n' or c == '\r'):
 		return
 	
-	if scheme and scheme.indenter != None:
+	if scheme.indenter != None:
 		scheme.indenter(c, doc)
+
+def onCharsAdded(chars, doc):
+	""" Method called with a burst of typing for on_char_added handlers that
+	set char_added_batched, once the typing is over """
+	if not doc.CurrentScheme in schemes:
+		return
+		
+	scheme = schemes[doc.CurrentScheme]
+	
+	if scheme.on_char_added == None or not scheme.char_added_batched:
+		return
 	
+	wanted = "".join([c for c in chars if wantsChar(scheme, c)])
+	if len(wanted):
+		scheme.on_char_added(wanted, doc)
+
+def wantsChar(scheme, c):
+	return scheme.char_added_chars == None or c in scheme.char_added_chars
+
+def updateCharListeners():
+	""" Tell PN which typed characters the schemes want, it doesn't call
+	onCharAdded or onCharsAdded for the rest. A script that replaces
+	onCharAdded itself is still given every character """
+	chars = ""
+	anyChar = False
+	batchedChars = ""
+	anyBatchedChar = False
+	for scheme in schemes.values():
+		if scheme.on_char_added != None:
+			if scheme.char_added_batched:
+				if scheme.char_added_chars == None:
+					anyBatchedChar = True
+				else:
+					batchedChars = batchedChars + scheme.char_added_chars
+			elif scheme.char_added_chars == None:
+				anyChar = True
+			else:
+				chars = chars + scheme.char_added_chars
+		if scheme.indenter != None:
+			chars = chars + "\r\n"
+	pn.ListenForChars(chars, anyChar)
+	pn.ListenForBatchedChars(batchedChars, anyBatchedChar)
+
+def addDocEventHandler(event, f):
+	""" Call f for a document event, event is one of the pn.DOCEVENT_ values.
+	The default onDocLoad and friends call these, a script that replaces
+	one of them takes over that event """
+	if not event in docEventHandlers:
+		docEventHandlers[event] = []
+	docEventHandlers[event].append(f)
+
+def fireDocEvent(event, *args):
+	if event in docEventHandlers:
+		for f in docEventHandlers[event]:
+			f(*args)
+
 def onDocLoad(doc):
 	""" Method called when a document is loaded into PN """
-	pass
+	fireDocEvent(pn.DOCEVENT_LOAD, doc)
 	
 def onDocSave(filename, doc):
 	""" Method called when a document is about to be saved to a file """
-	pass
+	fireDocEvent(pn.DOCEVENT_SAVE, filename, doc)
 
 def onDocSaved(doc):
 	""" Method called when a document has been saved """
-	pass
+	fireDocEvent(pn.DOCEVENT_SAVED, doc)
 
 def onModifiedChanged(modified, doc):
 	""" Method called when the modified flag is changed """
-	pass
+	fireDocEvent(pn.DOCEVENT_MODIFIEDCHANGED, modified, doc)
 
 def onWriteProtectChanged(protected, doc):
 	""" Method called when the read only status of a document is changed """
-	pass
+	fireDocEvent(pn.DOCEVENT_WRITEPROTECTCHANGED, protected, doc)
 
 def getSchemeConfig(name):
 	""" Get a pypn scheme configuration, used to hook up indenter 
@@ -315,11 +315,15 @@ class Recorder:
 		self.insertbuf = ""
 		self.lineends = ['\r', '\n']
 
-	def recordScintillaAction(self, message, wParam, lParam):
+	def recordScintillaAction(self, message, wParam, lParam, repeat=1):
 		""" The user performed an action in scintilla, we handle it here 
-		and add it to the script """
+		and add it to the script. PN records actions natively and passes 
+		them on when recording stops, with runs of the same action 
+		collapsed into one call with a repeat count. """
 		command = self._handleMessage(message, wParam, lParam)
 		if command != None:
+			if repeat > 1:
+				command = "\tfor i in range(" + str(repeat) + "):\r\n\t" + command
 			self.script = self.script + command
 	
 	def recordSearchAction(self, type, options, result):
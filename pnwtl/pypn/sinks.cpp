@@ -10,6 +10,7 @@
 #include "stdafx.h"
 #include "sinks.h"
 #include "app.h"
+#include "textbufferview.h"
 
 using namespace extensions;
 using namespace boost::python;
@@ -20,7 +21,21 @@ using namespace boost::python;
 	static char THIS_FILE[] = __FILE__;
 #endif*/
 
-DocSink::DocSink(IDocumentPtr& doc) : m_doc(doc)
+namespace
+{
+
+/**
+ * More keystrokes waiting means the user is typing faster than we're keeping
+ * up, or keys are being fed in by something else.
+ */
+bool isInputPending()
+{
+	return (HIWORD(::GetQueueStatus(QS_KEY)) & QS_KEY) != 0;
+}
+
+} // namespace
+
+DocSink::DocSink(IDocumentPtr& doc) : m_doc(doc), m_chars(g_app->GetEventFilter())
 {
 
 }
@@ -32,11 +47,39 @@ DocSink::~DocSink()
 
 void DocSink::OnDocClosing()
 {
+	// The text is about to go, no script may read it through a view now:
+	if (m_doc.get())
+	{
+		TextBufferView::InvalidateAll(m_doc->GetScintillaHWND());
+	}
+
+	m_chars.Clear();
 	m_doc.reset();
 }
 
 void DocSink::OnCharAdded(char c)
 {
+	const DocEventFilter& filter = g_app->GetEventFilter();
+
+	// Handlers that asked for batches get a burst of typing once it's over:
+	if (filter.WantsBatchedChar(c) || m_chars.HasPending())
+	{
+		if (m_chars.Add(c, isInputPending()))
+		{
+			FlushChars();
+		}
+		else if (m_chars.HasPending())
+		{
+			g_app->QueueFlushChars(shared_from_this());
+		}
+	}
+
+	// Typing into a document nobody is listening to stays out of Python altogether:
+	if (!filter.WantsChar(c) && !g_app->IsOnCharAddedReplaced())
+	{
+		return;
+	}
+
 	try
 	{
 		boost::python::call_method<void>(g_app->PyPnGlue().ptr(), "onCharAdded", c, (m_doc));
@@ -48,8 +91,31 @@ void DocSink::OnCharAdded(char c)
 	}
 }
 
+void DocSink::FlushChars()
+{
+	if (!m_chars.HasPending() || !m_doc.get())
+	{
+		return;
+	}
+
+	std::string chars;
+	m_chars.Take(chars);
+
+	try
+	{
+		boost::python::call_method<void>(g_app->PyPnGlue().ptr(), "onCharsAdded", chars, (m_doc));
+	}
+	catch(error_already_set&)
+	{
+		std::string s = getPythonErrorString();
+		OutputDebugString(s.c_str());
+	}
+}
+
 void DocSink::OnAfterLoad()
 {
+	FlushChars();
+
 	try
 	{
 		boost::python::call_method<void>(g_app->PyPnGlue().ptr(), "onDocLoad", (m_doc));
@@ -63,6 +129,8 @@ void DocSink::OnAfterLoad()
 
 void DocSink::OnBeforeSave(const wchar_t* filename)
 {
+	FlushChars();
+
 	try
 	{
 		std::wstring fn(filename);
@@ -77,6 +145,8 @@ void DocSink::OnBeforeSave(const wchar_t* filename)
 
 void DocSink::OnAfterSave()
 {
+	FlushChars();
+
 	try
 	{
 		boost::python::call_method<void>(g_app->PyPnGlue().ptr(), "onDocSaved", (m_doc));
@@ -90,6 +160,8 @@ void DocSink::OnAfterSave()
 
 void DocSink::OnModifiedChanged(bool modified)
 {
+	FlushChars();
+
 	try
 	{
 		boost::python::call_method<void>(g_app->PyPnGlue().ptr(), "onModifiedChanged", modified, (m_doc));
@@ -103,6 +175,14 @@ void DocSink::OnModifiedChanged(bool modified)
 
 void DocSink::OnWriteProtectChanged(bool writeProtect)
 {
+	// The text can change from now on:
+	if (!writeProtect && m_doc.get())
+	{
+		TextBufferView::InvalidateAll(m_doc->GetScintillaHWND());
+	}
+
+	FlushChars();
+
 	try
 	{
 		boost::python::call_method<void>(g_app->PyPnGlue().ptr(), "onWriteProtectChanged", writeProtect, (m_doc));
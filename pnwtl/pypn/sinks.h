@@ -14,7 +14,12 @@
 	#pragma once
 #endif
 
-class DocSink : public extensions::IDocumentEventSink, public extensions::ITextEditorEventSink
+#include "eventfilter.h"
+
+#include <boost/enable_shared_from_this.hpp>
+
+class DocSink : public extensions::IDocumentEventSink, public extensions::ITextEditorEventSink,
+	public boost::enable_shared_from_this<DocSink>
 {
 public:
 	DocSink(extensions::IDocumentPtr& doc);
@@ -30,8 +35,14 @@ public:
 
 	virtual void OnCharAdded(char c);
 
+	/**
+	 * Pass any characters waiting from a burst of typing on to the scripts.
+	 */
+	void FlushChars();
+
 private:
 	extensions::IDocumentPtr m_doc;
+	CharBatch m_chars;
 };
 
 #endif //#ifndef sinks_h__included
\ No newline at end of file
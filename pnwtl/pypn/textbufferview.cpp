@@ -0,0 +1,279 @@
+/**
+ * @file textbufferview.cpp
+ * @brief Read-only access to the document text for scripts, without copying it
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#include "stdafx.h"
+#include "textbufferview.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+/// Views that are valid or exported, only touched on the UI thread
+std::vector<TextBufferView*> s_views;
+
+/// Read the text of a view by the buffer protocol, set up by AddBufferProtocol
+PyBufferProcs s_bufferProcs;
+
+boost::python::object makeBytes(const char* text, Py_ssize_t length)
+{
+	return boost::python::object(boost::python::handle<>(PyBytes_FromStringAndSize(text, length)));
+}
+
+int getBuffer(PyObject* exporter, Py_buffer* view, int flags)
+{
+	boost::python::extract<TextBufferView&> textView(exporter);
+	if (!textView.check())
+	{
+		view->obj = NULL;
+		PyErr_SetString(PyExc_BufferError, "Not a TextBufferView");
+		return -1;
+	}
+
+	return textView().GetBuffer(exporter, view, flags);
+}
+
+void releaseBuffer(PyObject* exporter, Py_buffer* /*view*/)
+{
+	boost::python::extract<TextBufferView&> textView(exporter);
+	if (textView.check())
+	{
+		textView().ReleaseBuffer();
+	}
+}
+
+} // namespace
+
+TextBufferView::TextBufferView(HWND hWndScintilla, const char* text, int length) :
+	m_hWnd(hWndScintilla),
+	m_text(text),
+	m_length(length),
+	m_valid(true),
+	m_exports(0)
+{
+	s_views.push_back(this);
+}
+
+void TextBufferView::AddBufferProtocol(boost::python::object type)
+{
+	s_bufferProcs.bf_getbuffer = getBuffer;
+	s_bufferProcs.bf_releasebuffer = releaseBuffer;
+
+	PyTypeObject* typeObject = reinterpret_cast<PyTypeObject*>(type.ptr());
+	typeObject->tp_as_buffer = &s_bufferProcs;
+#if PY_MAJOR_VERSION < 3
+	typeObject->tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+}
+
+TextBufferView::~TextBufferView()
+{
+	// Buffers hold a reference to the view, so none can be left:
+	PNASSERT(m_exports == 0);
+
+	m_valid = false;
+	forget();
+}
+
+void TextBufferView::Invalidate()
+{
+	if (!m_valid)
+	{
+		return;
+	}
+
+	m_valid = false;
+	m_text = NULL;
+
+	forget();
+}
+
+void TextBufferView::InvalidateAll(HWND hWndScintilla)
+{
+	// Views hardly ever outlive their callback, so there's rarely anything here.
+	// Invalidating may forget the view, so copy the list first:
+	std::vector<TextBufferView*> views(s_views);
+	for (std::vector<TextBufferView*>::const_iterator i = views.begin(); i != views.end(); ++i)
+	{
+		if ((*i)->m_hWnd == hWndScintilla)
+		{
+			(*i)->Invalidate();
+		}
+	}
+}
+
+bool TextBufferView::IsExported(HWND hWndScintilla)
+{
+	for (std::vector<TextBufferView*>::const_iterator i = s_views.begin(); i != s_views.end(); ++i)
+	{
+		if ((*i)->m_hWnd == hWndScintilla && (*i)->IsExported())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TextBufferView::IsValid() const
+{
+	return m_valid;
+}
+
+bool TextBufferView::IsExported() const
+{
+	return m_exports > 0;
+}
+
+void TextBufferView::SetReleasedHandler(ReleasedHandler handler)
+{
+	m_released = handler;
+}
+
+int TextBufferView::GetBuffer(PyObject* exporter, Py_buffer* view, int flags)
+{
+	if (!m_valid)
+	{
+		view->obj = NULL;
+		PyErr_SetString(PyExc_BufferError, "The text view is no longer valid, the document has changed or ReadText has returned");
+		return -1;
+	}
+
+	// Fails for anyone wanting to write:
+	if (PyBuffer_FillInfo(view, exporter, const_cast<char*>(m_text), m_length, 1, flags) != 0)
+	{
+		return -1;
+	}
+
+	++m_exports;
+	return 0;
+}
+
+void TextBufferView::ReleaseBuffer()
+{
+	PNASSERT(m_exports > 0);
+
+	if (--m_exports != 0 || m_valid)
+	{
+		return;
+	}
+
+	forget();
+
+	if (m_released)
+	{
+		ReleasedHandler handler;
+		handler.swap(m_released);
+		handler();
+	}
+}
+
+int TextBufferView::Length() const
+{
+	text();
+	return m_length;
+}
+
+boost::python::object TextBufferView::GetItem(boost::python::object key) const
+{
+	const char* buf = text();
+
+	if (PySlice_Check(key.ptr()))
+	{
+		Py_ssize_t start, stop, step, count;
+#if PY_MAJOR_VERSION >= 3
+		if (PySlice_GetIndicesEx(key.ptr(), m_length, &start, &stop, &step, &count) != 0)
+#else
+		if (PySlice_GetIndicesEx(reinterpret_cast<PySliceObject*>(key.ptr()), m_length, &start, &stop, &step, &count) != 0)
+#endif
+		{
+			boost::python::throw_error_already_set();
+		}
+
+		if (step == 1)
+		{
+			return makeBytes(buf + start, count);
+		}
+
+		std::string stepped;
+		stepped.reserve(count);
+		for (Py_ssize_t i = 0; i < count; ++i)
+		{
+			stepped += buf[start + i * step];
+		}
+
+		return makeBytes(stepped.data(), count);
+	}
+
+	int index = boost::python::extract<int>(key);
+	if (index < 0)
+	{
+		index += m_length;
+	}
+
+	if (index < 0 || index >= m_length)
+	{
+		PyErr_SetString(PyExc_IndexError, "index out of range");
+		boost::python::throw_error_already_set();
+	}
+
+#if PY_MAJOR_VERSION >= 3
+	return boost::python::object(static_cast<unsigned char>(buf[index]));
+#else
+	return makeBytes(buf + index, 1);
+#endif
+}
+
+boost::python::object TextBufferView::ToBytes() const
+{
+	return makeBytes(text(), m_length);
+}
+
+int TextBufferView::Find(const std::string& sub, int start) const
+{
+	const char* buf = text();
+
+	if (start < 0)
+	{
+		start = 0;
+	}
+
+	if (start > m_length)
+	{
+		return -1;
+	}
+
+	const char* end = buf + m_length;
+	const char* found = std::search(buf + start, end, sub.begin(), sub.end());
+	if (found == end && !sub.empty())
+	{
+		return -1;
+	}
+
+	return static_cast<int>(found - buf);
+}
+
+void TextBufferView::forget()
+{
+	if (!m_valid && m_exports == 0)
+	{
+		s_views.erase(std::remove(s_views.begin(), s_views.end(), this), s_views.end());
+	}
+}
+
+const char* TextBufferView::text() const
+{
+	if (!m_valid)
+	{
+		throw std::runtime_error("The text view is no longer valid, the document has changed or ReadText has returned");
+	}
+
+	return m_text;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file textbufferview.h
+ * @brief Read-only access to the document text for scripts, without copying it
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#ifndef textbufferview_h__included
+#define textbufferview_h__included
+
+#ifdef _MSC_VER
+	#pragma once
+#endif
+
+/**
+ * Part of a document's text, read straight from Scintilla's buffer. The
+ * buffer moves as soon as the text changes. ReadText keeps the document
+ * read only while a view is in use, so a view goes invalid when the
+ * callback it was given to returns or when the document could change:
+ * when it stops being read only or is closed. Every access checks first
+ * and raises rather than read stale memory. Indexing, slices and tobytes()
+ * copy, what they return is safe to keep.
+ *
+ * Views also have the buffer protocol, so memoryview(view) and anything
+ * else that takes a buffer reads the text in place. A buffer can only be
+ * taken from a valid view, and the document is kept read only until every
+ * buffer taken from it has been released.
+ */
+class TextBufferView
+{
+public:
+	typedef boost::function<void ()> ReleasedHandler;
+
+	/**
+	 * @param hWndScintilla The document the text belongs to
+	 */
+	TextBufferView(HWND hWndScintilla, const char* text, int length);
+	~TextBufferView();
+
+	/// Give the Python type for TextBufferView the buffer protocol
+	static void AddBufferProtocol(boost::python::object type);
+
+	/// Stop this view reading the buffer
+	void Invalidate();
+
+	/// Stop every live view of a document, called when its text may change
+	static void InvalidateAll(HWND hWndScintilla);
+
+	/// Are buffers taken from any view of a document still held?
+	static bool IsExported(HWND hWndScintilla);
+
+	bool IsValid() const;
+
+	/// Are any buffers taken from this view still held?
+	bool IsExported() const;
+
+	/// Called once when the last buffer is released after the view is invalid
+	void SetReleasedHandler(ReleasedHandler handler);
+
+	/// bf_getbuffer, fails unless the view is valid
+	int GetBuffer(PyObject* exporter, Py_buffer* view, int flags);
+
+	/// bf_releasebuffer
+	void ReleaseBuffer();
+
+	/// __len__
+	int Length() const;
+
+	/// __getitem__, a byte for an index and a copy for a slice, as bytes does
+	boost::python::object GetItem(boost::python::object key) const;
+
+	/// A copy of the whole view
+	boost::python::object ToBytes() const;
+
+	/// Offset of the first sub at or after start, or -1
+	int Find(const std::string& sub, int start) const;
+
+private:
+	TextBufferView(const TextBufferView&);
+	TextBufferView& operator=(const TextBufferView&);
+
+	/// The text, or throws if the view is no longer valid
+	const char* text() const;
+
+	/// Stop tracking the view once it's invalid and not exported
+	void forget();
+
+	HWND m_hWnd;
+	const char* m_text;
+	int m_length;
+	bool m_valid;
+	int m_exports;
+	ReleasedHandler m_released;
+};
+
+#endif // #ifndef textbufferview_h__included
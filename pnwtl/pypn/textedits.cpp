@@ -0,0 +1,80 @@
+/**
+ * @file textedits.cpp
+ * @brief A set of replacements to make to a document in one go
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#include "stdafx.h"
+#include "textedits.h"
+
+#include <algorithm>
+
+namespace
+{
+
+bool editLess(const TextEdit& a, const TextEdit& b)
+{
+	if (a.Start != b.Start)
+	{
+		return a.Start < b.Start;
+	}
+
+	// An insertion goes before a replacement starting at the same place:
+	return a.End < b.End;
+}
+
+} // namespace
+
+bool TextEdits::Add(int start, int end, const std::string& text)
+{
+	if (start < 0 || end < start)
+	{
+		return false;
+	}
+
+	m_edits.push_back(TextEdit());
+	TextEdit& edit = m_edits.back();
+	edit.Start = start;
+	edit.End = end;
+	edit.Text = text;
+
+	return true;
+}
+
+bool TextEdits::Prepare(int length)
+{
+	std::stable_sort(m_edits.begin(), m_edits.end(), editLess);
+
+	for (size_t i = 0; i < m_edits.size(); ++i)
+	{
+		if (m_edits[i].End > length)
+		{
+			return false;
+		}
+
+		if (i > 0 && m_edits[i - 1].End > m_edits[i].Start)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+TextEdits::const_iterator TextEdits::begin() const
+{
+	return m_edits.rbegin();
+}
+
+TextEdits::const_iterator TextEdits::end() const
+{
+	return m_edits.rend();
+}
+
+size_t TextEdits::Size() const
+{
+	return m_edits.size();
+}
@@ -0,0 +1,66 @@
+/**
+ * @file textedits.h
+ * @brief A set of replacements to make to a document in one go
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+#ifndef textedits_h__included
+#define textedits_h__included
+
+#ifdef _MSC_VER
+	#pragma once
+#endif
+
+#include <string>
+#include <vector>
+
+/**
+ * Replace the text from Start up to End with Text, positions are in the
+ * document as it was before any of the edits.
+ */
+class TextEdit
+{
+public:
+	int Start;
+	int End;
+	std::string Text;
+};
+
+/**
+ * Edits collected from a script. Once prepared they can be applied from the
+ * last to the first, so that each edit leaves the positions of the ones
+ * still to come alone.
+ */
+class TextEdits
+{
+public:
+	typedef std::vector<TextEdit> EditList;
+	typedef EditList::const_reverse_iterator const_iterator;
+
+	/**
+	 * @return false if the range is backwards or negative
+	 */
+	bool Add(int start, int end, const std::string& text);
+
+	/**
+	 * Sort the edits by position. Insertions at the same position keep the
+	 * order they were added in.
+	 * @param length length of the document
+	 * @return false if edits overlap or run past the end of the document
+	 */
+	bool Prepare(int length);
+
+	/// Iterate the prepared edits from the last one to the first
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	size_t Size() const;
+
+private:
+	EditList m_edits;
+};
+
+#endif // #ifndef textedits_h__included
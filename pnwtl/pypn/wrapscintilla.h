@@ -15,10 +15,33 @@
 #endif
 
 #include "../scintillaif.h"
+#include "textedits.h"
+#include "textbufferview.h"
 
 #define PN_OVERWRITETARGET	(WM_APP+19)
 #define PN_INSERTCLIPTEXT   (WM_APP+23)
 
+/**
+ * Puts a document's read only state back, for when the last memoryview of
+ * a TextBufferView is released after ReadText has returned.
+ */
+class RestoreReadOnly
+{
+public:
+	RestoreReadOnly(HWND hWndScintilla, bool readOnly) : m_hWnd(hWndScintilla), m_readOnly(readOnly)
+	{
+	}
+
+	void operator()() const
+	{
+		::SendMessage(m_hWnd, SCI_SETREADONLY, m_readOnly, 0);
+	}
+
+private:
+	HWND m_hWnd;
+	bool m_readOnly;
+};
+
 class PNScintilla : public CScintilla
 {
 public:
@@ -156,6 +179,125 @@ public:
 		return buf;
 	}
 
+	/**
+	 * Views of the text stop working once the document can change, and it
+	 * can't be made writable while a memoryview of them is still held.
+	 */
+	void SetReadOnly(bool readOnly)
+	{
+		if (!readOnly)
+		{
+			if (TextBufferView::IsExported(m_scihWnd))
+			{
+				PyErr_SetString(PyExc_BufferError, "A memoryview of the document text is still held");
+				boost::python::throw_error_already_set();
+			}
+
+			TextBufferView::InvalidateAll(m_scihWnd);
+		}
+
+		CScintilla::SetReadOnly(readOnly);
+	}
+
+	/**
+	 * Call callback with a TextBufferView over the document text, the text
+	 * isn't copied. The document is read only until callback returns, and
+	 * the view stops working when it does or if the text changes anyway.
+	 * A memoryview of the view kept past that keeps the document read only
+	 * until it's released.
+	 * @return whatever callback returns
+	 */
+	boost::python::object ReadText(boost::python::object callback)
+	{
+		return ReadTextRange(callback, 0, -1);
+	}
+
+	/**
+	 * ReadText for the text from start to end, -1 means the end of the document.
+	 */
+	boost::python::object ReadTextRange(boost::python::object callback, int start, int end)
+	{
+		int length = GetLength();
+		if (end < 0 || end > length)
+		{
+			end = length;
+		}
+
+		if (start < 0)
+		{
+			start = 0;
+		}
+		else if (start > end)
+		{
+			start = end;
+		}
+
+		// Asking for the pointer moves the gap out of the way, so the text is contiguous:
+		char* text = reinterpret_cast<char*>(::SendMessage(m_scihWnd, SCI_GETCHARACTERPOINTER, 0, 0));
+
+		boost::shared_ptr<TextBufferView> view(new TextBufferView(m_scihWnd, text + start, end - start));
+
+		bool wasReadOnly = GetReadOnly();
+		SetReadOnly(true);
+
+		boost::python::object result;
+		try
+		{
+			result = callback(boost::python::object(view));
+		}
+		catch (...)
+		{
+			endReading(*view, wasReadOnly);
+			throw;
+		}
+
+		endReading(*view, wasReadOnly);
+
+		return result;
+	}
+
+	/**
+	 * Make a list of (start, end, text) replacements as one undo action.
+	 * Positions are in the document as it is before any of them are made.
+	 * @return the number of replacements made
+	 */
+	int ReplaceMany(boost::python::object edits)
+	{
+		TextEdits prepared;
+
+		boost::python::ssize_t count = boost::python::len(edits);
+		for (boost::python::ssize_t i = 0; i < count; ++i)
+		{
+			boost::python::object edit(edits[i]);
+			int start = boost::python::extract<int>(edit[0]);
+			int end = boost::python::extract<int>(edit[1]);
+			std::string text = boost::python::extract<std::string>(edit[2]);
+
+			if (!prepared.Add(start, end, text))
+			{
+				throw std::runtime_error("Invalid edit range");
+			}
+		}
+
+		if (!prepared.Prepare(GetLength()))
+		{
+			throw std::runtime_error("Edits overlap or run past the end of the document");
+		}
+
+		BeginUndoAction();
+
+		for (TextEdits::const_iterator i = prepared.begin(); i != prepared.end(); ++i)
+		{
+			SetTargetStart((*i).Start);
+			SetTargetEnd((*i).End);
+			ReplaceTarget(static_cast<int>((*i).Text.size()), (*i).Text.c_str());
+		}
+
+		EndUndoAction();
+
+		return static_cast<int>(prepared.Size());
+	}
+
 	boost::python::object FindTextString(int start, int end, const char* string_to_find, int flags)
 	{
 		Scintilla::TextToFind f;	
@@ -186,6 +328,25 @@ public:
 	{
 		::SendMessage(m_scihWnd, PN_INSERTCLIPTEXT, 0, reinterpret_cast<LPARAM>(clipText.c_str()));
 	}
+
+private:
+	/**
+	 * Stop view working, and make the document writable again unless a
+	 * buffer taken from it is still held.
+	 */
+	void endReading(TextBufferView& view, bool wasReadOnly)
+	{
+		view.Invalidate();
+
+		if (view.IsExported())
+		{
+			view.SetReleasedHandler(RestoreReadOnly(m_scihWnd, wasReadOnly));
+		}
+		else
+		{
+			CScintilla::SetReadOnly(wasReadOnly);
+		}
+	}
 };
 
 #endif //#ifndef pypnwrapscintilla_h__included
\ No newline at end of file
@@ -863,6 +863,12 @@
 #define ID_NEW_DEFAULT                  33158
 #define ID_NEW_PROJECT                  33159
 #define ID_WINDOWS_CURRENTEDITOR        33160
+#define ID_OUTPUT_NEXTERROR             33161
+#define ID_OUTPUT_PREVIOUSERROR         33162
+#define ID_PROJECT_EXPORTHTML           33163
+#define ID_PROJECT_EXPORTRTF            33164
+#define IDS_BROWSEEXPORTROOT            33165
+#define ID_PROJECT_CANCELEXPORT         33166
 
 // Next default values for new objects
 // 
@@ -870,7 +876,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
 #define _APS_NEXT_RESOURCE_VALUE        372
-#define _APS_NEXT_COMMAND_VALUE         33161
+#define _APS_NEXT_COMMAND_VALUE         33167
 #define _APS_NEXT_CONTROL_VALUE         1174
 #define _APS_NEXT_SYMED_VALUE           104
 #endif
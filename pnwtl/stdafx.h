@@ -97,29 +97,7 @@ typedef std::basic_string<TCHAR> tstring;
 #include <boost/spirit/include/qi.hpp>
 #include <boost/bind.hpp>
 
-template <typename match_type>
-bool safe_get_submatch(match_type& match, typename match_type::string_type& expr, typename match_type::char_type const *name)
-{
-	try
-	{
-		expr = match[name].str();
-		return true;
-	}
-	catch (boost::xpressive::regex_error&)
-	{
-		return false;
-	}
-}
-
-namespace boost { namespace xpressive {
-#ifdef _UNICODE
-	typedef wsregex tsregex;
-	typedef wsmatch tsmatch;
-#else
-	typedef sregex tsregex;
-	typedef smatch tsmatch;
-#endif
-}} // namespace boost::xpressive
+#include "include/xpressiveutil.h"
 
 #define PNASSERT ATLASSERT
 
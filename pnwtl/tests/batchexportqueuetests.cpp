@@ -0,0 +1,92 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../batchexportqueue.h"
+
+BOOST_AUTO_TEST_SUITE( batchexportqueue_tests );
+
+BOOST_AUTO_TEST_CASE( output_keeps_folders_below_the_base_path )
+{
+	tstring output = BatchExportQueue::GetOutputFile(L"c:\\project\\src\\main.cpp", L"c:\\project\\", L"c:\\export", L"html");
+
+	BOOST_CHECK_EQUAL(L"c:\\export\\src\\main.cpp.html", output.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( output_outside_the_base_path_is_flattened )
+{
+	tstring output = BatchExportQueue::GetOutputFile(L"d:\\other\\lib\\util.h", L"c:\\project", L"c:\\export\\", L"rtf");
+
+	BOOST_CHECK_EQUAL(L"c:\\export\\util.h.rtf", output.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( output_without_a_base_path_is_flattened )
+{
+	tstring output = BatchExportQueue::GetOutputFile(L"c:\\project\\src\\main.cpp", L"", L"c:\\export", L"html");
+
+	BOOST_CHECK_EQUAL(L"c:\\export\\main.cpp.html", output.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( output_keeps_the_original_extension )
+{
+	tstring header = BatchExportQueue::GetOutputFile(L"c:\\project\\main.h", L"c:\\project", L"c:\\export", L"html");
+	tstring source = BatchExportQueue::GetOutputFile(L"c:\\project\\main.cpp", L"c:\\project", L"c:\\export", L"html");
+
+	BOOST_CHECK(header != source);
+}
+
+BOOST_AUTO_TEST_CASE( jobs_come_out_in_order_once_each )
+{
+	BatchExportQueue queue;
+	queue.Reset(L"c:\\project", L"c:\\export", L"html");
+
+	queue.Add(L"c:\\project\\a.cpp", SchemeSnapshotPtr());
+	queue.Add(L"c:\\project\\src\\b.cpp", SchemeSnapshotPtr());
+
+	BOOST_CHECK_EQUAL(2, queue.GetCount());
+
+	BatchExportJob job;
+	BOOST_REQUIRE(queue.Next(job));
+	BOOST_CHECK_EQUAL(L"c:\\project\\a.cpp", job.File.c_str());
+	BOOST_CHECK_EQUAL(L"c:\\export\\a.cpp.html", job.OutputFile.c_str());
+
+	BOOST_REQUIRE(queue.Next(job));
+	BOOST_CHECK_EQUAL(L"c:\\project\\src\\b.cpp", job.File.c_str());
+	BOOST_CHECK_EQUAL(L"c:\\export\\src\\b.cpp.html", job.OutputFile.c_str());
+
+	BOOST_CHECK(!queue.Next(job));
+	BOOST_CHECK_EQUAL(0, queue.GetCount());
+}
+
+BOOST_AUTO_TEST_CASE( clear_drops_the_jobs_not_taken )
+{
+	BatchExportQueue queue;
+	queue.Reset(NULL, L"c:\\export", L"rtf");
+
+	queue.Add(L"c:\\project\\a.cpp", SchemeSnapshotPtr());
+	queue.Add(L"c:\\project\\b.cpp", SchemeSnapshotPtr());
+
+	BatchExportJob job;
+	BOOST_REQUIRE(queue.Next(job));
+
+	queue.Clear();
+
+	BOOST_CHECK(!queue.Next(job));
+}
+
+BOOST_AUTO_TEST_CASE( reset_empties_the_queue )
+{
+	BatchExportQueue queue;
+	queue.Reset(L"c:\\project", L"c:\\export", L"html");
+	queue.Add(L"c:\\project\\a.cpp", SchemeSnapshotPtr());
+
+	queue.Reset(L"c:\\project", L"c:\\other", L"rtf");
+	queue.Add(L"c:\\project\\b.cpp", SchemeSnapshotPtr());
+
+	BatchExportJob job;
+	BOOST_REQUIRE(queue.Next(job));
+	BOOST_CHECK_EQUAL(L"c:\\other\\b.cpp.rtf", job.OutputFile.c_str());
+	BOOST_CHECK(!queue.Next(job));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
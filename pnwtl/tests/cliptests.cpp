@@ -8,6 +8,7 @@
 
 #include "../textclips.h"
 #include "../textclips/clipmanager.h"
+#include "../textclips/clipcache.h"
 #include "../scintillaif.h"
 #include "mocks/mockoptions.h"
 
@@ -310,4 +311,159 @@ BOOST_AUTO_TEST_CASE( filename_allocation_avoids_dupes )
 	BOOST_REQUIRE_EQUAL(_T("Tests\\User\\default\\default1.clips"), set->GetFilename());
 }
 
+/**
+ * Shortcut lookup finds clips across all sets for a scheme.
+ */
+BOOST_AUTO_TEST_CASE( find_by_shortcut_searches_all_sets )
+{
+	TextClipsManager manager;
+	TextClipSet* set = new TextClipSet(_T(""), _T("Set"), "default", false);
+	set->Add(new Clip(tstring(_T("One")), std::string("one"), std::string("1")));
+	TextClipSet* set2 = new TextClipSet(_T(""), _T("Set 2"), "default", false);
+	set2->Add(new Clip(tstring(_T("Two")), std::string("two"), std::string("2")));
+	manager.Add(set);
+	manager.Add(set2);
+
+	BOOST_REQUIRE_EQUAL(set->GetClips().front(), manager.FindByShortcut("default", "one"));
+	BOOST_REQUIRE_EQUAL(set2->GetClips().front(), manager.FindByShortcut("default", "two"));
+	BOOST_REQUIRE(manager.FindByShortcut("default", "three") == NULL);
+	BOOST_REQUIRE(manager.FindByShortcut("cpp", "one") == NULL);
+}
+
+/**
+ * User clips beat distribution clips with the same shortcut, regardless of load order.
+ */
+BOOST_AUTO_TEST_CASE( user_clip_beats_distribution_clip )
+{
+	TextClipsManager manager;
+	TextClipSet* dist = new TextClipSet(_T(""), _T("Dist"), "default", false);
+	dist->SetDistribution(true);
+	dist->Add(new Clip(tstring(_T("Dist")), std::string("for"), std::string("dist")));
+	manager.Add(dist);
+	
+	BOOST_REQUIRE_EQUAL(dist->GetClips().front(), manager.FindByShortcut("default", "for"));
+
+	TextClipSet* user = new TextClipSet(_T(""), _T("User"), "default", false);
+	user->Add(new Clip(tstring(_T("User")), std::string("for"), std::string("user")));
+	manager.Add(user);
+
+	BOOST_REQUIRE_EQUAL(user->GetClips().front(), manager.FindByShortcut("default", "for"));
+}
+
+/**
+ * Removing the winning clip for a shortcut falls back to the next candidate.
+ */
+BOOST_AUTO_TEST_CASE( removing_clip_falls_back_to_next_set )
+{
+	TextClipsManager manager;
+	TextClipSet* set = new TextClipSet(_T(""), _T("Set"), "default", false);
+	manager.Add(set);
+	TextClipSet* set2 = new TextClipSet(_T(""), _T("Set 2"), "default", false);
+	Clip* fallback = new Clip(tstring(_T("Second")), std::string("for"), std::string("2"));
+	set2->Add(fallback);
+	manager.Add(set2);
+
+	Clip* first = new Clip(tstring(_T("First")), std::string("for"), std::string("1"));
+	set->Add(first);
+	
+	BOOST_REQUIRE_EQUAL(first, manager.FindByShortcut("default", "for"));
+
+	set->Remove(first);
+	delete first;
+
+	BOOST_REQUIRE_EQUAL(fallback, manager.FindByShortcut("default", "for"));
+
+	manager.Delete(set2);
+
+	BOOST_REQUIRE(manager.FindByShortcut("default", "for") == NULL);
+}
+
+/**
+ * Editing a clip's shortcut in place is picked up once the set is told.
+ */
+BOOST_AUTO_TEST_CASE( changed_shortcut_is_found )
+{
+	TextClipsManager manager;
+	TextClipSet* set = new TextClipSet(_T(""), _T("Set"), "default", false);
+	Clip* clip = new Clip(tstring(_T("Clip")), std::string("old"), std::string("text"));
+	set->Add(clip);
+	manager.Add(set);
+	
+	BOOST_REQUIRE_EQUAL(clip, manager.FindByShortcut("default", "old"));
+	
+	clip->Shortcut = "new";
+	set->ClipChanged(clip);
+
+	BOOST_REQUIRE(manager.FindByShortcut("default", "old") == NULL);
+	BOOST_REQUIRE_EQUAL(clip, manager.FindByShortcut("default", "new"));
+}
+
+/**
+ * The cached sorted list reflects clips added after it was first built.
+ */
+BOOST_AUTO_TEST_CASE( sorted_clip_list_tracks_changes )
+{
+	TextClipsManager manager;
+	TextClipSet* set = new TextClipSet(_T(""), _T("Set"), "default", false);
+	set->Add(new Clip(tstring(_T("B")), std::string("b"), std::string("b")));
+	manager.Add(set);
+
+	BOOST_REQUIRE_EQUAL("b: B", manager.BuildSortedClipList("default"));
+
+	set->Add(new Clip(tstring(_T("A")), std::string("a"), std::string("a")));
+
+	BOOST_REQUIRE_EQUAL("a: A,b: B", manager.BuildSortedClipList("default"));
+}
+
+/**
+ * Clip sets survive a trip through the binary cache format.
+ */
+BOOST_AUTO_TEST_CASE( cache_round_trips_clip_sets )
+{
+	LIST_CLIPSETS sets;
+	TextClipSet* set = new TextClipSet(_T("c:\\clips\\default.clips"), _T("Set"), "default", true);
+	set->Add(new Clip(tstring(_T("For Loop")), std::string("for"), std::string("for (${1}) {\n\t${0}\n}")));
+	set->Add(new Clip(tstring(_T("Empty")), std::string(""), std::string("")));
+	sets.push_back(set);
+
+	std::vector<unsigned char> blob;
+	ClipSetCache::Serialize(sets, blob);
+
+	LIST_CLIPSETS loaded;
+	BOOST_REQUIRE(ClipSetCache::Deserialize(&blob[0], blob.size(), _T("c:\\clips\\default.clips"), loaded));
+	BOOST_REQUIRE_EQUAL(1, loaded.size());
+
+	TextClipSet* result = loaded.front();
+	BOOST_REQUIRE_EQUAL(_T("Set"), result->GetName());
+	BOOST_REQUIRE_EQUAL("default", result->GetScheme());
+	BOOST_REQUIRE_EQUAL(_T("c:\\clips\\default.clips"), result->GetFilename());
+	BOOST_REQUIRE_EQUAL(true, result->GetEncodeClipNames());
+	BOOST_REQUIRE_EQUAL(2, result->GetClips().size());
+	BOOST_REQUIRE_EQUAL("for", result->GetClips().front()->Shortcut);
+	BOOST_REQUIRE_EQUAL("for (${1}) {\n\t${0}\n}", result->GetClips().front()->Text);
+	BOOST_REQUIRE(tstring(_T("For Loop")) == result->GetClips().front()->Name);
+
+	delete set;
+	delete result;
+}
+
+/**
+ * Truncated cache data is rejected rather than half-loaded.
+ */
+BOOST_AUTO_TEST_CASE( cache_rejects_truncated_data )
+{
+	LIST_CLIPSETS sets;
+	TextClipSet* set = new TextClipSet(_T(""), _T("Set"), "default", false);
+	set->Add(new Clip(tstring(_T("Clip")), std::string("clip"), std::string("Some text")));
+	sets.push_back(set);
+
+	std::vector<unsigned char> blob;
+	ClipSetCache::Serialize(sets, blob);
+	delete set;
+
+	LIST_CLIPSETS loaded;
+	BOOST_REQUIRE(!ClipSetCache::Deserialize(&blob[0], blob.size() - 3, _T(""), loaded));
+	BOOST_REQUIRE_EQUAL(0, loaded.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END();
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../pypn/eventfilter.h"
+
+BOOST_AUTO_TEST_SUITE( doceventfilter_tests );
+
+BOOST_AUTO_TEST_CASE( nothing_is_wanted_by_default )
+{
+	DocEventFilter filter;
+
+	BOOST_CHECK(!filter.WantsChars());
+	BOOST_CHECK(!filter.WantsChar('a'));
+	BOOST_CHECK(!filter.WantsChar('\n'));
+	BOOST_CHECK(!filter.WantsBatchedChar('a'));
+}
+
+BOOST_AUTO_TEST_CASE( only_listed_chars_are_wanted )
+{
+	DocEventFilter filter;
+	filter.SetChars("\r\n\xe9", false);
+
+	BOOST_CHECK(filter.WantsChars());
+	BOOST_CHECK(filter.WantsChar('\r'));
+	BOOST_CHECK(filter.WantsChar('\n'));
+	BOOST_CHECK(filter.WantsChar('\xe9'));
+	BOOST_CHECK(!filter.WantsChar('a'));
+	BOOST_CHECK(!filter.WantsChar('\xff'));
+
+	filter.SetChars(NULL, true);
+
+	BOOST_CHECK(filter.WantsChar('a'));
+	BOOST_CHECK(filter.WantsChar('\xff'));
+
+	filter.SetChars("", false);
+
+	BOOST_CHECK(!filter.WantsChars());
+}
+
+BOOST_AUTO_TEST_CASE( batched_chars_are_kept_apart )
+{
+	DocEventFilter filter;
+	filter.SetChars("\r\n", false);
+	filter.SetBatchedChars("(", false);
+
+	BOOST_CHECK(filter.WantsChar('\n'));
+	BOOST_CHECK(!filter.WantsChar('('));
+	BOOST_CHECK(filter.WantsBatchedChar('('));
+	BOOST_CHECK(!filter.WantsBatchedChar('\n'));
+
+	filter.SetChars(NULL, false);
+
+	BOOST_CHECK(filter.WantsChars());
+
+	// Characters handlers want one at a time never wait in a batch:
+	CharBatch batch(filter);
+	filter.SetChars(NULL, true);
+	BOOST_CHECK(!batch.Add('a', false));
+	BOOST_CHECK(!batch.HasPending());
+}
+
+BOOST_AUTO_TEST_CASE( unwanted_chars_are_not_batched )
+{
+	DocEventFilter filter;
+	filter.SetBatchedChars("\n", false);
+	CharBatch batch(filter);
+
+	BOOST_CHECK(!batch.Add('a', false));
+	BOOST_CHECK(!batch.HasPending());
+	BOOST_CHECK(batch.Add('\n', false));
+
+	std::string chars;
+	batch.Take(chars);
+	BOOST_CHECK_EQUAL("\n", chars);
+	BOOST_CHECK(!batch.HasPending());
+}
+
+BOOST_AUTO_TEST_CASE( burst_is_dispatched_once_input_runs_out )
+{
+	DocEventFilter filter;
+	filter.SetBatchedChars(NULL, true);
+	CharBatch batch(filter);
+
+	BOOST_CHECK(!batch.Add('a', true));
+	BOOST_CHECK(!batch.Add('b', true));
+	BOOST_CHECK(batch.HasPending());
+	BOOST_CHECK(batch.Add('c', false));
+
+	std::string chars;
+	batch.Take(chars);
+	BOOST_CHECK_EQUAL("abc", chars);
+}
+
+BOOST_AUTO_TEST_CASE( line_end_ends_a_burst )
+{
+	DocEventFilter filter;
+	filter.SetBatchedChars(NULL, true);
+	CharBatch batch(filter);
+
+	BOOST_CHECK(!batch.Add('a', true));
+	BOOST_CHECK(batch.Add('\r', true));
+
+	std::string chars;
+	batch.Take(chars);
+	BOOST_CHECK_EQUAL("a\r", chars);
+}
+
+BOOST_AUTO_TEST_CASE( long_burst_is_dispatched_in_pieces )
+{
+	DocEventFilter filter;
+	filter.SetBatchedChars(NULL, true);
+	CharBatch batch(filter);
+
+	size_t added(0);
+	while (!batch.Add('x', true))
+	{
+		++added;
+		BOOST_REQUIRE(added < 100000);
+	}
+
+	std::string chars;
+	batch.Take(chars);
+	BOOST_CHECK_EQUAL(static_cast<size_t>(CharBatch::MaxPending), chars.size());
+}
+
+BOOST_AUTO_TEST_CASE( pending_chars_can_be_flushed_after_unwanted_ones )
+{
+	DocEventFilter filter;
+	filter.SetBatchedChars("(", false);
+	CharBatch batch(filter);
+
+	BOOST_CHECK(!batch.Add('(', true));
+
+	// The burst ends on a char nobody wants, what's waiting still goes:
+	BOOST_CHECK(batch.Add('a', false));
+
+	std::string chars;
+	batch.Take(chars);
+	BOOST_CHECK_EQUAL("(", chars);
+
+	batch.Add('(', true);
+	batch.Clear();
+	BOOST_CHECK(!batch.HasPending());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
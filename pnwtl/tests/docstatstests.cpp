@@ -0,0 +1,306 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../docstats.h"
+
+namespace {
+
+/**
+ * Serves text from a string, the way CScintillaImpl serves it from the editor.
+ */
+class StringSource : public IDocStatsSource
+{
+public:
+	StringSource(const std::string& text) : Text(text), Reads(0) {}
+
+	virtual void GetText(int start, int end, char* buffer)
+	{
+		memcpy(buffer, Text.c_str() + start, end - start);
+		buffer[end - start] = 0;
+		Reads += end - start;
+	}
+
+	int Length() const
+	{
+		return static_cast<int>(Text.size());
+	}
+
+	std::string Text;
+	int Reads;
+};
+
+/**
+ * One character at a time, the way the old WordCounter did it.
+ */
+TextStats countSlowly(const std::string& text)
+{
+	const char* delimiters = DocStats::DefaultDelimiters;
+
+	TextStats stats;
+	stats.Bytes = static_cast<int>(text.size());
+
+	bool inspace = true;
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		bool word = (c < 0x80 && isalnum(c)) || c >= 0xC0;
+
+		if (inspace && word)
+		{
+			stats.Words++;
+			inspace = false;
+		}
+		else if (!inspace && c != 0 && strchr(delimiters, c) != NULL)
+		{
+			inspace = true;
+		}
+
+		if ((c & 0xC0) != 0x80)
+			stats.Characters++;
+
+		if (c == '\n' || (c == '\r' && (i + 1 == text.size() || text[i + 1] != '\n')))
+			stats.Lines++;
+	}
+
+	return stats;
+}
+
+std::string randomText(size_t length, unsigned int seed)
+{
+	static const char* pieces[] = { "word", " ", "\r\n", "\n", "\r", "-", "_x", ".", "\xC3\xA9", "\xE2\x82\xAC", "(", "42", "\t", "\0" };
+	const size_t count = sizeof(pieces) / sizeof(pieces[0]);
+
+	srand(seed);
+
+	std::string text;
+	while (text.size() < length)
+	{
+		size_t piece = rand() % count;
+		if (piece == count - 1)
+			text += '\0';
+		else
+			text += pieces[piece];
+	}
+
+	return text;
+}
+
+void checkStats(const TextStats& expected, const TextStats& actual)
+{
+	BOOST_CHECK_EQUAL(expected.Bytes, actual.Bytes);
+	BOOST_CHECK_EQUAL(expected.Characters, actual.Characters);
+	BOOST_CHECK_EQUAL(expected.Words, actual.Words);
+	BOOST_CHECK_EQUAL(expected.Lines, actual.Lines);
+}
+
+TextStats countAll(const std::string& text, int blockSize = DocStats::DefaultBlockSize)
+{
+	DocStats stats(DocStats::DefaultDelimiters, blockSize);
+	StringSource source(text);
+	stats.Update(source, source.Length());
+	return stats.GetStats();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( docstats_tests );
+
+BOOST_AUTO_TEST_CASE( counts_simple_text )
+{
+	TextStats stats = countAll("Hello world,\r\nthis is-a test.\nLast line");
+
+	// The hyphen isn't a delimiter, is-a is one word:
+	BOOST_CHECK_EQUAL(7, stats.Words);
+	BOOST_CHECK_EQUAL(3, stats.Lines);
+	BOOST_CHECK_EQUAL(39, stats.Bytes);
+	BOOST_CHECK_EQUAL(39, stats.Characters);
+}
+
+BOOST_AUTO_TEST_CASE( empty_document )
+{
+	TextStats stats = countAll("");
+
+	BOOST_CHECK_EQUAL(0, stats.Words);
+	BOOST_CHECK_EQUAL(1, stats.Lines);
+	BOOST_CHECK_EQUAL(0, stats.Characters);
+}
+
+BOOST_AUTO_TEST_CASE( utf8_code_points_are_counted )
+{
+	// caf<e-acute> costs <euro>5
+	TextStats stats = countAll("caf\xC3\xA9 costs \xE2\x82\xAC" "5");
+
+	BOOST_CHECK_EQUAL(16, stats.Bytes);
+	BOOST_CHECK_EQUAL(13, stats.Characters);
+	BOOST_CHECK_EQUAL(3, stats.Words);
+}
+
+BOOST_AUTO_TEST_CASE( simd_and_plain_scans_agree )
+{
+	DocStats stats;
+
+	for (unsigned int seed = 1; seed < 20; ++seed)
+	{
+		std::string text(randomText(1000 + seed * 37, seed));
+
+		BlockStats simd, plain;
+		stats.Scan(text.c_str(), static_cast<int>(text.size()), simd, true);
+		stats.Scan(text.c_str(), static_cast<int>(text.size()), plain, false);
+
+		BOOST_CHECK_EQUAL(plain.Words, simd.Words);
+		BOOST_CHECK_EQUAL(plain.LineEnds, simd.LineEnds);
+		BOOST_CHECK_EQUAL(plain.Characters, simd.Characters);
+		BOOST_CHECK_EQUAL(plain.LeadingWord, simd.LeadingWord);
+		BOOST_CHECK_EQUAL(plain.Exit, simd.Exit);
+
+		checkStats(countSlowly(text), countAll(text));
+	}
+}
+
+BOOST_AUTO_TEST_CASE( words_and_line_ends_span_blocks )
+{
+	// Small blocks so every kind of boundary turns up:
+	for (unsigned int seed = 1; seed < 10; ++seed)
+	{
+		std::string text(randomText(5000, seed));
+		checkStats(countSlowly(text), countAll(text, 64));
+		checkStats(countSlowly(text), countAll(text, 100));
+	}
+
+	checkStats(countSlowly("ab\r\ncd"), countAll("ab\r\ncd", 3));
+}
+
+BOOST_AUTO_TEST_CASE( edits_only_rescan_their_blocks )
+{
+	StringSource source(randomText(20000, 7));
+	DocStats stats(DocStats::DefaultDelimiters, 1024);
+	stats.Update(source, source.Length());
+	checkStats(countSlowly(source.Text), stats.GetStats());
+
+	int blocks = stats.GetLastScanned();
+	BOOST_CHECK(blocks > 10);
+
+	source.Reads = 0;
+	source.Text.insert(5000, "new words here");
+	stats.Inserted(5000, 14);
+	stats.Update(source, source.Length());
+
+	BOOST_CHECK_EQUAL(1, stats.GetLastScanned());
+	BOOST_CHECK(source.Reads < 2048);
+	checkStats(countSlowly(source.Text), stats.GetStats());
+
+	// Across a block boundary:
+	source.Text.erase(3000, 2000);
+	stats.Deleted(3000, 2000);
+	stats.Update(source, source.Length());
+
+	BOOST_CHECK(stats.GetLastScanned() <= 3);
+	checkStats(countSlowly(source.Text), stats.GetStats());
+
+	// Nothing changed:
+	stats.Update(source, source.Length());
+	BOOST_CHECK_EQUAL(0, stats.GetLastScanned());
+}
+
+BOOST_AUTO_TEST_CASE( random_edits_match_a_full_count )
+{
+	StringSource source(randomText(10000, 3));
+	DocStats stats(DocStats::DefaultDelimiters, 512);
+	stats.Update(source, source.Length());
+
+	srand(11);
+	for (int edit = 0; edit < 200; ++edit)
+	{
+		int pos = rand() % (source.Length() + 1);
+		if (rand() % 2 || source.Length() == 0)
+		{
+			std::string text(randomText(rand() % 2000, edit));
+			source.Text.insert(pos, text);
+			stats.Inserted(pos, static_cast<int>(text.size()));
+		}
+		else
+		{
+			int length = rand() % (source.Length() - pos + 1);
+			source.Text.erase(pos, length);
+			stats.Deleted(pos, length);
+		}
+
+		if (edit % 5 == 0)
+		{
+			stats.Update(source, source.Length());
+			checkStats(countSlowly(source.Text), stats.GetStats());
+		}
+	}
+
+	stats.Update(source, source.Length());
+	checkStats(countSlowly(source.Text), stats.GetStats());
+}
+
+BOOST_AUTO_TEST_CASE( first_count_can_be_done_a_piece_at_a_time )
+{
+	StringSource source(randomText(20000, 5));
+	DocStats stats(DocStats::DefaultDelimiters, 1024);
+
+	int calls(0);
+	while (!stats.UpdateSome(source, source.Length(), 4))
+	{
+		BOOST_CHECK_EQUAL(4, stats.GetLastScanned());
+		BOOST_CHECK(!stats.IsCounted(source.Length()));
+
+		// Edits in between are picked up along the way:
+		if (calls == 1)
+		{
+			source.Text.insert(100, "more words");
+			stats.Inserted(100, 10);
+		}
+
+		BOOST_REQUIRE(++calls < 20);
+	}
+
+	BOOST_CHECK(calls > 2);
+	BOOST_CHECK(stats.IsCounted(source.Length()));
+	checkStats(countSlowly(source.Text), stats.GetStats());
+
+	// Once counted it's done:
+	BOOST_CHECK(stats.UpdateSome(source, source.Length(), 4));
+	BOOST_CHECK_EQUAL(0, stats.GetLastScanned());
+}
+
+BOOST_AUTO_TEST_CASE( missed_changes_are_caught_by_length )
+{
+	StringSource source("one two");
+	DocStats stats;
+	stats.Update(source, source.Length());
+	BOOST_CHECK_EQUAL(2, stats.GetStats().Words);
+
+	source.Text += " three";
+	stats.Update(source, source.Length());
+	BOOST_CHECK_EQUAL(3, stats.GetStats().Words);
+}
+
+BOOST_AUTO_TEST_CASE( counted_until_reset_or_changes_are_missed )
+{
+	StringSource source("one two");
+	DocStats stats;
+	BOOST_CHECK(!stats.IsCounted(source.Length()));
+
+	stats.Update(source, source.Length());
+	BOOST_CHECK(stats.IsCounted(source.Length()));
+
+	// Edits we're told about only need the changed blocks counting:
+	source.Text += " three";
+	stats.Inserted(7, 6);
+	BOOST_CHECK(stats.IsCounted(source.Length()));
+
+	// Ones we aren't mean counting everything again:
+	source.Text += " four";
+	BOOST_CHECK(!stats.IsCounted(source.Length()));
+	stats.Update(source, source.Length());
+	BOOST_CHECK(stats.IsCounted(source.Length()));
+
+	stats.Reset();
+	BOOST_CHECK(!stats.IsCounted(source.Length()));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,151 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../errorindex.h"
+#include "../third_party/scintilla/include/scilexer.h"
+
+namespace {
+
+/// Long enough for a slow build machine, the worker normally takes no time
+const DWORD IndexTimeout = 5000;
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( errorindex_tests );
+
+BOOST_AUTO_TEST_CASE( gcc_error_is_parsed )
+{
+	ErrorLocation location;
+	BOOST_REQUIRE(BuiltInErrorParsers::Get().Parse(SCE_ERR_GCC, "src/main.c:12:5: error: expected ';'", location));
+	BOOST_CHECK_EQUAL("src/main.c", location.File);
+	BOOST_CHECK_EQUAL(12, location.Line);
+	BOOST_CHECK_EQUAL(5, location.Column);
+}
+
+BOOST_AUTO_TEST_CASE( ms_error_is_parsed )
+{
+	ErrorLocation location;
+	BOOST_REQUIRE(BuiltInErrorParsers::Get().Parse(SCE_ERR_MS, "c:\\src\\main.cpp(40): error C2065: 'x' : undeclared identifier", location));
+	BOOST_CHECK_EQUAL("c:\\src\\main.cpp", location.File);
+	BOOST_CHECK_EQUAL(40, location.Line);
+	BOOST_CHECK_EQUAL(0, location.Column);
+}
+
+BOOST_AUTO_TEST_CASE( borland_style_falls_back_to_lcc )
+{
+	ErrorLocation location;
+	BOOST_REQUIRE(BuiltInErrorParsers::Get().Parse(SCE_ERR_BORLAND, "Error test.c: 14 undeclared identifier", location));
+	BOOST_CHECK_EQUAL("test.c", location.File);
+	BOOST_CHECK_EQUAL(14, location.Line);
+}
+
+BOOST_AUTO_TEST_CASE( plain_text_is_not_an_error )
+{
+	ErrorLocation location;
+	BOOST_CHECK(!BuiltInErrorParsers::Get().Parse("Build succeeded.", location));
+}
+
+BOOST_AUTO_TEST_CASE( lines_are_classified_like_the_lexer )
+{
+	BOOST_CHECK_EQUAL(SCE_ERR_GCC, BuiltInErrorParsers::Classify("main.c:3: warning: unused"));
+	BOOST_CHECK_EQUAL(SCE_ERR_MS, BuiltInErrorParsers::Classify("c:\\src\\main.cpp(40): error C2065"));
+	BOOST_CHECK_EQUAL(SCE_ERR_MS, BuiltInErrorParsers::Classify("main.cpp(40,7) : message"));
+	BOOST_CHECK_EQUAL(SCE_ERR_PYTHON, BuiltInErrorParsers::Classify("  File \"t.py\", line 45, in <module>"));
+	BOOST_CHECK_EQUAL(SCE_ERR_BORLAND, BuiltInErrorParsers::Classify("Error E2034 clippert.cpp 207: message"));
+	BOOST_CHECK_EQUAL(SCE_ERR_PERL, BuiltInErrorParsers::Classify("syntax error at a.pl line 103, near \"){\""));
+	BOOST_CHECK_EQUAL(SCE_ERR_DEFAULT, BuiltInErrorParsers::Classify("> Process started"));
+	BOOST_CHECK_EQUAL(SCE_ERR_DEFAULT, BuiltInErrorParsers::Classify("Call me on (0)1234: anytime"));
+	BOOST_CHECK_EQUAL(SCE_ERR_DEFAULT, BuiltInErrorParsers::Classify(""));
+}
+
+BOOST_AUTO_TEST_CASE( formats_are_only_found_where_the_lexer_finds_them )
+{
+	ErrorLocation location;
+
+	// Borland messages start their line:
+	BOOST_CHECK(!BuiltInErrorParsers::Get().Parse("note: Error E2034 clippert.cpp 207: message", location));
+
+	// The command echo isn't parsed, even with a gcc style location in it:
+	BOOST_CHECK(!BuiltInErrorParsers::Get().Parse("> gcc main.c:3: -o main", location));
+
+	BOOST_REQUIRE(BuiltInErrorParsers::Get().Parse("Error E2034 clippert.cpp 207: message", location));
+	BOOST_CHECK_EQUAL("clippert.cpp", location.File);
+	BOOST_CHECK_EQUAL(207, location.Line);
+}
+
+BOOST_AUTO_TEST_CASE( index_finds_errors_across_chunks )
+{
+	ErrorIndex index;
+
+	// Line endings and a line split between chunks:
+	const char* chunks[] = { "Compiling...\r\n", "main.c:3: warn", "ing: unused\r", "\nok\rutil.c:7:2: error: oops\n" };
+	for (int i = 0; i < 4; ++i)
+	{
+		index.Add(chunks[i], strlen(chunks[i]));
+	}
+
+	BOOST_REQUIRE(index.WaitUntilIndexed(IndexTimeout));
+
+	size_t begin, end;
+	index.GetRange(begin, end);
+	BOOST_REQUIRE_EQUAL(2, end - begin);
+
+	ErrorIndex::Entry entry;
+	BOOST_REQUIRE(index.GetEntry(begin, entry));
+	BOOST_CHECK_EQUAL(1, entry.OutputLine);
+	BOOST_CHECK_EQUAL("main.c", entry.Location.File);
+	BOOST_CHECK_EQUAL(3, entry.Location.Line);
+
+	BOOST_REQUIRE(index.GetEntry(begin + 1, entry));
+	BOOST_CHECK_EQUAL(3, entry.OutputLine);
+	BOOST_CHECK_EQUAL("util.c", entry.Location.File);
+	BOOST_CHECK_EQUAL(2, entry.Location.Column);
+
+	size_t found;
+	BOOST_REQUIRE(index.FindLine(3, found));
+	BOOST_CHECK_EQUAL(begin + 1, found);
+	BOOST_CHECK(!index.FindLine(2, found));
+}
+
+BOOST_AUTO_TEST_CASE( discarded_entries_keep_their_numbers )
+{
+	ErrorIndex index;
+	const char* output = "a.c:1: x\nb.c:2: y\nc.c:3: z\n";
+	index.Add(output, strlen(output));
+	BOOST_REQUIRE(index.WaitUntilIndexed(IndexTimeout));
+
+	index.DiscardBefore(2);
+
+	size_t begin, end;
+	index.GetRange(begin, end);
+	BOOST_CHECK_EQUAL(2, begin);
+	BOOST_CHECK_EQUAL(3, end);
+
+	ErrorIndex::Entry entry;
+	BOOST_CHECK(!index.GetEntry(1, entry));
+	BOOST_REQUIRE(index.GetEntry(2, entry));
+	BOOST_CHECK_EQUAL("c.c", entry.Location.File);
+}
+
+BOOST_AUTO_TEST_CASE( custom_parser_replaces_built_in_formats )
+{
+	ErrorIndex index;
+	index.SetParser(ErrorParserPtr(new ErrorParser("^ERR (?P<f>\\S+) (?P<l>[0-9]+)")));
+
+	const char* output = "a.c:1: gcc style\nERR b.c 9\n";
+	index.Add(output, strlen(output));
+	BOOST_REQUIRE(index.WaitUntilIndexed(IndexTimeout));
+
+	size_t begin, end;
+	index.GetRange(begin, end);
+	BOOST_REQUIRE_EQUAL(1, end - begin);
+
+	ErrorIndex::Entry entry;
+	BOOST_REQUIRE(index.GetEntry(begin, entry));
+	BOOST_CHECK_EQUAL(1, entry.OutputLine);
+	BOOST_CHECK_EQUAL("b.c", entry.Location.File);
+	BOOST_CHECK_EQUAL(9, entry.Location.Line);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
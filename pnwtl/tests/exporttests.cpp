@@ -0,0 +1,223 @@
+#include "stdafx.h"
+
+#include <fstream>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+#include "../styles.h"
+#include "../exporters.h"
+
+namespace {
+
+/**
+ * Styled text held in memory, served the way ScintillaStyledText serves it
+ * from the editor.
+ */
+class BufferSource : public IStyledTextSource
+{
+public:
+	BufferSource() : Reads(0) {}
+
+	void Add(const std::string& text, int style)
+	{
+		Text += text;
+		Styles.append(text.size(), static_cast<char>(style));
+	}
+
+	virtual int GetLength()
+	{
+		return static_cast<int>(Text.size());
+	}
+
+	virtual int GetTabWidth()
+	{
+		return 4;
+	}
+
+	virtual void Colourise(int start, int end)
+	{
+	}
+
+	virtual void GetStyledText(int start, int end, char* buffer)
+	{
+		for (int i = start; i < end; ++i)
+		{
+			*buffer++ = Text[i];
+			*buffer++ = Styles[i];
+		}
+
+		*buffer++ = 0;
+		*buffer = 0;
+		Reads++;
+	}
+
+	std::string Text;
+	std::string Styles;
+	int Reads;
+};
+
+StyleDetails* makeStyle(int key, COLORREF fore, COLORREF back, bool bold, bool italic, LPCTSTR classname)
+{
+	StyleDetails* style = new StyleDetails();
+	style->Key = key;
+	style->FontName = _T("Courier New");
+	style->ForeColor = fore;
+	style->BackColor = back;
+	style->Bold = bold;
+	style->Italic = italic;
+	style->classname = classname;
+	return style;
+}
+
+void addStyles(StylesList& styles)
+{
+	styles.AddStyle(makeStyle(STYLE_DEFAULT, RGB(0, 0, 0), RGB(255, 255, 255), false, false, _T("")));
+	styles.AddStyle(makeStyle(1, RGB(0, 128, 0), RGB(255, 255, 255), false, true, _T("comment")));
+	styles.AddStyle(makeStyle(2, RGB(0, 0, 255), RGB(255, 255, 255), true, false, _T("")));
+	styles.AddStyle(makeStyle(3, RGB(128, 0, 0), RGB(255, 255, 192), false, false, _T("string")));
+}
+
+/**
+ * A few lines of C with every character the exporters escape.
+ */
+void addSample(BufferSource& source)
+{
+	source.Add("// Exported <sample> & \"test\"", 1);
+	source.Add("\r\n", 0);
+	source.Add("int", 2);
+	source.Add(" main()\r\n{\r\n\t", 0);
+	source.Add("return", 2);
+	source.Add(" ", 0);
+	source.Add("\"{\\\\}\\n\"", 3);
+	source.Add(" > 0;\n}\n", 0);
+	source.Add("\r", 40);
+	source.Add("\n", 0);
+}
+
+std::string exportSample(ExporterFactory::EExporterType type, BufferSource& source)
+{
+	StylesList styles;
+	addStyles(styles);
+
+	StringOutput out;
+	std::auto_ptr<BaseExporter> exporter(ExporterFactory::GetExporter(type, &out, "cpp", &styles, &source));
+	exporter->Export(0, -1);
+	return out.c_str();
+}
+
+std::string readSample(const char* name)
+{
+	std::string path(__FILE__);
+	path = path.substr(0, path.find_last_of("\\/") + 1) + "exportsamples/" + name;
+
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	BOOST_REQUIRE_MESSAGE(file.good(), "Missing " << path);
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( export_tests );
+
+BOOST_AUTO_TEST_CASE( html_matches_sample )
+{
+	BufferSource source;
+	addSample(source);
+
+	BOOST_CHECK_EQUAL(readSample("sample.html"), exportSample(ExporterFactory::HTML, source));
+}
+
+BOOST_AUTO_TEST_CASE( rtf_matches_sample )
+{
+	BufferSource source;
+	addSample(source);
+
+	BOOST_CHECK_EQUAL(readSample("sample.rtf"), exportSample(ExporterFactory::RTF, source));
+}
+
+BOOST_AUTO_TEST_CASE( runs_split_at_style_changes_and_chunks )
+{
+	BufferSource source;
+	source.Add("aaaa", 1);
+	source.Add("bb", 2);
+	source.Add("cccccccc", 1);
+
+	StyleRunReader reader(&source, 1, source.GetLength(), 5);
+	StyleRun run;
+	std::string text, runs;
+	while (reader.Next(run))
+	{
+		text.append(run.Text, run.Length);
+
+		std::stringstream desc;
+		desc << run.Style << ":" << run.Length << " ";
+		runs += desc.str();
+	}
+
+	BOOST_CHECK_EQUAL("aaabbcccccccc", text);
+	BOOST_CHECK_EQUAL("1:3 2:2 1:5 1:3 ", runs);
+	BOOST_CHECK_EQUAL(3, source.Reads);
+}
+
+BOOST_AUTO_TEST_CASE( export_reads_in_chunks )
+{
+	BufferSource source;
+	for (int i = 0; i < 20000; ++i)
+	{
+		addSample(source);
+	}
+
+	std::string html(exportSample(ExporterFactory::HTML, source));
+
+	int chunks = (source.GetLength() + StyleRunReader::DefaultChunkSize - 1) / StyleRunReader::DefaultChunkSize;
+	BOOST_CHECK_EQUAL(chunks, source.Reads);
+
+	// The whole document made it, in one pre block:
+	size_t returns(0);
+	for (size_t pos = html.find("return"); pos != std::string::npos; pos = html.find("return", pos + 1))
+	{
+		returns++;
+	}
+	BOOST_CHECK_EQUAL(20000, returns);
+	BOOST_CHECK(html.find("</pre>") == html.rfind("</pre>"));
+}
+
+BOOST_AUTO_TEST_CASE( file_output_is_written_when_flushed )
+{
+	TCHAR tempPath[MAX_PATH + 1];
+	TCHAR fileName[MAX_PATH + 1];
+	::GetTempPath(MAX_PATH, tempPath);
+	::GetTempFileName(tempPath, _T("pnx"), 0, fileName);
+
+	std::string expected;
+	{
+		FileOutput out(fileName);
+		BOOST_REQUIRE(out.IsValid());
+
+		for (int i = 0; i < 10000; ++i)
+		{
+			out.puts("line of text ");
+			out.printf("%d\n", i);
+
+			std::stringstream line;
+			line << "line of text " << i << "\n";
+			expected += line.str();
+		}
+
+		BOOST_CHECK(out.Close());
+	}
+
+	CFile file;
+	BOOST_REQUIRE(file.Open(fileName, CFile::modeRead | CFile::modeBinary));
+	std::string contents(file.GetLength(), '\0');
+	file.Read(&contents[0], static_cast<UINT>(contents.size()));
+	file.Close();
+	::DeleteFile(fileName);
+
+	BOOST_CHECK(expected == contents);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,131 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../inifile.h"
+
+namespace {
+
+const TCHAR* TestFile = _T("inifiletests.ini");
+
+void parse(IniFile& ini, const tstring& text)
+{
+	ini.Parse(text.c_str(), text.size());
+}
+
+tstring get(const IniFile& ini, LPCTSTR section, LPCTSTR key)
+{
+	const tstring* value = ini.Get(section, key);
+	return value != NULL ? *value : tstring(_T("<none>"));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( inifile_tests );
+
+BOOST_AUTO_TEST_CASE( values_are_found_by_section_and_key )
+{
+	IniFile ini;
+	parse(ini, _T("[Editor]\r\nTabWidth=4\r\nUseTabs=1\r\n\r\n[Interface]\nOutputMaxLines=1000\n"));
+
+	BOOST_CHECK(get(ini, _T("Editor"), _T("TabWidth")) == _T("4"));
+	BOOST_CHECK(get(ini, _T("Editor"), _T("UseTabs")) == _T("1"));
+	BOOST_CHECK(get(ini, _T("Interface"), _T("OutputMaxLines")) == _T("1000"));
+	BOOST_CHECK(ini.Get(_T("Editor"), _T("OutputMaxLines")) == NULL);
+	BOOST_CHECK(ini.Get(_T("Missing"), _T("TabWidth")) == NULL);
+	BOOST_CHECK(!ini.IsDirty());
+}
+
+BOOST_AUTO_TEST_CASE( names_are_case_insensitive )
+{
+	IniFile ini;
+	parse(ini, _T("[Editor]\nTabWidth=4\n"));
+
+	BOOST_CHECK(get(ini, _T("editor"), _T("TABWIDTH")) == _T("4"));
+}
+
+BOOST_AUTO_TEST_CASE( values_are_read_like_the_profile_functions )
+{
+	IniFile ini;
+	parse(ini, _T("junk before sections\n[s]\n  spaced  =  value  \nquoted=\"  kept  \"\n; comment=ignored\nnoequals\nfirst=1\nfirst=2\nempty=\n"));
+
+	BOOST_CHECK(get(ini, _T("s"), _T("spaced")) == _T("value"));
+	BOOST_CHECK(get(ini, _T("s"), _T("quoted")) == _T("  kept  "));
+	BOOST_CHECK(ini.Get(_T("s"), _T("; comment")) == NULL);
+	BOOST_CHECK(get(ini, _T("s"), _T("first")) == _T("1"));
+	BOOST_CHECK(get(ini, _T("s"), _T("empty")) == _T(""));
+}
+
+BOOST_AUTO_TEST_CASE( unchanged_sections_are_written_as_they_were )
+{
+	IniFile ini;
+	tstring text(_T("; settings\r\n[a]\r\n; keep me\r\nx = 1\r\n[b]\r\ny=2\r\n"));
+	parse(ini, text);
+
+	ini.Set(_T("b"), _T("z"), _T("3"));
+	BOOST_CHECK(ini.IsDirty());
+
+	tstring written;
+	ini.Write(written);
+	BOOST_CHECK(written == _T("; settings\r\n[a]\r\n; keep me\r\nx = 1\r\n[b]\r\ny=2\r\nz=3\r\n"));
+}
+
+BOOST_AUTO_TEST_CASE( setting_the_same_value_is_not_a_change )
+{
+	IniFile ini;
+	parse(ini, _T("[a]\nx=1\n"));
+
+	ini.Set(_T("A"), _T("X"), _T("1"));
+	BOOST_CHECK(!ini.IsDirty());
+
+	ini.Set(_T("A"), _T("X"), _T("2"));
+	BOOST_CHECK(ini.IsDirty());
+	BOOST_CHECK(get(ini, _T("a"), _T("x")) == _T("2"));
+}
+
+BOOST_AUTO_TEST_CASE( cleared_sections_lose_their_keys )
+{
+	IniFile ini;
+	parse(ini, _T("[a]\nx=1\n[b]\ny=2\n"));
+
+	ini.ClearSection(_T("a"));
+
+	BOOST_CHECK(ini.Get(_T("a"), _T("x")) == NULL);
+
+	tstring written;
+	ini.Write(written);
+	BOOST_CHECK(written == _T("[a]\r\n[b]\ny=2\n"));
+}
+
+BOOST_AUTO_TEST_CASE( save_only_replaces_changed_sections )
+{
+	_tremove(TestFile);
+
+	IniFile ours;
+	BOOST_CHECK(!ours.Load(TestFile));
+	ours.Set(_T("a"), _T("x"), _T("1"));
+	BOOST_REQUIRE(ours.Save(TestFile));
+	BOOST_CHECK(!ours.IsDirty());
+
+	// Somebody else changes another section in the meantime:
+	IniFile theirs;
+	BOOST_REQUIRE(theirs.Load(TestFile));
+	BOOST_CHECK(get(theirs, _T("a"), _T("x")) == _T("1"));
+	theirs.Set(_T("b"), _T("y"), _T("2"));
+	BOOST_REQUIRE(theirs.Save(TestFile));
+
+	ours.Set(_T("a"), _T("x"), _T("3"));
+	BOOST_REQUIRE(ours.Save(TestFile));
+
+	// Both changes survive, and we now know about theirs:
+	BOOST_CHECK(get(ours, _T("b"), _T("y")) == _T("2"));
+
+	IniFile check;
+	BOOST_REQUIRE(check.Load(TestFile));
+	BOOST_CHECK(get(check, _T("a"), _T("x")) == _T("3"));
+	BOOST_CHECK(get(check, _T("b"), _T("y")) == _T("2"));
+
+	_tremove(TestFile);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -3,6 +3,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include "../include/Utf8_16.h"
+#include "../third_party/genx/genx.h"
+#include "../include/pngenx.h"
 
 BOOST_AUTO_TEST_SUITE( io_tests );
 
@@ -90,4 +92,25 @@ BOOST_AUTO_TEST_CASE( converting_utf16_to_threebyte_utf8_char_works )
 	BOOST_CHECK_EQUAL(0xa0, buffer[2] & 0xff);
 }
 
+BOOST_AUTO_TEST_CASE( genx_writer_writes_to_buffer )
+{
+	std::string xml;
+	GenxXMLWriter writer;
+	writer.StartBuffer(xml);
+	BOOST_REQUIRE(writer.IsValid());
+
+	genxStartElementLiteral(writer, NULL, u("a"));
+	genxAddAttributeLiteral(writer, NULL, u("x"), u("1"));
+	
+	// Content can be added to the buffer directly once the start tag is out:
+	genxAddText(writer, u(""));
+	xml += "<b></b>";
+	
+	genxEndElement(writer);
+	writer.Close();
+
+	BOOST_CHECK(!writer.IsValid());
+	BOOST_CHECK_EQUAL(std::string("<a x=\"1\"><b></b></a>"), xml);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../keymap.h"
+
+using Commands::KeyBindings;
+
+namespace {
+
+ExtensionCommand makeExtended(unsigned char key, unsigned char modifiers, const char* command)
+{
+	ExtensionCommand cmd;
+	cmd.key = key;
+	cmd.modifiers = modifiers;
+	cmd.msg = 0;
+	cmd.command = command;
+	return cmd;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( keymap_tests );
+
+BOOST_AUTO_TEST_CASE( find_matches_key_and_modifiers )
+{
+	KeyBindings keys;
+	keys.AssignCmdKey('S', FCONTROL, 100);
+	keys.AssignCmdKey('S', FCONTROL | FSHIFT, 101);
+
+	BOOST_CHECK_EQUAL(100, keys.Find('S', FCONTROL));
+	BOOST_CHECK_EQUAL(101, keys.Find('S', FCONTROL | FSHIFT));
+	BOOST_CHECK_EQUAL(0, keys.Find('S', FALT));
+	BOOST_CHECK_EQUAL(0, keys.Find('S' + 0x100, FCONTROL));
+	BOOST_CHECK_EQUAL(2, keys.GetCount());
+}
+
+BOOST_AUTO_TEST_CASE( assigning_a_bound_key_replaces_the_command )
+{
+	KeyBindings keys;
+	keys.AssignCmdKey('O', FCONTROL, 100);
+	keys.AssignCmdKey('O', FCONTROL, 200);
+
+	BOOST_CHECK_EQUAL(200, keys.Find('O', FCONTROL));
+	BOOST_REQUIRE_EQUAL(1, keys.GetCount());
+	BOOST_CHECK_EQUAL(200, keys.GetMappings()[0].msg);
+}
+
+BOOST_AUTO_TEST_CASE( extension_command_displaces_command )
+{
+	KeyBindings keys;
+	keys.AssignCmdKey('R', FCONTROL, 100);
+	keys.AddExtended(makeExtended('R', FCONTROL, "python:Run"));
+
+	BOOST_CHECK_EQUAL(0, keys.Find('R', FCONTROL));
+	BOOST_CHECK_EQUAL(0, keys.GetCount());
+
+	const ExtensionCommand* cmd = keys.FindExtended('R', FCONTROL);
+	BOOST_REQUIRE(cmd != NULL);
+	BOOST_CHECK_EQUAL("python:Run", cmd->command);
+}
+
+BOOST_AUTO_TEST_CASE( command_displaces_extension_command )
+{
+	KeyBindings keys;
+	keys.AddExtended(makeExtended('R', FCONTROL, "python:Run"));
+	keys.AssignCmdKey('R', FCONTROL, 100);
+
+	BOOST_CHECK(keys.FindExtended('R', FCONTROL) == NULL);
+	BOOST_CHECK_EQUAL(0, keys.GetExtendedCount());
+	BOOST_CHECK_EQUAL(100, keys.Find('R', FCONTROL));
+}
+
+BOOST_AUTO_TEST_CASE( first_extension_command_on_a_key_wins )
+{
+	KeyBindings keys;
+	keys.AddExtended(makeExtended('K', FALT, "python:First"));
+	keys.AddExtended(makeExtended('K', FALT, "python:Second"));
+
+	BOOST_CHECK_EQUAL(1, keys.GetExtendedCount());
+	BOOST_CHECK_EQUAL("python:First", keys.FindExtended('K', FALT)->command);
+}
+
+BOOST_AUTO_TEST_CASE( removing_keeps_other_lookups_right )
+{
+	KeyBindings keys;
+	for (int i = 0; i < 20; ++i)
+	{
+		keys.AssignCmdKey('A' + i, FCONTROL, 100 + i);
+	}
+
+	// Wrong command, nothing happens:
+	keys.RemoveCmdKey('C', FCONTROL, 999);
+	BOOST_CHECK_EQUAL(20, keys.GetCount());
+
+	keys.RemoveCmdKey('C', FCONTROL, 102);
+	keys.RemoveCmdKey('A', FCONTROL, 100);
+	BOOST_CHECK_EQUAL(18, keys.GetCount());
+
+	BOOST_CHECK_EQUAL(0, keys.Find('A', FCONTROL));
+	BOOST_CHECK_EQUAL(0, keys.Find('C', FCONTROL));
+
+	for (int i = 0; i < 20; ++i)
+	{
+		if (i == 0 || i == 2)
+			continue;
+		BOOST_CHECK_EQUAL(100 + i, keys.Find('A' + i, FCONTROL));
+	}
+
+	// The table keeps its order for saving:
+	BOOST_CHECK_EQUAL('B', keys.GetMappings()[0].key);
+	BOOST_CHECK_EQUAL('D', keys.GetMappings()[1].key);
+
+	keys.AssignCmdKey('A', FCONTROL, 300);
+	BOOST_CHECK_EQUAL(300, keys.Find('A', FCONTROL));
+	BOOST_CHECK_EQUAL('A', keys.GetMappings()[18].key);
+}
+
+BOOST_AUTO_TEST_CASE( copies_have_their_own_lookups )
+{
+	KeyBindings keys;
+	keys.AssignCmdKey('N', FCONTROL, 100);
+	keys.AddExtended(makeExtended('E', FCONTROL, "python:Ext"));
+
+	KeyBindings copy(keys);
+	keys.RemoveCmdKey('N', FCONTROL, 100);
+	keys.RemoveExtended('E', FCONTROL);
+
+	BOOST_CHECK_EQUAL(100, copy.Find('N', FCONTROL));
+	BOOST_REQUIRE(copy.FindExtended('E', FCONTROL) != NULL);
+	BOOST_CHECK_EQUAL("python:Ext", copy.FindExtended('E', FCONTROL)->command);
+
+	copy.Clear();
+	BOOST_CHECK_EQUAL(0, copy.Find('N', FCONTROL));
+	BOOST_CHECK_EQUAL(0, copy.GetCount());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+#include "../pypn/macrolog.h"
+#include "../third_party/scintilla/include/Scintilla.h"
+
+namespace {
+
+typedef std::vector<std::string> CALLS;
+
+/**
+ * Writes down what it's asked to do.
+ */
+class FakeTarget : public IMacroTarget
+{
+public:
+	FakeTarget(CALLS& calls) : m_calls(calls) {}
+
+	virtual void Perform(int message, uintptr_t wParam, intptr_t lParam)
+	{
+		std::stringstream call;
+		call << message << " " << wParam << " ";
+
+		if (message == SCI_REPLACESEL || message == SCI_INSERTTEXT)
+		{
+			call << reinterpret_cast<const char*>(lParam);
+		}
+		else if (message == SCI_ADDTEXT)
+		{
+			call << std::string(reinterpret_cast<const char*>(lParam), wParam);
+		}
+		else
+		{
+			call << lParam;
+		}
+
+		m_calls.push_back(call.str());
+	}
+
+	virtual void Search(int index)
+	{
+		std::stringstream call;
+		call << "search " << index;
+		m_calls.push_back(call.str());
+	}
+
+private:
+	CALLS& m_calls;
+};
+
+void type(MacroLog& log, const char* text)
+{
+	for (const char* p = text; *p; ++p)
+	{
+		char c[2] = { *p, 0 };
+		log.Record(SCI_REPLACESEL, 0, reinterpret_cast<intptr_t>(c));
+	}
+}
+
+CALLS replay(const MacroLog& log)
+{
+	CALLS calls;
+	FakeTarget target(calls);
+	log.Replay(target);
+	return calls;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( macrolog_tests );
+
+BOOST_AUTO_TEST_CASE( typing_is_coalesced_a_line_at_a_time )
+{
+	MacroLog log;
+	type(log, "hello\r\nworld");
+	log.Finish();
+
+	BOOST_CHECK_EQUAL(2, log.GetCount());
+
+	CALLS calls(replay(log));
+	BOOST_REQUIRE_EQUAL(2, calls.size());
+	BOOST_CHECK_EQUAL("2170 0 hello\r\n", calls[0]);
+	BOOST_CHECK_EQUAL("2170 0 world", calls[1]);
+}
+
+BOOST_AUTO_TEST_CASE( repeated_moves_are_counted )
+{
+	MacroLog log;
+	for (int i = 0; i < 5; ++i)
+	{
+		log.Record(SCI_CHARLEFT, 0, 0);
+	}
+
+	log.Record(SCI_GOTOPOS, 7, 0);
+	log.Record(SCI_CHARLEFT, 0, 0);
+	log.Finish();
+
+	BOOST_CHECK_EQUAL(3, log.GetCount());
+
+	size_t pos(0);
+	MacroAction action;
+	BOOST_REQUIRE(log.Next(pos, action));
+	BOOST_CHECK_EQUAL(SCI_CHARLEFT, action.Message);
+	BOOST_CHECK_EQUAL(5, action.Repeat);
+
+	CALLS calls(replay(log));
+	BOOST_REQUIRE_EQUAL(7, calls.size());
+	BOOST_CHECK_EQUAL("2304 0 0", calls[4]);
+	BOOST_CHECK_EQUAL("2025 7 0", calls[5]);
+	BOOST_CHECK_EQUAL("2304 0 0", calls[6]);
+}
+
+BOOST_AUTO_TEST_CASE( deleting_the_selection_is_kept_apart )
+{
+	MacroLog log;
+	type(log, "ab");
+	log.Record(SCI_REPLACESEL, 0, reinterpret_cast<intptr_t>(""));
+	log.Record(SCI_REPLACESEL, 0, reinterpret_cast<intptr_t>(""));
+	type(log, "c");
+	log.Finish();
+
+	CALLS calls(replay(log));
+	BOOST_REQUIRE_EQUAL(4, calls.size());
+	BOOST_CHECK_EQUAL("2170 0 ab", calls[0]);
+	BOOST_CHECK_EQUAL("2170 0 ", calls[1]);
+	BOOST_CHECK_EQUAL("2170 0 ", calls[2]);
+	BOOST_CHECK_EQUAL("2170 0 c", calls[3]);
+}
+
+BOOST_AUTO_TEST_CASE( strings_are_copied_when_recorded )
+{
+	MacroLog log;
+
+	std::string text("inserted");
+	log.Record(SCI_INSERTTEXT, 12, reinterpret_cast<intptr_t>(text.c_str()));
+
+	// AddText has a length, the text needn't end there:
+	log.Record(SCI_ADDTEXT, 3, reinterpret_cast<intptr_t>("abcdef"));
+
+	text = "changed!";
+	log.Finish();
+
+	CALLS calls(replay(log));
+	BOOST_REQUIRE_EQUAL(2, calls.size());
+	BOOST_CHECK_EQUAL("2003 12 inserted", calls[0]);
+	BOOST_CHECK_EQUAL("2001 3 abc", calls[1]);
+}
+
+BOOST_AUTO_TEST_CASE( searches_and_negative_params_round_trip )
+{
+	MacroLog log;
+	log.Record(SCI_LINESCROLL, 0, -3);
+	log.RecordSearch(0);
+	log.RecordSearch(1);
+	log.Record(SCI_LINESCROLL, 0, 1000000);
+	log.Finish();
+
+	CALLS calls(replay(log));
+	BOOST_REQUIRE_EQUAL(4, calls.size());
+	BOOST_CHECK_EQUAL("2168 0 -3", calls[0]);
+	BOOST_CHECK_EQUAL("search 0", calls[1]);
+	BOOST_CHECK_EQUAL("search 1", calls[2]);
+	BOOST_CHECK_EQUAL("2168 0 1000000", calls[3]);
+}
+
+BOOST_AUTO_TEST_CASE( log_is_compact )
+{
+	MacroLog log;
+	for (int i = 0; i < 1000; ++i)
+	{
+		type(log, "word ");
+		log.Record(SCI_CHARRIGHT, 0, 0);
+	}
+
+	log.Finish();
+
+	BOOST_CHECK_EQUAL(2000, log.GetCount());
+
+	// A message and its repeat count fit in a few bytes, text costs little more than itself:
+	BOOST_CHECK(log.GetSize() < 1000 * (5 + 16));
+
+	log.Clear();
+	BOOST_CHECK(log.IsEmpty());
+	BOOST_CHECK(replay(log).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
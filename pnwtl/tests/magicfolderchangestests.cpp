@@ -0,0 +1,344 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../magicfolderchanges.h"
+
+#include <deque>
+
+using namespace Projects;
+
+namespace {
+
+#define TEST_ROOT _T("c:\\project\\")
+
+/**
+ * Hands out queued reads, one per Wait, and answers Exists from a list of
+ * the items that are there now.
+ */
+class FakeDirectoryWatchBackend : public DirectoryWatchBackend
+{
+public:
+	FakeDirectoryWatchBackend() : m_cookie(0)
+	{
+	}
+
+	virtual bool Start(const tstring& /*path*/, int cookie)
+	{
+		m_cookie = cookie;
+		return true;
+	}
+
+	virtual void Stop(int /*cookie*/)
+	{
+	}
+
+	virtual EWaitResult Wait(int& cookie, DIRECTORY_CHANGES& changes)
+	{
+		if (m_reads.empty())
+		{
+			return wrClosed;
+		}
+
+		cookie = m_cookie;
+		changes = m_reads.front();
+		m_reads.pop_front();
+
+		return wrChanges;
+	}
+
+	virtual void Wake()
+	{
+	}
+
+	virtual bool Exists(const tstring& path, bool& isFolder)
+	{
+		std::map<tstring, bool>::const_iterator i = m_items.find(path);
+		if (i == m_items.end())
+		{
+			return false;
+		}
+
+		isFolder = (*i).second;
+		return true;
+	}
+
+	void AddFile(LPCTSTR path)
+	{
+		m_items[tstring(TEST_ROOT) + path] = false;
+	}
+
+	void AddFolder(LPCTSTR path)
+	{
+		m_items[tstring(TEST_ROOT) + path] = true;
+	}
+
+	void QueueRead(const DIRECTORY_CHANGES& changes)
+	{
+		m_reads.push_back(changes);
+	}
+
+private:
+	int m_cookie;
+	std::map<tstring, bool> m_items;
+	std::deque<DIRECTORY_CHANGES> m_reads;
+};
+
+/**
+ * Builds the notifications for one read.
+ */
+class Read
+{
+public:
+	Read& Added(LPCTSTR path)
+	{
+		Changes.push_back(DirectoryChange(DirectoryChange::dcAdded, path));
+		return *this;
+	}
+
+	Read& Removed(LPCTSTR path)
+	{
+		Changes.push_back(DirectoryChange(DirectoryChange::dcRemoved, path));
+		return *this;
+	}
+
+	Read& RenamedFrom(LPCTSTR path)
+	{
+		Changes.push_back(DirectoryChange(DirectoryChange::dcRenamedOldName, path));
+		return *this;
+	}
+
+	Read& RenamedTo(LPCTSTR path)
+	{
+		Changes.push_back(DirectoryChange(DirectoryChange::dcRenamedNewName, path));
+		return *this;
+	}
+
+	Read& Renamed(LPCTSTR oldPath, LPCTSTR newPath)
+	{
+		return RenamedFrom(oldPath).RenamedTo(newPath);
+	}
+
+	DIRECTORY_CHANGES Changes;
+};
+
+/**
+ * Run the reads through a collector as the watcher's worker does.
+ */
+MAGICFOLDER_CHANGES collect(FakeDirectoryWatchBackend& backend)
+{
+	MagicFolderChangeCollector collector(backend, TEST_ROOT, _T("*.cpp;*.h"), _T("*.bak"), _T(".svn"));
+	BOOST_REQUIRE(backend.Start(collector.GetPath(), 1));
+
+	MAGICFOLDER_CHANGES changes;
+	int cookie(0);
+	DIRECTORY_CHANGES notifications;
+
+	while (backend.Wait(cookie, notifications) == DirectoryWatchBackend::wrChanges)
+	{
+		BOOST_CHECK_EQUAL(1, cookie);
+		collector.Collect(notifications, changes);
+		notifications.clear();
+	}
+
+	return changes;
+}
+
+void checkChange(const MagicFolderChange& change, MagicFolderChange::EChangeType type, LPCTSTR path, bool isFolder)
+{
+	BOOST_CHECK_EQUAL(type, change.Type);
+	BOOST_CHECK_EQUAL(tstring(path), change.Path);
+	BOOST_CHECK_EQUAL(isFolder, change.IsFolder);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( magicfolderchanges_tests );
+
+BOOST_AUTO_TEST_CASE( additions_are_filtered )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("main.cpp"));
+	backend.AddFile(_T("notes.txt"));
+	backend.AddFile(_T("main.cpp.bak"));
+	backend.AddFolder(_T("src"));
+	backend.AddFolder(_T(".svn"));
+	backend.AddFile(_T("src\\util.h"));
+
+	backend.QueueRead(Read()
+		.Added(_T("main.cpp"))
+		.Added(_T("notes.txt"))
+		.Added(_T("main.cpp.bak"))
+		.Added(_T("src"))
+		.Added(_T(".svn"))
+		.Added(_T("src\\util.h"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(3, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcAdded, _T("main.cpp"), false);
+	checkChange(changes[1], MagicFolderChange::mcAdded, _T("src"), true);
+	checkChange(changes[2], MagicFolderChange::mcAdded, _T("src\\util.h"), false);
+}
+
+BOOST_AUTO_TEST_CASE( added_then_removed_is_not_reported )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("b.cpp"));
+
+	backend.QueueRead(Read()
+		.Added(_T("a.cpp"))
+		.Added(_T("b.cpp"))
+		.Added(_T("b.cpp"))
+		.Removed(_T("A.CPP"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(1, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcAdded, _T("b.cpp"), false);
+}
+
+BOOST_AUTO_TEST_CASE( removed_then_added_is_both )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("a.cpp"));
+
+	backend.QueueRead(Read()
+		.Removed(_T("a.cpp"))
+		.Added(_T("a.cpp"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(2, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcRemoved, _T("a.cpp"), false);
+	checkChange(changes[1], MagicFolderChange::mcAdded, _T("a.cpp"), false);
+}
+
+BOOST_AUTO_TEST_CASE( added_then_renamed_is_added_with_the_new_name )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("a.cpp"));
+
+	// How editors often save, by writing a temporary file and renaming it:
+	backend.QueueRead(Read()
+		.Added(_T("a.tmp"))
+		.Renamed(_T("a.tmp"), _T("a.cpp"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(1, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcAdded, _T("a.cpp"), false);
+}
+
+BOOST_AUTO_TEST_CASE( renames_are_reported_with_both_names )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFolder(_T("include"));
+
+	backend.QueueRead(Read()
+		.Renamed(_T("inc"), _T("include"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(1, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcRenamed, _T("include"), true);
+	BOOST_CHECK_EQUAL(tstring(_T("inc")), changes[0].OldPath);
+}
+
+BOOST_AUTO_TEST_CASE( a_chain_of_renames_is_one_rename )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("c.cpp"));
+	backend.AddFile(_T("d.cpp"));
+
+	backend.QueueRead(Read()
+		.Renamed(_T("a.cpp"), _T("b.cpp"))
+		.Renamed(_T("b.cpp"), _T("c.cpp"))
+		.Renamed(_T("d.cpp"), _T("e.cpp"))
+		.Renamed(_T("e.cpp"), _T("d.cpp"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	// Renamed back to where it started is nothing at all:
+	BOOST_REQUIRE_EQUAL(1, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcRenamed, _T("c.cpp"), false);
+	BOOST_CHECK_EQUAL(tstring(_T("a.cpp")), changes[0].OldPath);
+}
+
+BOOST_AUTO_TEST_CASE( renamed_then_removed_removes_the_old_name )
+{
+	FakeDirectoryWatchBackend backend;
+
+	backend.QueueRead(Read()
+		.Renamed(_T("a.cpp"), _T("b.cpp"))
+		.Removed(_T("b.cpp"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(1, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcRemoved, _T("a.cpp"), false);
+}
+
+BOOST_AUTO_TEST_CASE( renames_in_and_out_of_the_filters )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("a.bak"));
+	backend.AddFile(_T("b.h"));
+
+	backend.QueueRead(Read()
+		.Renamed(_T("a.cpp"), _T("a.bak"))
+		.Renamed(_T("b.txt"), _T("b.h"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(2, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcRemoved, _T("a.cpp"), false);
+	checkChange(changes[1], MagicFolderChange::mcAdded, _T("b.h"), false);
+}
+
+BOOST_AUTO_TEST_CASE( rename_split_across_reads )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("b.cpp"));
+
+	backend.QueueRead(Read().RenamedFrom(_T("a.cpp")).Changes);
+	backend.QueueRead(Read().RenamedTo(_T("b.cpp")).Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(1, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcRenamed, _T("b.cpp"), false);
+	BOOST_CHECK_EQUAL(tstring(_T("a.cpp")), changes[0].OldPath);
+}
+
+BOOST_AUTO_TEST_CASE( unpaired_rename_names )
+{
+	FakeDirectoryWatchBackend backend;
+	backend.AddFile(_T("c.cpp"));
+	backend.AddFile(_T("d.cpp"));
+
+	// An old name with no new one went somewhere we can't see, and a new
+	// name with no old one came from somewhere:
+	backend.QueueRead(Read()
+		.RenamedFrom(_T("a.cpp"))
+		.Renamed(_T("b.cpp"), _T("c.cpp"))
+		.RenamedTo(_T("d.cpp"))
+		.Changes);
+
+	MAGICFOLDER_CHANGES changes(collect(backend));
+
+	BOOST_REQUIRE_EQUAL(3, changes.size());
+	checkChange(changes[0], MagicFolderChange::mcRemoved, _T("a.cpp"), false);
+	checkChange(changes[1], MagicFolderChange::mcRenamed, _T("c.cpp"), false);
+	checkChange(changes[2], MagicFolderChange::mcAdded, _T("d.cpp"), false);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
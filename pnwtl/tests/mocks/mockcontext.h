@@ -0,0 +1,39 @@
+#ifndef MOCKCONTEXT_H__INCLUDED
+#define MOCKCONTEXT_H__INCLUDED
+
+#pragma once
+
+/**
+ * Just enough of IMainFrame for the code under test to report problems to,
+ * the messages are dropped.
+ */
+class MockMainFrame
+{
+public:
+	class Window
+	{
+	public:
+		Window() : m_hWnd(NULL) {}
+		HWND m_hWnd;
+	};
+
+	void SetStatusText(LPCTSTR text, bool bLongLife = true) {}
+
+	Window* GetWindow()
+	{
+		return &m_window;
+	}
+
+private:
+	Window m_window;
+};
+
+/**
+ * Mock of the application context in pn.h
+ */
+struct _Context
+{
+	MockMainFrame* m_frame;
+};
+
+#endif // MOCKCONTEXT_H__INCLUDED
@@ -0,0 +1,98 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../optionsstore.h"
+
+BOOST_AUTO_TEST_SUITE( optionsstore_tests );
+
+BOOST_AUTO_TEST_CASE( interned_keys_keep_their_handle )
+{
+	OptionsStore store;
+
+	OptionsStore::Handle tabs = store.Intern(_T("Editor"), _T("TabWidth"));
+	OptionsStore::Handle other = store.Intern(_T("Editor"), _T("UseTabs"));
+
+	BOOST_CHECK(tabs != other);
+	BOOST_CHECK_EQUAL(tabs, store.Intern(_T("Editor"), _T("TabWidth")));
+	BOOST_CHECK_EQUAL(tabs, store.Find(_T("Editor"), _T("TabWidth")));
+	BOOST_CHECK(store.GetKey(tabs) == _T("Editor.TabWidth"));
+	BOOST_CHECK(!store.HasValue(tabs));
+}
+
+BOOST_AUTO_TEST_CASE( group_and_name_must_both_match )
+{
+	OptionsStore store;
+	store.Load(_T("Editor.TabWidth"), _T("4"));
+
+	BOOST_CHECK(store.Find(_T("Editor"), _T("TabWidth")) != OptionsStore::NoHandle);
+	BOOST_CHECK(store.Find(_T("Editor.Tab"), _T("Width")) == OptionsStore::NoHandle);
+	BOOST_CHECK(store.Find(_T("Editor"), _T("TabWidt")) == OptionsStore::NoHandle);
+	BOOST_CHECK(store.Find(_T("Edit"), _T("TabWidth")) == OptionsStore::NoHandle);
+}
+
+BOOST_AUTO_TEST_CASE( loaded_values_are_found_by_group_and_name )
+{
+	OptionsStore store;
+	store.Load(_T("Editor.TabWidth"), _T("4"));
+	store.Load(_T("Editor.TabWidth"), _T("8"));
+	store.Load(_T("Editor.UseTabs"), _T("true"));
+	store.Load(_T("General.Big"), _T("18446744073709551615"));
+
+	OptionsStore::Handle tabs = store.Find(_T("Editor"), _T("TabWidth"));
+	BOOST_REQUIRE(tabs != OptionsStore::NoHandle);
+	BOOST_CHECK_EQUAL(4, store.GetInt(tabs));
+
+	BOOST_CHECK(store.GetBool(store.Find(_T("Editor"), _T("UseTabs"))));
+	BOOST_CHECK_EQUAL(18446744073709551615ULL, store.GetUInt64(store.Find(_T("General"), _T("Big"))));
+}
+
+BOOST_AUTO_TEST_CASE( setting_a_value_replaces_cached_numbers )
+{
+	OptionsStore store;
+	OptionsStore::Handle option = store.Intern(_T("g"), _T("n"));
+
+	store.Set(option, 42);
+	BOOST_CHECK(store.GetString(option) == _T("42"));
+	BOOST_CHECK_EQUAL(42, store.GetInt(option));
+
+	store.Set(option, -7);
+	BOOST_CHECK(store.GetString(option) == _T("-7"));
+	BOOST_CHECK_EQUAL(-7, store.GetInt(option));
+
+	store.Set(option, _T("12"));
+	BOOST_CHECK_EQUAL(12, store.GetInt(option));
+	BOOST_CHECK_EQUAL(12U, store.GetUInt64(option));
+	BOOST_CHECK(!store.GetBool(option));
+
+	store.Set(option, true);
+	BOOST_CHECK(store.GetString(option) == _T("true"));
+	BOOST_CHECK(store.GetBool(option));
+}
+
+BOOST_AUTO_TEST_CASE( many_keys_stay_findable )
+{
+	OptionsStore store;
+
+	for (int i = 0; i < 2000; ++i)
+	{
+		tstring name(_T("option"));
+		name += static_cast<TCHAR>(_T('a') + i % 26);
+		name += static_cast<TCHAR>(_T('a') + i / 26 % 26);
+		name += static_cast<TCHAR>(_T('a') + i / 676);
+		store.Set(store.Intern(_T("group"), name.c_str()), i);
+	}
+
+	BOOST_CHECK_EQUAL(2000U, store.Size());
+
+	std::vector<OptionsStore::Handle> sorted;
+	store.GetSorted(sorted);
+	BOOST_REQUIRE_EQUAL(2000U, sorted.size());
+	BOOST_CHECK(store.GetKey(sorted[0]) == _T("group.optionaaa"));
+
+	OptionsStore::Handle last = store.Find(_T("group"), _T("optionxyc"));
+	BOOST_REQUIRE(last != OptionsStore::NoHandle);
+	BOOST_CHECK_EQUAL(1999, store.GetInt(last));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
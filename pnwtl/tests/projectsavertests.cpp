@@ -0,0 +1,319 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../include/tempfile.h"
+#include "../project.h"
+#include "../projectwriter.h"
+#include "../projectsaver.h"
+
+using namespace Projects;
+
+namespace {
+
+/**
+ * A new directory under the temp path, removed along with everything
+ * created in it through File and Folder.
+ */
+class TestDirectory
+{
+public:
+	TestDirectory()
+	{
+		TempFileName name(NULL, NULL, true);
+		m_path = name.t_str();
+		BOOST_REQUIRE(::CreateDirectory(m_path.c_str(), NULL) != FALSE);
+		m_path += _T('\\');
+	}
+
+	~TestDirectory()
+	{
+		ProjectSaver::GetInstance()->WaitAll();
+
+		for (tstring_array::reverse_iterator i = m_items.rbegin(); i != m_items.rend(); ++i)
+		{
+			if (!::DeleteFile((*i).c_str()))
+			{
+				::RemoveDirectory((*i).c_str());
+			}
+		}
+
+		::RemoveDirectory(m_path.c_str());
+	}
+
+	/**
+	 * Path of a file in the directory, deleted with it.
+	 */
+	tstring File(LPCTSTR name)
+	{
+		tstring path(m_path + name);
+		m_items.push_back(path);
+		return path;
+	}
+
+	/**
+	 * Create a folder in the directory.
+	 */
+	tstring Folder(LPCTSTR name)
+	{
+		tstring path(File(name));
+		BOOST_REQUIRE(::CreateDirectory(path.c_str(), NULL) != FALSE);
+		return path;
+	}
+
+	/**
+	 * How many files and folders are in the directory, temporary files
+	 * included.
+	 */
+	int Count()
+	{
+		int count(0);
+
+		WIN32_FIND_DATA fd;
+		HANDLE hFind = ::FindFirstFile((m_path + _T("*")).c_str(), &fd);
+		if (hFind == INVALID_HANDLE_VALUE)
+		{
+			return 0;
+		}
+
+		do
+		{
+			if (_tcscmp(fd.cFileName, _T(".")) != 0 && _tcscmp(fd.cFileName, _T("..")) != 0)
+			{
+				count++;
+			}
+		} while (::FindNextFile(hFind, &fd));
+
+		::FindClose(hFind);
+
+		return count;
+	}
+
+private:
+	tstring m_path;
+	tstring_array m_items;
+};
+
+std::string readFile(const tstring& filename)
+{
+	std::string contents;
+
+	FILE* file = _tfopen(filename.c_str(), _T("rb"));
+	BOOST_REQUIRE(file != NULL);
+
+	char buffer[1024];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		contents.append(buffer, read);
+	}
+
+	fclose(file);
+
+	return contents;
+}
+
+void writeFile(const tstring& filename, const std::string& contents)
+{
+	FILE* file = _tfopen(filename.c_str(), _T("wb"));
+	BOOST_REQUIRE(file != NULL);
+	BOOST_REQUIRE_EQUAL(contents.size(), fwrite(contents.data(), 1, contents.size(), file));
+	fclose(file);
+}
+
+ProjectSaveJob* makeJob(LPCTSTR filename, const char* contents)
+{
+	ProjectSaveJob* job = new ProjectSaveJob;
+	job->FileName = filename;
+	job->File = INVALID_HANDLE_VALUE;
+	job->Contents = contents;
+	return job;
+}
+
+/**
+ * Start with no failures left over from other tests.
+ */
+void clearFailures()
+{
+	std::vector<tstring> failed;
+	ProjectSaver::GetInstance()->TakeFailures(failed);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( projectsaver_tests );
+
+BOOST_AUTO_TEST_CASE( queued_save_takes_the_contents_of_a_later_save )
+{
+	ProjectSaveQueue queue;
+	queue.Add(makeJob(_T("c:\\test\\test.pnproj"), "first"));
+
+	std::string contents("second");
+	BOOST_CHECK(queue.Coalesce(_T("C:\\Test\\TEST.pnproj"), contents));
+
+	// The old contents are swapped out rather than copied:
+	BOOST_CHECK_EQUAL(std::string("first"), contents);
+	BOOST_CHECK_EQUAL(1, queue.GetCount());
+
+	ProjectSaveJob* job = queue.Next();
+	BOOST_REQUIRE(job != NULL);
+	BOOST_CHECK_EQUAL(std::string("second"), job->Contents);
+	delete job;
+
+	queue.Done();
+	BOOST_CHECK(queue.IsIdle());
+}
+
+BOOST_AUTO_TEST_CASE( saves_of_other_files_are_not_coalesced )
+{
+	ProjectSaveQueue queue;
+	queue.Add(makeJob(_T("c:\\test\\a.pnproj"), "a"));
+
+	std::string contents("b");
+	BOOST_CHECK(!queue.Coalesce(_T("c:\\test\\b.pnproj"), contents));
+	BOOST_CHECK_EQUAL(std::string("b"), contents);
+	BOOST_CHECK_EQUAL(1, queue.GetCount());
+}
+
+BOOST_AUTO_TEST_CASE( save_being_written_is_not_coalesced )
+{
+	ProjectSaveQueue queue;
+	queue.Add(makeJob(_T("c:\\test\\test.pnproj"), "first"));
+
+	ProjectSaveJob* job = queue.Next();
+	BOOST_REQUIRE(job != NULL);
+
+	// It's too late to change what's being written, so this is a new save:
+	std::string contents("second");
+	BOOST_CHECK(!queue.Coalesce(_T("c:\\test\\test.pnproj"), contents));
+	BOOST_CHECK(queue.IsBusy(_T("c:\\test\\test.pnproj")));
+	BOOST_CHECK(!queue.IsBusy(_T("c:\\test\\other.pnproj")));
+
+	queue.Done();
+	delete job;
+
+	BOOST_CHECK(!queue.IsBusy(_T("c:\\test\\test.pnproj")));
+	BOOST_CHECK(queue.IsIdle());
+	BOOST_CHECK(queue.Next() == NULL);
+}
+
+BOOST_AUTO_TEST_CASE( wait_returns_once_the_last_save_is_written )
+{
+	TestDirectory dir;
+	tstring filename(dir.File(_T("test.pnproj")));
+	ProjectSaver* saver = ProjectSaver::GetInstance();
+
+	for (int i = 0; i < 20; i++)
+	{
+		char contents[32];
+		sprintf(contents, "<Project name=\"%d\"></Project>", i);
+
+		std::string xml(contents);
+		BOOST_REQUIRE(saver->Save(filename.c_str(), xml));
+	}
+
+	saver->Wait(filename.c_str());
+
+	BOOST_CHECK_EQUAL(std::string("<Project name=\"19\"></Project>"), readFile(filename));
+
+	// No temporary files are left behind:
+	BOOST_CHECK_EQUAL(1, dir.Count());
+}
+
+BOOST_AUTO_TEST_CASE( save_replaces_an_existing_file )
+{
+	TestDirectory dir;
+	tstring filename(dir.File(_T("test.pnproj")));
+	writeFile(filename, "old");
+
+	std::string xml("new");
+	BOOST_REQUIRE(ProjectSaver::GetInstance()->Save(filename.c_str(), xml));
+	ProjectSaver::GetInstance()->Wait(filename.c_str());
+
+	BOOST_CHECK_EQUAL(std::string("new"), readFile(filename));
+	BOOST_CHECK_EQUAL(1, dir.Count());
+}
+
+BOOST_AUTO_TEST_CASE( save_to_a_missing_directory_fails_straight_away )
+{
+	clearFailures();
+
+	TestDirectory dir;
+	tstring filename(dir.File(_T("missing\\test.pnproj")));
+
+	std::string xml("contents");
+	BOOST_CHECK(!ProjectSaver::GetInstance()->Save(filename.c_str(), xml));
+	BOOST_CHECK_EQUAL(std::string("contents"), xml);
+
+	ProjectSaver::GetInstance()->WaitAll();
+
+	std::vector<tstring> failed;
+	ProjectSaver::GetInstance()->TakeFailures(failed);
+	BOOST_CHECK(failed.empty());
+}
+
+BOOST_AUTO_TEST_CASE( failed_write_is_taken_once )
+{
+	clearFailures();
+
+	TestDirectory dir;
+
+	// The temporary file can be written, but a folder can't be replaced by it:
+	tstring filename(dir.Folder(_T("test.pnproj")));
+
+	std::string xml("contents");
+	BOOST_REQUIRE(ProjectSaver::GetInstance()->Save(filename.c_str(), xml));
+	ProjectSaver::GetInstance()->Wait(filename.c_str());
+
+	std::vector<tstring> failed;
+	ProjectSaver::GetInstance()->TakeFailures(failed);
+	BOOST_REQUIRE_EQUAL(1, failed.size());
+	BOOST_CHECK(failed[0] == filename);
+
+	failed.clear();
+	ProjectSaver::GetInstance()->TakeFailures(failed);
+	BOOST_CHECK(failed.empty());
+
+	// The temporary file is cleaned up:
+	BOOST_CHECK_EQUAL(1, dir.Count());
+}
+
+BOOST_AUTO_TEST_CASE( unchanged_magic_folder_round_trips_byte_for_byte )
+{
+	// The magic folder's directory doesn't exist, and isn't read. If the
+	// folder were serialised again rather than copied from the XML that was
+	// loaded, the cached sub-folder and files would be missing.
+	const std::string xml(
+		"<Project name=\"Test\">"
+			"<MagicFolder excludeFiles=\"*.bak\" excludeFolders=\".svn\" filter=\"*.cpp;*.h\" name=\"src\" path=\"src\">"
+				"<MagicFolder name=\"lib\">"
+					"<File path=\"util.cpp\"></File>"
+				"</MagicFolder>"
+				"<File path=\"main.cpp\"></File>"
+			"</MagicFolder>"
+			"<File path=\"readme.txt\"></File>"
+		"</Project>");
+
+	TestDirectory dir;
+	tstring filename(dir.File(_T("test.pnproj")));
+	writeFile(filename, xml);
+
+	Project project(filename.c_str());
+	BOOST_REQUIRE(project.Exists());
+
+	std::string written;
+	ProjectWriter writer;
+	writer.StartBuffer(written);
+	writer.WriteProject(&project);
+	writer.Close();
+
+	BOOST_CHECK_EQUAL(xml, written);
+
+	// And again from the XML kept by the last write, through the saver:
+	project.Save();
+	ProjectSaver::GetInstance()->Wait(filename.c_str());
+
+	BOOST_CHECK_EQUAL(xml, readFile(filename));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,38 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../project.h"
+
+using namespace Projects;
+
+BOOST_AUTO_TEST_SUITE( project_tests );
+
+BOOST_AUTO_TEST_CASE( unread_magic_folders_are_left_to_the_caller )
+{
+	Folder root(_T("root"), _T("c:\\test\\"));
+	root.AddFile(_T("readme.txt"));
+	root.AddFile(_T("README.TXT"));
+
+	MagicFolder* magic = new MagicFolder(_T("src"), _T("c:\\test\\src"));
+	magic->SetFilter(_T("*.cpp"));
+	root.AddChild(magic);
+
+	std::vector<tstring> files;
+	MAGICFOLDER_SOURCES unread;
+	root.GetAllFiles([&files] (LPCTSTR filename) { files.push_back(filename); }, unread);
+
+	BOOST_REQUIRE_EQUAL(1, files.size());
+	BOOST_CHECK(files[0] == _T("c:\\test\\readme.txt"));
+
+	// Nothing was read from disk:
+	BOOST_CHECK(!magic->GetGotContents());
+
+	BOOST_REQUIRE_EQUAL(1, unread.size());
+	BOOST_CHECK(unread[0].Path == _T("c:\\test\\src\\"));
+	BOOST_CHECK(unread[0].Filter == _T("*.cpp"));
+	BOOST_CHECK(unread[0].ExcludedFiles == magic->GetExcludedFileFilter());
+	BOOST_CHECK(unread[0].ExcludedFolders == magic->GetFolderFilter());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
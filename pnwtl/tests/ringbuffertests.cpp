@@ -0,0 +1,68 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../include/ringbuffer.h"
+
+#include <string>
+
+using pnutils::RingBuffer;
+
+BOOST_AUTO_TEST_SUITE( ringbuffer_tests );
+
+BOOST_AUTO_TEST_CASE( capacity_is_rounded_up_to_a_power_of_two )
+{
+	RingBuffer<char> buffer(100);
+	BOOST_CHECK_EQUAL(128, buffer.Capacity());
+}
+
+BOOST_AUTO_TEST_CASE( written_data_is_read_in_order )
+{
+	RingBuffer<char> buffer(16);
+	BOOST_REQUIRE(buffer.Write("hello ", 6));
+	BOOST_REQUIRE(buffer.Write("world", 5));
+	BOOST_CHECK_EQUAL(11, buffer.Size());
+
+	std::string out;
+	BOOST_CHECK_EQUAL(11, buffer.ReadAll(out));
+	BOOST_CHECK_EQUAL("hello world", out);
+	BOOST_CHECK_EQUAL(0, buffer.Size());
+	BOOST_CHECK_EQUAL(0, buffer.ReadAll(out));
+}
+
+BOOST_AUTO_TEST_CASE( writes_wrap_around_the_end )
+{
+	RingBuffer<char> buffer(8);
+	std::string out;
+
+	BOOST_REQUIRE(buffer.Write("abcdef", 6));
+	buffer.ReadAll(out);
+	out.clear();
+
+	BOOST_REQUIRE(buffer.Write("ghijkl", 6));
+	BOOST_CHECK_EQUAL(6, buffer.ReadAll(out));
+	BOOST_CHECK_EQUAL("ghijkl", out);
+}
+
+BOOST_AUTO_TEST_CASE( writes_that_do_not_fit_are_refused_whole )
+{
+	RingBuffer<char> buffer(8);
+	BOOST_REQUIRE(buffer.Write("abcdef", 6));
+	BOOST_CHECK(!buffer.Write("ghi", 3));
+	BOOST_CHECK(buffer.Write("gh", 2));
+
+	std::string out;
+	buffer.ReadAll(out);
+	BOOST_CHECK_EQUAL("abcdefgh", out);
+}
+
+BOOST_AUTO_TEST_CASE( discard_empties_the_buffer )
+{
+	RingBuffer<char> buffer(8);
+	BOOST_REQUIRE(buffer.Write("abc", 3));
+	buffer.Discard();
+	BOOST_CHECK_EQUAL(0, buffer.Size());
+	BOOST_CHECK(buffer.Write("abcdefgh", 8));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
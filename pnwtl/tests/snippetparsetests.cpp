@@ -4,6 +4,7 @@
 #include <boost/test/unit_test.hpp>
 #include "../textclips.h"
 #include "../textclips/chunkparser.h"
+#include "../textclips/cliptemplate.h"
 #include "mocks/mockscriptrunner.h"
 
 BOOST_AUTO_TEST_SUITE( snippet_parse_tests );
@@ -285,4 +286,87 @@ BOOST_AUTO_TEST_CASE( backticks_default_blank )
 	BOOST_REQUIRE_EQUAL("", (*c).GetText());
 }
 
+BOOST_AUTO_TEST_CASE( template_instantiates_repeatably )
+{
+	TextClips::ChunkParser p;
+	std::string input("for (${1:i} = 0; $1 < $(TEST); ${2:x})\n{\n\t${0}\n}");
+	TextClips::ClipTemplate compiled(input);
+	BOOST_REQUIRE_EQUAL(true, p.Compile(input, compiled));
+
+	FakeVariableProvider vars;
+	std::vector<Chunk> first;
+	std::vector<Chunk> second;
+	compiled.Instantiate(first, &vars, NULL, std::string(), PNSF_Unix);
+	compiled.Instantiate(second, &vars, NULL, std::string(), PNSF_Unix);
+
+	// The same as parsing every time:
+	std::vector<Chunk> parsed;
+	p.SetVariableProvider(&vars);
+	BOOST_REQUIRE_EQUAL(true, p.Parse(input, parsed));
+
+	BOOST_REQUIRE_EQUAL(parsed.size(), first.size());
+	BOOST_REQUIRE_EQUAL(parsed.size(), second.size());
+	for (size_t i = 0; i < parsed.size(); ++i)
+	{
+		BOOST_REQUIRE_EQUAL(parsed[i].GetText(), first[i].GetText());
+		BOOST_REQUIRE_EQUAL(parsed[i].GetText(), second[i].GetText());
+		BOOST_REQUIRE_EQUAL(parsed[i].IsField(), first[i].IsField());
+		BOOST_REQUIRE_EQUAL(parsed[i].Id, first[i].Id);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( template_applies_indent_and_eol )
+{
+	TextClips::ChunkParser p;
+	std::string input("{\n${1:body}\n}");
+	TextClips::ClipTemplate compiled(input);
+	BOOST_REQUIRE_EQUAL(true, p.Compile(input, compiled));
+
+	std::vector<Chunk> chunks;
+	compiled.Instantiate(chunks, NULL, NULL, std::string("\t"), PNSF_Windows);
+	BOOST_REQUIRE_EQUAL(3, chunks.size());
+	BOOST_REQUIRE_EQUAL("{\r\n\t", chunks[0].GetText());
+	BOOST_REQUIRE_EQUAL("body", chunks[1].GetText());
+	BOOST_REQUIRE_EQUAL("\r\n\t}", chunks[2].GetText());
+
+	compiled.Instantiate(chunks, NULL, NULL, std::string(), PNSF_Mac);
+	BOOST_REQUIRE_EQUAL(3, chunks.size());
+	BOOST_REQUIRE_EQUAL("{\r", chunks[0].GetText());
+}
+
+BOOST_AUTO_TEST_CASE( template_evaluates_variables_per_instance )
+{
+	TextClips::ChunkParser p;
+	std::string input("a $(TEST) b `print \"Hello World\"`");
+	TextClips::ClipTemplate compiled(input);
+	BOOST_REQUIRE_EQUAL(true, p.Compile(input, compiled));
+	BOOST_REQUIRE_EQUAL(true, compiled.HasScripts());
+
+	std::vector<Chunk> chunks;
+	compiled.Instantiate(chunks, NULL, NULL, std::string(), PNSF_Unix);
+	BOOST_REQUIRE_EQUAL(1, chunks.size());
+	BOOST_REQUIRE_EQUAL("a  b ", chunks[0].GetText());
+
+	FakeVariableProvider vars;
+	FakeScriptRunner runner;
+	compiled.Instantiate(chunks, &vars, &runner, std::string(), PNSF_Unix);
+	BOOST_REQUIRE_EQUAL(1, chunks.size());
+	BOOST_REQUIRE_EQUAL("a Test Value b Hello World", chunks[0].GetText());
+}
+
+BOOST_AUTO_TEST_CASE( clip_recompiles_when_text_changes )
+{
+	TextClips::Clip clip(tstring(_T("test")), std::string("test"), std::string("one ${1:two}"));
+	boost::shared_ptr<const TextClips::ClipTemplate> compiled(clip.GetTemplate());
+	BOOST_REQUIRE(compiled.get() == clip.GetTemplate().get());
+
+	clip.Text = "three";
+	BOOST_REQUIRE(compiled.get() != clip.GetTemplate().get());
+
+	std::vector<Chunk> chunks;
+	clip.GetChunks(chunks);
+	BOOST_REQUIRE_EQUAL(1, chunks.size());
+	BOOST_REQUIRE_EQUAL("three", chunks[0].GetText());
+}
+
 BOOST_AUTO_TEST_SUITE_END();
\ No newline at end of file
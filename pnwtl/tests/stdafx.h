@@ -28,6 +28,7 @@
 #define PN_NO_CSTRING 1
 
 #include <atlbase.h>
+#include <atlstr.h>
 #include <shellapi.h>
 
 // Disable the "unreferenced formal parameter" warning. I see no reason for it.
@@ -66,17 +67,11 @@ typedef std::vector<tstring> tstring_array;
 #include <boost/foreach.hpp>
 #include <boost/spirit/include/qi.hpp>
 
-namespace boost { namespace xpressive {
-#ifdef _UNICODE
-	typedef wsregex tsregex;
-	typedef wsmatch tsmatch;
-#else
-	typedef sregex tsregex;
-	typedef smatch tsmatch;
-#endif
-}} // namespace boost::xpressive
+#include "../include/xpressiveutil.h"
 
 // PN Stuff:
+#include "../include/singleton.h"
+#include "../tracing.h"
 #include "../scintillaif.h"
 #include "../pnstrings.h"
 #include "../extiface.h"
@@ -84,8 +79,10 @@ namespace boost { namespace xpressive {
 #include "../files.h"
 #include "../filename.h"
 #include "mocks/mockoptions.h"
+#include "mocks/mockcontext.h"
 
 extern IOptionsWithString* g_Options;
+extern _Context g_Context;
 #define OPTIONS g_Options
 #define LOG(x) ::OutputDebugString(x);
 
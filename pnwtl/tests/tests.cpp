@@ -5,6 +5,9 @@
 
 IOptionsWithString* g_Options = NULL;
 
+MockMainFrame g_MainFrame;
+_Context g_Context = { &g_MainFrame };
+
 #define BOOST_TEST_MAIN
 #include <boost/test/unit_test.hpp>
 
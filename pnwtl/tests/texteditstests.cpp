@@ -0,0 +1,89 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../pypn/textedits.h"
+
+namespace {
+
+/**
+ * Apply the edits the way PNScintilla::ReplaceMany does.
+ */
+std::string apply(const TextEdits& edits, const std::string& text)
+{
+	std::string result(text);
+	for (TextEdits::const_iterator i = edits.begin(); i != edits.end(); ++i)
+	{
+		result.replace((*i).Start, (*i).End - (*i).Start, (*i).Text);
+	}
+
+	return result;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( textedits_tests );
+
+BOOST_AUTO_TEST_CASE( positions_are_in_the_original_text )
+{
+	std::string text("one two three");
+	TextEdits edits;
+
+	BOOST_REQUIRE(edits.Add(8, 13, "3"));
+	BOOST_REQUIRE(edits.Add(0, 3, "first"));
+	BOOST_REQUIRE(edits.Add(4, 7, "2"));
+	BOOST_REQUIRE(edits.Prepare(static_cast<int>(text.size())));
+
+	BOOST_CHECK_EQUAL(3, edits.Size());
+	BOOST_CHECK_EQUAL("first 2 3", apply(edits, text));
+}
+
+BOOST_AUTO_TEST_CASE( insertions_keep_their_order )
+{
+	std::string text("ab");
+	TextEdits edits;
+
+	edits.Add(1, 1, "1");
+	edits.Add(1, 2, "B");
+	edits.Add(1, 1, "2");
+	BOOST_REQUIRE(edits.Prepare(static_cast<int>(text.size())));
+
+	BOOST_CHECK_EQUAL("a12B", apply(edits, text));
+}
+
+BOOST_AUTO_TEST_CASE( adjacent_edits_are_allowed )
+{
+	std::string text("abcd");
+	TextEdits edits;
+
+	edits.Add(0, 2, "X");
+	edits.Add(2, 4, "Y");
+	edits.Add(4, 4, "!");
+	BOOST_REQUIRE(edits.Prepare(static_cast<int>(text.size())));
+
+	BOOST_CHECK_EQUAL("XY!", apply(edits, text));
+}
+
+BOOST_AUTO_TEST_CASE( overlapping_edits_are_refused )
+{
+	TextEdits edits;
+
+	edits.Add(0, 3, "X");
+	edits.Add(2, 4, "Y");
+
+	BOOST_CHECK(!edits.Prepare(10));
+}
+
+BOOST_AUTO_TEST_CASE( bad_ranges_are_refused )
+{
+	TextEdits edits;
+
+	BOOST_CHECK(!edits.Add(-1, 2, "X"));
+	BOOST_CHECK(!edits.Add(3, 2, "X"));
+	BOOST_CHECK_EQUAL(0, edits.Size());
+
+	edits.Add(2, 11, "X");
+	BOOST_CHECK(!edits.Prepare(10));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
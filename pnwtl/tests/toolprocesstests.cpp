@@ -0,0 +1,107 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../toolprocess.h"
+
+#include <memory>
+
+#if defined(_WIN32)
+	#define TEST_ERRORS _T("cmd /c echo out & echo err 1>&2")
+	#define TEST_EXITCODE _T("cmd /c exit 3")
+	#define TEST_LONGRUNNING _T("ping -n 30 127.0.0.1")
+#else
+	#define TEST_ERRORS _T("echo out; echo err 1>&2")
+	#define TEST_EXITCODE _T("exit 3")
+	#define TEST_LONGRUNNING _T("sleep 30")
+#endif
+
+class CollectingSink : public IToolProcessSink
+{
+public:
+	virtual void OnOutput(ToolProcess::EStream stream, const char* data, size_t length)
+	{
+		Output[stream].append(data, length);
+	}
+
+	std::string Output[2];
+};
+
+BOOST_AUTO_TEST_SUITE( toolprocess_tests );
+
+BOOST_AUTO_TEST_CASE( output_and_errors_are_captured_separately )
+{
+	std::auto_ptr<ToolProcess> process(ToolProcess::Create());
+	CollectingSink sink;
+
+	BOOST_REQUIRE(process->Start(TEST_ERRORS, NULL, NULL, 0));
+	BOOST_CHECK(process->Wait(&sink));
+
+	BOOST_CHECK(sink.Output[ToolProcess::tsOutput].find("out") != std::string::npos);
+	BOOST_CHECK(sink.Output[ToolProcess::tsOutput].find("err") == std::string::npos);
+	BOOST_CHECK(sink.Output[ToolProcess::tsError].find("err") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( exit_code_is_returned )
+{
+	std::auto_ptr<ToolProcess> process(ToolProcess::Create());
+	CollectingSink sink;
+
+	BOOST_REQUIRE(process->Start(TEST_EXITCODE, NULL, NULL, 0));
+	BOOST_CHECK(process->Wait(&sink));
+	BOOST_REQUIRE(process->WaitForExit(5000));
+
+	BOOST_CHECK_EQUAL(3, process->GetExitCode());
+}
+
+BOOST_AUTO_TEST_CASE( input_is_written_to_the_process )
+{
+	std::auto_ptr<ToolProcess> process(ToolProcess::Create());
+	CollectingSink sink;
+
+	// More than fits in a pipe buffer, so writing has to wait for reading:
+	std::string input;
+	for (int i = 0; i < 10000; ++i)
+	{
+		input += "b\n";
+	}
+	input += "a\n";
+
+	BOOST_REQUIRE(process->Start(_T("sort"), NULL, reinterpret_cast<const unsigned char*>(input.c_str()), input.size()));
+	BOOST_CHECK(process->Wait(&sink));
+
+	const std::string& output = sink.Output[ToolProcess::tsOutput];
+	BOOST_REQUIRE(output.size() > 0);
+	BOOST_CHECK_EQUAL('a', output[0]);
+	BOOST_CHECK(output.find_last_of('b') != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( cancel_stops_waiting_for_the_process )
+{
+	std::auto_ptr<ToolProcess> process(ToolProcess::Create());
+	CollectingSink sink;
+
+	BOOST_REQUIRE(process->Start(TEST_LONGRUNNING, NULL, NULL, 0));
+	process->Cancel();
+
+	BOOST_CHECK(!process->Wait(&sink));
+	BOOST_CHECK(!process->WaitForExit(0));
+
+	process->Terminate(1);
+	BOOST_CHECK(process->WaitForExit(5000));
+}
+
+#if defined(_WIN32)
+
+BOOST_AUTO_TEST_CASE( failing_to_start_reports_an_error )
+{
+	std::auto_ptr<ToolProcess> process(ToolProcess::Create());
+
+	BOOST_CHECK(!process->Start(_T("pn_no_such_program.exe"), NULL, NULL, 0));
+	BOOST_CHECK(process->GetError().size() > 0);
+	BOOST_CHECK(process->GetErrorCode() != 0);
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END();
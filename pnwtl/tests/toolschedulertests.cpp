@@ -0,0 +1,343 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../toolscheduler.h"
+#include "../toolprocess.h"
+
+#include <memory>
+
+#if defined(_WIN32)
+	#define TEST_SUCCEEDS _T("cmd /c exit 0")
+	#define TEST_FAILS _T("cmd /c exit 1")
+#else
+	#define TEST_SUCCEEDS _T("exit 0")
+	#define TEST_FAILS _T("exit 1")
+#endif
+
+namespace {
+
+typedef std::vector<std::string> EVENTS;
+
+/**
+ * Records what the scheduler does with it, the test says when it finishes.
+ */
+class FakeJob : public ToolJob
+{
+public:
+	FakeJob(EVENTS& events, const std::string& name, const tstring& key = _T("")) :
+		m_events(events),
+		m_name(name),
+		m_key(key.size() ? key : tstring(name.begin(), name.end()))
+	{
+	}
+
+	virtual void Start()
+	{
+		m_events.push_back("start " + m_name);
+	}
+
+	virtual void Cancel()
+	{
+		m_events.push_back("cancel " + m_name);
+	}
+
+	virtual void OnDropped()
+	{
+		m_events.push_back("drop " + m_name);
+	}
+
+	virtual tstring GetKey() const
+	{
+		return m_key;
+	}
+
+private:
+	EVENTS& m_events;
+	std::string m_name;
+	tstring m_key;
+};
+
+/**
+ * Runs a real process to completion when started.
+ */
+class ProcessJob : public ToolJob, IToolProcessSink
+{
+public:
+	ProcessJob(ToolScheduler& scheduler, EVENTS& events, const std::string& name, LPCTSTR command) :
+		m_scheduler(scheduler),
+		m_events(events),
+		m_name(name),
+		m_command(command)
+	{
+	}
+
+	virtual void Start()
+	{
+		std::auto_ptr<ToolProcess> process(ToolProcess::Create());
+
+		bool succeeded = process->Start(m_command, NULL, NULL, 0)
+			&& process->Wait(this)
+			&& process->WaitForExit(5000)
+			&& process->GetExitCode() == 0;
+
+		m_events.push_back((succeeded ? "ok " : "failed ") + m_name);
+		m_scheduler.Finished(this, succeeded);
+	}
+
+	virtual void Cancel()
+	{
+	}
+
+	virtual void OnDropped()
+	{
+		m_events.push_back("drop " + m_name);
+	}
+
+	virtual tstring GetKey() const
+	{
+		return m_command;
+	}
+
+	virtual void OnOutput(ToolProcess::EStream /*stream*/, const char* /*data*/, size_t /*length*/)
+	{
+	}
+
+private:
+	ToolScheduler& m_scheduler;
+	EVENTS& m_events;
+	std::string m_name;
+	tstring m_command;
+};
+
+class CountingHandler
+{
+public:
+	CountingHandler(int& count) : m_count(count) {}
+
+	void operator()()
+	{
+		++m_count;
+	}
+
+private:
+	int& m_count;
+};
+
+ToolOwnerID owner(int id)
+{
+	return reinterpret_cast<ToolOwnerID>(static_cast<intptr_t>(id));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE( toolscheduler_tests );
+
+BOOST_AUTO_TEST_CASE( running_jobs_are_limited )
+{
+	ToolScheduler scheduler(2);
+	EVENTS events;
+
+	ToolJobPtr a(new FakeJob(events, "a"));
+	scheduler.Submit(a, owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "b")), owner(2));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "c")), owner(3));
+
+	BOOST_REQUIRE_EQUAL(2, events.size());
+	BOOST_CHECK_EQUAL(2, scheduler.GetRunningCount());
+
+	scheduler.Finished(a.get(), true);
+
+	BOOST_REQUIRE_EQUAL(3, events.size());
+	BOOST_CHECK_EQUAL("start c", events[2]);
+	BOOST_CHECK_EQUAL(2, scheduler.GetRunningCount());
+}
+
+BOOST_AUTO_TEST_CASE( default_limit_is_processor_count )
+{
+	ToolScheduler scheduler;
+	BOOST_CHECK(ToolScheduler::GetProcessorCount() >= 1);
+	BOOST_CHECK_EQUAL(ToolScheduler::GetProcessorCount(), scheduler.GetMaxRunning());
+}
+
+BOOST_AUTO_TEST_CASE( one_job_at_a_time_per_owner )
+{
+	ToolScheduler scheduler(4);
+	EVENTS events;
+
+	ToolJobPtr a(new FakeJob(events, "a"));
+	scheduler.Submit(a, owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "b")), owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "c")), owner(2));
+
+	BOOST_REQUIRE_EQUAL(2, events.size());
+	BOOST_CHECK_EQUAL("start a", events[0]);
+	BOOST_CHECK_EQUAL("start c", events[1]);
+	BOOST_CHECK(scheduler.IsBusy(owner(1)));
+	BOOST_CHECK(!scheduler.IsBusy(owner(3)));
+
+	scheduler.Finished(a.get(), true);
+
+	BOOST_REQUIRE_EQUAL(3, events.size());
+	BOOST_CHECK_EQUAL("start b", events[2]);
+}
+
+BOOST_AUTO_TEST_CASE( dependent_job_runs_after_success )
+{
+	ToolScheduler scheduler(4);
+	EVENTS events;
+
+	ToolJobPtr a(new FakeJob(events, "a"));
+	ToolScheduler::JobID first = scheduler.Submit(a, owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "b")), owner(2), first);
+
+	BOOST_REQUIRE_EQUAL(1, events.size());
+
+	scheduler.Finished(a.get(), true);
+
+	BOOST_REQUIRE_EQUAL(2, events.size());
+	BOOST_CHECK_EQUAL("start b", events[1]);
+}
+
+BOOST_AUTO_TEST_CASE( failure_drops_the_jobs_that_come_after )
+{
+	ToolScheduler scheduler(4);
+	EVENTS events;
+
+	ToolJobPtr a(new FakeJob(events, "a"));
+	ToolScheduler::JobID first = scheduler.Submit(a, owner(1));
+	ToolScheduler::JobID second = scheduler.Submit(ToolJobPtr(new FakeJob(events, "b")), owner(2), first);
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "c")), owner(3), second);
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "d")), owner(2));
+
+	scheduler.Finished(a.get(), false);
+
+	BOOST_REQUIRE_EQUAL(4, events.size());
+	BOOST_CHECK_EQUAL("drop b", events[1]);
+	BOOST_CHECK_EQUAL("drop c", events[2]);
+	BOOST_CHECK_EQUAL("start d", events[3]);
+}
+
+BOOST_AUTO_TEST_CASE( cancel_drops_the_jobs_that_come_after )
+{
+	ToolScheduler scheduler(4);
+	EVENTS events;
+
+	ToolJobPtr a(new FakeJob(events, "a"));
+	scheduler.Submit(a, owner(1));
+	ToolScheduler::JobID queued = scheduler.Submit(ToolJobPtr(new FakeJob(events, "b")), owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "c")), owner(2), queued);
+
+	BOOST_REQUIRE_EQUAL(1, events.size());
+
+	// Only owner 1 is cancelled, but its queued job will never succeed:
+	scheduler.Cancel(owner(1));
+
+	BOOST_REQUIRE_EQUAL(4, events.size());
+	BOOST_CHECK_EQUAL("drop b", events[1]);
+	BOOST_CHECK_EQUAL("cancel a", events[2]);
+	BOOST_CHECK_EQUAL("drop c", events[3]);
+	BOOST_CHECK(!scheduler.IsBusy(owner(2)));
+}
+
+BOOST_AUTO_TEST_CASE( queued_duplicates_are_dropped )
+{
+	ToolScheduler scheduler(4);
+	EVENTS events;
+
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "a", _T("build"))), owner(1));
+	ToolScheduler::JobID queued = scheduler.Submit(ToolJobPtr(new FakeJob(events, "b", _T("build"))), owner(1));
+	ToolScheduler::JobID duplicate = scheduler.Submit(ToolJobPtr(new FakeJob(events, "c", _T("build"))), owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "d", _T("build"))), owner(2));
+
+	BOOST_CHECK_EQUAL(queued, duplicate);
+
+	// The running job isn't a duplicate, nor is one for another owner:
+	BOOST_REQUIRE_EQUAL(3, events.size());
+	BOOST_CHECK_EQUAL("start a", events[0]);
+	BOOST_CHECK_EQUAL("drop c", events[1]);
+	BOOST_CHECK_EQUAL("start d", events[2]);
+}
+
+BOOST_AUTO_TEST_CASE( cancel_drops_queued_and_cancels_running )
+{
+	ToolScheduler scheduler(4);
+	EVENTS events;
+
+	ToolJobPtr a(new FakeJob(events, "a"));
+	scheduler.Submit(a, owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "b")), owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "c")), owner(2));
+
+	scheduler.Cancel(owner(1));
+
+	BOOST_REQUIRE_EQUAL(4, events.size());
+	BOOST_CHECK_EQUAL("drop b", events[2]);
+	BOOST_CHECK_EQUAL("cancel a", events[3]);
+
+	// The cancelled job is running until it says it's finished:
+	BOOST_CHECK(scheduler.IsBusy(owner(1)));
+	scheduler.Finished(a.get(), false);
+	BOOST_CHECK(!scheduler.IsBusy(owner(1)));
+	BOOST_CHECK(scheduler.IsBusy());
+}
+
+BOOST_AUTO_TEST_CASE( dispatch_handler_defers_starting )
+{
+	ToolScheduler scheduler(1);
+	EVENTS events;
+	int requests(0);
+
+	scheduler.SetDispatchHandler(CountingHandler(requests));
+
+	ToolJobPtr a(new FakeJob(events, "a"));
+	scheduler.Submit(a, owner(1));
+	scheduler.Submit(ToolJobPtr(new FakeJob(events, "b")), owner(2));
+
+	scheduler.Finished(a.get(), true);
+
+	BOOST_CHECK_EQUAL(1, requests);
+	BOOST_REQUIRE_EQUAL(1, events.size());
+
+	scheduler.Dispatch();
+
+	BOOST_REQUIRE_EQUAL(2, events.size());
+	BOOST_CHECK_EQUAL("start b", events[1]);
+}
+
+BOOST_AUTO_TEST_CASE( process_jobs_for_an_owner_run_in_turn )
+{
+	ToolScheduler scheduler(2);
+	EVENTS events;
+
+	// A failed tool doesn't stop the next one unless it comes after it:
+	scheduler.Submit(ToolJobPtr(new ProcessJob(scheduler, events, "a", TEST_SUCCEEDS)), owner(1));
+	scheduler.Submit(ToolJobPtr(new ProcessJob(scheduler, events, "b", TEST_FAILS)), owner(1));
+	scheduler.Submit(ToolJobPtr(new ProcessJob(scheduler, events, "c", TEST_SUCCEEDS)), owner(1));
+
+	BOOST_REQUIRE_EQUAL(3, events.size());
+	BOOST_CHECK_EQUAL("ok a", events[0]);
+	BOOST_CHECK_EQUAL("failed b", events[1]);
+	BOOST_CHECK_EQUAL("ok c", events[2]);
+	BOOST_CHECK(!scheduler.IsBusy());
+	BOOST_CHECK_EQUAL(0, scheduler.GetRunningCount());
+}
+
+BOOST_AUTO_TEST_CASE( process_jobs_are_chained_on_exit_code )
+{
+	ToolScheduler scheduler(2);
+	EVENTS events;
+
+	ToolScheduler::JobID first = scheduler.Submit(ToolJobPtr(new ProcessJob(scheduler, events, "a", TEST_SUCCEEDS)), owner(1));
+	ToolScheduler::JobID second = scheduler.Submit(ToolJobPtr(new ProcessJob(scheduler, events, "b", TEST_FAILS)), owner(1), first);
+	scheduler.Submit(ToolJobPtr(new ProcessJob(scheduler, events, "c", TEST_SUCCEEDS)), owner(1), second);
+
+	BOOST_REQUIRE_EQUAL(3, events.size());
+	BOOST_CHECK_EQUAL("ok a", events[0]);
+	BOOST_CHECK_EQUAL("failed b", events[1]);
+	BOOST_CHECK_EQUAL("drop c", events[2]);
+	BOOST_CHECK(!scheduler.IsBusy());
+	BOOST_CHECK_EQUAL(0, scheduler.GetRunningCount());
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../tracing.h"
+
+namespace {
+
+const int EventsPerThread = 20000;
+
+/**
+ * Enables tracing for one test and throws away anything left over from
+ * the last one.
+ */
+struct TracingFixture
+{
+	TracingFixture()
+	{
+		std::vector<TraceEvent> leftovers;
+		Tracer::Take(leftovers);
+		Tracer::Enable(true);
+	}
+
+	~TracingFixture()
+	{
+		Tracer::Enable(false);
+		Tracer::SetCapacity(Tracer::DefaultCapacity);
+	}
+};
+
+int countNamed(const std::vector<TraceEvent>& events, const char* name)
+{
+	int count = 0;
+	for (std::vector<TraceEvent>::const_iterator i = events.begin(); i != events.end(); ++i)
+	{
+		if (strcmp((*i).Name, name) == 0)
+			count++;
+	}
+
+	return count;
+}
+
+DWORD WINAPI recordSpans(LPVOID)
+{
+	Tracer::SetThreadName("recorder");
+
+	for (int i = 0; i < EventsPerThread; ++i)
+	{
+		PNTRACE_SPAN("test", "threaded");
+	}
+
+	return 0;
+}
+
+DWORD WINAPI recordOverCapacity(LPVOID)
+{
+	for (int i = 0; i < 10; ++i)
+	{
+		PNTRACE_SPAN("test", "small");
+	}
+
+	return 0;
+}
+
+void runThreads(LPTHREAD_START_ROUTINE fn, int count)
+{
+	std::vector<HANDLE> threads;
+	for (int i = 0; i < count; ++i)
+	{
+		threads.push_back(::CreateThread(NULL, 0, fn, NULL, 0, NULL));
+	}
+
+	::WaitForMultipleObjects(static_cast<DWORD>(threads.size()), &threads[0], TRUE, INFINITE);
+
+	for (std::vector<HANDLE>::const_iterator i = threads.begin(); i != threads.end(); ++i)
+	{
+		::CloseHandle(*i);
+	}
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE( tracing_tests, TracingFixture );
+
+BOOST_AUTO_TEST_CASE( nothing_is_recorded_while_disabled )
+{
+	Tracer::Enable(false);
+
+	{
+		PNTRACE_SPAN("test", "disabled");
+	}
+
+	std::vector<TraceEvent> events;
+	Tracer::Take(events);
+
+	BOOST_CHECK_EQUAL(0, countNamed(events, "disabled"));
+}
+
+BOOST_AUTO_TEST_CASE( nested_spans_are_ordered_parent_first )
+{
+	{
+		PNTRACE_SPAN("test", "outer");
+		{
+			PNTRACE_SPAN("test", "inner");
+			::Sleep(1);
+		}
+	}
+
+	std::vector<TraceEvent> events;
+	Tracer::Take(events);
+
+	BOOST_REQUIRE_EQUAL(2, static_cast<int>(events.size()));
+	BOOST_CHECK_EQUAL(std::string("outer"), events[0].Name);
+	BOOST_CHECK_EQUAL(std::string("inner"), events[1].Name);
+	BOOST_CHECK(events[0].Start <= events[1].Start);
+	BOOST_CHECK(events[0].End >= events[1].End);
+	BOOST_CHECK(events[1].End > events[1].Start);
+	BOOST_CHECK_EQUAL(::GetCurrentThreadId(), events[0].ThreadId);
+
+	// Taking empties the buffers:
+	events.clear();
+	Tracer::Take(events);
+	BOOST_CHECK(events.empty());
+}
+
+BOOST_AUTO_TEST_CASE( chrome_trace_has_complete_and_metadata_events )
+{
+	Tracer::SetThreadName("test \"main\"");
+
+	{
+		PNTRACE_SPAN("file", "OpenFile");
+	}
+
+	std::string json;
+	Tracer::WriteChromeTrace(json);
+
+	BOOST_CHECK_EQUAL(0u, json.find("{\"traceEvents\":["));
+	BOOST_CHECK(json.find("{\"cat\":\"file\",\"name\":\"OpenFile\",\"ph\":\"X\",\"pid\":1,\"tid\":") != std::string::npos);
+	BOOST_CHECK(json.find("\"dur\":") != std::string::npos);
+	BOOST_CHECK(json.find("\"ph\":\"M\"") != std::string::npos);
+	BOOST_CHECK(json.find("\"args\":{\"name\":\"test \\\"main\\\"\"}") != std::string::npos);
+	BOOST_CHECK(json.find("\"displayTimeUnit\":\"ms\"") != std::string::npos);
+
+	// The events were taken, only the thread names remain:
+	Tracer::WriteChromeTrace(json);
+	BOOST_CHECK(json.find("OpenFile") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( full_buffers_drop_events )
+{
+	int dropped = Tracer::GetDropped();
+
+	Tracer::SetCapacity(4);
+	runThreads(recordOverCapacity, 1);
+
+	std::vector<TraceEvent> events;
+	Tracer::Take(events);
+
+	BOOST_CHECK_EQUAL(4, countNamed(events, "small"));
+	BOOST_CHECK_EQUAL(6, Tracer::GetDropped() - dropped);
+}
+
+BOOST_AUTO_TEST_CASE( threads_record_while_events_are_taken )
+{
+	int dropped = Tracer::GetDropped();
+
+	Tracer::SetCapacity(1024);
+
+	HANDLE threads[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		threads[i] = ::CreateThread(NULL, 0, recordSpans, NULL, 0, NULL);
+	}
+
+	// Drain while the threads are recording, nothing may be seen twice:
+	std::vector<TraceEvent> events;
+	while (::WaitForMultipleObjects(4, threads, TRUE, 0) == WAIT_TIMEOUT)
+	{
+		Tracer::Take(events);
+	}
+
+	Tracer::Take(events);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		::CloseHandle(threads[i]);
+	}
+
+	// Every span was either taken once or dropped:
+	int taken = countNamed(events, "threaded");
+	BOOST_CHECK(taken > 0);
+	BOOST_CHECK_EQUAL(4 * EventsPerThread, taken + Tracer::GetDropped() - dropped);
+
+	for (std::vector<TraceEvent>::const_iterator i = events.begin(); i != events.end(); ++i)
+	{
+		BOOST_CHECK((*i).End >= (*i).Start);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
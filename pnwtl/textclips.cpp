@@ -27,7 +27,10 @@ namespace TextClips {
 //////////////////////////////////////////////////////////////////////////////
 
 TextClipSet::TextClipSet(LPCTSTR filename, LPCTSTR name, LPCSTR scheme, bool encodeClipNames) :
-	m_encodeClipNames(encodeClipNames)
+	m_encodeClipNames(encodeClipNames),
+	m_bDirty(false),
+	m_distribution(false),
+	m_manager(NULL)
 {
 	if (filename != NULL)
 	{
@@ -45,12 +48,15 @@ TextClipSet::TextClipSet(LPCTSTR filename, LPCTSTR name, LPCSTR scheme, bool enc
 	}
 }
 
-TextClipSet::TextClipSet(const TextClipSet& copy)
+TextClipSet::TextClipSet(const TextClipSet& copy) :
+	m_bDirty(false),
+	m_manager(NULL)
 {
 	m_filename = copy.m_filename;
 	m_name = copy.m_name;
 	m_scheme = copy.m_scheme;
 	m_encodeClipNames = copy.m_encodeClipNames;
+	m_distribution = copy.m_distribution;
 
 	for(LIST_CLIPS::const_iterator i = copy.m_clips.begin();
 		i != copy.m_clips.end();
@@ -126,6 +132,34 @@ bool TextClipSet::GetEncodeClipNames() const
 void TextClipSet::Remove(TextClips::Clip* clip)
 {
 	m_clips.remove(clip);
+
+	if (m_manager != NULL)
+	{
+		m_manager->clipRemoved(this, clip);
+	}
+}
+
+void TextClipSet::ClipChanged(TextClips::Clip* clip)
+{
+	if (m_manager != NULL)
+	{
+		m_manager->clipChanged(this, clip);
+	}
+}
+
+bool TextClipSet::IsDistribution() const
+{
+	return m_distribution;
+}
+
+void TextClipSet::SetDistribution(bool distribution)
+{
+	m_distribution = distribution;
+}
+
+void TextClipSet::SetManager(TextClipsManager* manager)
+{
+	m_manager = manager;
 }
 
 void TextClipSet::Save()
@@ -161,6 +195,11 @@ void TextClipSet::Add(Clip* clip)
 {
 	m_clips.push_back(clip);
 	m_bDirty = true;
+
+	if (m_manager != NULL)
+	{
+		m_manager->clipAdded(this, clip);
+	}
 }
 
 
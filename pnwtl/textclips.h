@@ -22,6 +22,8 @@ namespace TextClips {
 typedef enum { ctNone = 0, ctField = 0x01, ctMasterField = 0x03, ctFinalCaretPos = 0x4 } EChunkType;
 
 class TextClipSet;
+class TextClipsManager;
+class ClipTemplate;
 
 typedef std::list<TextClipSet*> LIST_CLIPSETS;
 typedef std::map<std::string, LIST_CLIPSETS> MAP_CLIPSETS;
@@ -89,7 +91,7 @@ class Clip
 		{
 		}
 
-		Clip(const Clip& copy) : Name(copy.Name), Shortcut(copy.Shortcut), Text(copy.Text){}
+		Clip(const Clip& copy) : Name(copy.Name), Shortcut(copy.Shortcut), Text(copy.Text), m_template(copy.m_template){}
 
 		tstring Name;
 		std::string Shortcut;
@@ -100,9 +102,17 @@ class Clip
 		void GetChunks(std::vector<Chunk>& chunks) const;
 		void GetChunks(std::vector<Chunk>& chunks, CScintilla* scintilla, IVariableProvider* variables, extensions::IScriptRegistry* scriptRegistry) const;
 
+		/**
+		 * Get the compiled form of Text, compiled on first use and
+		 * again only if Text changes.
+		 */
+		boost::shared_ptr<const ClipTemplate> GetTemplate() const;
+
 	private:
 		void FixText(CScintilla* scintilla, std::vector<Chunk>& chunks) const;
-		std::string FixChunkText(std::string& theText, const std::string& theIndent, int eolMode) const;
+		std::string getIndent(CScintilla* scintilla) const;
+
+		mutable boost::shared_ptr<const ClipTemplate> m_template;
 };
 
 typedef std::list<Clip*>	LIST_CLIPS;
@@ -162,6 +172,27 @@ class TextClipSet
 		 */
 		void Remove(TextClips::Clip* clip);
 
+		/**
+		 * Notify that a clip in this set has been modified (e.g. shortcut changed)
+		 */
+		void ClipChanged(TextClips::Clip* clip);
+
+		/**
+		 * Was this set loaded from the distribution clips directory?
+		 */
+		bool IsDistribution() const;
+
+		/**
+		 * Mark this set as coming from the distribution clips directory,
+		 * user sets take precedence over distribution sets.
+		 */
+		void SetDistribution(bool distribution);
+
+		/**
+		 * Set the manager to be notified of changes to the clips in this set.
+		 */
+		void SetManager(TextClipsManager* manager);
+
 		/**
 		 * Save this clipset to its file
 		 */
@@ -177,6 +208,8 @@ class TextClipSet
 		tstring m_filename;
 		bool m_encodeClipNames;
 		bool m_bDirty;
+		bool m_distribution;
+		TextClipsManager* m_manager;
 };
 
 } // namespace TextClips
@@ -9,7 +9,7 @@
  */
 
 #include "stdafx.h"
-#include "..\textclips.h"
+#include "../textclips.h"
 
 using namespace TextClips;
 
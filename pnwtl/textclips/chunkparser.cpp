@@ -10,12 +10,15 @@
  
 #include "stdafx.h"
 #include "chunkparser.h"
+#include "cliptemplate.h"
 
 #include <boost/spirit/include/phoenix_core.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/spirit/include/phoenix_bind.hpp>
 #include <boost/fusion/include/std_pair.hpp>
 
+#include <set>
+
 using namespace TextClips;
 using namespace extensions;
 
@@ -42,7 +45,7 @@ using qi::_1;
 template <typename Iterator>
 struct snippet : qi::grammar<Iterator, boost::spirit::ascii::space_type>
 {
-	explicit snippet() : snippet::base_type(start), m_vars(NULL), m_runner(NULL)
+	explicit snippet() : snippet::base_type(start), m_result(NULL)
 	{
 		// bring in _val?
 		using qi::labels::_val;
@@ -112,40 +115,17 @@ struct snippet : qi::grammar<Iterator, boost::spirit::ascii::space_type>
 			chunkType = chunkType | ctFinalCaretPos;
 		}
 
-		m_placeholders.push_back(Chunk(chunkType, stop));
+		m_result->AddField(chunkType, stop, std::string());
 	}
 
 	void text(std::string const& str)
 	{
-		append_text(str.c_str());
+		m_result->AddText(str);
 	}
 
 	void escape_char(char c)
 	{
-		char buf[2] = {c, 0};
-		append_text(buf);
-	}
-
-	void append_text(const char* buf)
-	{
-		if (m_placeholders.size() == 0)
-		{
-			m_placeholders.push_back(Chunk(TextClips::ctNone, buf));
-		}
-		else
-		{
-			Chunk& chunk = m_placeholders.back();
-			if (!chunk.IsField())
-			{
-				std::string text(chunk.GetText());
-				text += buf;
-				chunk.SetText(text.c_str());
-			}
-			else
-			{
-				m_placeholders.push_back(Chunk(TextClips::ctNone, buf));
-			}
-		}
+		m_result->AddText(std::string(1, c));
 	}
 
 	void text_placeholder(std::pair<int, std::string> const& args)//std::string const& str, int const& i)
@@ -156,55 +136,36 @@ struct snippet : qi::grammar<Iterator, boost::spirit::ascii::space_type>
 			chunkType = chunkType | ctFinalCaretPos;
 		}
 
-		m_placeholders.push_back(Chunk(chunkType, args.first, args.second));
+		m_result->AddField(chunkType, args.first, args.second);
 	}
 
 	void variable(std::string const& name)
 	{
-		variable(name, std::string(""));
+		add_variable(name, std::string(""));
 	}
 
 	void variable_default(std::pair<std::string, std::string> const& details)
 	{
-		variable(details.first, details.second);
+		add_variable(details.first, details.second);
 	}
 
-	void variable(std::string const& name, std::string const& value)
+	void add_variable(std::string const& name, std::string const& value)
 	{
-		std::string realText;
-		if (m_vars == NULL || !m_vars->GetVariable(name.c_str(), realText))
-		{
-			realText = value;
-		}
-
-		append_text(realText.c_str());
+		m_result->AddVariable(name, value);
 	}
 
 	void backtick(std::string const& text)
 	{
-		if (m_runner != NULL)
-		{
-			PN::AString as;
-			
-			m_runner->Exec("evalScript", text.c_str(), extensions::efCaptureOutput | extensions::efBuiltIn, as);
-
-			append_text(as.Get());
-		}
-		else
-		{
-			append_text("");
-		}
+		m_result->AddScript(text);
 	}
 
-	std::vector<Chunk> m_placeholders;
 	std::set<int> m_seenStops;
-	TextClips::IVariableProvider* m_vars;
-	extensions::IScriptRunner* m_runner;
+	ClipTemplate* m_result;
 };
 
 }} // namespace TextClips::Internal
 
-ChunkParser::ChunkParser()
+ChunkParser::ChunkParser() : m_vars(NULL), m_runner(NULL)
 {
 	m_grammar = new Internal::snippet<std::string::const_iterator>();
 }
@@ -216,6 +177,18 @@ ChunkParser::~ChunkParser()
 
 bool ChunkParser::Parse(const std::string& clip, std::vector<Chunk>& chunks)
 {
+	ClipTemplate compiled(clip);
+	bool r = Compile(clip, compiled);
+	compiled.Instantiate(chunks, m_vars, m_runner, std::string(), PNSF_Unix);
+
+	return r;
+}
+
+bool ChunkParser::Compile(const std::string& clip, ClipTemplate& result)
+{
+	m_grammar->m_result = &result;
+	m_grammar->m_seenStops.clear();
+
 	std::string::const_iterator first = clip.begin();
 	std::string::const_iterator last = clip.end();
 	bool r = phrase_parse(
@@ -229,21 +202,21 @@ bool ChunkParser::Parse(const std::string& clip, std::vector<Chunk>& chunks)
 	{
 		// if we did not get a full match, we copy in the remaining text:
 		std::string buf(first, last);
-		m_grammar->m_placeholders.push_back(Chunk(TextClips::ctNone, buf));
+		result.AddRemainder(buf);
 		r = false;
 	}
-    
-	std::swap(m_grammar->m_placeholders, chunks);
+
+	m_grammar->m_result = NULL;
 
 	return r;
 }
 
 void ChunkParser::SetVariableProvider(IVariableProvider* variables)
 {
-	m_grammar->m_vars = variables;
+	m_vars = variables;
 }
 
 void ChunkParser::SetScriptRunner(IScriptRunner* runner)
 {
-	m_grammar->m_runner = runner;
+	m_runner = runner;
 }
\ No newline at end of file
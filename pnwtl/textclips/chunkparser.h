@@ -19,6 +19,8 @@ namespace extensions {
 
 namespace TextClips {
 
+class ClipTemplate;
+
 namespace Internal {
 template <typename Iterator>
 struct snippet;
@@ -33,13 +35,23 @@ public:
 	explicit ChunkParser();
 	~ChunkParser();
 
+	/**
+	 * Parse clip text and evaluate it straight into chunks.
+	 */
 	bool Parse(const std::string& clip, std::vector<Chunk>& chunks);
 
+	/**
+	 * Parse clip text into a template that can be instantiated many times.
+	 */
+	bool Compile(const std::string& clip, ClipTemplate& result);
+
 	void SetVariableProvider(IVariableProvider* variables);
 	void SetScriptRunner(extensions::IScriptRunner* runner);
 
 private:
 	Internal::snippet<std::string::const_iterator>* m_grammar;
+	IVariableProvider* m_vars;
+	extensions::IScriptRunner* m_runner;
 };
 
 } // namespace TextClips
@@ -10,6 +10,7 @@
 #include "stdafx.h"
 #include "../textclips.h"
 #include "chunkparser.h"
+#include "cliptemplate.h"
 #include "../include/encoding.h"
 
 #include <set>
@@ -66,24 +67,35 @@ void Clip::GetChunks(std::vector<Chunk>& chunks) const
 
 void Clip::GetChunks(std::vector<Chunk>& chunks, CScintilla* scintilla, IVariableProvider* variables, extensions::IScriptRegistry* scriptRegistry) const
 {
-	ChunkParser parser;
+	boost::shared_ptr<const ClipTemplate> compiled(GetTemplate());
 
-	if (variables)
+	extensions::IScriptRunner* runner(NULL);
+	if (scriptRegistry && compiled->HasScripts())
 	{
-		parser.SetVariableProvider(variables);
+		runner = scriptRegistry->GetRunner("python");
 	}
 
-	if (scriptRegistry)
+	if (scintilla == NULL)
+	{
+		compiled->Instantiate(chunks, variables, runner, std::string(), PNSF_Unix);
+	}
+	else
 	{
-		extensions::IScriptRunner* runner = scriptRegistry->GetRunner("python");
-		if (runner != NULL)
-		{
-			parser.SetScriptRunner(runner);
-		}
+		compiled->Instantiate(chunks, variables, runner, getIndent(scintilla), scintilla->GetEOLMode());
 	}
+}
 
-	parser.Parse(std::string(Text.c_str()), chunks);
-	FixText(scintilla, chunks);
+boost::shared_ptr<const ClipTemplate> Clip::GetTemplate() const
+{
+	if (m_template.get() == NULL || m_template->GetSource() != Text)
+	{
+		boost::shared_ptr<ClipTemplate> compiled(new ClipTemplate(Text));
+		ChunkParser parser;
+		parser.Compile(Text, *compiled);
+		m_template = compiled;
+	}
+
+	return m_template;
 }
 
 void Clip::FixText(CScintilla* scintilla, std::vector<Chunk>& chunks) const
@@ -93,65 +105,25 @@ void Clip::FixText(CScintilla* scintilla, std::vector<Chunk>& chunks) const
 		return;
 	}
 
-	// Indentation:
-	int indentation = scintilla->GetLineIndentation(scintilla->LineFromPosition(scintilla->GetCurrentPos()));
-	
-	// Work out tabs and spaces combination to get the indentation right
-	// according to user's settings.
-	std::string theIndent = MakeIndentText(indentation, scintilla->GetUseTabs(), scintilla->GetTabWidth());
+	std::string theIndent = getIndent(scintilla);
+	int eolMode = scintilla->GetEOLMode();
 
 	for(auto cit = chunks.begin(); cit != chunks.end(); ++cit)
 	{
-		std::string result = cit->GetText();
-		result = FixChunkText(result, theIndent, scintilla->GetEOLMode());
+		std::string result;
+		ClipTemplate::AppendFixedText(result, cit->GetText(), theIndent, eolMode);
 		cit->SetText(result.c_str());
 	}
 }
 
-std::string Clip::FixChunkText(std::string& theText, const std::string& theIndent, int eolMode) const
+/**
+ * Get the indentation text for new lines inserted at the current position.
+ */
+std::string Clip::getIndent(CScintilla* scintilla) const
 {
-	for (size_t i = 0; i < theText.size(); i++)
-	{
-		if (theText[i] == '\n')
-		{
-			theText.insert(i+1, theIndent);
-			i += theIndent.size();
-		}
-	}
+	int indentation = scintilla->GetLineIndentation(scintilla->LineFromPosition(scintilla->GetCurrentPos()));
 	
-	std::string clipstr;
-
-	// Text is in Unix EOL mode (LF only), convert it to target EOL mode
-	switch (eolMode)
-	{
-	case PNSF_Unix:
-		// no conversion needed, just copy
-		clipstr = theText;
-		break;
-
-	case PNSF_Windows:
-		{
-			// heuristically reserve size for the target string
-			// and copy the string by inserting '\r' where appropriate
-			clipstr.reserve(theText.size() + (theText.size() / 16));
-			std::string::const_iterator it = theText.begin();
-			std::string::const_iterator end = theText.end();
-			for(; it != end; ++it)
-			{
-				if(*it == '\n')
-					clipstr += '\r';
-				clipstr += *it;
-			}
-		}
-		break;
-
-	case PNSF_Mac:
-		// reserve size for the target string and use standard algorithm
-		clipstr.reserve(theText.size());
-		std::replace_copy(theText.begin(), theText.end(),
-			std::back_inserter(clipstr), '\n', '\r');
-		break;
-	}
-
-	return clipstr;
+	// Work out tabs and spaces combination to get the indentation right
+	// according to user's settings.
+	return MakeIndentText(indentation, scintilla->GetUseTabs(), scintilla->GetTabWidth());
 }
\ No newline at end of file
@@ -0,0 +1,574 @@
+/**
+ * @file clipcache.cpp
+ * @brief Binary cache of parsed text clip sets.
+ * @author Simon Steele
+ * @note Copyright (c) 2002-2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "clipcache.h"
+#include "clipparser.h"
+#include "../include/filefinder.h"
+
+using namespace TextClips;
+using pnutils::threading::CritLock;
+
+// Cache file layout, all integers native byte order:
+//  header: magic, version, sizeof(TCHAR), entry count
+//  entry:  path, last write time, size, blob length, blob
+//  blob:   set count, then per set: name, scheme, encode names, clip count,
+//          then per clip: name, shortcut, text
+// Strings are a character count followed by the characters.
+#define CLIPCACHE_MAGIC		0x43434E50 // "PNCC"
+#define CLIPCACHE_VERSION	1
+
+namespace {
+
+class BlobWriter
+{
+public:
+	explicit BlobWriter(std::vector<unsigned char>& out) : m_out(out) {}
+
+	void WriteInt(uint32_t value)
+	{
+		WriteBytes(&value, sizeof(value));
+	}
+
+	void WriteInt64(uint64_t value)
+	{
+		WriteBytes(&value, sizeof(value));
+	}
+
+	template <typename TChar>
+	void WriteString(const std::basic_string<TChar>& value)
+	{
+		WriteInt(static_cast<uint32_t>(value.size()));
+		WriteBytes(value.data(), value.size() * sizeof(TChar));
+	}
+
+	void WriteBytes(const void* data, size_t length)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		m_out.insert(m_out.end(), p, p + length);
+	}
+
+private:
+	std::vector<unsigned char>& m_out;
+};
+
+/**
+ * Bounds-checked reader, once a read fails all further reads fail.
+ */
+class BlobReader
+{
+public:
+	BlobReader(const unsigned char* data, size_t length) : m_p(data), m_end(data + length), m_ok(true) {}
+
+	bool Ok() const
+	{
+		return m_ok;
+	}
+
+	uint32_t ReadInt()
+	{
+		uint32_t value(0);
+		ReadBytes(&value, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadInt64()
+	{
+		uint64_t value(0);
+		ReadBytes(&value, sizeof(value));
+		return value;
+	}
+
+	template <typename TChar>
+	void ReadString(std::basic_string<TChar>& value)
+	{
+		size_t length = ReadInt();
+		const unsigned char* p = Skip(length * sizeof(TChar));
+		if (p != NULL)
+		{
+			value.resize(length);
+			if (length)
+			{
+				memcpy(&value[0], p, length * sizeof(TChar));
+			}
+		}
+	}
+
+	void ReadBytes(void* out, size_t length)
+	{
+		const unsigned char* p = Skip(length);
+		if (p != NULL)
+		{
+			memcpy(out, p, length);
+		}
+	}
+
+	const unsigned char* Skip(size_t length)
+	{
+		if (!m_ok || static_cast<size_t>(m_end - m_p) < length)
+		{
+			m_ok = false;
+			return NULL;
+		}
+
+		const unsigned char* p = m_p;
+		m_p += length;
+		return p;
+	}
+
+private:
+	const unsigned char* m_p;
+	const unsigned char* m_end;
+	bool m_ok;
+};
+
+} // namespace
+
+void TextClips::FindClipFiles(LPCTSTR path, CLIPFILE_LIST& files)
+{
+	FileFinderFunctor<std::function<void (LPCTSTR, FileFinderData&, bool&)>>(
+		[&files] (LPCTSTR foundPath, FileFinderData& details, bool& /*shouldContinue*/)
+		{
+			tstring fullPath(foundPath);
+			fullPath += details.GetFilename();
+			uint64_t size = (static_cast<uint64_t>(details.m_findData.nFileSizeHigh) << 32) | details.m_findData.nFileSizeLow;
+			files.push_back(ClipFileInfo(fullPath, details.GetFilename(), details.GetLastWriteTime(), size));
+		}).Find(path, _T("*.clips"), false);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ClipSetCache
+//////////////////////////////////////////////////////////////////////////////
+
+ClipSetCache::ClipSetCache(LPCTSTR cacheFile) :
+	m_cacheFile(cacheFile),
+	m_hFile(NULL),
+	m_hMapping(NULL),
+	m_view(NULL),
+	m_viewSize(0),
+	m_dirty(false),
+	m_warmThread(this, &ClipSetCache::warm)
+{
+	open();
+}
+
+ClipSetCache::~ClipSetCache()
+{
+	StopWarming();
+	Save();
+	close();
+}
+
+void ClipSetCache::Load(const ClipFileInfo& file, LIST_CLIPSETS& sets)
+{
+	if (lookup(file, sets))
+	{
+		return;
+	}
+
+	LIST_CLIPSETS parsed;
+	parse(file.Path.c_str(), parsed);
+	store(file, parsed);
+
+	sets.insert(sets.end(), parsed.begin(), parsed.end());
+}
+
+void ClipSetCache::Save()
+{
+	CritLock lock(m_cs);
+
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	boost::shared_ptr< std::vector<unsigned char> > out(new std::vector<unsigned char>());
+	BlobWriter writer(*out);
+
+	writer.WriteInt(CLIPCACHE_MAGIC);
+	writer.WriteInt(CLIPCACHE_VERSION);
+	writer.WriteInt(sizeof(TCHAR));
+	size_t countOffset = out->size();
+	writer.WriteInt(0);
+
+	// Remember where each blob ends up so entries can point at the new buffer:
+	std::vector< std::pair<MAP_ENTRIES::iterator, size_t> > offsets;
+	offsets.reserve(m_entries.size());
+
+	for (MAP_ENTRIES::iterator i = m_entries.begin(); i != m_entries.end(); )
+	{
+		// Drop entries for files that have gone away:
+		if (!FileExists((*i).first.c_str()))
+		{
+			i = m_entries.erase(i);
+			continue;
+		}
+
+		const Entry& entry = (*i).second;
+		writer.WriteString((*i).first);
+		writer.WriteInt64(entry.LastWriteTime);
+		writer.WriteInt64(entry.Size);
+		writer.WriteInt(static_cast<uint32_t>(entry.Length));
+		offsets.push_back(std::make_pair(i, out->size()));
+		writer.WriteBytes(entry.Data, entry.Length);
+		++i;
+	}
+
+	uint32_t count = static_cast<uint32_t>(offsets.size());
+	memcpy(&(*out)[countOffset], &count, sizeof(count));
+
+	for (size_t i = 0; i < offsets.size(); ++i)
+	{
+		Entry& entry = (*offsets[i].first).second;
+		entry.Data = &(*out)[offsets[i].second];
+		entry.Owned = out;
+	}
+
+	// Nothing refers to the old view now:
+	close();
+
+	tstring tempFile(m_cacheFile);
+	tempFile += _T(".tmp");
+
+	HANDLE hFile = ::CreateFile(tempFile.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		LOG(_T("PN2: Failed to write text clips cache.\n"));
+		return;
+	}
+
+	DWORD written(0);
+	BOOL ok = ::WriteFile(hFile, &(*out)[0], static_cast<DWORD>(out->size()), &written, NULL);
+	::CloseHandle(hFile);
+
+	if (!ok || written != out->size() || !::MoveFileEx(tempFile.c_str(), m_cacheFile.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		LOG(_T("PN2: Failed to write text clips cache.\n"));
+		::DeleteFile(tempFile.c_str());
+		return;
+	}
+
+	m_dirty = false;
+
+	// Swap the private copy for a mapping of what we just wrote:
+	m_entries.clear();
+	open();
+}
+
+void ClipSetCache::WarmAsync(LPCTSTR clipsPath, LPCTSTR userClipsPath)
+{
+	m_warmPath = clipsPath;
+	m_warmUserPath = userClipsPath;
+	m_warmThread.Start();
+}
+
+void ClipSetCache::StopWarming()
+{
+	m_warmThread.Stop();
+}
+
+void ClipSetCache::Serialize(const LIST_CLIPSETS& sets, std::vector<unsigned char>& blob)
+{
+	BlobWriter writer(blob);
+	writer.WriteInt(static_cast<uint32_t>(sets.size()));
+
+	BOOST_FOREACH(const TextClipSet* set, sets)
+	{
+		writer.WriteString(tstring(set->GetName()));
+		writer.WriteString(std::string(set->GetScheme() != NULL ? set->GetScheme() : ""));
+		writer.WriteInt(set->GetEncodeClipNames() ? 1 : 0);
+		writer.WriteInt(static_cast<uint32_t>(set->GetClips().size()));
+
+		BOOST_FOREACH(const Clip* clip, set->GetClips())
+		{
+			writer.WriteString(clip->Name);
+			writer.WriteString(clip->Shortcut);
+			writer.WriteString(clip->Text);
+		}
+	}
+}
+
+bool ClipSetCache::Deserialize(const unsigned char* data, size_t length, LPCTSTR filename, LIST_CLIPSETS& sets)
+{
+	BlobReader reader(data, length);
+	LIST_CLIPSETS loaded;
+
+	uint32_t setCount = reader.ReadInt();
+	for (uint32_t i = 0; i < setCount && reader.Ok(); ++i)
+	{
+		tstring name;
+		std::string scheme;
+		reader.ReadString(name);
+		reader.ReadString(scheme);
+		bool encodeClipNames = reader.ReadInt() != 0;
+		uint32_t clipCount = reader.ReadInt();
+
+		if (!reader.Ok())
+		{
+			break;
+		}
+
+		TextClipSet* set = new TextClipSet(filename, name.c_str(), scheme.size() ? scheme.c_str() : NULL, encodeClipNames);
+		loaded.push_back(set);
+
+		for (uint32_t j = 0; j < clipCount && reader.Ok(); ++j)
+		{
+			tstring clipName;
+			std::string shortcut;
+			std::string text;
+			reader.ReadString(clipName);
+			reader.ReadString(shortcut);
+			reader.ReadString(text);
+
+			if (reader.Ok())
+			{
+				set->Add(new Clip(clipName, shortcut, text));
+			}
+		}
+	}
+
+	if (!reader.Ok())
+	{
+		BOOST_FOREACH(TextClipSet* set, loaded)
+		{
+			delete set;
+		}
+
+		return false;
+	}
+
+	sets.insert(sets.end(), loaded.begin(), loaded.end());
+	return true;
+}
+
+/**
+ * Map the cache file and index the entries in it, a cache that
+ * doesn't look right is simply ignored and rebuilt.
+ */
+void ClipSetCache::open()
+{
+	m_hFile = ::CreateFile(m_cacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		m_hFile = NULL;
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0 || static_cast<uint64_t>(size.QuadPart) > static_cast<uint64_t>(SIZE_MAX))
+	{
+		close();
+		return;
+	}
+
+	m_hMapping = ::CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping != NULL)
+	{
+		m_view = static_cast<const unsigned char*>(::MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	}
+
+	if (m_view == NULL)
+	{
+		close();
+		return;
+	}
+
+	m_viewSize = static_cast<size_t>(size.QuadPart);
+
+	BlobReader reader(m_view, m_viewSize);
+	if (reader.ReadInt() != CLIPCACHE_MAGIC || reader.ReadInt() != CLIPCACHE_VERSION || reader.ReadInt() != sizeof(TCHAR))
+	{
+		close();
+		return;
+	}
+
+	uint32_t count = reader.ReadInt();
+	for (uint32_t i = 0; i < count && reader.Ok(); ++i)
+	{
+		tstring path;
+		reader.ReadString(path);
+
+		Entry entry;
+		entry.LastWriteTime = reader.ReadInt64();
+		entry.Size = reader.ReadInt64();
+		entry.Length = reader.ReadInt();
+		entry.Data = reader.Skip(entry.Length);
+
+		if (reader.Ok())
+		{
+			m_entries[path] = entry;
+		}
+	}
+
+	if (!reader.Ok())
+	{
+		LOG(_T("PN2: Text clips cache is corrupt, ignoring it.\n"));
+		m_entries.clear();
+		close();
+	}
+}
+
+void ClipSetCache::close()
+{
+	if (m_view != NULL)
+	{
+		::UnmapViewOfFile(m_view);
+		m_view = NULL;
+		m_viewSize = 0;
+	}
+
+	if (m_hMapping != NULL)
+	{
+		::CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+
+	if (m_hFile != NULL)
+	{
+		::CloseHandle(m_hFile);
+		m_hFile = NULL;
+	}
+}
+
+bool ClipSetCache::lookup(const ClipFileInfo& file, LIST_CLIPSETS& sets)
+{
+	CritLock lock(m_cs);
+
+	MAP_ENTRIES::iterator i = m_entries.find(key(file.Path));
+	if (i == m_entries.end())
+	{
+		return false;
+	}
+
+	const Entry& entry = (*i).second;
+	if (entry.LastWriteTime != file.LastWriteTime || entry.Size != file.Size)
+	{
+		return false;
+	}
+
+	if (!Deserialize(entry.Data, entry.Length, file.Path.c_str(), sets))
+	{
+		m_entries.erase(i);
+		m_dirty = true;
+		return false;
+	}
+
+	return true;
+}
+
+void ClipSetCache::store(const ClipFileInfo& file, const LIST_CLIPSETS& sets)
+{
+	boost::shared_ptr< std::vector<unsigned char> > blob(new std::vector<unsigned char>());
+	Serialize(sets, *blob);
+
+	Entry entry;
+	entry.LastWriteTime = file.LastWriteTime;
+	entry.Size = file.Size;
+	entry.Data = &(*blob)[0];
+	entry.Length = blob->size();
+	entry.Owned = blob;
+
+	CritLock lock(m_cs);
+	m_entries[key(file.Path)] = entry;
+	m_dirty = true;
+}
+
+/**
+ * Background thread function, parse anything that's out of date and
+ * then save the cache.
+ */
+void ClipSetCache::warm(CSSThread* thread)
+{
+	warmPath(thread, m_warmPath);
+	warmPath(thread, m_warmUserPath);
+
+	if (thread->GetCanRun())
+	{
+		Save();
+	}
+}
+
+void ClipSetCache::warmPath(CSSThread* thread, const tstring& path)
+{
+	if (path.empty() || !DirExists(path.c_str()))
+	{
+		return;
+	}
+
+	// Scheme clips live one directory down from the root:
+	CLIPFILE_LIST files;
+	FileFinderFunctor<std::function<void (LPCTSTR, FileFinderData&, bool&)>>(
+		[&files, thread] (LPCTSTR foundPath, FileFinderData& details, bool& shouldContinue)
+		{
+			if ((details.m_findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0
+				&& details.GetFilename()[0] != _T('.'))
+			{
+				tstring schemePath(foundPath);
+				schemePath += details.GetFilename();
+				schemePath += _T('\\');
+				FindClipFiles(schemePath.c_str(), files);
+			}
+
+			shouldContinue = thread->GetCanRun();
+		}).Find(path.c_str(), _T("*"), false);
+
+	BOOST_FOREACH(const ClipFileInfo& file, files)
+	{
+		if (!thread->GetCanRun())
+		{
+			return;
+		}
+
+		{
+			CritLock lock(m_cs);
+			MAP_ENTRIES::const_iterator i = m_entries.find(key(file.Path));
+			if (i != m_entries.end() && (*i).second.LastWriteTime == file.LastWriteTime && (*i).second.Size == file.Size)
+			{
+				continue;
+			}
+		}
+
+		LIST_CLIPSETS parsed;
+		parse(file.Path.c_str(), parsed);
+		store(file, parsed);
+
+		BOOST_FOREACH(TextClipSet* set, parsed)
+		{
+			delete set;
+		}
+	}
+}
+
+void ClipSetCache::parse(LPCTSTR filename, LIST_CLIPSETS& sets)
+{
+	Parser parseState(sets, filename);
+
+	XMLParser parser;
+	parser.SetParseState(&parseState);
+
+	try
+	{
+		parser.LoadFile(filename);
+	}
+	catch( XMLParserException& ex )
+	{
+		LOG(ex.GetMessage());
+	}
+}
+
+/**
+ * Paths are case-insensitive, so are the cache keys.
+ */
+tstring ClipSetCache::key(const tstring& path)
+{
+	tstring result(path);
+	MakeLower(result);
+	return result;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file clipcache.h
+ * @brief Binary cache of parsed text clip sets.
+ * @author Simon Steele
+ * @note Copyright (c) 2002-2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef CLIPCACHE_H__INCLUDED
+#define CLIPCACHE_H__INCLUDED
+
+#include "../textclips.h"
+#include "../include/threading.h"
+#include "../include/ssthreads.h"
+
+#include <unordered_map>
+
+namespace TextClips {
+
+/**
+ * Identifies a .clips file on disk, cached results are only used
+ * if the modified time and size both still match.
+ */
+class ClipFileInfo
+{
+public:
+	ClipFileInfo() : LastWriteTime(0), Size(0) {}
+	ClipFileInfo(const tstring& path, LPCTSTR name, uint64_t lastWriteTime, uint64_t size) : Path(path), Name(name), LastWriteTime(lastWriteTime), Size(size) {}
+
+	/// Full path to the file
+	tstring Path;
+	/// Filename without the path
+	tstring Name;
+	uint64_t LastWriteTime;
+	uint64_t Size;
+};
+
+typedef std::vector<ClipFileInfo> CLIPFILE_LIST;
+
+/**
+ * Find all .clips files in path, with their modified times and sizes.
+ */
+void FindClipFiles(LPCTSTR path, CLIPFILE_LIST& files);
+
+/**
+ * Binary cache of parsed clip sets, stored in a single file which is
+ * memory-mapped when loaded. Only files that have changed since the
+ * cache was written are parsed from XML again. All methods are safe
+ * to call from any thread.
+ */
+class ClipSetCache
+{
+public:
+	explicit ClipSetCache(LPCTSTR cacheFile);
+	~ClipSetCache();
+
+	/**
+	 * Load the clip sets in a file, from the cache if it's up to date
+	 * and from the XML otherwise. New sets are appended to sets.
+	 */
+	void Load(const ClipFileInfo& file, LIST_CLIPSETS& sets);
+
+	/**
+	 * Write any changes back to the cache file.
+	 */
+	void Save();
+
+	/**
+	 * Start bringing the cache up to date for every scheme on a
+	 * background thread, paths are the distribution and user clips
+	 * directories containing one directory per scheme.
+	 */
+	void WarmAsync(LPCTSTR clipsPath, LPCTSTR userClipsPath);
+
+	/**
+	 * Stop warming the cache if it's still in progress.
+	 */
+	void StopWarming();
+
+	/**
+	 * Serialize clip sets into the binary cache format.
+	 */
+	static void Serialize(const LIST_CLIPSETS& sets, std::vector<unsigned char>& blob);
+
+	/**
+	 * Create clip sets from the binary cache format, filename is
+	 * used for each of the sets.
+	 * @returns false if the data is corrupt.
+	 */
+	static bool Deserialize(const unsigned char* data, size_t length, LPCTSTR filename, LIST_CLIPSETS& sets);
+
+private:
+	class Entry
+	{
+	public:
+		Entry() : LastWriteTime(0), Size(0), Data(NULL), Length(0) {}
+
+		uint64_t LastWriteTime;
+		uint64_t Size;
+		const unsigned char* Data;
+		size_t Length;
+		boost::shared_ptr< std::vector<unsigned char> > Owned;
+	};
+
+	typedef std::unordered_map<tstring, Entry> MAP_ENTRIES;
+
+	void open();
+	void close();
+	bool lookup(const ClipFileInfo& file, LIST_CLIPSETS& sets);
+	void store(const ClipFileInfo& file, const LIST_CLIPSETS& sets);
+	void warm(CSSThread* thread);
+	void warmPath(CSSThread* thread, const tstring& path);
+	static void parse(LPCTSTR filename, LIST_CLIPSETS& sets);
+	static tstring key(const tstring& path);
+
+	tstring m_cacheFile;
+	tstring m_warmPath;
+	tstring m_warmUserPath;
+	MAP_ENTRIES m_entries;
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+	const unsigned char* m_view;
+	size_t m_viewSize;
+	bool m_dirty;
+	pnutils::threading::CriticalSection m_cs;
+	CSSThreadT<ClipSetCache> m_warmThread;
+};
+
+typedef boost::shared_ptr<ClipSetCache> ClipSetCachePtr;
+
+} // namespace TextClips
+
+#endif // #ifndef CLIPCACHE_H__INCLUDED
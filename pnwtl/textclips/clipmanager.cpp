@@ -12,10 +12,11 @@
 #include "clipmanager.h"
 #include "clipparser.h"
 #include "clipwriter.h"
-#include "../include/filefinder.h"
 #include "../include/encoding.h"
 #include "../filename.h"
 
+#include <unordered_set>
+
 namespace TextClips {
 
 //////////////////////////////////////////////////////////////////////////////
@@ -29,7 +30,7 @@ TextClipsManager::TextClipsManager() : m_loadingClips(NULL)
 /**
  * Copy constructor - deep copy
  */
-TextClipsManager::TextClipsManager(const TextClipsManager& other)
+TextClipsManager::TextClipsManager(const TextClipsManager& other) : m_loadingClips(NULL)
 {
 	copy(other);
 }
@@ -39,24 +40,6 @@ TextClipsManager::~TextClipsManager()
 	clear();
 }
 
-template <class T, class TIterator> class contains_predicate : public std::unary_function<T, bool> 
-{
-public:
-	explicit contains_predicate(TIterator begin, TIterator end) : m_begin(begin), m_end(end)
-	{
-	}
-
-	bool operator( ) ( T& val ) 
-	{
-		return std::find(m_begin, m_end, val) != m_end;
-	}
-
-private:
-	TIterator m_begin;
-	TIterator m_end;
-};
-
-
 const LIST_CLIPSETS& TextClipsManager::GetClips(LPCSTR schemeName)
 {
 	MAP_CLIPSETS::iterator i = m_schemeClipSets.find(std::string(schemeName));
@@ -84,26 +67,33 @@ const LIST_CLIPSETS& TextClipsManager::GetClips(LPCSTR schemeName)
 	usPath += (LPCTSTR)scheme;
 	usPath += _T("\\");
 
-	FileFinderList finder;
-	std::list<tstring> userFiles;
+	CLIPFILE_LIST userFiles;
 
 	if( DirExists(usPath.c_str()) )
 	{		
-		const std::list<tstring>& foundFiles = finder.GetFiles(usPath.c_str(), _T("*.clips"), false);
-		userFiles.insert(userFiles.end(), foundFiles.begin(), foundFiles.end());
+		FindClipFiles(usPath.c_str(), userFiles);
 	}
 	
 	m_loadingClips = &(*i).second;
 
 	if (DirExists(path.c_str()))
 	{
-		FileFinderList finder;
+		CLIPFILE_LIST foundFiles;
+		FindClipFiles(path.c_str(), foundFiles);
 
-		std::list<tstring> foundFiles(finder.GetFiles(path.c_str(), _T("*.clips"), false));
-		foundFiles.remove_if(contains_predicate<tstring, std::list<tstring>::const_iterator>(userFiles.begin(), userFiles.end()));
+		// User files replace distribution files of the same name:
+		std::unordered_set<tstring> userNames;
+		BOOST_FOREACH(const ClipFileInfo& file, userFiles)
+		{
+			userNames.insert(file.Name);
+		}
+
+		foundFiles.erase(std::remove_if(foundFiles.begin(), foundFiles.end(), 
+			[&userNames] (const ClipFileInfo& file) { return userNames.find(file.Name) != userNames.end(); }),
+			foundFiles.end());
 
 		// Load these files:
-		loadClips(path.c_str(), foundFiles);
+		loadClips(foundFiles);
 
 		// Switch all filenames to point to user settings in case of
 		// user modification:
@@ -112,23 +102,56 @@ const LIST_CLIPSETS& TextClipsManager::GetClips(LPCSTR schemeName)
 			CFileName setfn(set->GetFilename());
 			setfn.ChangePathTo(usPath.c_str());
 			set->SetFilename(setfn.c_str());
+			set->SetDistribution(true);
 		}
 	}
 	
 	// load user files:
-	loadClips(usPath.c_str(), userFiles);
+	loadClips(userFiles);
 	
 	m_loadingClips = NULL;
+
+	BOOST_FOREACH (TextClipSet* set, (*i).second)
+	{
+		set->SetManager(this);
+	}
+
+	invalidate(schemeName);
+
 	return (*i).second;
 }
 
-void TextClipsManager::loadClips(LPCTSTR path, std::list<tstring>& files)
+const Clip* TextClipsManager::FindByShortcut(LPCSTR schemeName, const std::string& shortcut)
 {
-	BOOST_FOREACH (tstring& file, files)
+	const LIST_CLIPSETS& sets = GetClips(schemeName);
+	
+	SchemeIndex& index = m_indexes[std::string(schemeName)];
+	if (!index.Valid)
+	{
+		buildIndex(index, sets);
+	}
+
+	MAP_SHORTCUTS::const_iterator i = index.Shortcuts.find(shortcut);
+	if (i == index.Shortcuts.end())
+	{
+		return NULL;
+	}
+
+	return (*i).second.Winner;
+}
+
+void TextClipsManager::loadClips(const CLIPFILE_LIST& files)
+{
+	BOOST_FOREACH (const ClipFileInfo& file, files)
 	{
-		CFileName clipsFile(file);
-		clipsFile.Root(path);
-		parse(clipsFile.c_str());
+		if (m_cache.get() != NULL)
+		{
+			m_cache->Load(file, *m_loadingClips);
+		}
+		else
+		{
+			parse(file.Path.c_str());
+		}
 	}
 }
 
@@ -146,18 +169,34 @@ std::string TextClipsManager::BuildSortedClipList(LPCSTR schemeName) const
 		return std::string("");
 	}
 
-	std::string result;
+	SchemeIndex& index = m_indexes[(*i).first];
+	if (index.SortedValid)
+	{
+		return index.SortedList;
+	}
+
+	std::string& result = index.SortedList;
+	result.clear();
+	
+	std::vector<const Clip*> sortedClips;
+	size_t total(0);
 	
-	LIST_CLIPS sortedClips;
+	BOOST_FOREACH(TextClipSet* set, (*i).second)
+	{
+		total += set->GetClips().size();
+	}
+
+	sortedClips.reserve(total);
 
 	BOOST_FOREACH(TextClipSet* set, (*i).second)
 	{
 		sortedClips.insert(sortedClips.end(), set->GetClips().begin(), set->GetClips().end());
 	}
 
-	sortedClips.sort(SortClipsByShortcut);
+	// Stable to match the order we've always shown duplicate shortcuts in:
+	std::stable_sort(sortedClips.begin(), sortedClips.end(), SortClipsByShortcut);
 
-	BOOST_FOREACH(Clip* clip, sortedClips)
+	BOOST_FOREACH(const Clip* clip, sortedClips)
 	{
 		if (result.size())
 			result += ",";
@@ -168,6 +207,8 @@ std::string TextClipsManager::BuildSortedClipList(LPCSTR schemeName) const
 		result += name;
 	}
 
+	index.SortedValid = true;
+
 	return result;
 }
 
@@ -244,6 +285,18 @@ void TextClipsManager::Add(TextClipSet* clips)
 	}
 
 	(*i).second.push_back(clips);
+	clips->SetManager(this);
+
+	MAP_SCHEMEINDEX::iterator index = m_indexes.find(schemeName);
+	if (index != m_indexes.end())
+	{
+		BOOST_FOREACH(const Clip* clip, clips->GetClips())
+		{
+			indexClip((*index).second, (*i).second, clips, clip);
+		}
+
+		(*index).second.SortedValid = false;
+	}
 }
 
 /**
@@ -264,6 +317,18 @@ void TextClipsManager::Delete(TextClipSet* clips)
 	}
 
 	(*i).second.remove(clips);
+	clips->SetManager(NULL);
+
+	MAP_SCHEMEINDEX::iterator index = m_indexes.find((*i).first);
+	if (index != m_indexes.end())
+	{
+		BOOST_FOREACH(const Clip* clip, clips->GetClips())
+		{
+			unindexClip((*index).second, (*i).second, clip);
+		}
+
+		(*index).second.SortedValid = false;
+	}
 
 	if (::FileExists(clips->GetFilename()))
 	{
@@ -273,6 +338,11 @@ void TextClipsManager::Delete(TextClipSet* clips)
 	delete clips;
 }
 
+void TextClipsManager::SetCache(ClipSetCachePtr cache)
+{
+	m_cache = cache;
+}
+
 void TextClipsManager::Reset(const TextClipsManager& other)
 {
 	clear();
@@ -293,10 +363,13 @@ void TextClipsManager::clear()
 	}
 
 	m_schemeClipSets.clear();
+	m_indexes.clear();
 }
 
 void TextClipsManager::copy(const TextClipsManager& copy)
 {
+	m_cache = copy.m_cache;
+
 	for (MAP_CLIPSETS::const_iterator j = copy.m_schemeClipSets.begin();
 		j != copy.m_schemeClipSets.end();
 		++j)
@@ -305,7 +378,9 @@ void TextClipsManager::copy(const TextClipsManager& copy)
 		LIST_CLIPSETS& mine((*k).second);
 		BOOST_FOREACH(TextClipSet* copySet, (*j).second)
 		{
-			mine.push_back(new TextClipSet(*copySet));
+			TextClipSet* set = new TextClipSet(*copySet);
+			set->SetManager(this);
+			mine.push_back(set);
 		}
 	}
 }
@@ -346,4 +421,164 @@ void TextClipsManager::getAllKnownSetFilenames(const char* scheme, std::vector<t
 	}
 }
 
+/**
+ * A clip was added to a set we manage, index it if it wins its shortcut.
+ */
+void TextClipsManager::clipAdded(TextClipSet* set, Clip* clip)
+{
+	std::string scheme(set->GetScheme() != NULL ? set->GetScheme() : "");
+	MAP_SCHEMEINDEX::iterator index = m_indexes.find(scheme);
+	MAP_CLIPSETS::const_iterator sets = m_schemeClipSets.find(scheme);
+	if (index == m_indexes.end() || sets == m_schemeClipSets.end())
+	{
+		return;
+	}
+
+	indexClip((*index).second, (*sets).second, set, clip);
+	(*index).second.SortedValid = false;
+}
+
+/**
+ * A clip was removed from a set we manage, if it was the winner for its
+ * shortcut then find the next best candidate.
+ */
+void TextClipsManager::clipRemoved(TextClipSet* set, Clip* clip)
+{
+	std::string scheme(set->GetScheme() != NULL ? set->GetScheme() : "");
+	MAP_SCHEMEINDEX::iterator index = m_indexes.find(scheme);
+	MAP_CLIPSETS::const_iterator sets = m_schemeClipSets.find(scheme);
+	if (index == m_indexes.end() || sets == m_schemeClipSets.end())
+	{
+		return;
+	}
+
+	unindexClip((*index).second, (*sets).second, clip);
+	(*index).second.SortedValid = false;
+}
+
+/**
+ * A clip has been edited in place, we don't know what it used to be called
+ * so the index for the scheme is rebuilt when next needed.
+ */
+void TextClipsManager::clipChanged(TextClipSet* set, Clip* /*clip*/)
+{
+	invalidate(set->GetScheme() != NULL ? set->GetScheme() : "");
+}
+
+void TextClipsManager::indexClip(SchemeIndex& index, const LIST_CLIPSETS& sets, const TextClipSet* set, const Clip* clip)
+{
+	if (!index.Valid)
+	{
+		return;
+	}
+
+	std::pair<MAP_SHORTCUTS::iterator, bool> result = index.Shortcuts.insert(MAP_SHORTCUTS::value_type(clip->Shortcut, IndexEntry(clip, set)));
+	if (!result.second && takesPrecedence(sets, set, (*result.first).second.Owner))
+	{
+		(*result.first).second = IndexEntry(clip, set);
+	}
+}
+
+void TextClipsManager::unindexClip(SchemeIndex& index, const LIST_CLIPSETS& sets, const Clip* clip)
+{
+	if (!index.Valid)
+	{
+		return;
+	}
+
+	MAP_SHORTCUTS::iterator i = index.Shortcuts.find(clip->Shortcut);
+	if (i == index.Shortcuts.end() || (*i).second.Winner != clip)
+	{
+		return;
+	}
+
+	index.Shortcuts.erase(i);
+
+	// Re-resolve this one shortcut against the remaining sets:
+	BOOST_FOREACH(const TextClipSet* set, sets)
+	{
+		const Clip* candidate = set->FindByShortcut(clip->Shortcut);
+		if (candidate != NULL)
+		{
+			indexClip(index, sets, set, candidate);
+		}
+	}
+}
+
+void TextClipsManager::invalidate(LPCSTR schemeName)
+{
+	MAP_SCHEMEINDEX::iterator i = m_indexes.find(std::string(schemeName));
+	if (i != m_indexes.end())
+	{
+		(*i).second.Valid = false;
+		(*i).second.Shortcuts.clear();
+		(*i).second.SortedValid = false;
+	}
+}
+
+void TextClipsManager::buildIndex(SchemeIndex& index, const LIST_CLIPSETS& sets)
+{
+	index.Shortcuts.clear();
+
+	size_t total(0);
+	BOOST_FOREACH(const TextClipSet* set, sets)
+	{
+		total += set->GetClips().size();
+	}
+
+	index.Shortcuts.rehash(total);
+
+	// User sets first so they win over distribution sets, insert never
+	// replaces so within each pass the first set loaded wins:
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		bool distribution(pass == 1);
+		BOOST_FOREACH(const TextClipSet* set, sets)
+		{
+			if (set->IsDistribution() != distribution)
+			{
+				continue;
+			}
+
+			BOOST_FOREACH(const Clip* clip, set->GetClips())
+			{
+				index.Shortcuts.insert(MAP_SHORTCUTS::value_type(clip->Shortcut, IndexEntry(clip, set)));
+			}
+		}
+	}
+
+	index.Valid = true;
+}
+
+/**
+ * Should a clip from set beat one from other with the same shortcut?
+ */
+bool TextClipsManager::takesPrecedence(const LIST_CLIPSETS& sets, const TextClipSet* set, const TextClipSet* other) const
+{
+	if (set->IsDistribution() != other->IsDistribution())
+	{
+		return !set->IsDistribution();
+	}
+
+	if (set == other)
+	{
+		// Clips are only ever appended, the one already there came first.
+		return false;
+	}
+
+	BOOST_FOREACH(const TextClipSet* candidate, sets)
+	{
+		if (candidate == set)
+		{
+			return true;
+		}
+		else if (candidate == other)
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
 } // namespace TextClips
\ No newline at end of file
@@ -12,6 +12,9 @@
 #define CLIPMANAGER_H__INCLUDED
 
 #include "../textclips.h"
+#include "clipcache.h"
+
+#include <unordered_map>
 
 class FileFinderData;
 
@@ -29,6 +32,12 @@ class TextClipsManager
 
 		const LIST_CLIPSETS& GetClips(LPCSTR schemeName);
 
+		/**
+		 * Find the clip for a shortcut in a scheme, user clips win over
+		 * distribution clips, otherwise the first set loaded wins.
+		 */
+		const Clip* FindByShortcut(LPCSTR schemeName, const std::string& shortcut);
+
 		std::string BuildSortedClipList(LPCSTR schemeName) const;
 
 		void Add(TextClipSet* clips);
@@ -36,15 +45,67 @@ class TextClipsManager
 
 		void Reset(const TextClipsManager& copy);
 
+		/**
+		 * Use a cache of parsed clip sets when loading clips files,
+		 * the cache is shared with any copies of this manager.
+		 */
+		void SetCache(ClipSetCachePtr cache);
+
 	private:
+		friend class TextClipSet;
+
+		/**
+		 * Winning clip for a shortcut, and the set it came from.
+		 */
+		class IndexEntry
+		{
+		public:
+			IndexEntry() : Winner(NULL), Owner(NULL) {}
+			IndexEntry(const Clip* clip, const TextClipSet* set) : Winner(clip), Owner(set) {}
+
+			const Clip* Winner;
+			const TextClipSet* Owner;
+		};
+
+		typedef std::unordered_map<std::string, IndexEntry> MAP_SHORTCUTS;
+
+		/**
+		 * Per-scheme lookup caches, built on first use and then
+		 * maintained as sets and clips come and go.
+		 */
+		class SchemeIndex
+		{
+		public:
+			SchemeIndex() : Valid(false), SortedValid(false) {}
+
+			bool Valid;
+			MAP_SHORTCUTS Shortcuts;
+			bool SortedValid;
+			std::string SortedList;
+		};
+
+		typedef std::map<std::string, SchemeIndex> MAP_SCHEMEINDEX;
+
 		void clear();
 		void copy(const TextClipsManager& copy);
-		void loadClips(LPCTSTR path, std::list<tstring>& files);
+		void loadClips(const CLIPFILE_LIST& files);
 		void parse(LPCTSTR filename);
 		void getAllKnownSetFilenames(const char* scheme, std::vector<tstring>& clipFiles);
 
+		// Index maintenance:
+		void clipAdded(TextClipSet* set, Clip* clip);
+		void clipRemoved(TextClipSet* set, Clip* clip);
+		void clipChanged(TextClipSet* set, Clip* clip);
+		void indexClip(SchemeIndex& index, const LIST_CLIPSETS& sets, const TextClipSet* set, const Clip* clip);
+		void unindexClip(SchemeIndex& index, const LIST_CLIPSETS& sets, const Clip* clip);
+		void invalidate(LPCSTR schemeName);
+		void buildIndex(SchemeIndex& index, const LIST_CLIPSETS& sets);
+		bool takesPrecedence(const LIST_CLIPSETS& sets, const TextClipSet* set, const TextClipSet* other) const;
+
 		MAP_CLIPSETS	m_schemeClipSets;
 		LIST_CLIPSETS*	m_loadingClips;
+		ClipSetCachePtr	m_cache;
+		mutable MAP_SCHEMEINDEX	m_indexes;
 };
 
 }
@@ -0,0 +1,182 @@
+/**
+ * @file cliptemplate.cpp
+ * @brief Compiled Text Clip Templates.
+ * @author Simon Steele
+ * @note Copyright (c) 2011+ Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "cliptemplate.h"
+
+using namespace TextClips;
+
+ClipTemplate::ClipTemplate(const std::string& source) : m_source(source), m_hasScripts(false)
+{
+}
+
+const std::string& ClipTemplate::GetSource() const
+{
+	return m_source;
+}
+
+const std::vector<ClipTemplate::Part>& ClipTemplate::GetParts() const
+{
+	return m_parts;
+}
+
+bool ClipTemplate::HasScripts() const
+{
+	return m_hasScripts;
+}
+
+void ClipTemplate::AddText(const std::string& text)
+{
+	// Adjacent literal text is merged at compile time:
+	if (m_parts.size() && m_parts.back().Type == ptText)
+	{
+		m_parts.back().Text += text;
+	}
+	else
+	{
+		m_parts.push_back(Part(ptText, ctNone, 0, text, std::string()));
+	}
+}
+
+void ClipTemplate::AddField(int flags, int id, const std::string& text)
+{
+	m_parts.push_back(Part(ptField, flags, id, text, std::string()));
+}
+
+void ClipTemplate::AddVariable(const std::string& name, const std::string& defaultValue)
+{
+	m_parts.push_back(Part(ptVariable, ctNone, 0, name, defaultValue));
+}
+
+void ClipTemplate::AddScript(const std::string& script)
+{
+	m_parts.push_back(Part(ptScript, ctNone, 0, script, std::string()));
+	m_hasScripts = true;
+}
+
+void ClipTemplate::AddRemainder(const std::string& text)
+{
+	m_parts.push_back(Part(ptRemainder, ctNone, 0, text, std::string()));
+}
+
+void ClipTemplate::Instantiate(std::vector<Chunk>& chunks, IVariableProvider* variables, extensions::IScriptRunner* runner, const std::string& indent, int eolMode) const
+{
+	chunks.clear();
+	chunks.reserve(m_parts.size());
+
+	// Text, variables and scripts all run together into one chunk until
+	// the next field, we build that text here:
+	std::string text;
+	bool inText(false);
+	std::string value;
+
+	for (std::vector<Part>::const_iterator i = m_parts.begin(); i != m_parts.end(); ++i)
+	{
+		const Part& part = *i;
+
+		switch (part.Type)
+		{
+		case ptText:
+			AppendFixedText(text, part.Text, indent, eolMode);
+			inText = true;
+			break;
+
+		case ptVariable:
+			if (variables == NULL || !variables->GetVariable(part.Text.c_str(), value))
+			{
+				value = part.Default;
+			}
+
+			AppendFixedText(text, value, indent, eolMode);
+			inText = true;
+			break;
+
+		case ptScript:
+			if (runner != NULL)
+			{
+				PN::AString output;
+				runner->Exec("evalScript", part.Text.c_str(), extensions::efCaptureOutput | extensions::efBuiltIn, output);
+				AppendFixedText(text, std::string(output.Get()), indent, eolMode);
+			}
+
+			inText = true;
+			break;
+
+		case ptField:
+		case ptRemainder:
+			if (inText)
+			{
+				chunks.push_back(Chunk(ctNone, text));
+				text.clear();
+				inText = false;
+			}
+
+			if (part.Type == ptField)
+			{
+				std::string fieldText;
+				AppendFixedText(fieldText, part.Text, indent, eolMode);
+				chunks.push_back(Chunk(part.Flags, part.Id, fieldText));
+			}
+			else
+			{
+				// Unparsed trailing text always gets a chunk of its own:
+				text.clear();
+				AppendFixedText(text, part.Text, indent, eolMode);
+				chunks.push_back(Chunk(ctNone, text));
+				text.clear();
+			}
+			break;
+		}
+	}
+
+	if (inText)
+	{
+		chunks.push_back(Chunk(ctNone, text));
+	}
+}
+
+void ClipTemplate::AppendFixedText(std::string& out, const std::string& text, const std::string& indent, int eolMode)
+{
+	// Fast path, nothing to convert:
+	if (indent.empty() && (eolMode == PNSF_Unix || eolMode == PNSF_NoChange))
+	{
+		out += text;
+		return;
+	}
+
+	out.reserve(out.size() + text.size() + (text.size() / 16));
+
+	size_t start(0);
+	size_t eol;
+	while ((eol = text.find('\n', start)) != text.npos)
+	{
+		out.append(text, start, eol - start);
+
+		switch (eolMode)
+		{
+		case PNSF_Windows:
+			out += "\r\n";
+			break;
+
+		case PNSF_Mac:
+			out += '\r';
+			break;
+
+		default:
+			out += '\n';
+			break;
+		}
+
+		out += indent;
+		start = eol + 1;
+	}
+
+	out.append(text, start, text.npos);
+}
@@ -0,0 +1,99 @@
+/**
+ * @file cliptemplate.h
+ * @brief Compiled Text Clip Templates.
+ * @author Simon Steele
+ * @note Copyright (c) 2011+ Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef CLIPTEMPLATE_H__INCLUDED
+#define CLIPTEMPLATE_H__INCLUDED
+
+#include "../textclips.h"
+
+namespace extensions {
+	class IScriptRunner;
+}
+
+namespace TextClips {
+
+/**
+ * A clip compiled from its text into literal text, fields, variable
+ * references and script calls. Compiling happens once, after that each
+ * insertion only evaluates variables and scripts and emits text with the
+ * right indentation and line endings.
+ */
+class ClipTemplate
+{
+public:
+	typedef enum { ptText, ptField, ptVariable, ptScript, ptRemainder } EPartType;
+
+	/**
+	 * Single element of a compiled template.
+	 */
+	class Part
+	{
+	public:
+		Part(EPartType type, int flags, int id, const std::string& text, const std::string& defaultValue) :
+			Type(type), Flags(flags), Id(id), Text(text), Default(defaultValue) {}
+
+		EPartType Type;
+		/// EChunkType flags for fields
+		int Flags;
+		/// Field id
+		int Id;
+		/// Literal text, initial field text, variable name or script
+		std::string Text;
+		/// Default value for variables
+		std::string Default;
+	};
+
+	explicit ClipTemplate(const std::string& source);
+
+	/**
+	 * The clip text this template was compiled from.
+	 */
+	const std::string& GetSource() const;
+
+	const std::vector<Part>& GetParts() const;
+
+	/**
+	 * Does this template call any scripts?
+	 */
+	bool HasScripts() const;
+
+	// Building, used by the parser:
+	void AddText(const std::string& text);
+	void AddField(int flags, int id, const std::string& text);
+	void AddVariable(const std::string& name, const std::string& defaultValue);
+	void AddScript(const std::string& script);
+	void AddRemainder(const std::string& text);
+
+	/**
+	 * Build the chunks for one insertion of this template.
+	 * @param variables Variable provider, may be NULL
+	 * @param runner Script runner for backtick expressions, may be NULL
+	 * @param indent Text to insert after each line break
+	 * @param eolMode Target line ending mode (EPNSaveFormat)
+	 */
+	void Instantiate(std::vector<Chunk>& chunks, IVariableProvider* variables, extensions::IScriptRunner* runner, const std::string& indent, int eolMode) const;
+
+	/**
+	 * Append LF-only text to out, converting line endings to eolMode and
+	 * indenting each new line with indent.
+	 */
+	static void AppendFixedText(std::string& out, const std::string& text, const std::string& indent, int eolMode);
+
+private:
+	std::string m_source;
+	std::vector<Part> m_parts;
+	bool m_hasScripts;
+};
+
+typedef boost::shared_ptr<const ClipTemplate> ClipTemplatePtr;
+
+} // namespace TextClips
+
+#endif // #ifndef CLIPTEMPLATE_H__INCLUDED
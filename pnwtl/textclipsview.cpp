@@ -381,6 +381,7 @@ LRESULT CClipsDocker::OnEdit(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*
 	clip->Name = dlg.GetHint();
 
 	TextClips::TextClipSet* set = getSetForItem(hSelected);
+	set->ClipChanged(clip);
 	set->Save();
 
 	m_tv.SetItemText(hSelected, clip->Name.c_str());
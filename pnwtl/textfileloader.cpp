@@ -0,0 +1,117 @@
+/**
+ * @file textfileloader.cpp
+ * @brief Read text files into Scintilla, detecting their encoding
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "textfileloader.h"
+#include "include/Utf8_16.h"
+#include "include/lineendings.h"
+
+/**
+ * @return number of bytes to skip for BOM
+ */
+static int determineEncoding(unsigned char* pBuf, int nLen, EPNEncoding& eEncoding) {
+	eEncoding = eUnknown;
+
+	int nRet = 0;
+
+	if (nLen > 1) {
+		if (pBuf[0] == Utf8_16::k_Boms[eUtf16BigEndian][0] && pBuf[1] == Utf8_16::k_Boms[eUtf16BigEndian][1]) {
+			eEncoding = eUtf16BigEndian;
+			nRet = 2;
+		} else if (pBuf[0] == Utf8_16::k_Boms[eUtf16LittleEndian][0] && pBuf[1] == Utf8_16::k_Boms[eUtf16LittleEndian][1]) {
+			eEncoding = eUtf16LittleEndian;
+			nRet = 2;
+		} else if (nLen > 2 && pBuf[0] == Utf8_16::k_Boms[eUtf8][0] && pBuf[1] == Utf8_16::k_Boms[eUtf8][1] && pBuf[2] == Utf8_16::k_Boms[eUtf8][2]) {
+			eEncoding = eUtf8;
+			nRet = 3;
+		} else {
+			int good_cnt = 0;
+			int escaped = 0;
+			for (int i = 0; i < nLen; ++i)
+			{
+				unsigned char c = pBuf[i];
+
+				if (((escaped == 1) && !(c >= 0x80 && c <= 0xBF)) ||
+					((escaped == 0) && (c >= 0x80 && c <= 0xBF)))
+				{
+					// "Dead" combination ocuried - it is not UTF8
+					good_cnt = -1;
+					break;
+				}	
+
+				if (c >= 0xC0 && c <= 0xFD)
+				{	
+					escaped = 1;
+				}
+				if (c <= 0x7F)
+				{
+					escaped = 0;
+				}
+				if (c >= 0x80 && c <= 0xBF)
+				{
+					escaped++;
+					good_cnt++;
+				}
+			}
+			if (good_cnt > 0)
+			{
+				eEncoding = eUtf8NoBOM;
+				nRet = 0; // special case for auto UTF8 - no BOM
+			}
+		}
+	}
+
+	return nRet;
+}
+
+EPNSaveFormat LoadTextFile(CScintilla& sc, CFile& file, int blockSize, EPNEncoding& encoding)
+{
+	std::vector<char> data(blockSize);
+	int lenFile = file.Read(&data[0], blockSize);
+
+	///See if there's an encoding specified or not...
+	if(encoding == eUnknown)
+	{
+		determineEncoding(reinterpret_cast<unsigned char*>(&data[0]), lenFile, encoding);
+	}
+
+	EPNSaveFormat endings = determineLineEndings(reinterpret_cast<unsigned char*>(&data[0]), lenFile, encoding);
+
+	if(encoding != eUnknown)
+	{
+		// We do a Unicode-friendly read for unicode files...
+		sc.SPerform(SCI_SETCODEPAGE, SC_CP_UTF8);
+		Utf8_16_Read converter;
+		
+		// Converter doesn't understand UTF-8 with no BOM
+		Utf8_16::encodingType convEncType = (encoding == eUtf8NoBOM) ? Utf8_16::eUtf8 : (Utf8_16::encodingType)encoding;
+		int nBomSkipBytes( BOMLengthLookup[encoding] );
+
+		while (lenFile > 0)
+		{
+			lenFile = converter.convert(&data[0], lenFile, convEncType, nBomSkipBytes);
+			sc.SPerform(SCI_ADDTEXT, lenFile, (long)converter.getNewBuf());
+			lenFile = file.Read(&data[0], blockSize);
+		}
+	}
+	else
+	{
+		sc.SPerform(SCI_SETCODEPAGE, (long)OPTIONS->GetCached(Options::OMultiByteCodePage));
+
+		// Otherwise we do a simple read.
+		while (lenFile > 0) 
+		{
+			sc.SPerform(SCI_ADDTEXT, lenFile, reinterpret_cast<LPARAM>(&data[0]));
+			lenFile = file.Read(&data[0], blockSize);
+		}
+	}
+
+	return endings;
+}
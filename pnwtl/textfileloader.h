@@ -0,0 +1,28 @@
+/**
+ * @file textfileloader.h
+ * @brief Read text files into Scintilla, detecting their encoding
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef textfileloader_h__included
+#define textfileloader_h__included
+
+class CScintilla;
+class CFile;
+
+/**
+ * Read the rest of an open file onto the end of the text in sc, the way
+ * the editor opens files. Unicode files are converted to UTF-8, anything
+ * else is read as it is in the multi-byte code page, and sc is told
+ * which. Works on any thread that owns sc.
+ * @param encoding In: the encoding to read with, or eUnknown to detect it
+ * from the first block. Out: the encoding used.
+ * @return The line endings found in the first block.
+ */
+EPNSaveFormat LoadTextFile(CScintilla& sc, CFile& file, int blockSize, EPNEncoding& encoding);
+
+#endif // #ifndef textfileloader_h__included
@@ -13,7 +13,7 @@
 #include "textview.h"
 #include "scaccessor.h"
 #include "smartstart.h"
-#include "include/lineendings.h"
+#include "textfileloader.h"
 #include "scriptregistry.h"
 #include "project.h"
 #include "childfrm.h"
@@ -74,6 +74,8 @@ BOOL CTextView::PreTranslateMessage(MSG* pMsg)
 
 void CTextView::SetScheme(Scheme* pScheme, int flags)
 {
+	PNTRACE_SPAN("scheme", "CTextView::SetScheme");
+
 	if(pScheme != SchemeManager::GetInstance()->GetDefaultScheme())
 		m_bSmartStart = false;
 	
@@ -128,72 +130,12 @@ static std::string ExtractLine(const char *buf, size_t length) {
 	return std::string(buf, 0, endl);
 }
 
-/**
- * @return number of bytes to skip for BOM
- */
-int determineEncoding(unsigned char* pBuf, int nLen, EPNEncoding& eEncoding) {
-	eEncoding = eUnknown;
-
-	int nRet = 0;
-
-	if (nLen > 1) {
-		if (pBuf[0] == Utf8_16::k_Boms[eUtf16BigEndian][0] && pBuf[1] == Utf8_16::k_Boms[eUtf16BigEndian][1]) {
-			eEncoding = eUtf16BigEndian;
-			nRet = 2;
-		} else if (pBuf[0] == Utf8_16::k_Boms[eUtf16LittleEndian][0] && pBuf[1] == Utf8_16::k_Boms[eUtf16LittleEndian][1]) {
-			eEncoding = eUtf16LittleEndian;
-			nRet = 2;
-		} else if (nLen > 2 && pBuf[0] == Utf8_16::k_Boms[eUtf8][0] && pBuf[1] == Utf8_16::k_Boms[eUtf8][1] && pBuf[2] == Utf8_16::k_Boms[eUtf8][2]) {
-			eEncoding = eUtf8;
-			nRet = 3;
-		} else {
-			int good_cnt = 0;
-			int escaped = 0;
-			for (int i = 0; i < nLen; ++i)
-			{
-				unsigned char c = pBuf[i];
-
-				if (((escaped == 1) && !(c >= 0x80 && c <= 0xBF)) ||
-					((escaped == 0) && (c >= 0x80 && c <= 0xBF)))
-				{
-					// "Dead" combination ocuried - it is not UTF8
-					good_cnt = -1;
-					break;
-				}	
-
-				if (c >= 0xC0 && c <= 0xFD)
-				{	
-					escaped = 1;
-				}
-				if (c <= 0x7F)
-				{
-					escaped = 0;
-				}
-				if (c >= 0x80 && c <= 0xBF)
-				{
-					escaped++;
-					good_cnt++;
-				}
-			}
-			if (good_cnt > 0)
-			{
-				eEncoding = eUtf8NoBOM;
-				nRet = 0; // special case for auto UTF8 - no BOM
-			}
-		}
-	}
-
-	return nRet;
-}
-
 bool CTextView::OpenFile(LPCTSTR filename, EPNEncoding encoding)
 {
 	// We don't want smart start if we're opening a file...
 	m_bSmartStart = false;
 
-#ifdef _DEBUG
-	DWORD timeIn = GetTickCount();
-#endif
+	PNTRACE_SPAN("file", "CTextView::OpenFile");
 
 	CFile file;
 	if ( file.Open(filename, CFile::modeRead | CFile::modeBinary) ) 
@@ -240,49 +182,9 @@ bool CTextView::OpenFile(LPCTSTR filename, EPNEncoding encoding)
 			SPerform(SCI_SETLAYOUTCACHE, OPTIONS->GetCached(Options::ODefaultScintillaCache));
 		}
 		
-		std::vector<char> data(useBlockSize);
-		int lenFile = file.Read(&data[0], useBlockSize);
-
-		///See if there's an encoding specified or not...
-        if(encoding == eUnknown)
-		{
-			determineEncoding(reinterpret_cast<unsigned char*>(&data[0]), lenFile, m_encType);
-		}
-		else
-		{
-			m_encType = encoding;
-		}
-
-		EPNSaveFormat endings = determineLineEndings(reinterpret_cast<unsigned char*>(&data[0]), lenFile, m_encType);
-
-		if(m_encType != eUnknown)
-		{
-			// We do a Unicode-friendly read for unicode files...
-			SPerform(SCI_SETCODEPAGE, SC_CP_UTF8);
-			Utf8_16_Read converter;
-			
-			// Converter doesn't understand UTF-8 with no BOM
-			Utf8_16::encodingType convEncType = (m_encType == eUtf8NoBOM) ? Utf8_16::eUtf8 : (Utf8_16::encodingType)m_encType;
-			int nBomSkipBytes( BOMLengthLookup[m_encType] );
-
-			while (lenFile > 0)
-			{
-				lenFile = converter.convert(&data[0], lenFile, convEncType, nBomSkipBytes);
-				SPerform(SCI_ADDTEXT, lenFile, (long)converter.getNewBuf());
-				lenFile = file.Read(&data[0], useBlockSize);
-			}
-		}
-		else
-		{
-			SPerform(SCI_SETCODEPAGE, (long)OPTIONS->GetCached(Options::OMultiByteCodePage));
-
-			// Otherwise we do a simple read.
-			while (lenFile > 0) 
-			{
-				SPerform(SCI_ADDTEXT, lenFile, reinterpret_cast<LPARAM>(&data[0]));
-				lenFile = file.Read(&data[0], useBlockSize);
-			}
-		}
+		// eUnknown has the loader work it out:
+		m_encType = encoding;
+		EPNSaveFormat endings = LoadTextFile(*this, file, useBlockSize, m_encType);
 
 		file.Close();
 		SPerform(SCI_SETSEL, 0, 0);
@@ -298,14 +200,6 @@ bool CTextView::OpenFile(LPCTSTR filename, EPNEncoding encoding)
 
 		checkDotLogTimestamp();
 
-#ifdef _DEBUG
-		DWORD timeTotal = GetTickCount() - timeIn;
-		TCHAR outstr[300];
-		outstr[299] = NULL;
-		_sntprintf(outstr, 299, _T("File load takes %d milliseconds\n"), timeTotal);
-		::OutputDebugString(outstr);
-#endif
-
 		return true;
 	}
 	else
@@ -373,6 +267,8 @@ void CTextView::Revert(LPCTSTR filename)
 
 bool CTextView::SaveFile(IFilePtr file, bool setSavePoint)
 {
+	PNTRACE_SPAN("file", "CTextView::SaveFile");
+
 	char data[blockSize + 1];
 	int lengthDoc = SPerform(SCI_GETLENGTH);
 
@@ -558,11 +454,26 @@ void CTextView::SetPosStatus(CMultiPaneStatusBarCtrl& stat)
 	
 	long pos = GetCurrentPos();
 
-	_sntprintf(tvstatbuf, 49, _T("[%d:%d] : %d"), 
-		(LineFromPosition(pos) + 1),	/* row    */
-		(GetColumn(pos) + 1),			/* column */
-		GetLineCount()					/* lines  */
-	);
+	// Cheap once counted, only the edited blocks get counted again. Counting
+	// the whole document waits for CMainFrame::OnIdle, until then there are
+	// no words to show:
+	if (HaveTextStats())
+	{
+		_sntprintf(tvstatbuf, 49, _T("[%d:%d] : %d : %d words"), 
+			(LineFromPosition(pos) + 1),	/* row    */
+			(GetColumn(pos) + 1),			/* column */
+			GetLineCount(),					/* lines  */
+			GetTextStats().Words			/* words  */
+		);
+	}
+	else
+	{
+		_sntprintf(tvstatbuf, 49, _T("[%d:%d] : %d"), 
+			(LineFromPosition(pos) + 1),	/* row    */
+			(GetColumn(pos) + 1),			/* column */
+			GetLineCount()					/* lines  */
+		);
+	}
 
 	stat.SetPaneText(ID_POS_PANE, tvstatbuf);
 	
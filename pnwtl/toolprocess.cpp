@@ -0,0 +1,887 @@
+/**
+ * @file toolprocess.cpp
+ * @brief Run a tool process and capture its output.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "toolprocess.h"
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include <vector>
+
+#define TOOLPROCESS_BUFFER_SIZE 16384
+
+/// Once the process has exited, how long to wait for output still on its way
+#define TOOLPROCESS_DRAIN_WAIT 100
+
+#if defined(_WIN32)
+
+//////////////////////////////////////////////////////////////////////////////
+// Win32ToolProcess
+//////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/**
+ * Anonymous pipes can't do overlapped I/O, so our end of each pipe is a
+ * uniquely named pipe opened for overlapped I/O and the process gets an
+ * ordinary inheritable handle to the other end.
+ */
+class Win32ToolProcess : public ToolProcess
+{
+	public:
+		Win32ToolProcess();
+		virtual ~Win32ToolProcess();
+
+		virtual bool Start(const tstring& commandLine, const TCHAR* dir, const unsigned char* input, size_t inputLength);
+		virtual bool Wait(IToolProcessSink* sink);
+		virtual void Cancel();
+		virtual bool WaitForExit(unsigned int milliseconds);
+		virtual void Terminate(int exitCode);
+		virtual int GetExitCode();
+		virtual const tstring& GetError() const;
+		virtual int GetErrorCode() const;
+
+	private:
+		/// One of our ends of the pipes, with its outstanding I/O
+		class Stream
+		{
+			public:
+				Stream() : Handle(NULL), Pending(false)
+				{
+					memset(&Overlapped, 0, sizeof(OVERLAPPED));
+					Overlapped.hEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+				}
+
+				~Stream()
+				{
+					Close();
+					::CloseHandle(Overlapped.hEvent);
+				}
+
+				void Close()
+				{
+					if (Handle != NULL)
+					{
+						if (Pending)
+						{
+							DWORD transferred;
+							::CancelIo(Handle);
+							::GetOverlappedResult(Handle, &Overlapped, &transferred, TRUE);
+							Pending = false;
+						}
+
+						::CloseHandle(Handle);
+						Handle = NULL;
+					}
+				}
+
+				HANDLE Handle;
+				OVERLAPPED Overlapped;
+				bool Pending;
+		};
+
+		bool createPipe(bool inbound, Stream& ours, HANDLE& theirs, SECURITY_ATTRIBUTES* sa);
+		bool read(Stream& stream, EStream type, IToolProcessSink* sink);
+		void write(Stream& stream);
+		void setError(LPCTSTR what);
+
+		Stream m_streams[3];
+		HANDLE m_process;
+		HANDLE m_cancel;
+		const unsigned char* m_input;
+		size_t m_inputLength;
+		std::vector<char> m_buffers[2];
+		tstring m_error;
+		int m_errorCode;
+};
+
+enum { StdOut, StdErr, StdIn };
+
+Win32ToolProcess::Win32ToolProcess() : m_process(NULL), m_input(NULL), m_inputLength(0), m_errorCode(0)
+{
+	m_cancel = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+Win32ToolProcess::~Win32ToolProcess()
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		m_streams[i].Close();
+	}
+
+	if (m_process != NULL)
+	{
+		::CloseHandle(m_process);
+	}
+
+	::CloseHandle(m_cancel);
+}
+
+bool Win32ToolProcess::Start(const tstring& commandLine, const TCHAR* dir, const unsigned char* input, size_t inputLength)
+{
+	SECURITY_DESCRIPTOR sd;
+	::InitializeSecurityDescriptor(&sd, SECURITY_DESCRIPTOR_REVISION);
+	::SetSecurityDescriptorDacl(&sd, TRUE, NULL, FALSE);
+
+	SECURITY_ATTRIBUTES sa = {sizeof(SECURITY_ATTRIBUTES), &sd, TRUE};
+
+	HANDLE theirs[3] = {NULL, NULL, NULL};
+
+	if (!createPipe(true, m_streams[StdOut], theirs[StdOut], &sa)
+		|| !createPipe(true, m_streams[StdErr], theirs[StdErr], &sa)
+		|| !createPipe(false, m_streams[StdIn], theirs[StdIn], &sa))
+	{
+		setError(_T("Failed to create pipes: "));
+
+		for (int i = 0; i < 3; ++i)
+		{
+			if (theirs[i] != NULL)
+				::CloseHandle(theirs[i]);
+			m_streams[i].Close();
+		}
+
+		return false;
+	}
+
+	STARTUPINFO si;
+	memset(&si, 0, sizeof(STARTUPINFO));
+	si.cb = sizeof(STARTUPINFO);
+	si.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
+	si.wShowWindow = SW_HIDE;
+	si.hStdInput = theirs[StdIn];
+	si.hStdOutput = theirs[StdOut];
+	si.hStdError = theirs[StdErr];
+
+	PROCESS_INFORMATION pi = {0, 0, 0, 0};
+
+	std::vector<TCHAR> cmdbuf(commandLine.length() + 1);
+	memcpy(&cmdbuf[0], commandLine.c_str(), commandLine.size() * sizeof(TCHAR));
+
+	bool created = ::CreateProcess(NULL, &cmdbuf[0], &sa, NULL, TRUE, CREATE_NEW_CONSOLE, NULL, dir, &si, &pi) != 0;
+
+	if (!created)
+	{
+		setError(_T("Failed to create process: "));
+	}
+
+	// Only the process has the other ends now, so we see the pipes close
+	// when it (and anything it started) has finished with them:
+	for (int i = 0; i < 3; ++i)
+	{
+		::CloseHandle(theirs[i]);
+	}
+
+	if (!created)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			m_streams[i].Close();
+		}
+
+		return false;
+	}
+
+	::CloseHandle(pi.hThread);
+	m_process = pi.hProcess;
+
+	m_input = input;
+	m_inputLength = input != NULL ? inputLength : 0;
+
+	// Nothing to send, the process sees the end of its input straight away:
+	if (m_inputLength == 0)
+	{
+		m_streams[StdIn].Close();
+	}
+
+	return true;
+}
+
+bool Win32ToolProcess::Wait(IToolProcessSink* sink)
+{
+	m_buffers[tsOutput].resize(TOOLPROCESS_BUFFER_SIZE);
+	m_buffers[tsError].resize(TOOLPROCESS_BUFFER_SIZE);
+
+	bool exited(false);
+
+	for (;;)
+	{
+		// Start reads and writes until they're all waiting for the process:
+		bool reading = read(m_streams[StdOut], tsOutput, sink);
+		reading = read(m_streams[StdErr], tsError, sink) || reading;
+		write(m_streams[StdIn]);
+
+		if (exited && !reading)
+		{
+			return true;
+		}
+
+		HANDLE handles[5];
+		DWORD count(0);
+		handles[count++] = m_cancel;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			if (m_streams[i].Pending)
+				handles[count++] = m_streams[i].Overlapped.hEvent;
+		}
+
+		if (!exited)
+		{
+			handles[count++] = m_process;
+		}
+
+		// After the process exits, something it started may still have the
+		// pipes open, so only wait a little while for more output:
+		DWORD result = ::WaitForMultipleObjects(count, handles, FALSE, exited ? TOOLPROCESS_DRAIN_WAIT : INFINITE);
+
+		if (result == WAIT_OBJECT_0)
+		{
+			return false;
+		}
+		else if (result == WAIT_TIMEOUT || result == WAIT_FAILED)
+		{
+			return true;
+		}
+		else if (handles[result - WAIT_OBJECT_0] == m_process)
+		{
+			exited = true;
+		}
+	}
+}
+
+/**
+ * Deliver any completed read and start another, until one is left
+ * waiting for more output.
+ * @return false if the pipe has closed
+ */
+bool Win32ToolProcess::read(Stream& stream, EStream type, IToolProcessSink* sink)
+{
+	std::vector<char>& buffer = m_buffers[type];
+
+	while (stream.Handle != NULL)
+	{
+		DWORD bytesRead(0);
+
+		if (stream.Pending)
+		{
+			if (!::GetOverlappedResult(stream.Handle, &stream.Overlapped, &bytesRead, FALSE))
+			{
+				if (::GetLastError() == ERROR_IO_INCOMPLETE)
+				{
+					return true;
+				}
+
+				// ERROR_BROKEN_PIPE, the process closed its end:
+				stream.Pending = false;
+				stream.Close();
+				break;
+			}
+
+			stream.Pending = false;
+		}
+		else
+		{
+			::ResetEvent(stream.Overlapped.hEvent);
+
+			if (!::ReadFile(stream.Handle, &buffer[0], static_cast<DWORD>(buffer.size()), &bytesRead, &stream.Overlapped))
+			{
+				if (::GetLastError() == ERROR_IO_PENDING)
+				{
+					stream.Pending = true;
+					continue;
+				}
+
+				stream.Close();
+				break;
+			}
+		}
+
+		if (bytesRead > 0)
+		{
+			sink->OnOutput(type, &buffer[0], bytesRead);
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Write as much input as the pipe will take, closing it when done.
+ */
+void Win32ToolProcess::write(Stream& stream)
+{
+	while (stream.Handle != NULL)
+	{
+		DWORD written(0);
+
+		if (stream.Pending)
+		{
+			if (!::GetOverlappedResult(stream.Handle, &stream.Overlapped, &written, FALSE))
+			{
+				if (::GetLastError() == ERROR_IO_INCOMPLETE)
+				{
+					return;
+				}
+
+				// The process doesn't want any more input:
+				stream.Pending = false;
+				stream.Close();
+				return;
+			}
+
+			stream.Pending = false;
+		}
+		else
+		{
+			::ResetEvent(stream.Overlapped.hEvent);
+
+			if (!::WriteFile(stream.Handle, m_input, static_cast<DWORD>(m_inputLength), &written, &stream.Overlapped))
+			{
+				if (::GetLastError() == ERROR_IO_PENDING)
+				{
+					stream.Pending = true;
+					continue;
+				}
+
+				stream.Close();
+				return;
+			}
+		}
+
+		m_input += written;
+		m_inputLength -= written;
+
+		if (m_inputLength == 0)
+		{
+			// Close stdin so that a filter doesn't wait forever for more data:
+			stream.Close();
+		}
+	}
+}
+
+void Win32ToolProcess::Cancel()
+{
+	::SetEvent(m_cancel);
+}
+
+bool Win32ToolProcess::WaitForExit(unsigned int milliseconds)
+{
+	return ::WaitForSingleObject(m_process, milliseconds) == WAIT_OBJECT_0;
+}
+
+void Win32ToolProcess::Terminate(int exitCode)
+{
+	::TerminateProcess(m_process, exitCode);
+}
+
+int Win32ToolProcess::GetExitCode()
+{
+	DWORD exitCode(0);
+	::GetExitCodeProcess(m_process, &exitCode);
+	return static_cast<int>(exitCode);
+}
+
+const tstring& Win32ToolProcess::GetError() const
+{
+	return m_error;
+}
+
+int Win32ToolProcess::GetErrorCode() const
+{
+	return m_errorCode;
+}
+
+bool Win32ToolProcess::createPipe(bool inbound, Stream& ours, HANDLE& theirs, SECURITY_ATTRIBUTES* sa)
+{
+	static volatile LONG s_pipeSerial(0);
+
+	TCHAR name[MAX_PATH];
+	_sntprintf(name, MAX_PATH, _T("\\\\.\\pipe\\pn-tool-%u-%u"), ::GetCurrentProcessId(), ::InterlockedIncrement(&s_pipeSerial));
+	name[MAX_PATH - 1] = NULL;
+
+	HANDLE pipe = ::CreateNamedPipe(name,
+		(inbound ? PIPE_ACCESS_INBOUND : PIPE_ACCESS_OUTBOUND) | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+		PIPE_TYPE_BYTE | PIPE_WAIT, 1, TOOLPROCESS_BUFFER_SIZE, TOOLPROCESS_BUFFER_SIZE, 0, NULL);
+
+	if (pipe == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	theirs = ::CreateFile(name, inbound ? GENERIC_WRITE : GENERIC_READ, 0, sa, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (theirs == INVALID_HANDLE_VALUE)
+	{
+		theirs = NULL;
+		::CloseHandle(pipe);
+		return false;
+	}
+
+	ours.Handle = pipe;
+
+	return true;
+}
+
+void Win32ToolProcess::setError(LPCTSTR what)
+{
+	m_errorCode = static_cast<int>(::GetLastError());
+	m_error = what;
+
+	LPTSTR message(NULL);
+	if (::FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+		NULL, m_errorCode, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), reinterpret_cast<LPTSTR>(&message), 0, NULL) != 0)
+	{
+		m_error += message;
+		::LocalFree(message);
+	}
+}
+
+} // namespace
+
+ToolProcess* ToolProcess::Create()
+{
+	return new Win32ToolProcess();
+}
+
+#else // !defined(_WIN32)
+
+//////////////////////////////////////////////////////////////////////////////
+// PosixToolProcess
+//////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/**
+ * Runs the command line with /bin/sh. A thread waits for the process to
+ * exit and tells the reader through a pipe, so exit and output can be
+ * waited for together with poll.
+ */
+class PosixToolProcess : public ToolProcess
+{
+	public:
+		PosixToolProcess();
+		virtual ~PosixToolProcess();
+
+		virtual bool Start(const tstring& commandLine, const TCHAR* dir, const unsigned char* input, size_t inputLength);
+		virtual bool Wait(IToolProcessSink* sink);
+		virtual void Cancel();
+		virtual bool WaitForExit(unsigned int milliseconds);
+		virtual void Terminate(int exitCode);
+		virtual int GetExitCode();
+		virtual const tstring& GetError() const;
+		virtual int GetErrorCode() const;
+
+	private:
+		static void* waitThread(void* param);
+
+		bool read(int& fd, EStream type, IToolProcessSink* sink);
+		void write(int& fd);
+		void setError(const char* what, int error);
+
+		pid_t m_pid;
+		int m_status;
+		pthread_t m_waiter;
+		bool m_waiting;
+		/// Our ends of the process's stdout, stderr and stdin
+		int m_fds[3];
+		int m_cancel[2];
+		int m_exited[2];
+		const unsigned char* m_input;
+		size_t m_inputLength;
+		std::vector<char> m_buffer;
+		tstring m_error;
+		int m_errorCode;
+};
+
+enum { StdOut, StdErr, StdIn };
+
+void closeFd(int& fd)
+{
+	if (fd != -1)
+	{
+		::close(fd);
+		fd = -1;
+	}
+}
+
+bool makePipe(int fds[2])
+{
+	if (::pipe(fds) != 0)
+	{
+		fds[0] = fds[1] = -1;
+		return false;
+	}
+
+	::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	return true;
+}
+
+PosixToolProcess::PosixToolProcess() : m_pid(-1), m_status(0), m_waiting(false), m_input(NULL), m_inputLength(0), m_errorCode(0)
+{
+	m_fds[StdOut] = m_fds[StdErr] = m_fds[StdIn] = -1;
+	m_exited[0] = m_exited[1] = -1;
+
+	makePipe(m_cancel);
+}
+
+PosixToolProcess::~PosixToolProcess()
+{
+	if (m_waiting)
+	{
+		::pthread_join(m_waiter, NULL);
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		closeFd(m_fds[i]);
+	}
+
+	closeFd(m_exited[0]);
+	closeFd(m_exited[1]);
+	closeFd(m_cancel[0]);
+	closeFd(m_cancel[1]);
+}
+
+bool PosixToolProcess::Start(const tstring& commandLine, const TCHAR* dir, const unsigned char* input, size_t inputLength)
+{
+	int pipes[3][2] = {{-1, -1}, {-1, -1}, {-1, -1}};
+
+	if (!makePipe(pipes[StdOut]) || !makePipe(pipes[StdErr]) || !makePipe(pipes[StdIn]) || !makePipe(m_exited))
+	{
+		setError("Failed to create pipes: ", errno);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			closeFd(pipes[i][0]);
+			closeFd(pipes[i][1]);
+		}
+
+		return false;
+	}
+
+	posix_spawn_file_actions_t actions;
+	::posix_spawn_file_actions_init(&actions);
+	::posix_spawn_file_actions_adddup2(&actions, pipes[StdIn][0], 0);
+	::posix_spawn_file_actions_adddup2(&actions, pipes[StdOut][1], 1);
+	::posix_spawn_file_actions_adddup2(&actions, pipes[StdErr][1], 2);
+
+	// The shell changes directory, posix_spawn can't:
+	std::vector<const char*> argv;
+	argv.push_back("/bin/sh");
+	argv.push_back("-c");
+	if (dir != NULL)
+	{
+		argv.push_back("cd -- \"$0\" && exec /bin/sh -c \"$1\"");
+		argv.push_back(dir);
+	}
+	argv.push_back(commandLine.c_str());
+	argv.push_back(NULL);
+
+	int result = ::posix_spawn(&m_pid, "/bin/sh", &actions, NULL, const_cast<char* const*>(&argv[0]), environ);
+
+	::posix_spawn_file_actions_destroy(&actions);
+
+	// Keep only our ends:
+	closeFd(pipes[StdOut][1]);
+	closeFd(pipes[StdErr][1]);
+	closeFd(pipes[StdIn][0]);
+
+	m_fds[StdOut] = pipes[StdOut][0];
+	m_fds[StdErr] = pipes[StdErr][0];
+	m_fds[StdIn] = pipes[StdIn][1];
+
+	if (result != 0)
+	{
+		m_pid = -1;
+		setError("Failed to create process: ", result);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			closeFd(m_fds[i]);
+		}
+
+		return false;
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		::fcntl(m_fds[i], F_SETFL, ::fcntl(m_fds[i], F_GETFL) | O_NONBLOCK);
+	}
+
+	m_waiting = ::pthread_create(&m_waiter, NULL, &PosixToolProcess::waitThread, this) == 0;
+
+	m_input = input;
+	m_inputLength = input != NULL ? inputLength : 0;
+
+	if (m_inputLength == 0)
+	{
+		closeFd(m_fds[StdIn]);
+	}
+
+	return true;
+}
+
+void* PosixToolProcess::waitThread(void* param)
+{
+	PosixToolProcess* process = static_cast<PosixToolProcess*>(param);
+
+	int status(0);
+	while (::waitpid(process->m_pid, &status, 0) == -1 && errno == EINTR)
+		;
+
+	process->m_status = status;
+
+	// Wakes Wait and WaitForExit, the byte is never read:
+	char exited(1);
+	while (::write(process->m_exited[1], &exited, 1) == -1 && errno == EINTR)
+		;
+
+	return NULL;
+}
+
+bool PosixToolProcess::Wait(IToolProcessSink* sink)
+{
+	m_buffer.resize(TOOLPROCESS_BUFFER_SIZE);
+
+	// Writing to a process that has stopped reading must not kill us:
+	sigset_t pipeSignal, oldMask;
+	sigemptyset(&pipeSignal);
+	sigaddset(&pipeSignal, SIGPIPE);
+	::pthread_sigmask(SIG_BLOCK, &pipeSignal, &oldMask);
+
+	bool exited(false);
+	bool cancelled(false);
+
+	for (;;)
+	{
+		pollfd fds[5];
+		nfds_t count(0);
+
+		fds[count].fd = m_cancel[0];
+		fds[count++].events = POLLIN;
+
+		for (int i = StdOut; i <= StdErr; ++i)
+		{
+			if (m_fds[i] != -1)
+			{
+				fds[count].fd = m_fds[i];
+				fds[count++].events = POLLIN;
+			}
+		}
+
+		if (m_fds[StdIn] != -1)
+		{
+			fds[count].fd = m_fds[StdIn];
+			fds[count++].events = POLLOUT;
+		}
+
+		if (!exited)
+		{
+			fds[count].fd = m_exited[0];
+			fds[count++].events = POLLIN;
+		}
+
+		if (exited && m_fds[StdOut] == -1 && m_fds[StdErr] == -1)
+		{
+			break;
+		}
+
+		int ready = ::poll(fds, count, exited ? TOOLPROCESS_DRAIN_WAIT : -1);
+		if (ready == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (ready <= 0)
+		{
+			break;
+		}
+
+		if (fds[0].revents != 0)
+		{
+			cancelled = true;
+			break;
+		}
+
+		for (nfds_t i = 1; i < count; ++i)
+		{
+			if (fds[i].revents == 0)
+				continue;
+
+			if (fds[i].fd == m_fds[StdOut])
+				read(m_fds[StdOut], tsOutput, sink);
+			else if (fds[i].fd == m_fds[StdErr])
+				read(m_fds[StdErr], tsError, sink);
+			else if (fds[i].fd == m_fds[StdIn])
+				write(m_fds[StdIn]);
+			else if (fds[i].fd == m_exited[0])
+				exited = true;
+		}
+	}
+
+	// Throw away any SIGPIPE we caused before unblocking it again:
+	sigset_t pending;
+	sigpending(&pending);
+	if (sigismember(&pending, SIGPIPE))
+	{
+		int signal;
+		sigwait(&pipeSignal, &signal);
+	}
+
+	::pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+	return !cancelled;
+}
+
+/**
+ * Deliver everything that can be read without blocking.
+ * @return false if the pipe has closed
+ */
+bool PosixToolProcess::read(int& fd, EStream type, IToolProcessSink* sink)
+{
+	for (;;)
+	{
+		ssize_t bytesRead = ::read(fd, &m_buffer[0], m_buffer.size());
+
+		if (bytesRead > 0)
+		{
+			sink->OnOutput(type, &m_buffer[0], static_cast<size_t>(bytesRead));
+		}
+		else if (bytesRead == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (bytesRead == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			return true;
+		}
+		else
+		{
+			closeFd(fd);
+			return false;
+		}
+	}
+}
+
+/**
+ * Write as much input as the pipe will take, closing it when done.
+ */
+void PosixToolProcess::write(int& fd)
+{
+	while (m_inputLength > 0)
+	{
+		ssize_t written = ::write(fd, m_input, m_inputLength);
+
+		if (written > 0)
+		{
+			m_input += written;
+			m_inputLength -= static_cast<size_t>(written);
+		}
+		else if (written == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			return;
+		}
+		else
+		{
+			// The process doesn't want any more input:
+			break;
+		}
+	}
+
+	closeFd(fd);
+}
+
+void PosixToolProcess::Cancel()
+{
+	char cancel(1);
+	while (::write(m_cancel[1], &cancel, 1) == -1 && errno == EINTR)
+		;
+}
+
+bool PosixToolProcess::WaitForExit(unsigned int milliseconds)
+{
+	if (m_exited[0] == -1)
+	{
+		return true;
+	}
+
+	pollfd fd = {m_exited[0], POLLIN, 0};
+
+	int ready;
+	while ((ready = ::poll(&fd, 1, static_cast<int>(milliseconds))) == -1 && errno == EINTR)
+		;
+
+	return ready == 1;
+}
+
+void PosixToolProcess::Terminate(int /*exitCode*/)
+{
+	if (m_pid != -1)
+	{
+		::kill(m_pid, SIGKILL);
+	}
+}
+
+int PosixToolProcess::GetExitCode()
+{
+	if (!WaitForExit(0))
+	{
+		return -1;
+	}
+
+	if (WIFEXITED(m_status))
+	{
+		return WEXITSTATUS(m_status);
+	}
+
+	return 128 + WTERMSIG(m_status);
+}
+
+const tstring& PosixToolProcess::GetError() const
+{
+	return m_error;
+}
+
+int PosixToolProcess::GetErrorCode() const
+{
+	return m_errorCode;
+}
+
+void PosixToolProcess::setError(const char* what, int error)
+{
+	m_errorCode = error;
+	m_error = what;
+	m_error += ::strerror(error);
+}
+
+} // namespace
+
+ToolProcess* ToolProcess::Create()
+{
+	return new PosixToolProcess();
+}
+
+#endif // !defined(_WIN32)
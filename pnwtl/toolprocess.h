@@ -0,0 +1,78 @@
+/**
+ * @file toolprocess.h
+ * @brief Run a tool process and capture its output.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef toolprocess_h__included
+#define toolprocess_h__included
+
+class IToolProcessSink;
+
+/**
+ * A child process with its standard input, output and error redirected.
+ * Output is read as it arrives instead of being polled for, and the end
+ * of the process wakes the reader straight away. Create picks the
+ * implementation for the platform we're built for.
+ */
+class ToolProcess
+{
+	public:
+		typedef enum { tsOutput, tsError } EStream;
+
+		virtual ~ToolProcess() {}
+
+		static ToolProcess* Create();
+
+		/**
+		 * Start commandLine in dir, or the current directory if dir is NULL.
+		 * The input is written to the process's standard input, which is then
+		 * closed. It isn't copied and must stay valid until Wait returns.
+		 * @return false if the process couldn't be started, see GetError
+		 */
+		virtual bool Start(const tstring& commandLine, const TCHAR* dir, const unsigned char* input, size_t inputLength) = 0;
+
+		/**
+		 * Pass output to sink as it arrives, on the calling thread, until the
+		 * process has exited and its output has been read.
+		 * @return false if Cancel was called
+		 */
+		virtual bool Wait(IToolProcessSink* sink) = 0;
+
+		/**
+		 * Make Wait return early. This can be called from any thread, and also
+		 * before Wait is called.
+		 */
+		virtual void Cancel() = 0;
+
+		/**
+		 * Wait for the process to exit by itself.
+		 * @return true if the process has exited
+		 */
+		virtual bool WaitForExit(unsigned int milliseconds) = 0;
+
+		virtual void Terminate(int exitCode) = 0;
+
+		virtual int GetExitCode() = 0;
+
+		/// Why Start failed
+		virtual const tstring& GetError() const = 0;
+		virtual int GetErrorCode() const = 0;
+};
+
+/**
+ * Receives the output of a ToolProcess.
+ */
+class IToolProcessSink
+{
+	public:
+		virtual ~IToolProcessSink() {}
+
+		virtual void OnOutput(ToolProcess::EStream stream, const char* data, size_t length) = 0;
+};
+
+#endif // #ifndef toolprocess_h__included
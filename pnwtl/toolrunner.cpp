@@ -25,13 +25,18 @@
 ToolRunner::ToolRunner(ToolWrapper* pWrapper)
 {
 	m_pWrapper = pWrapper;
+	m_pProcess = ToolProcess::Create();
 	m_RetCode = 0;
 	m_pNext = NULL;
 }
 
 ToolRunner::~ToolRunner()
 {
+	// The capture thread uses the process until it finishes:
+	Cancel();
+	Stop();
 
+	delete m_pProcess;
 }
 
 bool ToolRunner::GetThreadedExecution()
@@ -49,12 +54,21 @@ int ToolRunner::GetExitCode()
 	return m_RetCode;
 }
 
+void ToolRunner::Cancel()
+{
+	SetCanRun(false);
+	m_pProcess->Cancel();
+}
+
 /**
  * Thread Run Function, calls Run_CreateProcess and notifies all 
  * interested parties on completion.
  */
 void ToolRunner::Run()
 {
+	Tracer::SetThreadName("Tool Runner");
+	PNTRACE_SPAN("tools", "ToolRunner::Run");
+
 	time(&m_starttime);
 	m_pWrapper->OnStart();
 	m_RetCode = Run_Capture(m_pWrapper->Command.c_str(), m_pWrapper->Params.c_str(), m_pWrapper->Folder.c_str());
@@ -86,223 +100,102 @@ int ToolRunner::Run_Capture(LPCTSTR command, LPCTSTR params, LPCTSTR dir)
 	if (_tcslen(dir) == 0)
 		dir = NULL;
 
-	OSVERSIONINFO osv = {sizeof(OSVERSIONINFO), 0, 0, 0, 0, _T("")};
-
-	::GetVersionEx(&osv);
-	bool bWin9x = osv.dwPlatformId == VER_PLATFORM_WIN32_WINDOWS;
-	
-	SECURITY_ATTRIBUTES sa = {sizeof(SECURITY_ATTRIBUTES), 0, 0};
-	sa.bInheritHandle = TRUE;
-	sa.lpSecurityDescriptor = NULL;
+	unsigned int dwBytesToWrite;
+	unsigned char* stdinbuf;
+	stdinbuf = m_pWrapper->GetStdIOBuffer(dwBytesToWrite);
 
-	SECURITY_DESCRIPTOR sd;
-	if (!bWin9x)
+	if (!m_pProcess->Start(clopts, dir, stdinbuf, dwBytesToWrite))
 	{
-		// On NT we can have a proper security descriptor...
-		::InitializeSecurityDescriptor(&sd, SECURITY_DESCRIPTOR_REVISION);
-		::SetSecurityDescriptorDacl(&sd, TRUE, NULL, FALSE);
-		sa.lpSecurityDescriptor = &sd;
+		m_pWrapper->_AddToolOutput(_T("\n> "));
+		m_pWrapper->_AddToolOutput(m_pProcess->GetError().c_str());
+
+		return m_pProcess->GetErrorCode();
 	}
 
-	HANDLE hWritePipe, hReadPipe;
-	HANDLE hStdInWrite, hStdInRead;
-	
-    if (!::CreatePipe(&hReadPipe, &hWritePipe, &sa, 0))
-	{
-		CLastErrorInfo lei;
-		m_pWrapper->_AddToolOutput(_T("\n> Failed to create StdOut and StdErr Pipe: "));
-		m_pWrapper->_AddToolOutput((LPCTSTR)lei);
+	// Output arrives in OnOutput until the process is finished, or we're told to close.
+	bool finished = m_pProcess->Wait(this);
+	flushOutput();
 
-		return lei.GetErrorCode();
+	if (!finished)
+	{
+		if (!m_pProcess->WaitForExit(500))
+		{
+			// We should do this only if the GUI process is stuck and
+			// don't answer to a normal termination command.
+			// This function is dangerous: dependant DLLs don't know the process
+			// is terminated, and memory isn't released.
+			m_pWrapper->_AddToolOutput(_T("\n> Forcefully terminating process...\n"));
+			m_pProcess->Terminate(1);
+		}
 	}
 
-	// read handle, write handle, security attributes,  number of bytes reserved for pipe - 0 default
-	
-	if (!::CreatePipe(&hStdInRead, &hStdInWrite, &sa, 0))
+	if (!m_pProcess->WaitForExit(1000))
 	{
-		CLastErrorInfo lei;
-
-		m_pWrapper->_AddToolOutput(_T("\n> Failed to create StdIn Pipe: "));
-		m_pWrapper->_AddToolOutput((LPCTSTR)lei);
-
-		return lei.GetErrorCode();
+		m_pWrapper->_AddToolOutput(_T("\n> Process failed to respond; forcing abrupt termination..."));
+		m_pProcess->Terminate(2);
+		m_pProcess->WaitForExit(1000);
 	}
 
-	::SetHandleInformation(hReadPipe, HANDLE_FLAG_INHERIT, 0);
-	::SetHandleInformation(hStdInWrite, HANDLE_FLAG_INHERIT, 0);
+	m_RetCode = m_pProcess->GetExitCode();
 
-	STARTUPINFO si;
-	memset(&si, 0, sizeof(STARTUPINFO));
-	si.cb = sizeof(STARTUPINFO);
-	si.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
-	si.wShowWindow = SW_HIDE;
-	si.hStdInput = hStdInRead;
-	si.hStdOutput = hWritePipe;
-	si.hStdError = hWritePipe;
-
-	PROCESS_INFORMATION pi = {0, 0, 0, 0};
-
-	DWORD dwCreationFlags = CREATE_NEW_CONSOLE; // CREATE_NEW_PROCESS_GROUP;
-
-	std::vector<TCHAR> cmdbuf(clopts.length() + 1);
-	memcpy(&cmdbuf[0], clopts.c_str(), clopts.size() * sizeof(TCHAR));
+	return m_RetCode;
+}
 
-	bool bCreated = ::CreateProcess(
-		NULL, 
-		&cmdbuf[0], 
-		&sa, /*LPSECURITY_ATTRIBUTES lpProcessAttributes*/
-		NULL, /*LPSECURITYATTRIBUTES lpThreadAttributes*/
-		TRUE, /*BOOL bInheritHandles*/ 
-		dwCreationFlags, /*DWORD dwCreationFlags*/
-		NULL, /*LPVOID lpEnvironment*/
-		dir, /*LPCTSTR lpWorkingDir*/
-		&si, /*LPSTARTUPINFO lpStartupInfo*/
-		&pi /*LPPROCESS_INFORMATION lpProcessInformation*/ 
-	) != 0;
+/**
+ * Called on the capture thread with output from the tool. Each stream only
+ * passes on whole lines, so that the output of tools running at the same
+ * time into one view doesn't get mixed up within a line.
+ */
+void ToolRunner::OnOutput(ToolProcess::EStream stream, const char* data, size_t length)
+{
+	std::string& partial = m_partial[stream == ToolProcess::tsError ? 1 : 0];
 
-	if (!bCreated)
+	size_t complete = length;
+	while (complete > 0 && data[complete - 1] != '\n')
 	{
-		::CloseHandle(hReadPipe);
-		::CloseHandle(hWritePipe);
-		::CloseHandle(hStdInRead);
-		::CloseHandle(hStdInWrite);
-
-		CLastErrorInfo lei;
-		m_pWrapper->_AddToolOutput(_T("\n> Failed to create process: "));
-		m_pWrapper->_AddToolOutput((LPCTSTR)lei);
-
-		return lei.GetErrorCode();
+		--complete;
 	}
 
-	unsigned int dwBytesToWrite;
-	unsigned char* stdinbuf;
-	stdinbuf = m_pWrapper->GetStdIOBuffer(dwBytesToWrite);
-	if (!dwBytesToWrite)
-		stdinbuf = NULL;
-
-	DWORD dwBytesAvail, dwBytesRead, exitCode, timeDeathDetected;
-	dwBytesAvail = dwBytesRead = exitCode = timeDeathDetected = 0;
-	DWORD dwBytesWritten = 0;
-	bool bCompleted = false;
-	BYTE buffer[TOOLS_BUFFER_SIZE];
-
-	while (!bCompleted)
+	if (complete == 0)
 	{
-		Sleep(50);
-
-		if (dwBytesToWrite > 0)
-		{
-			// We have a filter (we think), so write the filter data into the stdin
-			// of the process we started.
-			DWORD dwWrote;
-			::WriteFile(hStdInWrite, stdinbuf+dwBytesWritten, dwBytesToWrite, &dwWrote, NULL);
-			dwBytesWritten += dwWrote;
-			dwBytesToWrite -= dwWrote;
-			
-			if(dwBytesToWrite == 0)
-			{
-				// Now close stdin so that the filter doesn't wait forever for more data.
-				::CloseHandle(hStdInWrite);
-				hStdInWrite = NULL;
-			}
-		}
-
-		//The PeekNamedPipe function copies data from a named or 
-		// anonymous pipe into a buffer without removing it from the pipe.
-		if (!::PeekNamedPipe(hReadPipe, NULL, 0, NULL, &dwBytesAvail, NULL) )
-		{
-			dwBytesAvail = 0;
-		}
-
-		if (dwBytesAvail > 0)
-		{
-			BOOL bRead = ::ReadFile(hReadPipe, buffer, sizeof(buffer)-1, &dwBytesRead, NULL);
-			buffer[dwBytesRead] = NULL;
+		partial.append(data, length);
+		return;
+	}
 
-			if (bRead && dwBytesRead)
-			{
-				CA2CT conv(reinterpret_cast<const char*>(buffer));
-				m_pWrapper->_AddToolOutput(&conv[0], -1);
-			}
-			else
-			{
-				// Couldn't read from the pipe, must be finished...
-				bCompleted = true;
-			}
-		}
-		else
-		{
-			exitCode = STILL_ACTIVE;
+	if (partial.size())
+	{
+		partial.append(data, complete);
+		addOutput(partial.c_str(), partial.size());
+		partial.clear();
+	}
+	else
+	{
+		addOutput(data, complete);
+	}
 
-			// No data from the process, is it still active?
-			::GetExitCodeProcess(pi.hProcess, &exitCode);
-			if (STILL_ACTIVE != exitCode)
-			{
-				if (bWin9x)
-				{
-					// If we're running on Windows 9x then we give the
-					// process some time to return the remainder of its data.
-					// We wait until a pre-set amount of time has elapsed and
-					// then exit.
-
-					if (timeDeathDetected == 0)
-					{
-						timeDeathDetected = ::GetTickCount();
-					}
-					else
-					{
-						///@todo Get this value from the registry...
-						if ((::GetTickCount() - timeDeathDetected) > 500)
-						{
-							bCompleted = true;
-						}
-					}
-				}
-				else
-				{
-					// If NT, then the process is already dead.
-					bCompleted = true;
-				}
-			}
-		}
+	partial.append(data + complete, length - complete);
+}
 
-		// While we're here, we check to see if we've been told to close.
-		if (!GetCanRun())
+/**
+ * Pass on whatever the tool wrote without finishing the line.
+ */
+void ToolRunner::flushOutput()
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		if (m_partial[i].size())
 		{
-			if (WAIT_OBJECT_0 != ::WaitForSingleObject(pi.hProcess, 500)) 
-			{
-				// We should do this only if the GUI process is stuck and
-				// don't answer to a normal termination command.
-				// This function is dangerous: dependant DLLs don't know the process
-				// is terminated, and memory isn't released.
-				m_pWrapper->_AddToolOutput(_T("\n> Forcefully terminating process...\n"));
-				::TerminateProcess(pi.hProcess, 1);
-			}
-
-			bCompleted = true;
+			addOutput(m_partial[i].c_str(), m_partial[i].size());
+			m_partial[i].clear();
 		}
-	} // while (!bCompleted)
-
-	if (WAIT_OBJECT_0 != ::WaitForSingleObject(pi.hProcess, 1000)) 
-	{
-		m_pWrapper->_AddToolOutput(_T("\n> Process failed to respond; forcing abrupt termination..."));
-		::TerminateProcess(pi.hProcess, 2);
 	}
+}
 
-	::GetExitCodeProcess(pi.hProcess, &exitCode);
-
-	m_RetCode = exitCode;
-
-	::CloseHandle(pi.hProcess);
-	::CloseHandle(pi.hThread);
-	::CloseHandle(hReadPipe);
-	::CloseHandle(hWritePipe);
-	::CloseHandle(hStdInRead);
-	
-	if (hStdInWrite) // might already be closed
-		::CloseHandle(hStdInWrite);
-
-	return m_RetCode;
+void ToolRunner::addOutput(const char* data, size_t length)
+{
+	std::string text(data, length);
+	CA2CT conv(text.c_str());
+	m_pWrapper->_AddToolOutput(&conv[0], -1);
 }
 
 struct ShellErr 
@@ -411,6 +304,9 @@ int ToolRunner::Execute()
 	catch (FormatStringBuilderException&)
 	{
 		LOG(_T("FormatStringBuilderException building format string - user wants to cancel"));
+
+		// Nothing ran, so nothing that comes after this should either:
+		m_RetCode = -1;
 		return 0;
 	}
 
@@ -463,9 +359,59 @@ void ToolRunner::PostRun()
 // ToolOwner
 //////////////////////////////////////////////////////////////////////////////
 
-ToolOwner::ToolOwner()
+/**
+ * Runs a tool that captures output once the scheduler gets to it.
+ */
+class ToolOwner::RunnerJob : public ToolJob
+{
+	public:
+		RunnerJob(ToolOwner* pOwner, ToolRunner* pRunner, ToolWrapper* pWrapper) :
+			m_pOwner(pOwner),
+			m_pRunner(pRunner),
+			m_pWrapper(pWrapper)
+		{
+			m_key = pWrapper->Name + _T('|') + pWrapper->Command + _T('|') + pWrapper->Params + _T('|') + pWrapper->Folder;
+		}
+
+		virtual void Start()
+		{
+			m_pOwner->saveDocuments(m_pWrapper);
+
+			if (!m_pRunner->Execute())
+			{
+				m_pOwner->MarkToolForDeletion(m_pRunner);
+			}
+		}
+
+		virtual void Cancel()
+		{
+			m_pRunner->Cancel();
+		}
+
+		virtual void OnDropped()
+		{
+			m_pWrapper->SetRunning(false);
+			m_pOwner->MarkToolForDeletion(m_pRunner);
+		}
+
+		virtual tstring GetKey() const
+		{
+			return m_key;
+		}
+
+	private:
+		ToolOwner* m_pOwner;
+		ToolRunner* m_pRunner;
+		ToolWrapper* m_pWrapper;
+		tstring m_key;
+};
+
+ToolOwner::ToolOwner() :
+	m_scheduler(static_cast<size_t>(max(0, OPTIONS->Get(PNSK_GENERAL, _T("MaxRunningTools"), 0))))
 {
 	::InitializeCriticalSection(&m_crRunningTools);
+
+	m_scheduler.SetDispatchHandler(boost::bind(&ToolOwner::requestDispatch, this));
 }
 
 ToolOwner::~ToolOwner()
@@ -474,10 +420,14 @@ ToolOwner::~ToolOwner()
 }
 
 /**
+ * Tools that capture output are queued, and start once there's room for them
+ * and any tool they come after has succeeded.
  * @param pTool ToolWrapper instance to be orphaned to ToolOwner.
  * @param OwnerID Unique Identifier for the owning object - use "this".
+ * @param after Job id of a tool that must succeed before this one runs, or 0.
+ * @return Job id to run other tools after, 0 if the tool wasn't queued.
  */
-void ToolOwner::RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID)
+ToolScheduler::JobID ToolOwner::RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID, ToolScheduler::JobID after)
 {
 	_ToolWrapper _wrapper = {0};
 	_wrapper.OwnerID = OwnerID;
@@ -485,6 +435,13 @@ void ToolOwner::RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID)
 	_wrapper.pRunner = new ToolRunner( pTool.get() );
 
 	bool bThreaded = _wrapper.pRunner->GetThreadedExecution();
+
+	// Text filters change the document while the caller waits, so they can't queue:
+	bool bQueued = bThreaded && !pTool->IsTextFilter();
+	if( bQueued )
+	{
+		_wrapper.pJob.reset(new RunnerJob(this, _wrapper.pRunner, pTool.get()));
+	}
 	
 	if( bThreaded )
 	{
@@ -493,32 +450,12 @@ void ToolOwner::RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID)
 		m_RunningTools.push_back(_wrapper);	 // Add this tool to our list to mind.
 	}
 
-	if(pTool->SaveAll())
+	if( bQueued )
 	{
-		g_Context.m_frame->SaveAll();
+		return m_scheduler.Submit(_wrapper.pJob, OwnerID, after);
 	}
-	else if(pTool->SaveProjectGroup())
-	{
-		DocumentList list;
-		g_Context.m_frame->GetOpenWorkspaceDocuments(list);
 
-		for (DocumentList::iterator i = list.begin(); i != list.end(); ++i)
-		{
-			CChildFrame* frame = (*i)->GetFrame();
-			if (frame != NULL && frame->GetModified())
-			{
-				frame->Save(true); // save and notify change
-			}
-		}
-	}
-	else if (pTool->SaveOne())
-	{
-		CChildFrame* pChild = pTool->GetActiveChild();
-		if (pChild && pChild->GetModified())
-		{
-			pChild->Save(true); // save and notify change
-		}
-	}
+	saveDocuments(pTool.get());
 
 	if (!_wrapper.pRunner->Execute() && bThreaded)
 	{
@@ -533,6 +470,16 @@ void ToolOwner::RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID)
 
 	///@todo
 	//pT->UpdateRunningTools();
+
+	return 0;
+}
+
+/**
+ * Start any queued tools that can run now.
+ */
+void ToolOwner::RunQueuedTools()
+{
+	m_scheduler.Dispatch();
 }
 
 /**
@@ -541,19 +488,32 @@ void ToolOwner::RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID)
  */
 void ToolOwner::MarkToolForDeletion(ToolRunner* pRunningTool)
 {
-	CSSCritLock lock(&m_crRunningTools);
+	ToolJobPtr job;
+	bool succeeded(false);
 
-	for(RTOOLS_LIST::iterator i = m_RunningTools.begin();
-		i != m_RunningTools.end();
-		++i)
 	{
-		_ToolWrapper& tool = (*i);
-		if(tool.pRunner == pRunningTool)
+		CSSCritLock lock(&m_crRunningTools);
+
+		for(RTOOLS_LIST::iterator i = m_RunningTools.begin();
+			i != m_RunningTools.end();
+			++i)
 		{
-			tool.bDelete = true;
-			break;
+			_ToolWrapper& tool = (*i);
+			if(tool.pRunner == pRunningTool)
+			{
+				tool.bDelete = true;
+				job = tool.pJob;
+				succeeded = pRunningTool->GetExitCode() == 0;
+				break;
+			}
 		}
 	}
+
+	// Outside the lock, this can lead to the next tool being started:
+	if (job.get() != NULL)
+	{
+		m_scheduler.Finished(job.get(), succeeded);
+	}
 }
 
 /**
@@ -605,10 +565,55 @@ void ToolOwner::cleanup()
 	}
 }
 
+/**
+ * Save the documents a tool wants saved before it runs.
+ */
+void ToolOwner::saveDocuments(ToolWrapper* pTool)
+{
+	if(pTool->SaveAll())
+	{
+		g_Context.m_frame->SaveAll();
+	}
+	else if(pTool->SaveProjectGroup())
+	{
+		DocumentList list;
+		g_Context.m_frame->GetOpenWorkspaceDocuments(list);
+
+		for (DocumentList::iterator i = list.begin(); i != list.end(); ++i)
+		{
+			CChildFrame* frame = (*i)->GetFrame();
+			if (frame != NULL && frame->GetModified())
+			{
+				frame->Save(true); // save and notify change
+			}
+		}
+	}
+	else if (pTool->SaveOne())
+	{
+		CChildFrame* pChild = pTool->GetActiveChild();
+		if (pChild && pChild->GetModified())
+		{
+			pChild->Save(true); // save and notify change
+		}
+	}
+}
+
+/**
+ * Tools finish on their own threads, the next ones are started on the UI
+ * thread where their command lines are built.
+ */
+void ToolOwner::requestDispatch()
+{
+	g_Context.m_frame->GetWindow()->PostMessage(PN_RUNQUEUEDTOOLS);
+}
+
 void ToolOwner::KillTools(bool bWaitForKill, ToolOwnerID OwnerID)
 {
 	int iLoopCount = 0;
 
+	// Forget queued tools, and cancel the ones the scheduler started:
+	m_scheduler.Cancel(OwnerID);
+
 	// Signal to all tools to exit, scope to enter and exit critical section
 	{
 		CSSCritLock lock(&m_crRunningTools);
@@ -619,7 +624,7 @@ void ToolOwner::KillTools(bool bWaitForKill, ToolOwnerID OwnerID)
 		{
 			_ToolWrapper& tool = (*i);
 			if(OwnerID == 0 || tool.OwnerID == OwnerID)
-				tool.pRunner->SetCanRun(false);
+				tool.pRunner->Cancel();
 		}
 	}
 
@@ -11,8 +11,7 @@
 #define toolrunner_h__included
 
 #include "include/ssthreads.h"
-
-#define TOOLS_BUFFER_SIZE 16384
+#include "toolprocess.h"
 
 // Predeclarations:
 class ToolWrapper;
@@ -20,7 +19,7 @@ class ToolWrapper;
 /**
  * Class to run external tools.
  */
-class ToolRunner : public CSSThread
+class ToolRunner : public CSSThread, IToolProcessSink
 {
 public:
 	ToolRunner(ToolWrapper* pWrapper);
@@ -30,6 +29,13 @@ public:
 
 	bool GetThreadedExecution();
 
+	/**
+	 * Stop a running tool, the capture thread wakes up straight away.
+	 */
+	void Cancel();
+
+	int GetExitCode();
+
 	ToolRunner* m_pNext;
 
 protected:
@@ -39,13 +45,19 @@ protected:
 	virtual void Run();
 	virtual void OnException();
 
-	int GetExitCode();
+	virtual void OnOutput(ToolProcess::EStream stream, const char* data, size_t length);
+
+	void addOutput(const char* data, size_t length);
+	void flushOutput();
 	void PostRun();
 
 protected:
 	ToolWrapper*		m_pWrapper;
+	ToolProcess*		m_pProcess;
 	int					m_RetCode;
 	time_t				m_starttime;
+	/// Output after the last complete line of each stream
+	std::string			m_partial[2];
 };
 
 #endif //#ifndef toolrunner_h__included
\ No newline at end of file
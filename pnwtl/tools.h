@@ -11,6 +11,7 @@
 #define tools_h__included
 
 #include "include/threading.h"
+#include "toolscheduler.h"
 
 // Predeclares:
 
@@ -24,10 +25,6 @@ namespace Projects
 	class Project;
 }
 
-// Typedefs:
-
-typedef void* ToolOwnerID;
-
 // Classes:
 
 class ToolSource
@@ -301,13 +298,18 @@ typedef boost::shared_ptr<ToolWrapper> ToolWrapperPtr;
  * To run a tool, the caller must orphan a ToolWrapper instance to the
  * ToolOwner class. This class is then used to provide access to the 
  * methods necessary for a tool to be run with output capturing etc.
+ *
+ * Tools that capture output are queued with a ToolScheduler, so only a
+ * few run at once and each owner's tools run one after the other.
  */
 class ToolOwner : public Singleton<ToolOwner, SINGLETON_AUTO_DELETE>
 {
 	friend class Singleton<ToolOwner, SINGLETON_AUTO_DELETE>;
 
 	public:
-		void RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID);
+		ToolScheduler::JobID RunTool(ToolWrapperPtr& pTool, ToolOwnerID OwnerID, ToolScheduler::JobID after = 0);
+
+		void RunQueuedTools();
 
 		void KillTools(bool bWaitForKill, ToolOwnerID OwnerID = 0);
 
@@ -319,6 +321,8 @@ class ToolOwner : public Singleton<ToolOwner, SINGLETON_AUTO_DELETE>
 		ToolOwner();
 		~ToolOwner();
 
+		class RunnerJob;
+
 		struct _ToolWrapper
 		{
 			ToolOwnerID		OwnerID;
@@ -326,16 +330,21 @@ class ToolOwner : public Singleton<ToolOwner, SINGLETON_AUTO_DELETE>
 			bool			bDelete;
 
 			ToolWrapperPtr pWrapper;
+			/// Set for tools run through the scheduler
+			ToolJobPtr pJob;
 		};
 
 		typedef std::list<_ToolWrapper>	RTOOLS_LIST;
 
 		void cleanup();
+		void saveDocuments(ToolWrapper* pTool);
+		void requestDispatch();
 
 	protected:
 		CRITICAL_SECTION	m_crRunningTools;
 		RTOOLS_LIST			m_RunningTools;
 		ToolRunner*			m_pFirstTool;
+		ToolScheduler		m_scheduler;
 };
 
 #endif
\ No newline at end of file
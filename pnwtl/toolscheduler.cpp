@@ -0,0 +1,304 @@
+/**
+ * @file toolscheduler.cpp
+ * @brief Decide when queued tool jobs get to run.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "toolscheduler.h"
+
+#include <set>
+
+using pnutils::threading::CritLock;
+
+/// Results of finished jobs we remember for jobs queued after them
+#define TOOLSCHEDULER_MAX_RESULTS 256
+
+ToolScheduler::ToolScheduler(size_t maxRunning) :
+	m_nextID(1),
+	m_maxRunning(maxRunning != 0 ? maxRunning : GetProcessorCount()),
+	m_running(0)
+{
+}
+
+ToolScheduler::~ToolScheduler()
+{
+}
+
+void ToolScheduler::SetDispatchHandler(DispatchHandler handler)
+{
+	CritLock lock(m_cs);
+	m_dispatchHandler = handler;
+}
+
+ToolScheduler::JobID ToolScheduler::Submit(ToolJobPtr job, ToolOwnerID owner, JobID after)
+{
+	JobID id(0);
+	bool duplicate(false);
+
+	{
+		CritLock lock(m_cs);
+
+		// Something identical waiting to start will do the same work:
+		for (ENTRIES::const_iterator i = m_entries.begin(); i != m_entries.end(); ++i)
+		{
+			if (!(*i).Running && (*i).Owner == owner && (*i).After == after && (*i).Job->GetKey() == job->GetKey())
+			{
+				id = (*i).ID;
+				duplicate = true;
+				break;
+			}
+		}
+
+		if (!duplicate)
+		{
+			Entry entry;
+			entry.ID = id = m_nextID++;
+			entry.Owner = owner;
+			entry.After = after;
+			entry.Running = false;
+			entry.Job = job;
+			m_entries.push_back(entry);
+		}
+	}
+
+	if (duplicate)
+	{
+		job->OnDropped();
+	}
+	else
+	{
+		Dispatch();
+	}
+
+	return id;
+}
+
+void ToolScheduler::Dispatch()
+{
+	JOBS toStart, toDrop;
+
+	{
+		CritLock lock(m_cs);
+		collect(toStart, toDrop);
+	}
+
+	run(toStart, toDrop);
+}
+
+void ToolScheduler::Finished(ToolJob* job, bool succeeded)
+{
+	DispatchHandler handler;
+	bool found(false);
+
+	{
+		CritLock lock(m_cs);
+
+		for (ENTRIES::iterator i = m_entries.begin(); i != m_entries.end(); ++i)
+		{
+			if ((*i).Job.get() == job)
+			{
+				if ((*i).Running)
+				{
+					--m_running;
+				}
+
+				recordResult((*i).ID, succeeded);
+				m_entries.erase(i);
+				found = true;
+				break;
+			}
+		}
+
+		handler = m_dispatchHandler;
+	}
+
+	// Dropped, or already reported finished:
+	if (!found)
+	{
+		return;
+	}
+
+	if (handler)
+	{
+		handler();
+	}
+	else
+	{
+		Dispatch();
+	}
+}
+
+void ToolScheduler::Cancel(ToolOwnerID owner)
+{
+	JOBS toCancel, toDrop;
+
+	{
+		CritLock lock(m_cs);
+
+		ENTRIES::iterator i = m_entries.begin();
+		while (i != m_entries.end())
+		{
+			if (owner != 0 && (*i).Owner != owner)
+			{
+				++i;
+			}
+			else if ((*i).Running)
+			{
+				toCancel.push_back((*i).Job);
+				++i;
+			}
+			else
+			{
+				toDrop.push_back((*i).Job);
+				recordResult((*i).ID, false);
+				i = m_entries.erase(i);
+			}
+		}
+	}
+
+	for (JOBS::iterator j = toDrop.begin(); j != toDrop.end(); ++j)
+	{
+		(*j)->OnDropped();
+	}
+
+	for (JOBS::iterator j = toCancel.begin(); j != toCancel.end(); ++j)
+	{
+		(*j)->Cancel();
+	}
+
+	// Jobs of other owners that came after the ones we dropped go too:
+	Dispatch();
+}
+
+bool ToolScheduler::IsBusy(ToolOwnerID owner)
+{
+	CritLock lock(m_cs);
+
+	for (ENTRIES::const_iterator i = m_entries.begin(); i != m_entries.end(); ++i)
+	{
+		if (owner == 0 || (*i).Owner == owner)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+size_t ToolScheduler::GetRunningCount()
+{
+	CritLock lock(m_cs);
+	return m_running;
+}
+
+size_t ToolScheduler::GetMaxRunning() const
+{
+	return m_maxRunning;
+}
+
+size_t ToolScheduler::GetProcessorCount()
+{
+	SYSTEM_INFO info;
+	::GetSystemInfo(&info);
+
+	return info.dwNumberOfProcessors > 0 ? static_cast<size_t>(info.dwNumberOfProcessors) : 1;
+}
+
+/**
+ * Call with the lock held. Picks the jobs to start and the jobs to drop,
+ * the caller starts and drops them once the lock is released.
+ */
+void ToolScheduler::collect(JOBS& toStart, JOBS& toDrop)
+{
+	// Owners with a job running, or an earlier one still waiting:
+	std::set<ToolOwnerID> busyOwners;
+	for (ENTRIES::const_iterator i = m_entries.begin(); i != m_entries.end(); ++i)
+	{
+		if ((*i).Running)
+		{
+			busyOwners.insert((*i).Owner);
+		}
+	}
+
+	ENTRIES::iterator i = m_entries.begin();
+	while (i != m_entries.end())
+	{
+		Entry& entry = *i;
+
+		if (entry.Running || busyOwners.find(entry.Owner) != busyOwners.end())
+		{
+			++i;
+			continue;
+		}
+
+		if (entry.After != 0)
+		{
+			bool waiting(false);
+			for (ENTRIES::const_iterator j = m_entries.begin(); j != m_entries.end(); ++j)
+			{
+				if ((*j).ID == entry.After)
+				{
+					waiting = true;
+					break;
+				}
+			}
+
+			if (waiting)
+			{
+				busyOwners.insert(entry.Owner);
+				++i;
+				continue;
+			}
+
+			// A result we've forgotten was long enough ago not to matter:
+			RESULTS::const_iterator result = m_results.find(entry.After);
+			if (result != m_results.end() && !(*result).second)
+			{
+				// Jobs queued after this one are dropped later in this loop:
+				toDrop.push_back(entry.Job);
+				recordResult(entry.ID, false);
+				i = m_entries.erase(i);
+				continue;
+			}
+		}
+
+		busyOwners.insert(entry.Owner);
+
+		if (m_running < m_maxRunning)
+		{
+			entry.Running = true;
+			++m_running;
+			toStart.push_back(entry.Job);
+		}
+
+		++i;
+	}
+}
+
+void ToolScheduler::recordResult(JobID id, bool succeeded)
+{
+	m_results[id] = succeeded;
+
+	while (m_results.size() > TOOLSCHEDULER_MAX_RESULTS)
+	{
+		m_results.erase(m_results.begin());
+	}
+}
+
+void ToolScheduler::run(JOBS& toStart, JOBS& toDrop)
+{
+	for (JOBS::iterator i = toDrop.begin(); i != toDrop.end(); ++i)
+	{
+		(*i)->OnDropped();
+	}
+
+	for (JOBS::iterator i = toStart.begin(); i != toStart.end(); ++i)
+	{
+		(*i)->Start();
+	}
+}
@@ -0,0 +1,150 @@
+/**
+ * @file toolscheduler.h
+ * @brief Decide when queued tool jobs get to run.
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef toolscheduler_h__included
+#define toolscheduler_h__included
+
+#include <boost/function.hpp>
+#include <list>
+#include <map>
+
+#include "include/threading.h"
+
+typedef void* ToolOwnerID;
+
+class ToolScheduler;
+
+/**
+ * Something the scheduler runs, normally a tool with captured output.
+ */
+class ToolJob
+{
+	public:
+		virtual ~ToolJob() {}
+
+		/**
+		 * Start running. The job must call ToolScheduler::Finished when it's
+		 * done, from any thread, which may be before Start returns.
+		 */
+		virtual void Start() = 0;
+
+		/**
+		 * Ask a running job to stop, it still calls Finished.
+		 */
+		virtual void Cancel() = 0;
+
+		/**
+		 * Called instead of Start for a job that will never run: a duplicate,
+		 * one that depended on a job that failed, or one cancelled while queued.
+		 */
+		virtual void OnDropped() {}
+
+		/**
+		 * Queued jobs for the same owner with the same key are duplicates.
+		 */
+		virtual tstring GetKey() const = 0;
+};
+
+typedef boost::shared_ptr<ToolJob> ToolJobPtr;
+
+/**
+ * Runs jobs in the order they're queued, subject to:
+ *  - at most a fixed number of jobs running at once;
+ *  - one job at a time for each owner;
+ *  - a job that comes after another only runs if that one succeeded.
+ * A job queued while an identical one for the same owner is still waiting
+ * to start is dropped.
+ *
+ * Jobs are started from Submit and Dispatch, and from Finished unless a
+ * dispatch handler has been set to move that onto another thread.
+ */
+class ToolScheduler
+{
+	public:
+		typedef unsigned int JobID;
+		typedef boost::function<void ()> DispatchHandler;
+
+		/**
+		 * @param maxRunning Jobs allowed to run at once, 0 for the number of processors
+		 */
+		explicit ToolScheduler(size_t maxRunning = 0);
+		~ToolScheduler();
+
+		/**
+		 * Called when a finished job has made room for others to start,
+		 * instead of starting them on the thread that called Finished.
+		 * The handler should arrange for Dispatch to be called.
+		 */
+		void SetDispatchHandler(DispatchHandler handler);
+
+		/**
+		 * Queue a job and start it if it can run now.
+		 * @param after Only run once this job has succeeded, 0 for no dependency
+		 * @return id of the job, or of the queued duplicate the job was dropped for
+		 */
+		JobID Submit(ToolJobPtr job, ToolOwnerID owner, JobID after = 0);
+
+		/**
+		 * Start any queued jobs that can run.
+		 */
+		void Dispatch();
+
+		/**
+		 * A job that was started has finished. Jobs the scheduler doesn't
+		 * know about, such as ones that were dropped, are ignored.
+		 */
+		void Finished(ToolJob* job, bool succeeded);
+
+		/**
+		 * Drop queued jobs and cancel running ones for owner, or for all owners
+		 * if owner is 0.
+		 */
+		void Cancel(ToolOwnerID owner = 0);
+
+		/**
+		 * @return true if any jobs for owner are queued or running
+		 */
+		bool IsBusy(ToolOwnerID owner = 0);
+
+		size_t GetRunningCount();
+		size_t GetMaxRunning() const;
+
+		static size_t GetProcessorCount();
+
+	private:
+		class Entry
+		{
+			public:
+				JobID ID;
+				ToolOwnerID Owner;
+				JobID After;
+				bool Running;
+				ToolJobPtr Job;
+		};
+
+		typedef std::list<Entry> ENTRIES;
+		typedef std::list<ToolJobPtr> JOBS;
+		/// How finished jobs went, for the jobs that come after them
+		typedef std::map<JobID, bool> RESULTS;
+
+		void collect(JOBS& toStart, JOBS& toDrop);
+		void recordResult(JobID id, bool succeeded);
+		void run(JOBS& toStart, JOBS& toDrop);
+
+		ENTRIES m_entries;
+		RESULTS m_results;
+		JobID m_nextID;
+		size_t m_maxRunning;
+		size_t m_running;
+		DispatchHandler m_dispatchHandler;
+		pnutils::threading::CriticalSection m_cs;
+};
+
+#endif // #ifndef toolscheduler_h__included
@@ -0,0 +1,329 @@
+/**
+ * @file tracing.cpp
+ * @brief Timed spans, exported as Chrome trace events
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#include "stdafx.h"
+#include "tracing.h"
+#include "include/threading.h"
+#include "Files.h"
+
+#include <algorithm>
+
+using pnutils::threading::CriticalSection;
+using pnutils::threading::CritLock;
+
+typedef boost::shared_ptr<ThreadTrace> ThreadTracePtr;
+
+namespace {
+
+/// Every thread that has recorded, kept after the thread exits so its
+/// events can still be written
+std::vector<ThreadTracePtr> s_threads;
+CriticalSection s_threadsLock;
+int s_capacity = Tracer::DefaultCapacity;
+
+/// Timestamps in the trace are relative to process start
+LONGLONG s_origin = Tracer::Now();
+double s_ticksPerMicrosecond = 0.0;
+
+__declspec(thread) ThreadTrace* t_trace = NULL;
+
+int roundUpToPowerOfTwo(int value)
+{
+	int result = 1;
+	while (result < value)
+	{
+		result <<= 1;
+	}
+
+	return result;
+}
+
+/**
+ * Parents start no later than their children and end no earlier, so
+ * this puts them first and keeps the trace viewers happy.
+ */
+bool startsFirst(const TraceEvent& left, const TraceEvent& right)
+{
+	if (left.Start != right.Start)
+	{
+		return left.Start < right.Start;
+	}
+
+	return left.End > right.End;
+}
+
+void appendString(std::string& json, const char* value)
+{
+	json += '"';
+	for (const char* p = value; *p; ++p)
+	{
+		unsigned char c = static_cast<unsigned char>(*p);
+		if (c == '"' || c == '\\')
+		{
+			json += '\\';
+			json += *p;
+		}
+		else if (c < 0x20)
+		{
+			char escaped[8];
+			_snprintf(escaped, 8, "\\u%04x", c);
+			escaped[7] = 0;
+			json += escaped;
+		}
+		else
+		{
+			json += *p;
+		}
+	}
+	json += '"';
+}
+
+void appendFormat(std::string& json, const char* format, ...)
+{
+	char buf[64];
+
+	va_list args;
+	va_start(args, format);
+	_vsnprintf(buf, 64, format, args);
+	va_end(args);
+
+	buf[63] = 0;
+	json += buf;
+}
+
+double toMicroseconds(LONGLONG ticks)
+{
+	if (s_ticksPerMicrosecond == 0.0)
+	{
+		LARGE_INTEGER frequency;
+		::QueryPerformanceFrequency(&frequency);
+		s_ticksPerMicrosecond = static_cast<double>(frequency.QuadPart) / 1000000.0;
+	}
+
+	return static_cast<double>(ticks) / s_ticksPerMicrosecond;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// ThreadTrace
+
+ThreadTrace::ThreadTrace(DWORD threadId, int capacity) :
+	m_capacity(roundUpToPowerOfTwo(capacity)),
+	m_threadId(threadId),
+	m_name(NULL),
+	m_added(0),
+	m_taken(0),
+	m_dropped(0)
+{
+}
+
+bool ThreadTrace::Add(const TraceEvent& ev)
+{
+	LONG added = m_added;
+	if (static_cast<ULONG>(added - m_taken) >= static_cast<ULONG>(m_capacity))
+	{
+		::InterlockedIncrement(&m_dropped);
+		return false;
+	}
+
+	if (m_events.empty())
+	{
+		m_events.resize(m_capacity);
+	}
+
+	m_events[added & (m_capacity - 1)] = ev;
+
+	// Publish the event, Take won't look at it before this:
+	::InterlockedExchange(&m_added, added + 1);
+
+	return true;
+}
+
+void ThreadTrace::SetName(const char* name)
+{
+	m_name = name;
+}
+
+void ThreadTrace::Take(std::vector<TraceEvent>& events)
+{
+	LONG added = m_added;
+	LONG taken = m_taken;
+
+	for (; taken != added; ++taken)
+	{
+		events.push_back(m_events[taken & (m_capacity - 1)]);
+		events.back().ThreadId = m_threadId;
+	}
+
+	// Hand the space back to Add:
+	::InterlockedExchange(&m_taken, taken);
+}
+
+DWORD ThreadTrace::GetThreadId() const
+{
+	return m_threadId;
+}
+
+const char* ThreadTrace::GetName() const
+{
+	return m_name;
+}
+
+int ThreadTrace::GetDropped() const
+{
+	return m_dropped;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tracer
+
+volatile bool Tracer::s_enabled = false;
+
+void Tracer::Enable(bool enable)
+{
+	s_enabled = enable;
+}
+
+void Tracer::SetCapacity(int capacity)
+{
+	s_capacity = capacity;
+}
+
+LONGLONG Tracer::Now()
+{
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+void Tracer::Record(const char* category, const char* name, LONGLONG start, LONGLONG end)
+{
+	TraceEvent ev = { category, name, start, end, 0 };
+	threadTrace()->Add(ev);
+}
+
+void Tracer::SetThreadName(const char* name)
+{
+	if (!s_enabled)
+	{
+		return;
+	}
+
+	threadTrace()->SetName(name);
+}
+
+void Tracer::Take(std::vector<TraceEvent>& events)
+{
+	{
+		CritLock lock(s_threadsLock);
+		for (std::vector<ThreadTracePtr>::const_iterator i = s_threads.begin(); i != s_threads.end(); ++i)
+		{
+			(*i)->Take(events);
+		}
+	}
+
+	std::sort(events.begin(), events.end(), startsFirst);
+}
+
+int Tracer::GetDropped()
+{
+	CritLock lock(s_threadsLock);
+
+	int dropped = 0;
+	for (std::vector<ThreadTracePtr>::const_iterator i = s_threads.begin(); i != s_threads.end(); ++i)
+	{
+		dropped += (*i)->GetDropped();
+	}
+
+	return dropped;
+}
+
+void Tracer::WriteChromeTrace(std::string& json)
+{
+	std::vector<TraceEvent> events;
+	Take(events);
+
+	json = "{\"traceEvents\":[";
+	bool first = true;
+
+	{
+		CritLock lock(s_threadsLock);
+		for (std::vector<ThreadTracePtr>::const_iterator i = s_threads.begin(); i != s_threads.end(); ++i)
+		{
+			if ((*i)->GetName() == NULL)
+			{
+				continue;
+			}
+
+			json += first ? "\n" : ",\n";
+			first = false;
+
+			json += "{\"name\":\"thread_name\",\"ph\":\"M\",";
+			appendFormat(json, "\"pid\":1,\"tid\":%lu", (*i)->GetThreadId());
+			json += ",\"args\":{\"name\":";
+			appendString(json, (*i)->GetName());
+			json += "}}";
+		}
+	}
+
+	for (std::vector<TraceEvent>::const_iterator i = events.begin(); i != events.end(); ++i)
+	{
+		json += first ? "\n" : ",\n";
+		first = false;
+
+		json += "{\"cat\":";
+		appendString(json, (*i).Category);
+		json += ",\"name\":";
+		appendString(json, (*i).Name);
+		json += ",\"ph\":\"X\",";
+		appendFormat(json, "\"pid\":1,\"tid\":%lu", (*i).ThreadId);
+		appendFormat(json, ",\"ts\":%.3f", toMicroseconds((*i).Start - s_origin));
+		appendFormat(json, ",\"dur\":%.3f}", toMicroseconds((*i).End - (*i).Start));
+	}
+
+	json += "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":";
+	appendFormat(json, "%d", GetDropped());
+	json += "}}\n";
+}
+
+bool Tracer::WriteChromeTrace(LPCTSTR filename)
+{
+	std::string json;
+	WriteChromeTrace(json);
+
+	CFile file;
+	if (!file.Open(filename, CFile::modeWrite | CFile::modeBinary))
+	{
+		return false;
+	}
+
+	file.Write(const_cast<char*>(json.c_str()), static_cast<UINT>(json.size()));
+	file.Close();
+
+	return true;
+}
+
+/**
+ * The calling thread's buffer, made the first time the thread records.
+ */
+ThreadTrace* Tracer::threadTrace()
+{
+	if (t_trace == NULL)
+	{
+		ThreadTracePtr trace(new ThreadTrace(::GetCurrentThreadId(), s_capacity));
+
+		CritLock lock(s_threadsLock);
+		s_threads.push_back(trace);
+		t_trace = trace.get();
+	}
+
+	return t_trace;
+}
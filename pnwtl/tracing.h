@@ -0,0 +1,156 @@
+/**
+ * @file tracing.h
+ * @brief Timed spans, exported as Chrome trace events
+ * @author Simon Steele
+ * @note Copyright (c) 2011 Simon Steele - http://untidy.net/
+ *
+ * Programmer's Notepad 2 : The license file (license.[txt|html]) describes
+ * the conditions under which this source may be modified / distributed.
+ */
+
+#ifndef tracing_h__included
+#define tracing_h__included
+
+#include <vector>
+#include <string>
+
+/**
+ * One finished span. Names and categories must be string literals, or
+ * otherwise live for as long as the process, they're never copied.
+ */
+struct TraceEvent
+{
+	const char* Category;
+	const char* Name;
+	/// Ticks of the performance counter
+	LONGLONG Start;
+	LONGLONG End;
+	/// Filled in when the event is taken from its thread
+	DWORD ThreadId;
+};
+
+/**
+ * The events recorded by one thread. Only the owning thread adds events
+ * and only Tracer takes them, so the two sides share nothing but a pair
+ * of counters and need no lock.
+ */
+class ThreadTrace
+{
+public:
+	ThreadTrace(DWORD threadId, int capacity);
+
+	/// Owning thread only, returns false and counts a drop when full
+	bool Add(const TraceEvent& ev);
+
+	/// Owning thread only
+	void SetName(const char* name);
+
+	/// Move everything recorded so far to the end of events
+	void Take(std::vector<TraceEvent>& events);
+
+	DWORD GetThreadId() const;
+	const char* GetName() const;
+	int GetDropped() const;
+
+private:
+	/// Allocated by the first Add, threads that never record cost nothing
+	std::vector<TraceEvent> m_events;
+	LONG m_capacity;
+	DWORD m_threadId;
+	const char* m_name;
+	/// Only ever increase, positions are these masked by capacity - 1
+	volatile LONG m_added;
+	volatile LONG m_taken;
+	volatile LONG m_dropped;
+};
+
+/**
+ * Collects spans from every thread and writes them out in the Chrome
+ * trace event format, for chrome://tracing or any of its descendants.
+ *
+ * Tracing is compiled into every build and costs one flag test per span
+ * while it is turned off. Each thread gets its own buffer the first time
+ * it records anything, a full buffer drops new spans until the next Take.
+ */
+class Tracer
+{
+public:
+	enum { DefaultCapacity = 16384 };
+
+	static void Enable(bool enable);
+
+	static bool IsEnabled()
+	{
+		return s_enabled;
+	}
+
+	/// Per-thread buffer size for threads that start recording after this,
+	/// rounded up to a power of two
+	static void SetCapacity(int capacity);
+
+	/// High resolution timestamp in performance counter ticks
+	static LONGLONG Now();
+
+	static void Record(const char* category, const char* name, LONGLONG start, LONGLONG end);
+
+	/// Name the calling thread in the trace, name must be a literal. Does
+	/// nothing while tracing is off.
+	static void SetThreadName(const char* name);
+
+	/// Remove and return every event recorded so far, ordered by start time
+	static void Take(std::vector<TraceEvent>& events);
+
+	/// Spans lost to full buffers since the process started
+	static int GetDropped();
+
+	/// Remove every event recorded so far and format them as a trace
+	static void WriteChromeTrace(std::string& json);
+	static bool WriteChromeTrace(LPCTSTR filename);
+
+private:
+	static ThreadTrace* threadTrace();
+
+	static volatile bool s_enabled;
+};
+
+/**
+ * Times its own lifetime, declare one with PNTRACE_SPAN at the top of
+ * the block to be measured.
+ */
+class TraceSpan
+{
+public:
+	TraceSpan(const char* category, const char* name) : m_name(NULL)
+	{
+		if (Tracer::IsEnabled())
+		{
+			m_category = category;
+			m_name = name;
+			m_start = Tracer::Now();
+		}
+	}
+
+	~TraceSpan()
+	{
+		if (m_name != NULL)
+		{
+			Tracer::Record(m_category, m_name, m_start, Tracer::Now());
+		}
+	}
+
+private:
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator=(const TraceSpan&);
+
+	const char* m_category;
+	const char* m_name;
+	LONGLONG m_start;
+};
+
+#define PNTRACE_CONCAT2(a, b) a##b
+#define PNTRACE_CONCAT(a, b) PNTRACE_CONCAT2(a, b)
+
+/// Time the rest of the enclosing block as name, in category
+#define PNTRACE_SPAN(category, name) TraceSpan PNTRACE_CONCAT(traceSpan_, __LINE__)(category, name)
+
+#endif // #ifndef tracing_h__included
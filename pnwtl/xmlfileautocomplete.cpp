@@ -195,9 +195,7 @@ XmlFileAutocompleteProvider::XmlFileAutocompleteProvider(LPCTSTR apiFile)
 {
 	try
 	{
-#ifdef _DEBUG
-		OpTimer timer;
-#endif
+		PNTRACE_SPAN("autocomplete", "XmlFileAutocompleteProvider::Load");
 
 		XMLParser parser;
 		ParseHandler handler(m_tags);
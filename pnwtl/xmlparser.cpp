@@ -153,10 +153,7 @@ bool XMLParser::LoadFile(LPCTSTR filename)
 
 	bool bRet = true;
 
-	if(m_szFilename != NULL)
-		delete [] m_szFilename;
-	m_szFilename = new TCHAR[_tcslen(filename)+1];
-	_tcscpy(m_szFilename, filename);
+	setFileName(filename);
 
 	CFile file;
 	if(!file.Open(m_szFilename, 0))
@@ -184,11 +181,48 @@ bool XMLParser::LoadFile(LPCTSTR filename)
 	return bRet;
 }
 
+bool XMLParser::LoadDocument(LPCTSTR filename, std::string& document)
+{
+	ATLASSERT(m_pState != NULL);
+
+	setFileName(filename);
+
+	CFile file;
+	if(!file.Open(m_szFilename, 0))
+		return false;
+
+	long length = file.GetLength();
+	document.resize(length);
+	
+	if(length > 0)
+	{
+		int read = file.Read(&document[0], length);
+		document.resize(read > 0 ? read : 0);
+	}
+
+	file.Close();
+
+	if (!XML_Parse(m_parser, document.data(), document.size(), 1))
+	{
+		throw XMLParserException(this, XML_GetErrorCode(m_parser));
+	}
+
+	return true;
+}
+
 bool XMLParser::ParseBuffer(const char* buffer, DWORD dwRead, bool final)
 {
 	return XML_Parse(m_parser, buffer, dwRead, final) != 0;
 }
 
+void XMLParser::setFileName(LPCTSTR filename)
+{
+	if(m_szFilename != NULL)
+		delete [] m_szFilename;
+	m_szFilename = new TCHAR[_tcslen(filename)+1];
+	_tcscpy(m_szFilename, filename);
+}
+
 XML_Parser XMLParser::GetParser()
 {
 	return m_parser;
@@ -130,6 +130,14 @@ class XMLParser
 		XMLParser(bool namespaceAware = false);
 		~XMLParser();
 		bool LoadFile(LPCTSTR filename);
+
+		/**
+		 * Read the whole of filename into document and parse it in one go.
+		 * The caller keeps the document, so positions from
+		 * XML_GetCurrentByteIndex can be used to refer back into it.
+		 */
+		bool LoadDocument(LPCTSTR filename, std::string& document);
+
 		bool ParseBuffer(const char* buffer, DWORD dwRead, bool final);
 		void SetParseState(XMLParseState* pState);
 		void Reset();
@@ -137,6 +145,9 @@ class XMLParser
 		XML_Parser	GetParser();
 		LPCTSTR		GetFileName();
 
+	protected:
+		void setFileName(LPCTSTR filename);
+
 	protected:
 		XML_Parser		m_parser;
 		XMLParseState*	m_pState;